@@ -140,7 +140,7 @@ function _atk_g_ranged( target, dist )
       range = math.min ( range - dist * radial_vel / ( ai.getweapspeed( 4 ) - radial_vel ), range )
 
       local goal = ai.follow_accurate(target, range * 0.8, 0, 10, 20, "keepangle")
-      local mod = vec2.mod(goal - p:pos())
+      local mod = ai.dist(goal)
 
       --Must approach or stabilize
       if mod > 3000 then
@@ -167,7 +167,6 @@ function follow ()
 end
 function follow_accurate ()
    local target = ai.target()
-   local p = ai.pilot()
  
    -- Will just float without a target to escort.
    if not target:exists() then
@@ -178,7 +177,7 @@ function follow_accurate ()
    local goal = ai.follow_accurate(target, mem.radius, 
          mem.angle, mem.Kp, mem.Kd)
 
-   local mod = vec2.mod(goal - p:pos())
+   local mod = ai.dist(goal)
 
    --  Always face the goal
    local dir   = ai.face(goal)
@@ -364,9 +363,8 @@ function runaway ()
       ai.pushsubtask( "__landgo" )
    else 
       -- find which one is the closest
-      local pilpos = ai.pilot():pos()
-      local modt = vec2.mod(t:pos()-pilpos) 
-      local modp = vec2.mod(p:pos()-pilpos)
+      local modt = ai.dist(t:pos())
+      local modp = ai.dist(p:pos())
       if modt < modp then
          local pos = ai.sethyptarget(t)
          ai.pushsubtask( "__run_hyp", pos )
@@ -719,8 +717,8 @@ function mine ()
    if dir < 10 and mod > 300 then
       ai.accel()
    end
-   local relpos = vec2.add( p:pos(), vec2.mul(target2,-1) ):mod()
-   local relvel = vec2.add( p:vel(), vec2.mul(vel,-1) ):mod()
+   local relpos = ai.dist(target2)
+   local relvel = vec2.dist( p:vel(), vel )
    -- TODO : make 30 and 2 parameters dependent to Kp and Kd
    if relpos < 30 and relvel < 2 then
       ai.pushsubtask("__killasteroid")
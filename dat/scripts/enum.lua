@@ -1,3 +1,4 @@
+--@shared
 -- Enumerates the arguments passed to it. Arguments are used as keys and will be assigned numbers in the order they are passed.
 -- 
 -- Example usage: my_enum = enumerate({"first", "second", "third"})
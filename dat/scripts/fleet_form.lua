@@ -446,17 +446,10 @@ function Forma:control()
    self.thook = hook.timer(100, "toRepeat", self) -- Call the wrapper, not this function.
 
    --combat. mmmm.
-   local enemies = pilot.get(self.fleader:faction():enemies())
-
-   if self.fleader:hostile() then
-      enemies[#enemies+1] = player.pilot() -- Includes the player as an enemy to be iterated over.
-   end
-
-   for _, enemy in ipairs(enemies) do --Iterate over enemies to see if at least one is in range.
-      if enemy:pos():dist(self.fleader:pos()) < self.combat_dist then
-         inrange = true --The inrange variable was already defaulted to false.
-         break --If an enemy is in range, no need to continue looping.
-      end
+   --Enemies include the player if the leader is hostile to them.
+   for enemy in pilot.each{ hostile=self.fleader, pos=self.fleader, radius=self.combat_dist } do
+      inrange = true --The inrange variable was already defaulted to false.
+      break --If an enemy is in range, no need to continue looping.
    end
    
    --We want to seperate out the for loop that finds enemies and the if functions that control combat, so that all of the enemy pilots are iterated over to see if one is in range before controlling the pilots.
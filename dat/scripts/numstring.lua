@@ -1,3 +1,4 @@
+--@shared
 -- Converts an integer into a human readable string, delimiting every third digit with a comma.
 -- Note: rounds input to the nearest integer. Primary use is for payment descriptions.
 function numstring(number)
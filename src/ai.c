@@ -93,6 +93,7 @@
 #include "board.h"
 #include "hook.h"
 #include "array.h"
+#include "conf.h"
 
 
 /*
@@ -116,11 +117,40 @@
 #define AI_MEM_DEF      "def" /**< Default pilot memory. */
 
 
+/*
+ * equipment loadout cache
+ */
+#define EQUIP_CACHE_POOLS  256 /**< Maximum amount of loadout pools kept. */
+
+
+/**
+ * @brief Contents of a single outfit slot in a recorded loadout.
+ */
+typedef struct EquipSlot_ {
+   Outfit *outfit; /**< Outfit in the slot, NULL if empty. */
+   Outfit *ammo; /**< Ammo or fighters of the outfit. */
+   int quantity; /**< Amount of ammo. */
+} EquipSlot;
+
+
+/**
+ * @brief Loadouts generated by an equipper for a faction and ship.
+ */
+typedef struct EquipPool_ {
+   int faction; /**< Faction of the pilots. */
+   const Ship *ship; /**< Ship of the pilots. */
+   nlua_env env; /**< Equipper that generated them. */
+   EquipSlot **variants; /**< Recorded loadouts (array.h), one entry per outfit slot. */
+} EquipPool;
+
+
 /*
  * all the AI profiles
  */
 static AI_Profile* profiles = NULL; /**< Array of AI_Profiles loaded. */
 static nlua_env equip_env = LUA_NOREF; /**< Equipment enviornment. */
+static EquipPool *equip_pools = NULL; /**< Loadout pools (array.h). */
+static int equip_evict = 0; /**< Next pool to evict once full. */
 
 
 /*
@@ -139,6 +169,11 @@ static int ai_loadProfile( const char* filename );
 static void ai_setMemory (void);
 static void ai_create( Pilot* pilot );
 static int ai_loadEquip (void);
+/* Equipment loadout cache. */
+static void ai_equipFlush (void);
+static EquipPool* ai_equipPool( const Pilot *p, nlua_env env );
+static void ai_equipRecord( EquipPool *pool, const Pilot *p );
+static void ai_equipApply( Pilot *p, const EquipSlot *loadout );
 /* Task management. */
 static void ai_taskGC( Pilot* pilot );
 static Task* ai_curTask( Pilot* pilot );
@@ -343,6 +378,7 @@ static double pilot_acc    = 0.; /**< Current pilot's acceleration. */
 static double pilot_turn   = 0.; /**< Current pilot's turning. */
 static int pilot_flags     = 0; /**< Handle stuff like weapon firing. */
 static char aiL_distressmsg[PATH_MAX]; /**< Buffer to store distress message. */
+static size_t ai_allocated  = 0; /**< Bytes Lua allocated while running AI, see ai_memChurn(). */
 
 /*
  * ai status, used so that create functions can't be used elsewhere
@@ -433,6 +469,9 @@ void ai_setPilot( Pilot *p )
  */
 static void ai_run( nlua_env env, const char *funcname )
 {
+   size_t mem;
+
+   mem = nlua_allocCount();
    nlua_getenv(env, funcname);
 
 #ifdef DEBUGGING
@@ -448,6 +487,23 @@ static void ai_run( nlua_env env, const char *funcname )
       WARN( _("Pilot '%s' ai -> '%s': %s"), cur_pilot->name, funcname, lua_tostring(naevL,-1));
       lua_pop(naevL,1);
    }
+
+   ai_allocated += nlua_allocCount() - mem;
+}
+
+
+/**
+ * @brief Gets how many bytes the AI made Lua allocate since the last call.
+ *
+ * Measures the garbage the AI scripts generate, as nearly all of it is short
+ *  lived.
+ */
+size_t ai_memChurn (void)
+{
+   size_t mem;
+   mem = ai_allocated;
+   ai_allocated = 0;
+   return mem;
 }
 
 
@@ -598,28 +654,27 @@ int ai_load (void)
  */
 static int ai_loadEquip (void)
 {
-   char *buf;
-   size_t bufsize;
    const char *filename = "dat/factions/equip/generic.lua";
 
    /* Make sure doesn't already exist. */
    if (equip_env != LUA_NOREF)
       nlua_freeEnv(equip_env);
 
+   /* Loadouts of the previous equipper are stale. */
+   ai_equipFlush();
+
    /* Create new state. */
    equip_env = nlua_newEnv(1);
    nlua_loadStandard(equip_env);
 
    /* Load the file. */
-   buf = ndata_read( filename, &bufsize );
-   if (nlua_dobufenv(equip_env, buf, bufsize, filename) != 0) {
+   if (nlua_dondataenv(equip_env, filename) != 0) {
       WARN( _("Error loading file: %s\n"
           "%s\n"
           "Most likely Lua file has improper syntax, please check"),
             filename, lua_tostring(naevL, -1));
       return -1;
    }
-   free(buf);
 
    return 0;
 }
@@ -633,8 +688,6 @@ static int ai_loadEquip (void)
  */
 static int ai_loadProfile( const char* filename )
 {
-   char* buf = NULL;
-   size_t bufsize = 0;
    nlua_env env;
    AI_Profile *prof;
    size_t len;
@@ -673,8 +726,7 @@ static int ai_loadProfile( const char* filename )
    lua_pop(naevL, 1);                /*  */
 
    /* Now load the file since all the functions have been previously loaded */
-   buf = ndata_read( filename, &bufsize );
-   if (nlua_dobufenv(env, buf, bufsize, filename) != 0) {
+   if (nlua_dondataenv(env, filename) != 0) {
       WARN( _("Error loading AI file: %s\n"
           "%s\n"
           "Most likely Lua file has improper syntax, please check"),
@@ -682,10 +734,8 @@ static int ai_loadProfile( const char* filename )
       array_erase( &profiles, prof, &prof[1] );
       free(prof->name);
       nlua_freeEnv( env );
-      free(buf);
       return -1;
    }
-   free(buf);
 
    return 0;
 }
@@ -731,6 +781,9 @@ void ai_exit (void)
    if (equip_env != LUA_NOREF)
       nlua_freeEnv(equip_env);
    equip_env = LUA_NOREF;
+   ai_equipFlush();
+   array_free( equip_pools );
+   equip_pools = NULL;
 }
 
 
@@ -928,17 +981,144 @@ void ai_getDistress( Pilot *p, const Pilot *distressed, const Pilot *attacker )
 }
 
 
+/**
+ * @brief Frees all the recorded loadouts.
+ */
+static void ai_equipFlush (void)
+{
+   int i, j;
+
+   for (i=0; i<array_size(equip_pools); i++) {
+      for (j=0; j<array_size(equip_pools[i].variants); j++)
+         free( equip_pools[i].variants[j] );
+      array_free( equip_pools[i].variants );
+   }
+   if (equip_pools != NULL)
+      array_resize( &equip_pools, 0 );
+   equip_evict = 0;
+}
+
+
+/**
+ * @brief Gets the loadout pool for a pilot, creating it if needed.
+ *
+ * Once EQUIP_CACHE_POOLS pools exist, they are recycled round-robin.
+ *
+ *    @param p Pilot to get pool for.
+ *    @param env Equipper that will be used for the pilot.
+ *    @return The pool for the pilot.
+ */
+static EquipPool* ai_equipPool( const Pilot *p, nlua_env env )
+{
+   int i, j;
+   EquipPool *pool;
+
+   if (equip_pools == NULL)
+      equip_pools = array_create( EquipPool );
+
+   for (i=0; i<array_size(equip_pools); i++) {
+      pool = &equip_pools[i];
+      if ((pool->ship == p->ship) && (pool->faction == p->faction) &&
+            (pool->env == env))
+         return pool;
+   }
+
+   /* Make room. */
+   if (array_size(equip_pools) >= EQUIP_CACHE_POOLS) {
+      pool = &equip_pools[ equip_evict ];
+      equip_evict = (equip_evict+1) % EQUIP_CACHE_POOLS;
+      for (j=0; j<array_size(pool->variants); j++)
+         free( pool->variants[j] );
+      array_resize( &pool->variants, 0 );
+   }
+   else {
+      pool = &array_grow( &equip_pools );
+      pool->variants = array_create( EquipSlot* );
+   }
+   pool->faction  = p->faction;
+   pool->ship     = p->ship;
+   pool->env      = env;
+   return pool;
+}
+
+
+/**
+ * @brief Records the loadout a pilot was just equipped with.
+ *
+ *    @param pool Pool to record into.
+ *    @param p Pilot to record.
+ */
+static void ai_equipRecord( EquipPool *pool, const Pilot *p )
+{
+   int i;
+   EquipSlot *loadout;
+   const PilotOutfitSlot *s;
+
+   loadout = malloc( sizeof(EquipSlot) * p->noutfits );
+   for (i=0; i<p->noutfits; i++) {
+      s = p->outfits[i];
+      loadout[i].outfit    = s->outfit;
+      loadout[i].ammo      = NULL;
+      loadout[i].quantity  = 0;
+      if ((s->outfit != NULL) && (outfit_isLauncher(s->outfit) ||
+               outfit_isFighterBay(s->outfit))) {
+         loadout[i].ammo      = s->u.ammo.outfit;
+         loadout[i].quantity  = s->u.ammo.quantity;
+      }
+   }
+   array_push_back( &pool->variants, loadout );
+}
+
+
+/**
+ * @brief Equips a pilot with a recorded loadout in one go.
+ *
+ * Outfits are set raw and the stats are only calculated once at the end,
+ *  instead of after every outfit like the equipper does.
+ *
+ *    @param p Pilot to equip.
+ *    @param loadout Loadout to apply (one entry per slot).
+ */
+static void ai_equipApply( Pilot *p, const EquipSlot *loadout )
+{
+   int i;
+   PilotOutfitSlot *s;
+
+   for (i=0; i<p->noutfits; i++) {
+      s = p->outfits[i];
+      if (s->outfit != NULL)
+         pilot_rmOutfitRaw( p, s );
+      if (loadout[i].outfit == NULL)
+         continue;
+      pilot_addOutfitRaw( p, loadout[i].outfit, s );
+      if (loadout[i].ammo != NULL) {
+         s->u.ammo.outfit   = loadout[i].ammo;
+         s->u.ammo.quantity = loadout[i].quantity;
+      }
+   }
+
+   pilot_calcStats( p );
+   if (p->autoweap)
+      pilot_weaponAuto( p );
+}
+
+
 /**
  * @brief Runs the create() function in the pilot.
  *
  * Should create all the gear and such the pilot has.
  *
+ * With conf.equip_variants set, the first loadouts the equipper generates for
+ *  each faction and ship are recorded and further pilots get one of them at
+ *  random instead of running the equipper again.
+ *
  *    @param pilot Pilot to "create".
  */
 static void ai_create( Pilot* pilot )
 {
    nlua_env env;
    char *func;
+   EquipPool *pool;
 
    env = equip_env;
    func = "equip_generic";
@@ -954,13 +1134,30 @@ static void ai_create( Pilot* pilot )
          env = faction_getEquipper( pilot->faction );
          func = "equip";
       }
-      nlua_getenv(env, func);
-      nlua_pushenv(env);
-      lua_setfenv(naevL, -2);
-      lua_pushpilot(naevL, pilot->id);
-      if (nlua_pcall(env, 1, 0)) { /* Error has occurred. */
-         WARN( _("Pilot '%s' equip -> '%s': %s"), pilot->name, func, lua_tostring(naevL, -1));
-         lua_pop(naevL, 1);
+
+      /* Try to reuse a recorded loadout. */
+      pool = NULL;
+      if (conf.equip_variants > 0) {
+         pool = ai_equipPool( pilot, env );
+         if (array_size(pool->variants) >= conf.equip_variants) {
+            ai_equipApply( pilot,
+                  pool->variants[ RNG( 0, array_size(pool->variants)-1 ) ] );
+            pool = NULL;
+            env  = LUA_NOREF;
+         }
+      }
+
+      if (env != LUA_NOREF) {
+         nlua_getenv(env, func);
+         nlua_pushenv(env);
+         lua_setfenv(naevL, -2);
+         lua_pushpilot(naevL, pilot->id);
+         if (nlua_pcall(env, 1, 0)) { /* Error has occurred. */
+            WARN( _("Pilot '%s' equip -> '%s': %s"), pilot->name, func, lua_tostring(naevL, -1));
+            lua_pop(naevL, 1);
+         }
+         else if (pool != NULL)
+            ai_equipRecord( pool, pilot );
       }
    }
 
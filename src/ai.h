@@ -92,6 +92,7 @@ void ai_refuel( Pilot* refueler, unsigned int target );
 void ai_getDistress( Pilot *p, const Pilot *distressed, const Pilot *attacker );
 void ai_think( Pilot* pilot, const double dt );
 void ai_setPilot( Pilot *p );
+size_t ai_memChurn (void);
 
 
 #endif /* AI_H */
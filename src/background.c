@@ -421,9 +421,8 @@ static void background_renderImages( background_image_t *bkg_arr )
  */
 static nlua_env background_create( const char *name )
 {
-   size_t bufsize;
    char path[PATH_MAX];
-   char *buf;
+   int ret;
    nlua_env env;
 
    /* Create file name. */
@@ -436,25 +435,22 @@ static nlua_env background_create( const char *name )
    nlua_loadCol(env);
    nlua_loadBackground(env);
 
-   /* Open file. */
-   buf = ndata_read( path, &bufsize );
-   if (buf == NULL) {
+   /* Load file. */
+   ret = nlua_dondataenv(env, path);
+   if (ret == LUA_ERRFILE) {
       WARN( _("Default background script '%s' not found."), path);
+      lua_pop(naevL, 1);
       nlua_freeEnv(env);
       return LUA_NOREF;
    }
-
-   /* Load file. */
-   if (nlua_dobufenv(env, buf, bufsize, path) != 0) {
+   else if (ret != 0) {
       WARN( _("Error loading background file: %s\n"
             "%s\n"
             "Most likely Lua file has improper syntax, please check"),
             path, lua_tostring(naevL,-1));
-      free(buf);
       nlua_freeEnv(env);
       return LUA_NOREF;
    }
-   free(buf);
 
    return env;
 }
@@ -112,6 +112,27 @@ void cam_getPos( double *x, double *y )
 }
 
 
+/**
+ * @brief Gets the area of the system shown on the screen.
+ *
+ *    @param[out] x1 Left of the area.
+ *    @param[out] y1 Bottom of the area.
+ *    @param[out] x2 Right of the area.
+ *    @param[out] y2 Top of the area.
+ */
+void cam_getBounds( double *x1, double *y1, double *x2, double *y2 )
+{
+   double gx, gy;
+
+   /* Inverse of gl_gameToScreenCoords() on the screen corners. */
+   gui_getOffset( &gx, &gy );
+   *x1 = camera_X + (-gx - SCREEN_W/2.) / camera_Z;
+   *y1 = camera_Y + (-gy - SCREEN_H/2.) / camera_Z;
+   *x2 = camera_X + (-gx + SCREEN_W/2.) / camera_Z;
+   *y2 = camera_Y + (-gy + SCREEN_H/2.) / camera_Z;
+}
+
+
 /**
  * @brief Sets the target to follow.
  */
@@ -16,6 +16,7 @@
 double cam_getZoom (void);
 double cam_getZoomTarget (void);
 void cam_getPos( double *x, double *y );
+void cam_getBounds( double *x1, double *y1, double *x2, double *y2 );
 int cam_getTarget( void );
 
 
@@ -193,7 +193,12 @@ void conf_setGameplayDefaults (void)
    conf.afterburn_sens        = AFTERBURNER_SENSITIVITY_DEFAULT;
    conf.compression_velocity  = TIME_COMPRESSION_DEFAULT_MAX;
    conf.compression_mult      = TIME_COMPRESSION_DEFAULT_MULT;
+   conf.compression_lod       = TIME_COMPRESSION_DEFAULT_LOD;
    conf.save_compress         = SAVE_COMPRESSION_DEFAULT;
+   conf.lua_cache             = LUA_CACHE_DEFAULT;
+   conf.lua_gcpause           = LUA_GC_PAUSE_DEFAULT;
+   conf.lua_gcstepmul         = LUA_GC_STEPMUL_DEFAULT;
+   conf.equip_variants        = EQUIP_VARIANTS_DEFAULT;
    conf.mouse_thrust          = MOUSE_THRUST_DEFAULT;
    conf.mouse_doubleclick     = MOUSE_DOUBLECLICK_TIME;
    conf.autonav_reset_speed   = AUTONAV_RESET_SPEED_DEFAULT;
@@ -425,8 +430,13 @@ int conf_loadConfig ( const char* file )
       /* Misc. */
       conf_loadFloat("compression_velocity",conf.compression_velocity);
       conf_loadFloat("compression_mult",conf.compression_mult);
+      conf_loadBool("compression_lod",conf.compression_lod);
       conf_loadBool("redirect_file",conf.redirect_file);
       conf_loadBool("save_compress",conf.save_compress);
+      conf_loadBool("lua_cache",conf.lua_cache);
+      conf_loadInt("lua_gcpause",conf.lua_gcpause);
+      conf_loadInt("lua_gcstepmul",conf.lua_gcstepmul);
+      conf_loadInt("equip_variants",conf.equip_variants);
       conf_loadInt("afterburn_sensitivity",conf.afterburn_sens);
       conf_loadInt("mouse_thrust",conf.mouse_thrust);
       conf_loadFloat("mouse_doubleclick",conf.mouse_doubleclick);
@@ -1077,6 +1087,10 @@ int conf_saveConfig ( const char* file )
    conf_saveFloat("compression_mult",conf.compression_mult);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Simulates pilots far out of sensor range with a coarser step when time compression is enabled. Disable for exact, deterministic simulation."));
+   conf_saveBool("compression_lod",conf.compression_lod);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Redirects log and error output to files"));
    conf_saveBool("redirect_file",conf.redirect_file);
    conf_saveEmptyLine();
@@ -1085,6 +1099,22 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("save_compress",conf.save_compress);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Stores compiled Lua scripts in the cache directory to speed up loading"));
+   conf_saveBool("lua_cache",conf.lua_cache);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Lua garbage collector pause: waits for memory use to reach this percentage of what was in use after the last collection"));
+   conf_saveInt("lua_gcpause",conf.lua_gcpause);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Lua garbage collector step multiplier: how fast collection runs relative to allocation, in percent"));
+   conf_saveInt("lua_gcstepmul",conf.lua_gcstepmul);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Number of generated loadouts to remember per faction and ship, reused for new pilots (0 disables)"));
+   conf_saveInt("equip_variants",conf.equip_variants);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Afterburner sensitivity"));
    conf_saveInt("afterburn_sensitivity",conf.afterburn_sens);
    conf_saveEmptyLine();
@@ -14,6 +14,7 @@
 #define AFTERBURNER_SENSITIVITY_DEFAULT      250   /**< Default afterburner sensitivity. */
 #define TIME_COMPRESSION_DEFAULT_MAX         5000. /**< Maximum default level of time compression (target speed to match). */
 #define TIME_COMPRESSION_DEFAULT_MULT        200   /**< Default level of time compression multiplier. */
+#define TIME_COMPRESSION_DEFAULT_LOD         1     /**< Whether distant pilots are coarsely simulated during time compression. */
 #define REDIRECT_FILE_DEFAULT                1     /**< Whether output should be redirected to a file. */
 #define SAVE_COMPRESSION_DEFAULT             1     /**< Whether or not saved games should be compressed. */
 #define MOUSE_THRUST_DEFAULT                 1     /**< Whether or not to use mouse thrust controls. */
@@ -21,6 +22,10 @@
 #define AUTONAV_RESET_SPEED_DEFAULT          1.    /**< Shield level (0-1) to reset autonav speed at. 1 means at enemy presence, 0 means at armour damage. */
 #define MANUAL_ZOOM_DEFAULT                  0     /**< Whether or not to enable manual zoom controls. */
 #define INPUT_MESSAGES_DEFAULT               5     /**< Amount of messages to display. */
+#define LUA_CACHE_DEFAULT                    0     /**< Whether compiled Lua scripts should be persisted to the cache path. */
+#define LUA_GC_PAUSE_DEFAULT                 200   /**< Lua garbage collector pause (percent of memory in use to wait for). */
+#define LUA_GC_STEPMUL_DEFAULT               200   /**< Lua garbage collector step multiplier (percent of allocation speed). */
+#define EQUIP_VARIANTS_DEFAULT               0     /**< Loadouts recorded per faction and ship before reusing them (0 disables). */
 /* Video options */
 #define RESOLUTION_W_DEFAULT                 1024  /**< Default screen width. */
 #define RESOLUTION_H_DEFAULT                 768   /**< Default screen height. */
@@ -136,8 +141,13 @@ typedef struct PlayerConf_s {
    /* Misc. */
    double compression_velocity; /**< Velocity to compress to. */
    double compression_mult; /**< Maximum time multiplier. */
+   int compression_lod; /**< Coarsely simulate distant pilots during time compression. */
    int redirect_file; /**< Redirect output to files. */
    int save_compress; /**< Compress savegame. */
+   int lua_cache; /**< Persist compiled Lua bytecode to the cache path. */
+   int lua_gcpause; /**< Lua garbage collector pause. */
+   int lua_gcstepmul; /**< Lua garbage collector step multiplier. */
+   int equip_variants; /**< Loadouts to record per faction and ship, 0 to always run the equipper. */
    unsigned int afterburn_sens; /**< Afterburn sensibility. */
    int mouse_thrust; /**< Whether mouse flying controls thrust. */
    double mouse_doubleclick; /**< How long to consider double-clicks for. */
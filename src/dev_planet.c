@@ -19,6 +19,7 @@
 #include "nxml.h"
 #include "physics.h"
 #include "nfile.h"
+#include "ndata.h"
 #include "nstring.h"
 
 
@@ -137,6 +138,7 @@ int dpl_savePlanet( const Planet *p )
    cleanName = uniedit_nameFilter( p->name );
    nsnprintf( file, sizeof(file), "%s/%s.xml", conf.dev_save_asset, cleanName );
    xmlSaveFileEnc( file, doc, "UTF-8" );
+   ndata_invalidate();
 
    /* Clean up. */
    xmlFreeDoc(doc);
@@ -445,6 +445,7 @@ static void sysedit_btnRename( unsigned int wid_unused, char *unused )
          free(filtered);
 
          nfile_rename(oldName, newName);
+         ndata_invalidate();
 
          free(oldName);
          free(newName);
@@ -477,6 +478,7 @@ static void sysedit_btnRemove( unsigned int wid_unused, char *unused )
             file = malloc(16 + strlen(filtered));
             nsnprintf(file, 16 + strlen(filtered), "dat/assets/%s.xml", filtered);
             nfile_delete(file);
+            ndata_invalidate();
 
             free(filtered);
             free(file);
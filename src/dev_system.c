@@ -20,6 +20,7 @@
 #include "space.h"
 #include "physics.h"
 #include "nstring.h"
+#include "ndata.h"
 
 
 /*
@@ -197,6 +198,7 @@ int dsys_saveSystem( StarSystem *sys )
    cleanName = uniedit_nameFilter( sys->name );
    nsnprintf( file, sizeof(file), "%s/%s.xml", conf.dev_save_sys, cleanName );
    xmlSaveFileEnc( file, doc, "UTF-8" );
+   ndata_invalidate();
 
    /* Clean up. */
    xmlFreeDoc(doc);
@@ -316,6 +318,7 @@ int dsys_saveMap (StarSystem **uniedit_sys, int uniedit_nsys, char *fileName, ch
 
    /* Actually write data */
    xmlSaveFileEnc( file, doc, "UTF-8" );
+   ndata_invalidate();
    free( file );
 
    /* Clean up. */
@@ -27,6 +27,7 @@
 #include "dev_sysedit.h"
 #include "pause.h"
 #include "nfile.h"
+#include "ndata.h"
 #include "nstring.h"
 #include "conf.h"
 
@@ -718,6 +719,7 @@ static void uniedit_renameSys (void)
       free(filtered);
 
       nfile_rename(oldName,newName);
+      ndata_invalidate();
 
       free(oldName);
       free(newName);
@@ -36,6 +36,7 @@
 #include "rng.h"
 #include "space.h"
 #include "ntime.h"
+#include "icon.h"
 
 
 #define XML_COMMODITY_ID      "Commodities" /**< XML document identifier */
@@ -184,8 +185,6 @@ static void commodity_freeOne( Commodity* com )
       free(com->name);
    if (com->description)
       free(com->description);
-   if (com->gfx_store)
-      gl_freeTexture(com->gfx_store);
    if (com->gfx_space)
       gl_freeTexture(com->gfx_space);
 
@@ -245,21 +244,17 @@ static int commodity_parse( Commodity *temp, xmlNodePtr parent )
          temp->gfx_space = xml_parseTexture( node,
                COMMODITY_GFX_PATH"space/%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
       if (xml_isNode(node,"gfx_store")) {
-         temp->gfx_store = xml_parseTexture( node,
-               COMMODITY_GFX_PATH"%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
-         if (temp->gfx_store != NULL) {
-         } else {
-            temp->gfx_store = gl_newImage( COMMODITY_GFX_PATH"_default.png", 0 );
-         }
+         temp->gfx_store = xml_parseIcon( node,
+               COMMODITY_GFX_PATH"%s.png", COMMODITY_GFX_PATH"_default.png" );
          continue;
       }
    } while (xml_nextNode(node));
    if (temp->name == NULL)
       WARN( _("Commodity from %s has invalid or no name"), COMMODITY_DATA_PATH);
    if ((temp->price>0)) {
-      if (temp->gfx_store == NULL) {
+      if (temp->gfx_store == 0) {
          WARN(_("No <gfx_store> node found, using default texture for commodity \"%s\""), temp->name);
-         temp->gfx_store = gl_newImage( COMMODITY_GFX_PATH"_default.png", 0 );
+         temp->gfx_store = icon_new( COMMODITY_GFX_PATH"_default.png" );
       }
       if (temp->gfx_space == NULL)
          temp->gfx_space = gl_newImage( COMMODITY_GFX_PATH"space/_default.png", 0 );
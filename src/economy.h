@@ -32,7 +32,7 @@ typedef struct Commodity_ {
    char* description; /**< Description of the commodity. */
    /* Prices. */
    double price; /**< Base price of the commodity. */
-   glTexture* gfx_store; /**< Store graphic. */
+   int gfx_store; /**< Store graphic icon, see icon_get(). */
    glTexture* gfx_space; /**< Space graphic. */
 } Commodity;
 
@@ -34,6 +34,7 @@
 #include "slots.h"
 #include "map.h"
 #include "ndata.h"
+#include "icon.h"
 #include "tk/toolkit_priv.h" /* Yes, I'm a bad person, abstractions be damned! */
 
 
@@ -419,7 +420,7 @@ static void equipment_renderColumn( double x, double y, double w, double h,
 
       if (lst[i].outfit != NULL) {
          /* Draw bugger. */
-         gl_blitScale( lst[i].outfit->gfx_store,
+         gl_blitScale( icon_get( lst[i].outfit->gfx_store ),
                x, y, w, h, NULL );
       }
       else if ((o != NULL) &&
@@ -1518,7 +1519,7 @@ static void equipment_genOutfitList( unsigned int wid )
    noutfits = MAX( 1, player_numOutfits() ); /* This is the most we'll need, probably less due to filtering. */
    outfits  = calloc( noutfits, sizeof(Outfit*) );
    soutfits = calloc( noutfits, sizeof(char*) );
-   toutfits = calloc( noutfits, sizeof(glTexture*) );
+   toutfits = calloc( noutfits, sizeof(glTexture*) ); /* Loaded on demand. */
 
    filtertext = NULL;
    if (widget_exists(equipment_wid, EQUIPMENT_FILTER)) {
@@ -1528,7 +1529,7 @@ static void equipment_genOutfitList( unsigned int wid )
    }
 
    /* Get the outfits. */
-   noutfits = player_getOutfitsFiltered( outfits, toutfits,
+   noutfits = player_getOutfitsFiltered( outfits, NULL,
          tabfilters[active], filtertext );
 
    if (noutfits == 0) {
@@ -1549,6 +1550,7 @@ static void equipment_genOutfitList( unsigned int wid )
          toutfits, soutfits, noutfits,
          equipment_updateOutfits,
          equipment_rightClickOutfits );
+   toolkit_setImageArrayLoader( wid, EQUIPMENT_OUTFITS, outfits_getIcon );
 
    /* Case there are none we don't need to do more. */
    if (strcmp( soutfits[0], _("None") )==0)
@@ -244,8 +244,7 @@ static unsigned int event_genID (void)
  */
 static int event_create( int dataid, unsigned int *id )
 {
-   size_t bufsize;
-   char *buf;
+   int ret;
    Event_t *ev;
    EventData_t *data;
 
@@ -280,20 +279,19 @@ static int event_create( int dataid, unsigned int *id )
       nlua_loadTut(ev->env);
 
    /* Load file. */
-   buf = ndata_read( data->lua, &bufsize );
-   if (buf == NULL) {
+   ret = nlua_dondataenv(ev->env, data->lua);
+   if (ret == LUA_ERRFILE) {
       WARN(_("Event '%s' Lua script not found."), data->lua );
+      lua_pop(naevL, 1);
       return -1;
    }
-   if (nlua_dobufenv(ev->env, buf, bufsize, data->lua) != 0) {
+   else if (ret != 0) {
       WARN(_("Error loading event file: %s\n"
             "%s\n"
             "Most likely Lua file has improper syntax, please check"),
             data->lua, lua_tostring(naevL,-1));
-      free(buf);
       return -1;
    }
-   free(buf);
 
    /* Run Lua. */
    if ((id==NULL) || (*id==0))
@@ -781,12 +779,14 @@ int events_saveActive( xmlTextWriterPtr writer )
 
       /* Claims. */
       xmlw_startElem(writer,"claims");
-      claim_xmlSave( writer, ev->claims );
+      if (claim_xmlSave( writer, ev->claims ) < 0)
+         return -1;
       xmlw_endElem(writer); /* "claims" */
 
       /* Write Lua magic */
       xmlw_startElem(writer,"lua");
-      nxml_persistLua( ev->env, writer );
+      if (nxml_persistLua( ev->env, writer ) < 0)
+         return -1;
       xmlw_endElem(writer); /* "lua" */
 
       xmlw_endElem(writer); /* "event" */
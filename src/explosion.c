@@ -6,6 +6,18 @@
  * @file explosion.c
  *
  * @brief Handles gigantic explosions.
+ *
+ * Explosion damage is queued and done all at once by expl_update(), so
+ *  ships and weapons are looked up in the spatial indexes instead of each
+ *  explosion going over all of them.
+ *
+ * The queue is emptied right after space_update(), where asteroids blow up,
+ *  which is where their damage used to be done, and again after
+ *  pilots_update(), where pilots blow up. The damage of a pilot blowing up
+ *  used to be done in the middle of pilots_update(), so now the pilots after
+ *  it in the stack have already moved by the frame's step when it is done,
+ *  and the ones of them it kills get one more update before dying. Who is
+ *  hit and how hard, for the same positions, is checked by explosion_check.
  */
 
 
@@ -18,12 +30,21 @@
 #include "weapon.h"
 #include "spfx.h"
 #include "rng.h"
+#include "array.h"
 
 
 static int exp_s = -1; /**< Small explosion spfx. */
 static int exp_m = -1; /**< Medium explosion spfx. */
 static int exp_l = -1; /**< Large explosion spfx. */
 
+static ExplosionDamage *expl_queue = NULL; /**< Damage to do on the next expl_update() (array.h). */
+
+#if EXPL_CHECK
+int expl_checkErrors  = 0; /**< Differences with the old loops. */
+int expl_checkPilots  = 0; /**< Pilot hits checked. */
+int expl_checkWeapons = 0; /**< Weapons removed checked. */
+#endif /* EXPL_CHECK */
+
 
 /**
  * @brief Does explosion in a radius (damage and graphics).
@@ -87,6 +108,8 @@ void expl_explode( double x, double y, double vx, double vy,
 /**
  * @brief Does explosion damage in a radius.
  *
+ * The damage is done on the next expl_update().
+ *
  *    @param x X position of explosion center.
  *    @param y Y position of explosion center.
  *    @param radius Radius of the explosion.
@@ -99,12 +122,55 @@ void expl_explode( double x, double y, double vx, double vy,
 void expl_explodeDamage( double x, double y, double radius,
       const Damage *dmg, const Pilot *parent, int mode )
 {
+   ExplosionDamage *e;
+
+   if (expl_queue == NULL)
+      expl_queue = array_create( ExplosionDamage );
+
+   /* Parent may be gone by the time the damage is done. */
+   e           = &array_grow( &expl_queue );
+   e->x        = x;
+   e->y        = y;
+   e->radius   = radius;
+   e->dmg      = *dmg;
+   e->parent   = (parent != NULL) ? parent->id : 0;
+   e->mode     = mode;
+}
+
+
+/**
+ * @brief Does the damage of all the explosions queued so far.
+ */
+void expl_update (void)
+{
+   int i, n;
+   ExplosionDamage e;
+
+   if ((expl_queue == NULL) || (array_size(expl_queue) == 0))
+      return;
+
    /* Explosion affects ships. */
-   if (mode & EXPL_MODE_SHIP)
-      pilot_explode( x, y, radius, dmg, parent );
+   n = array_size(expl_queue);
+   for (i=0; i<n; i++) {
+      e = expl_queue[i]; /* Queue may grow while hitting. */
+      if (e.mode & EXPL_MODE_SHIP)
+         pilot_explode( e.x, e.y, e.radius, &e.dmg, e.parent );
+   }
 
    /* Explosion affects missiles and bolts. */
-   if ((mode & EXPL_MODE_MISSILE) || (mode & EXPL_MODE_BOLT))
-      weapon_explode( x, y, radius, dmg->type, dmg->damage, parent, mode );
+   weapons_explode( expl_queue, n );
+
+   /* Anything queued meanwhile waits for the next update. */
+   array_erase( &expl_queue, &expl_queue[0], &expl_queue[n] );
+}
+
+
+/**
+ * @brief Drops the explosion damage not done yet.
+ */
+void expl_clear (void)
+{
+   array_free( expl_queue );
+   expl_queue = NULL;
 }
 
@@ -17,11 +17,42 @@
 #define EXPL_MODE_BOLT     (1<<2) /**< Affects bolts. */
 
 
+/**
+ * @brief Set to 1 to check the damage done through the spatial indexes
+ *        against the old loops over every pilot and weapon (slow).
+ *
+ * explosion_check, run by "make check", is built with it on.
+ */
+#ifndef EXPL_CHECK
+#define EXPL_CHECK         0
+#endif /* EXPL_CHECK */
+
+
+/**
+ * @brief Explosion damage waiting for the end of the update.
+ */
+typedef struct ExplosionDamage_ {
+   double x; /**< X position of the centre. */
+   double y; /**< Y position of the centre. */
+   double radius; /**< Radius of the explosion. */
+   Damage dmg; /**< Damage done at the centre. */
+   unsigned int parent; /**< Id of the pilot responsible or 0. */
+   int mode; /**< What is affected, see EXPL_MODE_*. */
+} ExplosionDamage;
+
+
 void expl_explode( double x, double y, double vx, double vy,
       double radius, const Damage *dmg,
       const Pilot *parent, int mode );
 void expl_explodeDamage( double x, double y, double radius,
       const Damage *dmg, const Pilot *parent, int mode );
+void expl_update (void);
+void expl_clear (void);
+#if EXPL_CHECK
+extern int expl_checkErrors; /**< Differences with the old loops. */
+extern int expl_checkPilots; /**< Pilot hits checked. */
+extern int expl_checkWeapons; /**< Weapons removed checked. */
+#endif /* EXPL_CHECK */
 
 
 #endif /* EXPLOSION_H */
@@ -14,6 +14,7 @@
 #include "naev.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "nstring.h"
 
 #include "nxml.h"
@@ -27,6 +28,7 @@
 #include "colour.h"
 #include "hook.h"
 #include "space.h"
+#include "map.h"
 
 
 #define XML_FACTION_ID     "Factions"   /**< XML section identifier */
@@ -44,6 +46,15 @@
 #define faction_isFlag(fa,f)  ((fa)->flags & (f))
 #define faction_isKnown_(fa)   ((fa)->flags & (FACTION_KNOWN))
 
+/**
+ * @brief Set to 1 to check the relation matrix against the faction lists on
+ *        every areEnemies()/areAllies() (debug builds only, slow).
+ */
+#define FACTION_REL_CHECK     0
+
+#define faction_relBit(m,a,b) \
+   ((m)[ (a)*faction_relWords + ((b)>>5) ] & (UINT32_C(1) << ((b)&31))) /**< Tests a bit of a relation matrix. */
+
 /**
  * @struct Faction
  *
@@ -87,6 +98,11 @@ typedef struct Faction_ {
 static Faction* faction_stack = NULL; /**< Faction stack. */
 int faction_nstack = 0; /**< Number of factions in the faction stack. */
 
+/* Relations between all the factions, one bit per pair. */
+static uint32_t *faction_enemyBits = NULL; /**< Bit b of row a is set if a and b are enemies. */
+static uint32_t *faction_allyBits  = NULL; /**< Bit b of row a is set if a and b are allies. */
+static int faction_relWords        = 0; /**< Words in a row of the relation matrices. */
+
 
 /*
  * Prototypes
@@ -96,6 +112,12 @@ static void faction_sanitizePlayer( Faction* faction );
 static void faction_modPlayerLua( int f, double mod, const char *source, int secondary );
 static int faction_parse( Faction* temp, xmlNodePtr parent );
 static void faction_parseSocial( xmlNodePtr parent );
+static int faction_relEnemies( int a, int b );
+static int faction_relAllies( int a, int b );
+static void faction_relSet( uint32_t *m, int a, int b, int set );
+static void faction_relPair( int a, int b );
+static void faction_relPlayer( int f );
+static void faction_relBuild (void);
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -463,6 +485,8 @@ void faction_addEnemy( int f, int o)
    ff->nenemies++;
    ff->enemies = realloc(ff->enemies, sizeof(int)*ff->nenemies);
    ff->enemies[ff->nenemies-1] = o;
+
+   faction_relPair( f, o );
 }
 
 
@@ -491,6 +515,7 @@ void faction_rmEnemy( int f, int o)
          ff->enemies[i] = ff->enemies[ff->nenemies-1];
          ff->nenemies--;
          ff->enemies = realloc(ff->enemies, sizeof(int)*ff->nenemies);
+         faction_relPair( f, o );
          return;
       }
    }
@@ -540,6 +565,8 @@ void faction_addAlly( int f, int o)
    ff->nallies++;
    ff->allies = realloc(ff->allies, sizeof(int)*ff->nallies);
    ff->allies[ff->nallies-1] = o;
+
+   faction_relPair( f, o );
 }
 
 
@@ -568,6 +595,7 @@ void faction_rmAlly( int f, int o)
          ff->allies[i] = ff->allies[ff->nallies-1];
          ff->nallies--;
          ff->allies = realloc(ff->allies, sizeof(int)*ff->nallies);
+         faction_relPair( f, o );
          return;
       }
    }
@@ -613,6 +641,12 @@ static void faction_sanitizePlayer( Faction* faction )
       faction->player = 100.;
    else if (faction->player < -100.)
       faction->player = -100.;
+
+   /* Standing may change whether the player is an enemy or ally. */
+   faction_relPlayer( faction - faction_stack );
+
+   /* Standing changes the colours of the map. */
+   map_invalidate();
 }
 
 
@@ -755,6 +789,10 @@ void faction_modPlayerRaw( int f, double mod )
 
    faction = &faction_stack[f];
    faction->player += mod;
+
+   /* Sanitize just in case, hooks must see the new relations. */
+   faction_sanitizePlayer( faction );
+
    /* Run hook if necessary. */
    hparam[0].type    = HOOK_PARAM_FACTION;
    hparam[0].u.lf    = f;
@@ -763,9 +801,6 @@ void faction_modPlayerRaw( int f, double mod )
    hparam[2].type    = HOOK_PARAM_SENTINEL;
    hooks_runParam( "standing", hparam );
 
-   /* Sanitize just in case. */
-   faction_sanitizePlayer( faction );
-
    /* Tell space the faction changed. */
    space_factionChange();
 }
@@ -791,6 +826,10 @@ void faction_setPlayer( int f, double value )
    faction = &faction_stack[f];
    mod = value - faction->player;
    faction->player = value;
+
+   /* Sanitize just in case, hooks must see the new relations. */
+   faction_sanitizePlayer( faction );
+
    /* Run hook if necessary. */
    hparam[0].type    = HOOK_PARAM_FACTION;
    hparam[0].u.lf    = f;
@@ -799,9 +838,6 @@ void faction_setPlayer( int f, double value )
    hparam[2].type    = HOOK_PARAM_SENTINEL;
    hooks_runParam( "standing", hparam );
 
-   /* Sanitize just in case. */
-   faction_sanitizePlayer( faction );
-
    /* Tell space the faction changed. */
    space_factionChange();
 }
@@ -1068,34 +1104,19 @@ const char *faction_getStandingBroad( int f, int bribed, int override )
 
 
 /**
- * @brief Checks whether two factions are enemies.
+ * @brief Checks whether two valid factions are enemies from their lists.
  *
- *    @param a Faction A.
- *    @param b Faction B.
- *    @return 1 if A and B are enemies, 0 otherwise.
+ * Only used to fill in faction_enemyBits, which areEnemies() looks up.
  */
-int areEnemies( int a, int b)
+static int faction_relEnemies( int a, int b )
 {
    Faction *fa, *fb;
    int i;
 
    if (a==b) return 0; /* luckily our factions aren't masochistic */
 
-   /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
-      WARN(_("areEnemies: %d is an invalid faction"), a);
-      return 0;
-   }
-
-   /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
-      WARN(_("areEnemies: %d is an invalid faction"), b);
-      return 0;
-   }
+   fa = &faction_stack[a];
+   fb = &faction_stack[b];
 
    /* player handled separately */
    if (a==FACTION_PLAYER) {
@@ -1117,13 +1138,11 @@ int areEnemies( int a, int b)
 
 
 /**
- * @brief Checks whether two factions are allies or not.
+ * @brief Checks whether two valid factions are allies from their lists.
  *
- *    @param a Faction A.
- *    @param b Faction B.
- *    @return 1 if A and B are allies, 0 otherwise.
+ * Only used to fill in faction_allyBits, which areAllies() looks up.
  */
-int areAllies( int a, int b )
+static int faction_relAllies( int a, int b )
 {
    Faction *fa, *fb;
    int i;
@@ -1131,21 +1150,8 @@ int areAllies( int a, int b )
    /* If they are the same they must be allies. */
    if (a==b) return 1;
 
-   /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
-      WARN(_("%d is an invalid faction"), a);
-      return 0;
-   }
-
-   /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
-      WARN(_("%d is an invalid faction"), b);
-      return 0;
-   }
+   fa = &faction_stack[a];
+   fb = &faction_stack[b];
 
    /* we assume player becomes allies with high rating */
    if (a==FACTION_PLAYER) {
@@ -1166,6 +1172,139 @@ int areAllies( int a, int b )
 }
 
 
+/**
+ * @brief Sets or clears the bits of a pair in a relation matrix.
+ */
+static void faction_relSet( uint32_t *m, int a, int b, int set )
+{
+   uint32_t ba, bb;
+
+   ba = UINT32_C(1) << (b&31);
+   bb = UINT32_C(1) << (a&31);
+   if (set) {
+      m[ a*faction_relWords + (b>>5) ] |= ba;
+      m[ b*faction_relWords + (a>>5) ] |= bb;
+   }
+   else {
+      m[ a*faction_relWords + (b>>5) ] &= ~ba;
+      m[ b*faction_relWords + (a>>5) ] &= ~bb;
+   }
+}
+
+
+/**
+ * @brief Updates the relations between two factions.
+ */
+static void faction_relPair( int a, int b )
+{
+   if (faction_enemyBits == NULL)
+      return;
+   faction_relSet( faction_enemyBits, a, b, faction_relEnemies( a, b ) );
+   faction_relSet( faction_allyBits, a, b, faction_relAllies( a, b ) );
+}
+
+
+/**
+ * @brief Updates the relations between the player and a faction.
+ *
+ * These run the faction's standing script, so they are only computed when
+ *  the standing changes.
+ */
+static void faction_relPlayer( int f )
+{
+   if ((faction_enemyBits == NULL) || (f == FACTION_PLAYER))
+      return;
+   faction_relPair( FACTION_PLAYER, f );
+}
+
+
+/**
+ * @brief Computes the relations between all the factions.
+ */
+static void faction_relBuild (void)
+{
+   int a, b;
+   size_t size;
+
+   free( faction_enemyBits );
+   free( faction_allyBits );
+
+   faction_relWords  = (faction_nstack + 31) / 32;
+   size              = faction_nstack * faction_relWords * sizeof(uint32_t);
+   faction_enemyBits = calloc( 1, size );
+   faction_allyBits  = calloc( 1, size );
+
+   for (a=0; a<faction_nstack; a++)
+      for (b=a; b<faction_nstack; b++)
+         faction_relPair( a, b );
+}
+
+
+/**
+ * @brief Checks whether two factions are enemies.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are enemies, 0 otherwise.
+ */
+int areEnemies( int a, int b)
+{
+   int r;
+
+   if (a==b) return 0; /* luckily our factions aren't masochistic */
+
+   if (!faction_isFaction(a)) {
+      WARN(_("areEnemies: %d is an invalid faction"), a);
+      return 0;
+   }
+   if (!faction_isFaction(b)) {
+      WARN(_("areEnemies: %d is an invalid faction"), b);
+      return 0;
+   }
+
+   r = (faction_relBit( faction_enemyBits, a, b ) != 0);
+#if DEBUGGING && FACTION_REL_CHECK
+   if (r != faction_relEnemies( a, b ))
+      WARN(_("areEnemies: %s and %s are %d in the matrix instead of %d"),
+            faction_stack[a].name, faction_stack[b].name, r, !r );
+#endif /* DEBUGGING && FACTION_REL_CHECK */
+   return r;
+}
+
+
+/**
+ * @brief Checks whether two factions are allies or not.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are allies, 0 otherwise.
+ */
+int areAllies( int a, int b )
+{
+   int r;
+
+   /* If they are the same they must be allies. */
+   if (a==b) return 1;
+
+   if (!faction_isFaction(a)) {
+      WARN(_("%d is an invalid faction"), a);
+      return 0;
+   }
+   if (!faction_isFaction(b)) {
+      WARN(_("%d is an invalid faction"), b);
+      return 0;
+   }
+
+   r = (faction_relBit( faction_allyBits, a, b ) != 0);
+#if DEBUGGING && FACTION_REL_CHECK
+   if (r != faction_relAllies( a, b ))
+      WARN(_("areAllies: %s and %s are %d in the matrix instead of %d"),
+            faction_stack[a].name, faction_stack[b].name, r, !r );
+#endif /* DEBUGGING && FACTION_REL_CHECK */
+   return r;
+}
+
+
 /**
  * @brief Checks whether or not a faction is valid.
  *
@@ -1191,9 +1330,8 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
 {
    xmlNodePtr node;
    int player;
-   char buf[PATH_MAX], *dat, *ctmp;
+   char buf[PATH_MAX], *ctmp;
    glColour *col;
-   size_t ndat;
 
    /* Clear memory. */
    memset( temp, 0, sizeof(Faction) );
@@ -1256,8 +1394,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
          nsnprintf( buf, sizeof(buf), "dat/factions/spawn/%s.lua", xml_raw(node) );
          temp->sched_env = nlua_newEnv(1);
          nlua_loadStandard( temp->sched_env);
-         dat = ndata_read( buf, &ndat );
-         if (nlua_dobufenv(temp->sched_env, dat, ndat, buf) != 0) {
+         if (nlua_dondataenv(temp->sched_env, buf) != 0) {
             WARN(_("Failed to run spawn script: %s\n"
                   "%s\n"
                   "Most likely Lua file has improper syntax, please check"),
@@ -1265,7 +1402,6 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             nlua_freeEnv( temp->sched_env );
             temp->sched_env = LUA_NOREF;
          }
-         free(dat);
          continue;
       }
 
@@ -1275,8 +1411,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
          nsnprintf( buf, sizeof(buf), "dat/factions/standing/%s.lua", xml_raw(node) );
          temp->env = nlua_newEnv(1);
          nlua_loadStandard( temp->env );
-         dat = ndata_read( buf, &ndat );
-         if (nlua_dobufenv(temp->env, dat, ndat, buf) != 0) {
+         if (nlua_dondataenv(temp->env, buf) != 0) {
             WARN(_("Failed to run standing script: %s\n"
                   "%s\n"
                   "Most likely Lua file has improper syntax, please check"),
@@ -1284,7 +1419,6 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             nlua_freeEnv( temp->env );
             temp->env = LUA_NOREF;
          }
-         free(dat);
          continue;
       }
 
@@ -1299,8 +1433,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
          nsnprintf( buf, sizeof(buf), "dat/factions/equip/%s.lua", xml_raw(node) );
          temp->equip_env = nlua_newEnv(1);
          nlua_loadStandard( temp->equip_env );
-         dat = ndata_read( buf, &ndat );
-         if (nlua_dobufenv(temp->equip_env, dat, ndat, buf) != 0) {
+         if (nlua_dondataenv(temp->equip_env, buf) != 0) {
             WARN(_("Failed to run equip script: %s\n"
                   "%s\n"
                   "Most likely Lua file has improper syntax, please check"),
@@ -1308,7 +1441,6 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             nlua_freeEnv( temp->equip_env );
             temp->equip_env = LUA_NOREF;
          }
-         free(dat);
          continue;
       }
 
@@ -1427,8 +1559,10 @@ static void faction_parseSocial( xmlNodePtr parent )
 void factions_reset (void)
 {
    int i;
-   for (i=0; i<faction_nstack; i++)
+   for (i=0; i<faction_nstack; i++) {
       faction_stack[i].player = faction_stack[i].player_def;
+      faction_relPlayer( i );
+   }
 }
 
 
@@ -1535,6 +1669,9 @@ int factions_load (void)
    xmlFreeDoc(doc);
    free(buf);
 
+   /* Relations are looked up from now on. */
+   faction_relBuild();
+
    DEBUG( ngettext( "Loaded %d Faction", "Loaded %d Factions", faction_nstack ), faction_nstack );
 
    return 0;
@@ -1573,6 +1710,13 @@ void factions_free (void)
    free(faction_stack);
    faction_stack = NULL;
    faction_nstack = 0;
+
+   /* Free relations. */
+   free( faction_enemyBits );
+   free( faction_allyBits );
+   faction_enemyBits = NULL;
+   faction_allyBits  = NULL;
+   faction_relWords  = 0;
 }
 
 
@@ -1639,8 +1783,10 @@ int pfaction_load( xmlNodePtr parent )
                      if (xml_isNode(sub,"standing")) {
 
                         /* Must not be static. */
-                        if (!faction_isFlag( &faction_stack[faction], FACTION_STATIC ))
+                        if (!faction_isFlag( &faction_stack[faction], FACTION_STATIC )) {
                            faction_stack[faction].player = xml_getFloat(sub);
+                           faction_relPlayer( faction );
+                        }
                         continue;
                      }
                      if (xml_isNode(sub,"known")) {
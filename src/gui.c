@@ -2146,19 +2146,14 @@ char* gui_pick (void)
 int gui_load( const char* name )
 {
    (void) name;
-   char *buf, path[PATH_MAX];
-   size_t bufsize;
+   char path[PATH_MAX];
+   int ret;
 
    /* Set defaults. */
    gui_cleanup();
 
    /* Open file. */
    nsnprintf( path, sizeof(path), "dat/gui/%s.lua", name );
-   buf = ndata_read( path, &bufsize );
-   if (buf == NULL) {
-      WARN(_("Unable to find GUI '%s'."), path );
-      return -1;
-   }
 
    /* Clean up. */
    if (gui_env != LUA_NOREF) {
@@ -2168,17 +2163,23 @@ int gui_load( const char* name )
 
    /* Create Lua state. */
    gui_env = nlua_newEnv(1);
-   if (nlua_dobufenv( gui_env, buf, bufsize, path ) != 0) {
+   ret = nlua_dondataenv( gui_env, path );
+   if (ret == LUA_ERRFILE) {
+      WARN(_("Unable to find GUI '%s'."), path );
+      lua_pop(naevL, 1);
+      nlua_freeEnv( gui_env );
+      gui_env = LUA_NOREF;
+      return -1;
+   }
+   else if (ret != 0) {
       WARN(_("Failed to load GUI Lua: %s\n"
             "%s\n"
             "Most likely Lua file has improper syntax, please check"),
             path, lua_tostring(naevL,-1));
       nlua_freeEnv( gui_env );
       gui_env = LUA_NOREF;
-      free(buf);
       return -1;
    }
-   free(buf);
    nlua_loadStandard( gui_env );
    nlua_loadGFX( gui_env );
    nlua_loadGUI( gui_env );
@@ -30,6 +30,7 @@
 #include "nstring.h"
 
 #include "log.h"
+#include "array.h"
 #include "nxml.h"
 #include "player.h"
 #include "event.h"
@@ -49,7 +50,7 @@
  */
 typedef struct HookQueue_s {
    struct HookQueue_s *next; /**< Next in linked list. */
-   char *stack;         /**< Stack to run. */
+   int stack;           /**< Stack to run. */
    unsigned int id;     /**< Run specific hook. */
    HookParam hparam[ HOOK_MAX_PARAM ]; /**< Parameters. */
 } HookQueue_t;
@@ -76,9 +77,11 @@ typedef enum HookType_e {
  */
 typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
+   struct Hook_ *stack_next; /**< Next hook in the same stack. */
 
    unsigned int id; /**< unique id */
-   char *stack; /**< stack it's a part of */
+   const char *stack; /**< stack it's a part of, owned by the stack table */
+   int stackid; /**< Interned id of the stack. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
@@ -86,7 +89,8 @@ typedef struct Hook_ {
 
    /* Timer information. */
    int is_timer; /**< Whether or not is actually a timer. */
-   double ms; /**< Milliseconds left. */
+   double deadline; /**< Timer clock value at which the timer fires. */
+   int heap; /**< Position in the timer heap, -1 when not in it. */
 
    /* Date information. */
    int is_date; /**< Whether or not it is a date hook. */
@@ -107,6 +111,18 @@ typedef struct Hook_ {
 } Hook;
 
 
+/**
+ * @brief Interned hook stack.
+ *
+ * Stack names are interned to ids the first time they are seen, so running
+ *  a stack only has to walk the hooks that belong to it.
+ */
+typedef struct HookStack_ {
+   char *name; /**< Name of the stack. */
+   Hook *list; /**< Hooks in the stack, newest first. */
+} HookStack;
+
+
 /*
  * the stack
  */
@@ -114,6 +130,11 @@ static unsigned int hook_id   = 0; /**< Unique hook id generator. */
 static Hook* hook_list        = NULL; /**< Stack of hooks. */
 static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
+static int hook_npurge        = 0; /**< Number of hooks pending deletion. */
+static HookStack *hook_stacks = NULL; /**< Interned stacks (array.h). */
+static Hook **hook_timers     = NULL; /**< Min-heap of timer hooks by deadline (array.h). */
+static Hook **hook_due        = NULL; /**< Timer hooks due this update (array.h). */
+static double hook_clock      = 0.; /**< Timer clock, advanced by hooks_update. */
 
 
 /*
@@ -124,7 +145,15 @@ static int hooks_executeParam( const char* stack, HookParam *param );
 static void hooks_updateDateExecute( ntime_t change );
 /* intern */
 static void hook_rmRaw( Hook *h );
+static void hook_setDelete( Hook *h );
 static void hooks_purgeList (void);
+/* Stacks and timers. */
+static int hook_stackID( const char *stack );
+static void hook_timerSwap( int a, int b );
+static void hook_timerUp( int i );
+static void hook_timerDown( int i );
+static void hook_timerAdd( Hook *h, double ms );
+static void hook_timerRemove( Hook *h );
 static Hook* hook_get( unsigned int id );
 static unsigned int hook_genID (void);
 static Hook* hook_new( HookType_t type, const char *stack );
@@ -167,8 +196,6 @@ static int hq_add( HookQueue_t *hq )
  */
 static void hq_free( HookQueue_t *hq )
 {
-   if (hq->stack != NULL)
-      free(hq->stack);
    free(hq);
 }
 
@@ -212,7 +239,7 @@ void hook_exclusionEnd( double dt )
       hook_queue = hq->next;
 
       /* Execute. */
-      hooks_executeParam( hq->stack, hq->hparam );
+      hooks_executeParam( hook_stacks[ hq->stack ].name, hq->hparam );
 
       /* Clean up. */
       hq_free( hq );
@@ -309,7 +336,7 @@ static int hook_runMisn( Hook *hook, HookParam *param, int claims )
    /* Make sure it's valid. */
    if (hook->u.misn.parent == 0) {
       WARN(_("Trying to run hook with inexistant parent: deleting"));
-      hook->delete = 1; /* so we delete it */
+      hook_setDelete( hook ); /* so we delete it */
       return -1;
    }
 
@@ -317,7 +344,7 @@ static int hook_runMisn( Hook *hook, HookParam *param, int claims )
    misn = hook_getMission( hook );
    if (misn == NULL) {
       WARN(_("Trying to run hook with parent not in player mission stack: deleting"));
-      hook->delete = 1; /* so we delete it */
+      hook_setDelete( hook ); /* so we delete it */
       return -1;
    }
 
@@ -371,7 +398,7 @@ static int hook_runEvent( Hook *hook, HookParam *param, int claims )
    if (event_get(hook->u.event.parent) == NULL) {
       WARN(_("Hook [%s] '%d' -> '%s' failed, event does not exist. Deleting hook."), hook->stack,
             hook->id, hook->u.event.func);
-      hook->delete = 1; /* Set for deletion. */
+      hook_setDelete( hook ); /* Set for deletion. */
       return -1;
    }
 
@@ -425,7 +452,7 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
 
       default:
          WARN(_("Invalid hook type '%d', deleting."), hook->type);
-         hook->delete = 1;
+         hook_setDelete( hook );
          return -1;
    }
 
@@ -466,6 +493,7 @@ static unsigned int hook_genID (void)
 static Hook* hook_new( HookType_t type, const char *stack )
 {
    Hook *new_hook;
+   int id;
 
    /* Get and create new hook. */
    new_hook = calloc( 1, sizeof(Hook) );
@@ -477,11 +505,18 @@ static Hook* hook_new( HookType_t type, const char *stack )
       hook_list = new_hook;
    }
 
+   /* Also put at the front of its stack. */
+   id = hook_stackID( stack );
+   new_hook->stack_next = hook_stacks[id].list;
+   hook_stacks[id].list = new_hook;
+
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup(stack);
+   new_hook->stack   = hook_stacks[id].name;
+   new_hook->stackid = id;
    new_hook->created = 1;
+   new_hook->heap    = -1;
 
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
@@ -557,8 +592,7 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms
    new_hook->u.misn.func   = strdup(func);
 
    /* Timer information. */
-   new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   hook_timerAdd( new_hook, ms );
 
    return new_hook->id;
 }
@@ -584,50 +618,176 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
    new_hook->u.event.func   = strdup(func);
 
    /* Timer information. */
-   new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   hook_timerAdd( new_hook, ms );
 
    return new_hook->id;
 }
 
 
+/**
+ * @brief Gets the id of a hook stack, interning it if it's new.
+ *
+ *    @param stack Name of the stack.
+ *    @return Id of the stack.
+ */
+static int hook_stackID( const char *stack )
+{
+   int i;
+   HookStack *hs;
+
+   if (hook_stacks == NULL)
+      hook_stacks = array_create( HookStack );
+
+   /* There are only a handful of distinct stacks. */
+   for (i=0; i<array_size(hook_stacks); i++)
+      if (strcmp(hook_stacks[i].name, stack)==0)
+         return i;
+
+   hs       = &array_grow( &hook_stacks );
+   hs->name = strdup( stack );
+   hs->list = NULL;
+   return array_size(hook_stacks)-1;
+}
+
+
+/**
+ * @brief Swaps two elements of the timer heap.
+ */
+static void hook_timerSwap( int a, int b )
+{
+   Hook *h;
+   h              = hook_timers[a];
+   hook_timers[a] = hook_timers[b];
+   hook_timers[b] = h;
+   hook_timers[a]->heap = a;
+   hook_timers[b]->heap = b;
+}
+
+
+/**
+ * @brief Moves a timer up the heap until its parent fires before it.
+ */
+static void hook_timerUp( int i )
+{
+   int p;
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (hook_timers[p]->deadline <= hook_timers[i]->deadline)
+         break;
+      hook_timerSwap( i, p );
+      i = p;
+   }
+}
+
+
+/**
+ * @brief Moves a timer down the heap until its children fire after it.
+ */
+static void hook_timerDown( int i )
+{
+   int n, c;
+   n = array_size(hook_timers);
+   for (;;) {
+      c = 2*i+1;
+      if (c >= n)
+         break;
+      if ((c+1 < n) && (hook_timers[c+1]->deadline < hook_timers[c]->deadline))
+         c++;
+      if (hook_timers[i]->deadline <= hook_timers[c]->deadline)
+         break;
+      hook_timerSwap( i, c );
+      i = c;
+   }
+}
+
+
+/**
+ * @brief Turns a hook into a timer and adds it to the timer heap.
+ *
+ *    @param h Hook to add.
+ *    @param ms Time until it fires.
+ */
+static void hook_timerAdd( Hook *h, double ms )
+{
+   if (hook_timers == NULL)
+      hook_timers = array_create( Hook* );
+
+   h->is_timer = 1;
+   h->deadline = hook_clock + ms;
+   h->heap     = array_size(hook_timers);
+   array_push_back( &hook_timers, h );
+   hook_timerUp( h->heap );
+}
+
+
+/**
+ * @brief Removes a timer hook from the timer heap.
+ *
+ *    @param h Hook to remove.
+ */
+static void hook_timerRemove( Hook *h )
+{
+   int i, n;
+   Hook *last;
+
+   i = h->heap;
+   if (i < 0)
+      return;
+   h->heap = -1;
+
+   /* Fill the hole with the last timer and restore the heap. */
+   n    = array_size(hook_timers)-1;
+   last = hook_timers[n];
+   array_resize( &hook_timers, n );
+   if (i == n)
+      return;
+   hook_timers[i] = last;
+   last->heap     = i;
+   hook_timerUp( i );
+   hook_timerDown( last->heap );
+}
+
+
 /**
  * @brief Purges the list of deletable hooks.
  */
 static void hooks_purgeList (void)
 {
-   Hook *h, *hl;
+   int i;
+   Hook *h, **hp;
 
    /* Do not run while stack is being run. */
    if (hook_runningstack)
       return;
 
-   /* Second pass to delete. */
-   hl = NULL;
-   h  = hook_list;
-   while (h != NULL) {
-      /* Find valid timer hooks. */
-      if (h->delete) {
+   /* Nothing to do. */
+   if (hook_npurge == 0)
+      return;
 
-         if (hl == NULL)
-            hook_list = h->next;
+   /* Unlink from the stacks. */
+   for (i=0; i<array_size(hook_stacks); i++) {
+      hp = &hook_stacks[i].list;
+      while (*hp != NULL) {
+         if ((*hp)->delete)
+            *hp = (*hp)->stack_next;
          else
-            hl->next  = h->next;
+            hp = &(*hp)->stack_next;
+      }
+   }
 
-         /* Free. */
+   /* Second pass to delete. */
+   hp = &hook_list;
+   while (*hp != NULL) {
+      h = *hp;
+      if (h->delete) {
+         *hp = h->next;
          h->next = NULL;
          hook_free( h );
-
-         /* Last. */
-         h = hl;
       }
-
-      hl = h;
-      if (h == NULL)
-         h = hook_list;
       else
-         h = h->next;
+         hp = &h->next;
    }
+   hook_npurge = 0;
 }
 
 
@@ -646,21 +806,24 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
-   int j;
+   int j, id;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
+   /* Date hooks all live in the "date" stack. */
+   id = hook_stackID( "date" );
+
    /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
+   for (h=hook_stacks[id].list; h!=NULL; h=h->stack_next)
       h->created = 0;
 
    /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->stack_next) {
          /* Find valid date hooks. */
          if (h->is_date == 0)
             continue;
@@ -732,44 +895,55 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
 
 /**
  * @brief Updates all the hook timer related stuff.
+ *
+ * Timers are kept in a heap by deadline so only the ones that are due get
+ *  touched.
  */
 void hooks_update( double dt )
 {
-   int j;
+   int i, j;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   /* Restart the clock when idle so it doesn't lose precision. */
+   if ((hook_timers == NULL) || (array_size(hook_timers) == 0)) {
+      hook_clock = 0.;
+      return;
+   }
+   hook_clock += dt;
+
+   /* Pop the timers that are due, timers created while running them will
+    * not be run until the next update. */
+   if (hook_due == NULL)
+      hook_due = array_create( Hook* );
+   array_resize( &hook_due, 0 );
+   while ((array_size(hook_timers) > 0) && (hook_timers[0]->deadline <= hook_clock)) {
+      h = hook_timers[0];
+      hook_timerRemove( h );
+      if (!h->delete)
+         array_push_back( &hook_due, h );
+   }
 
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (i=0; i<array_size(hook_due); i++) {
+         h = hook_due[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid timer hooks. */
-         if (h->is_timer == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==0)
-            h->ms -= dt;
-         if (h->ms > 0.)
+         /* Already ran on the claimed pass. */
+         if (h->ran_once)
             continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
-         hook_rmRaw( h );
       }
    }
+   for (i=0; i<array_size(hook_due); i++)
+      hook_rmRaw( hook_due[i] );
    hook_runningstack--; /* not running hooks anymore */
 
    /* Second pass to delete. */
@@ -813,11 +987,23 @@ void hook_rm( unsigned int id )
  */
 static void hook_rmRaw( Hook *h )
 {
-   h->delete = 1;
+   hook_setDelete( h );
    hookL_unsetarg( h->id );
 }
 
 
+/**
+ * @brief Marks a hook for deletion when the stacks are purged.
+ */
+static void hook_setDelete( Hook *h )
+{
+   if (h->delete)
+      return;
+   h->delete = 1;
+   hook_npurge++;
+}
+
+
 /**
  * @brief Removes all hooks belonging to parent mission.
  *
@@ -829,7 +1015,7 @@ void hook_rmMisnParent( unsigned int parent )
 
    for (h=hook_list; h!=NULL; h=h->next)
       if ((h->type==HOOK_TYPE_MISN) && (parent == h->u.misn.parent))
-         h->delete = 1;
+         hook_setDelete( h );
 }
 
 
@@ -844,7 +1030,7 @@ void hook_rmEventParent( unsigned int parent )
 
    for (h=hook_list; h!=NULL; h=h->next)
       if ((h->type==HOOK_TYPE_EVENT) && (parent == h->u.event.parent))
-         h->delete = 1;
+         hook_setDelete( h );
 }
 
 
@@ -891,7 +1077,7 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char* stack, HookParam *param )
 {
-   int j;
+   int j, id;
    int run;
    Hook *h;
 
@@ -899,17 +1085,19 @@ static int hooks_executeParam( const char* stack, HookParam *param )
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   /* Only the hooks of the stack get touched. */
+   id = hook_stackID( stack );
+
    /* Reset the current stack's ran and creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (h=hook_stacks[id].list; h!=NULL; h=h->stack_next) {
+      h->ran_once = 0;
+      h->created = 0;
+   }
 
    run = 0;
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->stack_next) {
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -919,9 +1107,6 @@ static int hooks_executeParam( const char* stack, HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
-            continue;
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -956,7 +1141,7 @@ int hooks_runParam( const char* stack, HookParam *param )
    /* Not time to run hooks, so queue them. */
    if (hook_atomic) {
       hq = calloc( 1, sizeof(HookQueue_t) );
-      hq->stack = strdup(stack);
+      hq->stack = hook_stackID( stack );
       for (i=0; param[i].type != HOOK_PARAM_SENTINEL; i++)
          hq->hparam[i] = param[i];
 #ifdef DEBUGGING
@@ -1079,8 +1264,7 @@ static void hook_free( Hook *h )
    pilots_rmHook( h->id );
 
    /* Generic freeing. */
-   if (h->stack != NULL)
-      free(h->stack);
+   hook_timerRemove( h );
 
    /* Free type specific. */
    switch (h->type) {
@@ -1107,6 +1291,7 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup (void)
 {
+   int i;
    Hook *h, *hn;
 
    if (hook_runningstack)
@@ -1123,6 +1308,12 @@ void hook_cleanup (void)
    }
    /* sane defaults just in case */
    hook_list  = NULL;
+   hook_npurge = 0;
+   hook_clock = 0.;
+
+   /* Stacks stay interned, they just become empty. */
+   for (i=0; i<array_size(hook_stacks); i++)
+      hook_stacks[i].list = NULL;
 }
 
 
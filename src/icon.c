@@ -0,0 +1,444 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file icon.c
+ *
+ * @brief Lazily loaded store icons packed into atlas pages.
+ *
+ * Store graphics of outfits and commodities are only registered by path when
+ *  the data is loaded. The image is loaded the first time the icon is
+ *  displayed and copied into a free cell of an atlas page, a texture shared by
+ *  all the icons of the same cell size. The icon's glTexture points at the
+ *  page with the position of its cell in glTexture::ox and glTexture::oy, so
+ *  it is drawn with the usual blits, which sample just its sub-rectangle.
+ *  Images too big for a cell get a texture of their own.
+ *
+ * Icons stay loaded until icon_gc() finds them among the least recently used
+ *  ones once more than ICON_CACHE_MAX are loaded, their cells are then free
+ *  for other icons and the pages left empty are freed.
+ *
+ * Icons are referred to by handle, where 0 is no icon.
+ */
+
+
+#include "icon.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "array.h"
+#include "ndata.h"
+#include "npng.h"
+
+
+#define ICON_PAGE_SIZE  2048 /**< Width and height of an atlas page. */
+#define ICON_CELL_MIN   64 /**< Smallest cell of an atlas page. */
+#define ICON_CELL_MAX   256 /**< Biggest cell of an atlas page, bigger images aren't packed. */
+
+
+/**
+ * @brief A registered icon.
+ */
+typedef struct Icon_ {
+   char *path; /**< Path of the graphic. */
+   glTexture *tex; /**< Loaded texture or NULL if not loaded. */
+   int page; /**< Atlas page holding the icon or -1 if it has its own texture. */
+   int cell; /**< Cell of the page holding the icon. */
+   unsigned int used; /**< Last time the icon was requested. */
+   int failed; /**< Failed to load, don't try again. */
+} Icon;
+
+
+/**
+ * @brief An atlas page, a texture split into square cells of the same size.
+ */
+typedef struct IconPage_ {
+   GLuint texture; /**< Texture of the page or 0 if the page is free. */
+   int size; /**< Width and height of the texture. */
+   int cell; /**< Width and height of a cell. */
+   int ncells; /**< Number of cells. */
+   int nused; /**< Number of cells holding an icon. */
+   char *used; /**< Whether each cell holds an icon. */
+} IconPage;
+
+
+static Icon *icon_stack = NULL; /**< Registered icons. */
+static IconPage *icon_pages = NULL; /**< Atlas pages. */
+static unsigned int icon_clock = 0; /**< Incremented on every request. */
+static int icon_nloaded = 0; /**< Number of loaded icons. */
+
+
+/*
+ * Prototypes.
+ */
+static int icon_pageNew( int cell );
+static int icon_cellNew( int cellsize, int *cell );
+static glTexture* icon_load( Icon *ico );
+static void icon_unload( Icon *ico );
+static int icon_cmpUsed( const void *p1, const void *p2 );
+
+
+/**
+ * @brief Registers an icon without loading it.
+ *
+ *    @param path Path of the graphic to use.
+ *    @return Handle of the icon or 0 on error.
+ */
+int icon_new( const char *path )
+{
+   Icon *ico;
+
+   if (path == NULL)
+      return 0;
+
+   if (icon_stack == NULL)
+      icon_stack = array_create( Icon );
+
+   ico         = &array_grow( &icon_stack );
+   ico->path   = strdup( path );
+   ico->tex    = NULL;
+   ico->page   = -1;
+   ico->cell   = 0;
+   ico->used   = 0;
+   ico->failed = 0;
+
+   return array_size( icon_stack );
+}
+
+
+/**
+ * @brief Creates an atlas page.
+ *
+ *    @param cell Width and height of the cells of the page.
+ *    @return Index of the page in icon_pages.
+ */
+static int icon_pageNew( int cell )
+{
+   int i;
+   IconPage *pg;
+
+   /* Reuse a page freed by icon_gc(). */
+   pg = NULL;
+   for (i=0; i<array_size(icon_pages); i++) {
+      if (icon_pages[i].texture == 0) {
+         pg = &icon_pages[i];
+         break;
+      }
+   }
+   if (pg == NULL) {
+      pg = &array_grow( &icon_pages );
+      i  = array_size( icon_pages ) - 1;
+   }
+
+   pg->size    = MIN( ICON_PAGE_SIZE, gl_screen.tex_max );
+   pg->cell    = cell;
+   pg->ncells  = (pg->size / cell) * (pg->size / cell);
+   pg->nused   = 0;
+   pg->used    = calloc( pg->ncells, sizeof(char) );
+
+   /* Same parameters as gl_loadSurface() uses for mipmapped textures. The
+    * minification filter never reads the mipmaps there, so the pages have
+    * none, which also keeps them from mixing neighbouring cells. */
+   glGenTextures( 1, &pg->texture );
+   glBindTexture( GL_TEXTURE_2D, pg->texture );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+   glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, pg->size, pg->size, 0,
+         GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+   gl_checkErr();
+
+   return i;
+}
+
+
+/**
+ * @brief Takes a free cell in an atlas page, creating the page if needed.
+ *
+ *    @param cellsize Width and height of the cell.
+ *    @param[out] cell Cell taken in the page.
+ *    @return Index of the page in icon_pages.
+ */
+static int icon_cellNew( int cellsize, int *cell )
+{
+   int i, p;
+   IconPage *pg;
+
+   if (icon_pages == NULL)
+      icon_pages = array_create( IconPage );
+
+   p = -1;
+   for (i=0; i<array_size(icon_pages); i++) {
+      pg = &icon_pages[i];
+      if ((pg->texture != 0) && (pg->cell == cellsize) &&
+            (pg->nused < pg->ncells)) {
+         p = i;
+         break;
+      }
+   }
+   if (p < 0)
+      p = icon_pageNew( cellsize );
+
+   pg = &icon_pages[p];
+   for (i=0; i<pg->ncells; i++)
+      if (!pg->used[i])
+         break;
+   pg->used[i] = 1;
+   pg->nused++;
+   *cell = i;
+   return p;
+}
+
+
+/**
+ * @brief Loads an icon into a cell of an atlas page.
+ *
+ *    @param ico Icon to load.
+ *    @return The texture of the icon or NULL on error.
+ */
+static glTexture* icon_load( Icon *ico )
+{
+   SDL_RWops *rw;
+   npng_t *npng;
+   png_uint_32 w, h;
+   SDL_Surface *surface;
+   IconPage *pg;
+   glTexture *tex;
+   int cellsize, cell, p, x, y;
+   char *blank;
+
+   rw = ndata_rwops( ico->path );
+   if (rw == NULL) {
+      WARN(_("Failed to load icon '%s' from ndata."), ico->path);
+      return NULL;
+   }
+   npng = npng_open( rw );
+   if (npng == NULL) {
+      WARN(_("Icon '%s' is not a png."), ico->path);
+      SDL_RWclose( rw );
+      return NULL;
+   }
+   npng_dim( npng, &w, &h );
+
+   /* Too big for a cell, give it its own texture. */
+   cellsize = MAX( ICON_CELL_MIN, gl_pot( MAX( w, h ) ) );
+   if (cellsize > MIN( ICON_CELL_MAX, gl_screen.tex_max )) {
+      npng_close( npng );
+      SDL_RWclose( rw );
+      ico->page = -1;
+      return gl_newImage( ico->path, OPENGL_TEX_MIPMAPS );
+   }
+
+   /* Flipped like every texture, the first row being the bottom. */
+   surface = npng_readSurface( npng, 0, 1 );
+   npng_close( npng );
+   SDL_RWclose( rw );
+   if (surface == NULL) {
+      WARN(_("Icon '%s' could not be opened."), ico->path);
+      return NULL;
+   }
+
+   p  = icon_cellNew( cellsize, &cell );
+   pg = &icon_pages[p];
+   x  = (cell % (pg->size / cellsize)) * cellsize;
+   y  = (cell / (pg->size / cellsize)) * cellsize;
+
+   glBindTexture( GL_TEXTURE_2D, pg->texture );
+   /* Clear what the last icon of the cell left around the image. */
+   if (((int)w < cellsize) || ((int)h < cellsize)) {
+      blank = calloc( cellsize * cellsize, 4 );
+      glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, cellsize, cellsize,
+            GL_RGBA, GL_UNSIGNED_BYTE, blank );
+      free( blank );
+   }
+   SDL_LockSurface( surface );
+   glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, w, h,
+         GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels );
+   SDL_UnlockSurface( surface );
+   SDL_FreeSurface( surface );
+   gl_checkErr();
+
+   /* The icon is the sub-rectangle of the page holding the image. */
+   tex          = calloc( 1, sizeof(glTexture) );
+   tex->name    = strdup( ico->path );
+   tex->w       = (double) w;
+   tex->h       = (double) h;
+   tex->rw      = (double) pg->size;
+   tex->rh      = (double) pg->size;
+   tex->sx      = 1.;
+   tex->sy      = 1.;
+   tex->sw      = tex->w;
+   tex->sh      = tex->h;
+   tex->srw     = tex->sw / tex->rw;
+   tex->srh     = tex->sh / tex->rh;
+   tex->ox      = (double) x / tex->rw;
+   tex->oy      = (double) y / tex->rh;
+   tex->texture = pg->texture;
+
+   ico->page = p;
+   ico->cell = cell;
+   return tex;
+}
+
+
+/**
+ * @brief Unloads an icon, freeing its cell.
+ *
+ *    @param ico Icon to unload.
+ */
+static void icon_unload( Icon *ico )
+{
+   IconPage *pg;
+
+   if (ico->tex == NULL)
+      return;
+
+   /* Has its own texture. */
+   if (ico->page < 0) {
+      gl_freeTexture( ico->tex );
+      ico->tex = NULL;
+      return;
+   }
+
+   /* Only the page is a real texture. */
+   free( ico->tex->name );
+   free( ico->tex );
+   ico->tex = NULL;
+
+   pg = &icon_pages[ ico->page ];
+   pg->used[ ico->cell ] = 0;
+   pg->nused--;
+   if (pg->nused <= 0) {
+      glDeleteTextures( 1, &pg->texture );
+      pg->texture = 0;
+      free( pg->used );
+      pg->used    = NULL;
+   }
+   ico->page = -1;
+}
+
+
+/**
+ * @brief Gets the texture of an icon, loading it if needed.
+ *
+ * The texture stays valid until the next icon_gc(). It usually shares its
+ *  OpenGL texture with other icons, so callers that keep it around for longer
+ *  should get one of their own with icon_newTexture().
+ *
+ *    @param icon Handle of the icon to get.
+ *    @return The texture of the icon or NULL if not available.
+ */
+glTexture* icon_get( int icon )
+{
+   Icon *ico;
+
+   if ((icon <= 0) || (icon_stack == NULL) || (icon > array_size(icon_stack)))
+      return NULL;
+
+   ico = &icon_stack[ icon-1 ];
+   ico->used = ++icon_clock;
+   if ((ico->tex == NULL) && !ico->failed) {
+      ico->tex = icon_load( ico );
+      if (ico->tex == NULL)
+         ico->failed = 1;
+      else
+         icon_nloaded++;
+   }
+
+   return ico->tex;
+}
+
+
+/**
+ * @brief Loads the graphic of an icon as a texture of its own.
+ *
+ *    @param icon Handle of the icon to load.
+ *    @return New reference to the texture, to free with gl_freeTexture(), or
+ *            NULL if not available.
+ */
+glTexture* icon_newTexture( int icon )
+{
+   if ((icon <= 0) || (icon_stack == NULL) || (icon > array_size(icon_stack)))
+      return NULL;
+
+   return gl_newImage( icon_stack[ icon-1 ].path, OPENGL_TEX_MIPMAPS );
+}
+
+
+/**
+ * @brief Compares icons by last use for qsort.
+ */
+static int icon_cmpUsed( const void *p1, const void *p2 )
+{
+   const Icon *i1, *i2;
+   i1 = *(const Icon**) p1;
+   i2 = *(const Icon**) p2;
+   if (i1->used < i2->used)
+      return -1;
+   else if (i1->used > i2->used)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Unloads the least recently used icons over ICON_CACHE_MAX.
+ *
+ * Should only be called when no window is displaying icons, e.g. on takeoff.
+ */
+void icon_gc (void)
+{
+   int i, n;
+   Icon **loaded;
+
+   if (icon_nloaded <= ICON_CACHE_MAX)
+      return;
+
+   /* Sort the loaded icons by last use. */
+   loaded = malloc( icon_nloaded * sizeof(Icon*) );
+   n = 0;
+   for (i=0; i<array_size(icon_stack); i++)
+      if (icon_stack[i].tex != NULL)
+         loaded[n++] = &icon_stack[i];
+   qsort( loaded, n, sizeof(Icon*), icon_cmpUsed );
+
+   /* Unload the oldest. */
+   for (i=0; i<n-ICON_CACHE_MAX; i++)
+      icon_unload( loaded[i] );
+   icon_nloaded = MIN( n, ICON_CACHE_MAX );
+
+   free(loaded);
+}
+
+
+/**
+ * @brief Frees all the icons.
+ */
+void icon_exit (void)
+{
+   int i;
+
+   if (icon_stack != NULL) {
+      for (i=0; i<array_size(icon_stack); i++) {
+         icon_unload( &icon_stack[i] );
+         free( icon_stack[i].path );
+      }
+      array_free( icon_stack );
+      icon_stack = NULL;
+   }
+
+   /* Pages are freed with their last icon, only the slots are left. */
+   if (icon_pages != NULL) {
+      array_free( icon_pages );
+      icon_pages = NULL;
+   }
+
+   icon_nloaded = 0;
+   icon_clock   = 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef ICON_H
+#  define ICON_H
+
+
+#include "opengl.h"
+
+
+#define ICON_CACHE_MAX  256 /**< Maximum amount of icons kept loaded between landings. */
+
+
+/*
+ * Registering.
+ */
+int icon_new( const char *path );
+
+/*
+ * Getting.
+ */
+glTexture* icon_get( int icon );
+glTexture* icon_newTexture( int icon );
+
+/*
+ * Cleaning up.
+ */
+void icon_gc (void);
+void icon_exit (void);
+
+
+#endif /* ICON_H */
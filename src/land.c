@@ -48,6 +48,7 @@
 #include "nlua.h"
 #include "nluadef.h"
 #include "nlua_tk.h"
+#include "icon.h"
 
 
 /* global/main window */
@@ -1438,6 +1439,9 @@ void land_cleanup (void)
       nlua_freeEnv(rescue_env);
       rescue_env = LUA_NOREF;
    }
+
+   /* No more store windows, unload the least used icons. */
+   icon_gc();
 }
 
 
@@ -31,6 +31,7 @@
 #include "dialogue.h"
 #include "map_find.h"
 #include "land_takeoff.h"
+#include "icon.h"
 
 
 #define  OUTFITS_IAR    "iarOutfits"
@@ -58,6 +59,8 @@ static void outfits_rmouse( unsigned int wid, char* widget_name );
 static void outfits_find( unsigned int wid, char* str );
 static credits_t outfit_getPrice( Outfit *outfit );
 static void outfits_genList( unsigned int wid );
+static void outfits_refreshList( unsigned int wid );
+static char *outfits_getQuantity( const Outfit *o );
 static void outfits_changeTab( unsigned int wid, char *wgt, int old, int tab );
 
 
@@ -238,7 +241,7 @@ static void outfits_genList( unsigned int wid )
       _("All"), _("\ab W "), _("\ag U "), _("\ap S "), _("\aRCore"), _("Other")
    };
 
-   int i, active, owned, len;
+   int i, active;
    int fx, fy, fw, fh, barw; /* Input filter. */
    Outfit **outfits;
    char **soutfits, **slottype, **quantity;
@@ -291,9 +294,9 @@ static void outfits_genList( unsigned int wid )
 
    moutfits = MAX( 1, noutfits );
    soutfits = malloc( moutfits * sizeof(char*) );
-   toutfits = malloc( moutfits * sizeof(glTexture*) );
+   toutfits = calloc( moutfits, sizeof(glTexture*) ); /* Loaded on demand. */
 
-   noutfits = outfits_filter( outfits, toutfits, noutfits,
+   noutfits = outfits_filter( outfits, NULL, noutfits,
          tabfilters[active], filtertext );
 
    if (noutfits <= 0) { /* No outfits */
@@ -317,14 +320,7 @@ static void outfits_genList( unsigned int wid )
          bg[i] = blend;
 
          /* Quantity. */
-         owned = player_outfitOwned(outfits[i]);
-         len = owned / 10 + 4;
-         if (owned >= 1) {
-            quantity[i] = malloc( len );
-            nsnprintf( quantity[i], len, "%d", owned );
-         }
-         else
-            quantity[i] = NULL;
+         quantity[i] = outfits_getQuantity( outfits[i] );
 
 
          /* Get slot name. */
@@ -345,6 +341,7 @@ static void outfits_genList( unsigned int wid )
    window_addImageArray( wid, 20, 20,
          iw, ih - 31, OUTFITS_IAR, 64, 64,
          toutfits, soutfits, noutfits, outfits_update, outfits_rmouse );
+   toolkit_setImageArrayLoader( wid, OUTFITS_IAR, outfits_getIcon );
 
    /* write the outfits stuff */
    outfits_update( wid, NULL );
@@ -357,6 +354,70 @@ static void outfits_genList( unsigned int wid )
 }
 
 
+/**
+ * @brief Refreshes the owned quantities of the outfit list in place.
+ *
+ * The outfits on sale don't change while landed, so buying and selling only
+ *  needs to update the quantities instead of regenerating the whole list.
+ *
+ *    @param wid Window to refresh the list on.
+ */
+static void outfits_refreshList( unsigned int wid )
+{
+   int i, n;
+   char **names;
+   Outfit *o;
+
+   names = toolkit_getImageArrayCaptions( wid, OUTFITS_IAR, &n );
+   for (i=0; i<n; i++) {
+      o = outfit_getW( names[i] );
+      if (o == NULL) /* "None" entry. */
+         continue;
+      toolkit_setImageArrayQuantityElem( wid, OUTFITS_IAR, i,
+            outfits_getQuantity( o ) );
+   }
+
+   outfits_update( wid, NULL );
+}
+
+
+/**
+ * @brief Gets the quantity text for an outfit.
+ *
+ *    @param o Outfit to get quantity of.
+ *    @return Newly allocated quantity text or NULL if none is owned.
+ */
+static char *outfits_getQuantity( const Outfit *o )
+{
+   int owned, len;
+   char *quantity;
+
+   owned = player_outfitOwned(o);
+   if (owned < 1)
+      return NULL;
+
+   len = owned / 10 + 4;
+   quantity = malloc( len );
+   nsnprintf( quantity, len, "%d", owned );
+   return quantity;
+}
+
+
+/**
+ * @brief Gets the store image of an outfit for the image array.
+ *
+ *    @param name Name of the outfit.
+ *    @return The store image of the outfit.
+ */
+glTexture *outfits_getIcon( const char *name )
+{
+   Outfit *o = outfit_getW( name );
+   if (o == NULL)
+      return NULL;
+   return icon_get( o->gfx_store );
+}
+
+
 /**
  * @brief Updates the outfits in the outfit window.
  *    @param wid Window to update the outfits in.
@@ -406,7 +467,7 @@ void outfits_update( unsigned int wid, char* str )
    outfit = outfit_get( outfitname );
 
    /* new image */
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", icon_get( outfit->gfx_store ), 0, 0 );
 
    if (outfit_canBuy(outfitname, land_planet) > 0)
       window_enableButton( wid, "btnBuyOutfit" );
@@ -469,7 +530,7 @@ void outfits_updateEquipmentOutfits( void )
    if (landed && land_doneLoading()) {
       if (planet_hasService(land_planet, PLANET_SERVICE_OUTFITS)) {
          ow = land_getWid( LAND_WINDOW_OUTFITS );
-         outfits_regenList( ow, NULL );
+         outfits_refreshList( ow );
       }
       else if (!planet_hasService(land_planet, PLANET_SERVICE_SHIPYARD))
          return;
@@ -543,7 +604,7 @@ int outfits_filter( Outfit **outfits, glTexture **toutfits, int n,
       /* Shift matches downward. */
       outfits[j] = outfits[i];
       if (toutfits != NULL)
-         toutfits[j] = outfits[i]->gfx_store;
+         toutfits[j] = icon_get( outfits[i]->gfx_store );
 
       j++;
    }
@@ -785,7 +846,9 @@ static void outfits_renderMod( double bx, double by, double w, double h, void *d
 
    q = outfits_getMod();
    if (q != outfits_mod) {
-      outfits_updateEquipmentOutfits();
+      /* Only prices and buttons depend on the modifier. */
+      if (landed && land_doneLoading())
+         outfits_update( land_getWid( LAND_WINDOW_OUTFITS ), NULL );
       outfits_mod = q;
    }
    if (q==1) return; /* Ignore no modifier. */
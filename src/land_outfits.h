@@ -16,6 +16,7 @@ void outfits_open( unsigned int wid );
 void outfits_regenList( unsigned int wid, char *str );
 void outfits_update( unsigned int wid, char* str );
 void outfits_updateEquipmentOutfits( void );
+glTexture *outfits_getIcon( const char *name );
 int outfits_filter( Outfit **outfits, glTexture **toutfits, int n,
       int(*filter)( const Outfit *o ), char *name );
 int outfit_canBuy( char *outfit, Planet *planet );
@@ -28,6 +28,7 @@
 #include "dialogue.h"
 #include "map_find.h"
 #include "land_shipyard.h"
+#include "icon.h"
 
 /*
  * Quantity to buy on one click
@@ -100,7 +101,7 @@ void commodity_exchange_open( unsigned int wid )
       tgoods    = malloc(sizeof(glTexture*) * ngoods);
       for (i=0; i<ngoods; i++) {
          goods[i] = strdup(land_planet->commodities[i]->name);
-         tgoods[i] = land_planet->commodities[i]->gfx_store;
+         tgoods[i] = icon_get( land_planet->commodities[i]->gfx_store );
       }
    }
    else {
@@ -152,7 +153,7 @@ void commodity_update( unsigned int wid, char* str )
    com = commodity_get( comname );
 
    /* modify image */
-   window_modifyImage( wid, "imgStore", com->gfx_store, 128, 128 );
+   window_modifyImage( wid, "imgStore", icon_get( com->gfx_store ), 128, 128 );
 
    /* modify text */
    nsnprintf( buf, PATH_MAX,
@@ -13,6 +13,8 @@
 
 #include "naev.h"
 
+#include "libxml/xmlreader.h"
+
 #include "nxml.h"
 #include "log.h"
 #include "player.h"
@@ -41,6 +43,8 @@
 #define BUTTON_WIDTH    80 /**< Button width. */
 #define BUTTON_HEIGHT   30 /**< Button height. */
 
+#define LOAD_INDEX_PATH "saves/index.xml" /**< Save index relative to the data path. */
+
 
 static nsave_t *load_saves = NULL; /**< Array of save.s */
 
@@ -76,6 +80,78 @@ static void load_menu_close( unsigned int wdw, char *str );
 static void load_menu_load( unsigned int wdw, char *str );
 static void load_menu_delete( unsigned int wdw, char *str );
 static int load_load( nsave_t *save, const char *path );
+static int load_loadHeader( nsave_t *save, const char *path );
+static void load_parseVersion( nsave_t *save, xmlNodePtr parent );
+static void load_parsePlayer( nsave_t *save, xmlNodePtr parent );
+static void load_freeSave( nsave_t *ns );
+static nsave_t *load_indexLoad (void);
+static int load_indexSave (void);
+
+
+/**
+ * @brief Parses the version node of a save.
+ */
+static void load_parseVersion( nsave_t *save, xmlNodePtr parent )
+{
+   xmlNodePtr node;
+   char *version = NULL;
+
+   node = parent->xmlChildrenNode;
+   do {
+      xmlr_strd(node,"naev",version);
+      xmlr_strd(node,"data",save->data);
+   } while (xml_nextNode(node));
+
+   if (version != NULL) {
+      naev_versionParse( save->version, version, strlen(version) );
+      free(version);
+   }
+}
+
+
+/**
+ * @brief Parses the information shown in the load menu.
+ *
+ * Works both on the player node and the save header, which share the same
+ * layout.
+ */
+static void load_parsePlayer( nsave_t *save, xmlNodePtr parent )
+{
+   xmlNodePtr node, cur;
+   int scu, stp, stu;
+
+   /* Get name. */
+   xmlr_attr(parent,"name",save->name);
+   /* Parse rest. */
+   node = parent->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+
+      /* Player info. */
+      xmlr_strd(node,"location",save->planet);
+      xmlr_ulong(node,"credits",save->credits);
+
+      /* Time. */
+      if (xml_isNode(node,"time")) {
+         cur = node->xmlChildrenNode;
+         scu = stp = stu = 0;
+         do {
+            xmlr_int(cur,"SCU",scu);
+            xmlr_int(cur,"STP",stp);
+            xmlr_int(cur,"STU",stu);
+         } while (xml_nextNode(cur));
+         save->date = ntime_create( scu, stp, stu );
+         continue;
+      }
+
+      /* Ship info. */
+      if (xml_isNode(node,"ship")) {
+         xmlr_attr(node,"name",save->shipname);
+         xmlr_attr(node,"model",save->shipmodel);
+         continue;
+      }
+   } while (xml_nextNode(node));
+}
 
 
 /**
@@ -84,9 +160,7 @@ static int load_load( nsave_t *save, const char *path );
 static int load_load( nsave_t *save, const char *path )
 {
    xmlDocPtr doc;
-   xmlNodePtr root, parent, node, cur;
-   int scu, stp, stu;
-   char *version = NULL;
+   xmlNodePtr root, parent;
 
    memset( save, 0, sizeof(nsave_t) );
 
@@ -113,56 +187,16 @@ static int load_load( nsave_t *save, const char *path )
 
       /* Info. */
       if (xml_isNode(parent,"version")) {
-         node = parent->xmlChildrenNode;
-         do {
-            xmlr_strd(node,"naev",version);
-            xmlr_strd(node,"data",save->data);
-         } while (xml_nextNode(node));
+         load_parseVersion( save, parent );
          continue;
       }
 
       if (xml_isNode(parent,"player")) {
-         /* Get name. */
-         xmlr_attr(parent,"name",save->name);
-         /* Parse rest. */
-         node = parent->xmlChildrenNode;
-         do {
-            xml_onlyNodes(node);
-
-            /* Player info. */
-            xmlr_strd(node,"location",save->planet);
-            xmlr_ulong(node,"credits",save->credits);
-
-            /* Time. */
-            if (xml_isNode(node,"time")) {
-               cur = node->xmlChildrenNode;
-               scu = stp = stu = 0;
-               do {
-                  xmlr_int(cur,"SCU",scu);
-                  xmlr_int(cur,"STP",stp);
-                  xmlr_int(cur,"STU",stu);
-               } while (xml_nextNode(cur));
-               save->date = ntime_create( scu, stp, stu );
-               continue;
-            }
-
-            /* Ship info. */
-            if (xml_isNode(node,"ship")) {
-               xmlr_attr(node,"name",save->shipname);
-               xmlr_attr(node,"model",save->shipmodel);
-               continue;
-            }
-         } while (xml_nextNode(node));
+         load_parsePlayer( save, parent );
          continue;
       }
    } while (xml_nextNode(parent));
 
-   /* Handle version. */
-   if (version != NULL) {
-      naev_versionParse( save->version, version, strlen(version) );
-      free(version);
-   }
-
    /* Clean up. */
    xmlFreeDoc(doc);
 
@@ -170,19 +204,89 @@ static int load_load( nsave_t *save, const char *path )
 }
 
 
+/**
+ * @brief Loads the header of an individual save.
+ *
+ * The save is streamed and reading stops after the header, so only the
+ * first few hundred bytes have to be read (and decompressed).
+ *
+ *    @param save Save to load into.
+ *    @param path Path of the save.
+ *    @return 0 on success, 1 if the save has no header (saves from older
+ *            versions), -1 on error.
+ */
+static int load_loadHeader( nsave_t *save, const char *path )
+{
+   xmlTextReaderPtr reader;
+   xmlNodePtr node;
+   const char *name;
+   int ret, found;
+
+   memset( save, 0, sizeof(nsave_t) );
+
+   reader = xmlReaderForFile( path, NULL, 0 );
+   if (reader == NULL) {
+      WARN( _("Unable to open save path '%s'."), path);
+      return -1;
+   }
+
+   /* Look at the children of the naev_save element until the header. */
+   found = 0;
+   ret   = xmlTextReaderRead( reader );
+   while (ret == 1) {
+      if ((xmlTextReaderNodeType( reader ) != XML_READER_TYPE_ELEMENT) ||
+            (xmlTextReaderDepth( reader ) != 1)) {
+         ret = xmlTextReaderRead( reader );
+         continue;
+      }
+
+      name = (const char*) xmlTextReaderConstName( reader );
+      if ((strcmp(name,"version")==0) || (strcmp(name,"header")==0)) {
+         node = xmlTextReaderExpand( reader );
+         if (node == NULL)
+            break;
+         if (strcmp(name,"version")==0)
+            load_parseVersion( save, node );
+         else {
+            load_parsePlayer( save, node );
+            found = 1;
+            break;
+         }
+      }
+      /* The header is always right after the version. */
+      else
+         break;
+
+      ret = xmlTextReaderNext( reader );
+   }
+   xmlFreeTextReader( reader );
+
+   if (!found) {
+      load_freeSave( save );
+      return (ret < 0) ? -1 : 1;
+   }
+
+   save->path = strdup(path);
+   return 0;
+}
+
+
 /**
  * @brief Loads or refreshes saved games.
  */
 int load_refresh (void)
 {
    char **files, buf[PATH_MAX], *tmp;
-   size_t nfiles, i, len;
-   int ok;
-   nsave_t *ns;
+   size_t nfiles, i, len, filesize;
+   int j, ok, dirty;
+   int64_t mtime;
+   nsave_t *ns, *index;
 
    if (load_saves != NULL)
       load_free();
    load_saves = array_create( nsave_t );
+   index = load_indexLoad();
+   dirty = 0;
 
    /* load the saves */
    files = nfile_readDir( &nfiles, "%ssaves", nfile_dataPath() );
@@ -200,8 +304,12 @@ int load_refresh (void)
    }
 
    /* Make sure files are none. */
-   if (files == NULL)
+   if (files == NULL) {
+      for (j=0; j<array_size(index); j++)
+         load_freeSave( &index[j] );
+      array_free( index );
       return 0;
+   }
 
    /* Make sure backups are after saves. */
    for (i=0; i<nfiles-1; i++) {
@@ -228,13 +336,51 @@ int load_refresh (void)
       if (!ok)
          ns = &array_grow( &load_saves );
       nsnprintf( buf, sizeof(buf), "%ssaves/%s", nfile_dataPath(), files[i] );
-      ok = load_load( ns, buf );
+      if (nfile_fileStat( &filesize, &mtime, "%s", buf ) != 0) {
+         ok = -1;
+         continue;
+      }
+
+      /* Use the index entry if the file hasn't changed since. */
+      for (j=0; j<array_size(index); j++) {
+         if ((index[j].path != NULL) && (strcmp(index[j].path,buf)==0) &&
+               (index[j].filesize==filesize) && (index[j].mtime==mtime)) {
+            *ns = index[j];
+            memset( &index[j], 0, sizeof(nsave_t) );
+            break;
+         }
+      }
+      if (j < array_size(index)) {
+         ok = 0;
+         continue;
+      }
+
+      /* Stream the header, old saves have to be fully parsed. */
+      ok = load_loadHeader( ns, buf );
+      if (ok > 0)
+         ok = load_load( ns, buf );
+      /* Saves that fail to parse aren't indexed, so they don't make it stale. */
+      if (ok == 0) {
+         ns->filesize = filesize;
+         ns->mtime    = mtime;
+         dirty        = 1;
+      }
    }
 
    /* If the save was invalid, array is 1 member too large. */
    if (ok)
       array_resize( &load_saves, array_size(load_saves)-1 );
 
+   /* Saves that were deleted also make the index stale. */
+   for (j=0; j<array_size(index); j++) {
+      if (index[j].path != NULL)
+         dirty = 1;
+      load_freeSave( &index[j] );
+   }
+   array_free( index );
+   if (dirty)
+      load_indexSave();
+
    /* Clean up memory. */
    for (i=0; i<nfiles; i++)
       free(files[i]);
@@ -250,32 +396,150 @@ int load_refresh (void)
 void load_free (void)
 {
    int i;
-   nsave_t *ns;
 
    if (load_saves != NULL) {
-      for (i=0; i<array_size(load_saves); i++) {
-         ns = &load_saves[i];
-         free(ns->path);
-         if (ns->name != NULL)
-            free(ns->name);
-
-         if (ns->data != NULL)
-            free(ns->data);
-
-         if (ns->planet != NULL)
-            free(ns->planet);
-
-         if (ns->shipname != NULL)
-            free(ns->shipname);
-         if (ns->shipmodel != NULL)
-            free(ns->shipmodel);
-      }
+      for (i=0; i<array_size(load_saves); i++)
+         load_freeSave( &load_saves[i] );
       array_free( load_saves );
    }
    load_saves = NULL;
 }
 
 
+/**
+ * @brief Frees the contents of a save.
+ */
+static void load_freeSave( nsave_t *ns )
+{
+   free(ns->path);
+   free(ns->name);
+   free(ns->data);
+   free(ns->planet);
+   free(ns->shipname);
+   free(ns->shipmodel);
+   memset( ns, 0, sizeof(nsave_t) );
+}
+
+
+/**
+ * @brief Loads the save index.
+ *
+ *    @return Array of the indexed saves (never NULL).
+ */
+static nsave_t *load_indexLoad (void)
+{
+   char path[PATH_MAX], *version;
+   xmlDocPtr doc;
+   xmlNodePtr node, cur;
+   nsave_t *index, *ns;
+
+   index = array_create( nsave_t );
+
+   nsnprintf( path, sizeof(path), "%s"LOAD_INDEX_PATH, nfile_dataPath() );
+   if (!nfile_fileExists( "%s", path ))
+      return index;
+
+   doc = xmlParseFile( path );
+   if (doc == NULL)
+      return index;
+   node = doc->xmlChildrenNode;
+   if ((node == NULL) || !xml_isNode(node,"saves")) {
+      xmlFreeDoc(doc);
+      return index;
+   }
+
+   node = node->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+      if (!xml_isNode(node,"save"))
+         continue;
+
+      ns = &array_grow( &index );
+      memset( ns, 0, sizeof(nsave_t) );
+      version = NULL;
+      xmlr_attr(node,"path",ns->path);
+      cur = node->xmlChildrenNode;
+      do {
+         xml_onlyNodes(cur);
+         xmlr_strd(cur,"version",version);
+         xmlr_strd(cur,"data",ns->data);
+         xmlr_strd(cur,"name",ns->name);
+         xmlr_strd(cur,"planet",ns->planet);
+         xmlr_long(cur,"date",ns->date);
+         xmlr_ulong(cur,"credits",ns->credits);
+         xmlr_strd(cur,"shipname",ns->shipname);
+         xmlr_strd(cur,"shipmodel",ns->shipmodel);
+         xmlr_ulong(cur,"filesize",ns->filesize);
+         xmlr_long(cur,"mtime",ns->mtime);
+      } while (xml_nextNode(cur));
+
+      if (version != NULL) {
+         naev_versionParse( ns->version, version, strlen(version) );
+         free(version);
+      }
+   } while (xml_nextNode(node));
+
+   xmlFreeDoc(doc);
+   return index;
+}
+
+
+/**
+ * @brief Saves the index of the currently loaded saves.
+ *
+ *    @return 0 on success.
+ */
+static int load_indexSave (void)
+{
+   char path[PATH_MAX];
+   xmlDocPtr doc;
+   xmlTextWriterPtr writer;
+   nsave_t *ns;
+   int i;
+
+   writer = xmlNewTextWriterDoc(&doc, 0);
+   if (writer == NULL) {
+      WARN(_("testXmlwriterDoc: Error creating the xml writer"));
+      return -1;
+   }
+   xmlw_setParams( writer );
+
+   xmlw_start(writer);
+   xmlw_startElem(writer,"saves");
+   for (i=0; i<array_size(load_saves); i++) {
+      ns = &load_saves[i];
+      xmlw_startElem(writer,"save");
+      xmlw_attr(writer,"path","%s",ns->path);
+      xmlw_elem(writer,"version","%d.%d.%d",ns->version[0],ns->version[1],ns->version[2]);
+      if (ns->data != NULL)
+         xmlw_elem(writer,"data","%s",ns->data);
+      if (ns->name != NULL)
+         xmlw_elem(writer,"name","%s",ns->name);
+      if (ns->planet != NULL)
+         xmlw_elem(writer,"planet","%s",ns->planet);
+      xmlw_elem(writer,"date","%"PRIi64,ns->date);
+      xmlw_elem(writer,"credits","%"CREDITS_PRI,ns->credits);
+      if (ns->shipname != NULL)
+         xmlw_elem(writer,"shipname","%s",ns->shipname);
+      if (ns->shipmodel != NULL)
+         xmlw_elem(writer,"shipmodel","%s",ns->shipmodel);
+      xmlw_elem(writer,"filesize","%lu",(unsigned long)ns->filesize);
+      xmlw_elem(writer,"mtime","%"PRIi64,ns->mtime);
+      xmlw_endElem(writer); /* "save" */
+   }
+   xmlw_endElem(writer); /* "saves" */
+   xmlw_done(writer);
+   xmlFreeTextWriter(writer);
+
+   nsnprintf( path, sizeof(path), "%s"LOAD_INDEX_PATH, nfile_dataPath() );
+   if (xmlSaveFileEnc(path, doc, "UTF-8") < 0)
+      WARN(_("Failed to write save index '%s'."), path);
+   xmlFreeDoc(doc);
+
+   return 0;
+}
+
+
 /**
  * @brief Gets the list of loaded saves.
  */
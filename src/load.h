@@ -7,6 +7,7 @@
 #  define LOAD_H
 
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "ntime.h"
@@ -31,6 +32,10 @@ typedef struct nsave_s {
    /* Ship info. */
    char *shipname; /**< Name of the ship. */
    char *shipmodel; /**< Model of the ship. */
+
+   /* File info, used to validate the save index. */
+   size_t filesize; /**< Size of the file when it was read. */
+   int64_t mtime; /**< Modification time of the file when it was read (ns, see nfile_fileStat()). */
 } nsave_t;
 
 
@@ -39,6 +39,20 @@
 #define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
                                  aborting. */
 
+#define MAP_RING_SEGMENTS  32 /**< Line segments used for cached system rings. */
+#define MAP_VERTEX_SIZE    8 /**< Floats per cached vertex: x, y, s, t, r, g, b, a. */
+
+/**
+ * @brief Sections of the cached static map layers, in render order.
+ */
+typedef enum MapLayer_ {
+   MAP_LAYER_DISKS, /**< Faction disks (textured). */
+   MAP_LAYER_JUMPS, /**< Jump routes (lines). */
+   MAP_LAYER_RINGS, /**< System outer rings (lines). */
+   MAP_LAYER_FILLS, /**< Known system fills (textured). */
+   MAP_LAYER_NUM    /**< Number of layers. */
+} MapLayer;
+
 /* map decorator stack */
 static MapDecorator* decorator_stack = NULL; /**< Contains all the map decorators. */
 static int decorator_nstack       = 0; /**< Number of map decorators in the stack. */
@@ -56,6 +70,17 @@ glTexture *gl_map_circle      = NULL; /**< Texture of the circle used for system
 /* VBO. */
 static gl_vbo *map_vbo = NULL; /**< Map VBO. */
 
+/* Cached static layers, in map coordinates. */
+static int map_dirty          = 1; /**< Static layers have to be regenerated. */
+static double map_cache_zoom  = 0.; /**< Zoom the layers were generated for. */
+static gl_vbo *map_cache_vbo  = NULL; /**< VBO with all the static layers. */
+static GLfloat *map_cache_vertex = NULL; /**< Vertex data of the static layers (array.h). */
+static int map_cache_start[MAP_LAYER_NUM]; /**< First vertex of each layer. */
+static int map_cache_n[MAP_LAYER_NUM]; /**< Number of vertices of each layer. */
+static int *map_cache_names   = NULL; /**< Systems with visible names (array.h). */
+static int *map_cache_namew   = NULL; /**< Width of the system names (array.h). */
+static char *map_cache_decorators = NULL; /**< Whether each decorator is visible. */
+
 
 /*
  * extern
@@ -74,6 +99,16 @@ static void map_update( unsigned int wid );
 /* Render. */
 static void map_render( double bx, double by, double w, double h, void *data );
 static void map_renderPath( double x, double y, double a );
+static void map_cacheUpdate( double r );
+static void map_cacheVertex( double x, double y, double s, double t,
+      const glColour *c, double a );
+static void map_cacheQuad( double x, double y, double hw,
+      const glTexture *tex, const glColour *c, double a );
+static void map_renderCache( double x, double y, MapLayer layer,
+      GLenum mode, const glTexture *tex );
+static void map_renderCacheDecorators( double x, double y );
+static void map_renderCacheNames( double bx, double by, double x, double y,
+      double w, double h );
 static void map_renderMarkers( double x, double y, double r, double a );
 static void map_drawMarker( double x, double y, double r, double a,
       int num, int cur, int type );
@@ -115,6 +150,21 @@ void map_exit (void)
       map_vbo = NULL;
    }
 
+   /* Destroy the cached layers. */
+   if (map_cache_vbo != NULL) {
+      gl_vboDestroy(map_cache_vbo);
+      map_cache_vbo = NULL;
+   }
+   array_free( map_cache_vertex );
+   map_cache_vertex = NULL;
+   array_free( map_cache_names );
+   map_cache_names = NULL;
+   array_free( map_cache_namew );
+   map_cache_namew = NULL;
+   free( map_cache_decorators );
+   map_cache_decorators = NULL;
+   map_dirty = 1;
+
    if (gl_faction_disk != NULL)
       gl_freeTexture( gl_faction_disk );
 
@@ -723,16 +773,24 @@ static void map_render( double bx, double by, double w, double h, void *data )
    if (gl_map_circle == NULL)
       gl_map_circle = gl_genCircle( r );
 
+   /* Regenerate the static layers if needed. */
+   map_cacheUpdate( r );
+
    /* background */
    gl_renderRect( bx, by, w, h, &cBlack );
 
-   map_renderDecorators( x, y, 0 );
+   map_renderCacheDecorators( x, y );
 
    /* Render faction disks. */
-   map_renderFactionDisks( x, y, 0 );
+   map_renderCache( x, y, MAP_LAYER_DISKS, GL_TRIANGLES, gl_faction_disk );
 
    /* Render jump routes. */
-   map_renderJumps( x, y, 0 );
+   glShadeModel( GL_SMOOTH );
+   glDisable( GL_LINE_SMOOTH );
+   glLineWidth( CLAMP(1., 4., 2. * map_zoom)*gl_screen.scale );
+   map_renderCache( x, y, MAP_LAYER_JUMPS, GL_LINES, NULL );
+   glShadeModel( GL_FLAT );
+   glLineWidth( 1. );
 
    /* Cause alpha to move smoothly between 0-1 every second. */
    col.a = ABS( 500 - (int)SDL_GetTicks() % 1000 ) / 500.;
@@ -741,10 +799,11 @@ static void map_render( double bx, double by, double w, double h, void *data )
    map_renderPath( x, y, col.a );
 
    /* Render systems. */
-   map_renderSystems( bx, by, x, y, w, h, r, 0 );
+   map_renderCache( x, y, MAP_LAYER_RINGS, GL_LINES, NULL );
+   map_renderCache( x, y, MAP_LAYER_FILLS, GL_TRIANGLES, gl_map_circle );
 
    /* Render system names. */
-   map_renderNames( bx, by, x, y, w, h, 0 );
+   map_renderCacheNames( bx, by, x, y, w, h );
 
    /* Render system markers. */
    map_renderMarkers( x, y, r, col.a );
@@ -780,6 +839,319 @@ static void map_render( double bx, double by, double w, double h, void *data )
 }
 
 
+/**
+ * @brief Marks the static map layers for regeneration.
+ *
+ * Should be called whenever what systems and jumps are known, their factions
+ *  or the player's standing change.
+ */
+void map_invalidate (void)
+{
+   map_dirty = 1;
+}
+
+
+/**
+ * @brief Adds a vertex to the cached layers.
+ */
+static void map_cacheVertex( double x, double y, double s, double t,
+      const glColour *c, double a )
+{
+   GLfloat *v;
+   int n;
+
+   n = array_size( map_cache_vertex );
+   array_resize( &map_cache_vertex, n + MAP_VERTEX_SIZE );
+   v = &map_cache_vertex[n];
+   v[0] = x;
+   v[1] = y;
+   v[2] = s;
+   v[3] = t;
+   v[4] = c->r;
+   v[5] = c->g;
+   v[6] = c->b;
+   v[7] = a;
+}
+
+
+/**
+ * @brief Adds a textured square as two triangles to the cached layers.
+ *
+ *    @param x X center of the square.
+ *    @param y Y center of the square.
+ *    @param hw Half the width of the square.
+ *    @param tex Texture the square will be rendered with.
+ *    @param c Colour of the square.
+ *    @param a Alpha of the square.
+ */
+static void map_cacheQuad( double x, double y, double hw,
+      const glTexture *tex, const glColour *c, double a )
+{
+   map_cacheVertex( x-hw, y-hw, 0.,       0.,       c, a );
+   map_cacheVertex( x+hw, y-hw, tex->srw, 0.,       c, a );
+   map_cacheVertex( x-hw, y+hw, 0.,       tex->srh, c, a );
+   map_cacheVertex( x+hw, y-hw, tex->srw, 0.,       c, a );
+   map_cacheVertex( x+hw, y+hw, tex->srw, tex->srh, c, a );
+   map_cacheVertex( x-hw, y+hw, 0.,       tex->srh, c, a );
+}
+
+
+/**
+ * @brief Regenerates the static map layers if they are out of date.
+ *
+ * Everything is generated in map coordinates so that panning and most of
+ *  the zooming is done by the modelview matrix. Only the system circles are
+ *  sized in screen pixels, so the layers are also regenerated when the zoom
+ *  changes.
+ *
+ *    @param r Radius of the systems in pixels.
+ */
+static void map_cacheUpdate( double r )
+{
+   int i, j, k;
+   const glColour *col, *cole;
+   glColour c;
+   StarSystem *sys, *jsys;
+   MapDecorator *decorator;
+   double presence, rr, mx, my;
+   double ringx[MAP_RING_SEGMENTS+1], ringy[MAP_RING_SEGMENTS+1];
+
+   if (!map_dirty && (map_zoom == map_cache_zoom))
+      return;
+   map_dirty      = 0;
+   map_cache_zoom = map_zoom;
+
+   if (map_cache_vertex == NULL) {
+      map_cache_vertex = array_create( GLfloat );
+      map_cache_names  = array_create( int );
+      map_cache_namew  = array_create( int );
+   }
+   array_resize( &map_cache_vertex, 0 );
+   array_resize( &map_cache_names, 0 );
+   array_resize( &map_cache_namew, 0 );
+
+   /* Faction disks. */
+   map_cache_start[MAP_LAYER_DISKS] = 0;
+   for (i=0; i<systems_nstack; i++) {
+      sys = system_getIndex( i );
+      if ((sys->faction == -1) || !sys_isKnown(sys))
+         continue;
+      presence = sqrt(sys->ownerpresence);
+      map_cacheQuad( sys->pos.x, sys->pos.y, (60. + presence * 3.) / 2.,
+            gl_faction_disk, faction_colour(sys->faction),
+            CLAMP( .6, .75, 20 / presence ) );
+   }
+
+   /* Jump routes, as two segments to fade towards the ends. */
+   map_cache_start[MAP_LAYER_JUMPS] = array_size(map_cache_vertex) / MAP_VERTEX_SIZE;
+   for (i=0; i<systems_nstack; i++) {
+      sys = system_getIndex( i );
+      if (!sys_isKnown(sys))
+         continue;
+
+      for (j=0; j<sys->njumps; j++) {
+         jsys = sys->jumps[j].target;
+         if (!space_sysReachableFromSys(jsys,sys))
+            continue;
+
+         /* Choose colours. */
+         cole = &cBlue;
+         for (k=0; k<jsys->njumps; k++) {
+            if (jsys->jumps[k].target == sys) {
+               if (jp_isFlag(&jsys->jumps[k], JP_EXITONLY))
+                  cole = &cWhite;
+               else if (jp_isFlag(&jsys->jumps[k], JP_HIDDEN))
+                  cole = &cRed;
+               break;
+            }
+         }
+         if (jp_isFlag(&sys->jumps[j], JP_EXITONLY))
+            col = &cWhite;
+         else if (jp_isFlag(&sys->jumps[j], JP_HIDDEN))
+            col = &cRed;
+         else
+            col = &cBlue;
+         c.r = (col->r + cole->r)/2.;
+         c.g = (col->g + cole->g)/2.;
+         c.b = (col->b + cole->b)/2.;
+
+         mx = (sys->pos.x + jsys->pos.x) / 2.;
+         my = (sys->pos.y + jsys->pos.y) / 2.;
+         map_cacheVertex( sys->pos.x,  sys->pos.y,  0., 0., col,  0.2 );
+         map_cacheVertex( mx,          my,          0., 0., &c,   0.8 );
+         map_cacheVertex( mx,          my,          0., 0., &c,   0.8 );
+         map_cacheVertex( jsys->pos.x, jsys->pos.y, 0., 0., cole, 0.2 );
+      }
+   }
+
+   /* System rings, sized in pixels. */
+   rr = r / map_zoom;
+   for (k=0; k<=MAP_RING_SEGMENTS; k++) {
+      ringx[k] = rr * cos( 2.*M_PI * (double)k / (double)MAP_RING_SEGMENTS );
+      ringy[k] = rr * sin( 2.*M_PI * (double)k / (double)MAP_RING_SEGMENTS );
+   }
+   map_cache_start[MAP_LAYER_RINGS] = array_size(map_cache_vertex) / MAP_VERTEX_SIZE;
+   for (i=0; i<systems_nstack; i++) {
+      sys = system_getIndex( i );
+      if (!sys_isKnown(sys) && !sys_isFlag(sys, SYSTEM_MARKED | SYSTEM_CMARKED)
+            && !space_sysReachable(sys))
+         continue;
+      for (k=0; k<MAP_RING_SEGMENTS; k++) {
+         map_cacheVertex( sys->pos.x + ringx[k], sys->pos.y + ringy[k],
+               0., 0., &cInert, cInert.a );
+         map_cacheVertex( sys->pos.x + ringx[k+1], sys->pos.y + ringy[k+1],
+               0., 0., &cInert, cInert.a );
+      }
+   }
+
+   /* Known systems with planets are filled. */
+   map_cache_start[MAP_LAYER_FILLS] = array_size(map_cache_vertex) / MAP_VERTEX_SIZE;
+   for (i=0; i<systems_nstack; i++) {
+      sys = system_getIndex( i );
+      if (!sys_isKnown(sys))
+         continue;
+
+      /* Name. */
+      array_push_back( &map_cache_names, i );
+      array_push_back( &map_cache_namew, gl_printWidthRaw( &gl_smallFont, sys->name ) );
+
+      if (!system_hasPlanet(sys))
+         continue;
+      col = (sys->faction < 0) ? &cInert : faction_getColour( sys->faction );
+      map_cacheQuad( sys->pos.x, sys->pos.y, .65 * rr, gl_map_circle, col, col->a );
+   }
+
+   /* Layer sizes. */
+   for (i=0; i<MAP_LAYER_NUM; i++)
+      map_cache_n[i] = ((i+1 < MAP_LAYER_NUM) ? map_cache_start[i+1] :
+            array_size(map_cache_vertex) / MAP_VERTEX_SIZE) - map_cache_start[i];
+
+   /* Upload. */
+   if (array_size(map_cache_vertex) > 0) {
+      if (map_cache_vbo == NULL)
+         map_cache_vbo = gl_vboCreateDynamic(
+               sizeof(GLfloat) * array_size(map_cache_vertex), map_cache_vertex );
+      else
+         gl_vboData( map_cache_vbo,
+               sizeof(GLfloat) * array_size(map_cache_vertex), map_cache_vertex );
+   }
+
+   /* Decorators are visible if near a known system. */
+   free( map_cache_decorators );
+   map_cache_decorators = calloc( MAX(1,decorator_nstack), sizeof(char) );
+   for (i=0; i<decorator_nstack; i++) {
+      decorator = &decorator_stack[i];
+      for (j=0; j<systems_nstack; j++) {
+         sys = system_getIndex( j );
+         if (!sys_isKnown(sys))
+            continue;
+         if ((decorator->x < sys->pos.x + decorator->detection_radius)
+               && (decorator->x > sys->pos.x - decorator->detection_radius)
+               && (decorator->y < sys->pos.y + decorator->detection_radius)
+               && (decorator->y > sys->pos.y - decorator->detection_radius)) {
+            map_cache_decorators[i] = 1;
+            break;
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Renders a cached map layer.
+ *
+ *    @param x X position of the map origin.
+ *    @param y Y position of the map origin.
+ *    @param layer Layer to render.
+ *    @param mode Primitives the layer is made of.
+ *    @param tex Texture to render with or NULL for none.
+ */
+static void map_renderCache( double x, double y, MapLayer layer,
+      GLenum mode, const glTexture *tex )
+{
+   GLsizei stride;
+
+   if (map_cache_n[layer] <= 0)
+      return;
+
+   stride = MAP_VERTEX_SIZE * sizeof(GLfloat);
+
+   gl_matrixPush();
+      gl_matrixTranslate( x, y );
+      gl_matrixScale( map_zoom, map_zoom );
+
+   if (tex != NULL) {
+      glEnable(GL_TEXTURE_2D);
+      glBindTexture( GL_TEXTURE_2D, tex->texture );
+      gl_vboActivateOffset( map_cache_vbo, GL_TEXTURE_COORD_ARRAY,
+            2*sizeof(GLfloat), 2, GL_FLOAT, stride );
+   }
+   gl_vboActivateOffset( map_cache_vbo, GL_VERTEX_ARRAY,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateOffset( map_cache_vbo, GL_COLOR_ARRAY,
+         4*sizeof(GLfloat), 4, GL_FLOAT, stride );
+   glDrawArrays( mode, map_cache_start[layer], map_cache_n[layer] );
+
+   /* Clear state. */
+   gl_vboDeactivate();
+   if (tex != NULL)
+      glDisable(GL_TEXTURE_2D);
+   gl_matrixPop();
+
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Renders the decorators near known systems.
+ */
+static void map_renderCacheDecorators( double x, double y )
+{
+   int i;
+   int sw, sh;
+   MapDecorator *decorator;
+
+   for (i=0; i<decorator_nstack; i++) {
+      decorator = &decorator_stack[i];
+      if ((decorator->picture == NULL) || !map_cache_decorators[i])
+         continue;
+
+      sw = decorator->picture->sw*map_zoom;
+      sh = decorator->picture->sh*map_zoom;
+      gl_blitScale( decorator->picture,
+            x + decorator->x*map_zoom - sw/2, y + decorator->y*map_zoom - sh/2,
+            sw, sh, &cWhite );
+   }
+}
+
+
+/**
+ * @brief Renders the names of the known systems in view.
+ */
+static void map_renderCacheNames( double bx, double by, double x, double y,
+      double w, double h )
+{
+   int i;
+   double tx, ty;
+   StarSystem *sys;
+
+   if (map_zoom <= 0.5)
+      return;
+
+   for (i=0; i<array_size(map_cache_names); i++) {
+      sys = system_getIndex( map_cache_names[i] );
+      tx = x + (sys->pos.x+11.) * map_zoom;
+      ty = y + (sys->pos.y-5.) * map_zoom;
+
+      /* Skip if out of bounds. */
+      if (!rectOverlap(tx, ty, map_cache_namew[i], gl_smallFont.h, bx, by, w, h))
+         continue;
+
+      gl_print( &gl_smallFont, tx, ty, &cWhite, sys->name );
+   }
+}
+
+
 /**
  * @brief Gets the render parameters.
  */
@@ -1840,6 +2212,7 @@ int map_map( const Outfit *map )
    for (i=0; i<array_size(map->u.map->jumps);i++)
       jp_setFlag(map->u.map->jumps[i], JP_KNOWN);
 
+   map_invalidate();
    return 1;
 }
 
@@ -1902,6 +2275,8 @@ int localmap_map( const Outfit *lmap )
       if (mod*p->hide <= detect)
          planet_setKnown( p );
    }
+
+   map_invalidate();
    return 0;
 }
 
@@ -1965,6 +2340,9 @@ void map_show( int wid, int x, int y, int w, int h, double zoom )
    /* Set zoom. */
    map_setZoom(zoom);
 
+   /* Known systems may have changed since it was last shown. */
+   map_invalidate();
+
    /* Make sure selected is sane. */
    sys = system_getIndex( map_selected );
    if (!(sys_isFlag(sys, SYSTEM_MARKED | SYSTEM_CMARKED)) &&
@@ -15,6 +15,7 @@
 #include "tech.h"
 #include "space.h"
 #include "nstring.h"
+#include "icon.h"
 
 
 #define MAP_WDWNAME     "Star Map" /**< Map window name. */
@@ -707,7 +708,7 @@ static void map_showOutfitDetail(unsigned int wid, char* wgtname, int x, int y,
 
    outfit = outfit_get( toolkit_getList(wid, wgtname) );
    window_modifyText( wid, "txtOutfitName", outfit->name );
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", icon_get( outfit->gfx_store ), 0, 0 );
 
    window_modifyText( wid, "txtDescription", outfit->description );
    credits2str( buf2, outfit->price, 2 );
@@ -157,8 +157,6 @@ MissionData* mission_getFromName( const char* name )
  */
 static int mission_init( Mission* mission, MissionData* misn, int genid, int create, unsigned int *id )
 {
-   char *buf;
-   size_t bufsize;
    int ret;
 
    /* clear the mission */
@@ -180,20 +178,19 @@ static int mission_init( Mission* mission, MissionData* misn, int genid, int cre
    misn_loadLibs( mission->env ); /* load our custom libraries */
 
    /* load the file */
-   buf = ndata_read( misn->lua, &bufsize );
-   if (buf == NULL) {
+   ret = nlua_dondataenv(mission->env, misn->lua);
+   if (ret == LUA_ERRFILE) {
       WARN(_("Mission '%s' Lua script not found."), misn->lua );
+      lua_pop(naevL, 1);
       return -1;
    }
-   if (nlua_dobufenv(mission->env, buf, bufsize, misn->lua) != 0) {
+   else if (ret != 0) {
       WARN(_("Error loading mission file: %s\n"
           "%s\n"
           "Most likely Lua file has improper syntax, please check"),
             misn->lua, lua_tostring(naevL, -1));
-      free(buf);
       return -1;
    }
-   free(buf);
 
    /* run create function */
    if (create) {
@@ -1044,12 +1041,14 @@ int missions_saveActive( xmlTextWriterPtr writer )
 
          /* Claims. */
          xmlw_startElem(writer,"claims");
-         claim_xmlSave( writer, player_missions[i]->claims );
+         if (claim_xmlSave( writer, player_missions[i]->claims ) < 0)
+            return -1;
          xmlw_endElem(writer); /* "claims" */
 
          /* Write Lua magic */
          xmlw_startElem(writer,"lua");
-         nxml_persistLua( player_missions[i]->env, writer );
+         if (nxml_persistLua( player_missions[i]->env, writer ) < 0)
+            return -1;
          xmlw_endElem(writer); /* "lua" */
 
          xmlw_endElem(writer); /* "mission" */
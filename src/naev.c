@@ -62,6 +62,7 @@
 #include "ai.h"
 #include "outfit.h"
 #include "weapon.h"
+#include "explosion.h"
 #include "faction.h"
 #include "nxml.h"
 #include "toolkit.h"
@@ -100,6 +101,7 @@
 #include "options.h"
 #include "dialogue.h"
 #include "slots.h"
+#include "icon.h"
 
 
 #define CONF_FILE       "conf.lua" /**< Configuration file by default. */
@@ -127,6 +129,9 @@ static double real_dt   = 0.; /**< Real deltatick. */
 const double fps_min    = 1./30.; /**< Minimum fps to run at. */
 static double fps_x     =  15.; /**< FPS X position. */
 static double fps_y     = -15.; /**< FPS Y position. */
+#define UPDATE_LOD_STEPS   8 /**< Steps distant pilots merge into one during time compression. */
+static int update_steps = 0; /**< Steps run during the last frame. */
+static int update_lod   = 0; /**< Pilot updates skipped by the coarse simulation during the last frame. */
 
 #if HAS_LINUX && HAS_BFD && defined(DEBUGGING)
 static bfd *abfd      = NULL;
@@ -140,8 +145,6 @@ static asymbol **syms = NULL;
 static void print_SDLversion (void);
 static void loadscreen_load (void);
 static void loadscreen_unload (void);
-static void load_all (void);
-static void unload_all (void);
 static void display_fps( const double dt );
 static void window_caption (void);
 static void debug_sigInit (void);
@@ -166,6 +169,15 @@ void naev_quit (void)
 }
 
 
+#ifdef NAEV_NO_MAIN
+/* Linked into a check that brings its own main(), so move ours out of the way
+ * like SDL_main does. */
+#undef main
+#define main naev_main
+int naev_main( int argc, char** argv );
+#endif /* NAEV_NO_MAIN */
+
+
 /**
  * @brief The entry point of Naev.
  *
@@ -282,6 +294,7 @@ int main( int argc, char** argv )
 
    conf_loadConfig(buf); /* Lua to parse the configuration file */
    conf_parseCLI( argc, argv ); /* parse CLI arguments */
+   nlua_setGC(); /* Lua settings from the configuration */
 
    if (conf.redirect_file && log_copying()) {
       log_redirect();
@@ -534,6 +547,7 @@ int main( int argc, char** argv )
    gl_exit(); /* Kills video output */
    sound_exit(); /* Kills the sound */
    news_exit(); /* Destroys the news. */
+   threadpool_exit(); /* Joins the worker threads. */
 
    /* Free the icon. */
    if (naev_icon)
@@ -732,6 +746,7 @@ void unload_all (void)
    player_cleanup(); /* cleans up the player stuff */
    gui_free(); /* cleans up the player's GUI */
    weapon_exit(); /* destroys all active weapons */
+   expl_clear(); /* drops pending explosion damage */
    pilots_free(); /* frees the pilots, they were locked up :( */
    cond_exit(); /* destroy conditional subsystem. */
    land_exit(); /* Destroys landing vbo and friends. */
@@ -750,6 +765,7 @@ void unload_all (void)
    events_cleanup(); /* Clean up events. */
    factions_free();
    commodity_free();
+   icon_exit(); /* after everything using store icons */
    var_cleanup(); /* cleans up mission variables */
    sp_cleanup();
 }
@@ -996,10 +1012,18 @@ static void update_all (void)
       microdt = game_dt / nf;
       n  = (int) nf;
 
+      /* Distant pilots don't need every step. */
+      if (conf.compression_lod)
+         pilots_setLOD( UPDATE_LOD_STEPS * microdt );
+
       /* Update as much as needed, evenly. */
       accumdt = 0.;
+      update_steps = 0;
+      update_lod   = 0;
       for (i=0; i<n; i++) {
          update_routine( microdt, 0 );
+         update_steps++;
+         update_lod += pilots_getLOD();
          /* Ok, so we need a bit of hackish logic here in case we are chopping up a
           * very large dt and it turns out time compression changes so we're now
           * updating in "normal time compression" zone. This amounts to many updates
@@ -1011,10 +1035,16 @@ static void update_all (void)
             break;
       }
 
+      /* Everyone catches up once we're out of time compression. */
+      pilots_setLOD( 0. );
+
       /* Note we don't touch game_dt so that fps_display works well */
    }
-   else /* Standard, just update with the last dt */
+   else { /* Standard, just update with the last dt */
       update_routine( game_dt, 0 );
+      update_steps = 1;
+      update_lod   = 0;
+   }
 
    fps_skipped = 0;
 }
@@ -1036,9 +1066,11 @@ void update_routine( double dt, int enter_sys )
 
    /* Update engine stuff. */
    space_update(dt);
+   expl_update(); /* asteroids blow up before anything moves */
    weapons_update(dt);
    spfx_update(dt);
    pilots_update(dt);
+   expl_update(); /* pilots blow up while they move */
 
    /* Update camera. */
    cam_update( dt );
@@ -1106,6 +1138,12 @@ static void display_fps( const double dt )
 {
    double x,y;
    double dt_mod_base = 1.;
+#ifdef DEBUGGING
+   int nvoices, nvirtual, ncapped;
+   size_t lua_mem;
+   static size_t lua_last = 0;
+   int pd, pc, wd, wc, sd, sc, ad, ac;
+#endif /* DEBUGGING */
 
    fps_dt  += dt;
    fps_cur += 1.;
@@ -1119,6 +1157,32 @@ static void display_fps( const double dt )
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+#ifdef DEBUGGING
+      sound_stats( &nvoices, &nvirtual, &ncapped );
+      gl_print( NULL, x, y, NULL, _("Voices: %d (%d virtual, %d capped)"),
+            nvoices, nvirtual, ncapped );
+      y -= gl_defFont.h + 5.;
+      gl_print( NULL, x, y, NULL, _("Steps: %d (%d pilot updates skipped)"),
+            update_steps, update_lod );
+      y -= gl_defFont.h + 5.;
+      lua_mem  = nlua_allocCount();
+      gl_print( NULL, x, y, NULL, _("Lua: %.1f KiB/frame (AI %.1f KiB)"),
+            (lua_mem - lua_last) / 1024., ai_memChurn() / 1024. );
+      lua_last = lua_mem;
+      y -= gl_defFont.h + 5.;
+      pilots_renderStats( &pd, &pc );
+      weapons_renderStats( &wd, &wc );
+      spfx_renderStats( &sd, &sc );
+      space_renderStats( &ad, &ac );
+      gl_print( NULL, x, y, NULL,
+            _("Drawn: %d pilots, %d weapons, %d effects, %d asteroids"),
+            pd, wd, sd, ad );
+      y -= gl_defFont.h + 5.;
+      gl_print( NULL, x, y, NULL,
+            _("Culled: %d pilots, %d weapons, %d effects, %d asteroids"),
+            pc, wc, sc, ac );
+      y -= gl_defFont.h + 5.;
+#endif /* DEBUGGING */
    }
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
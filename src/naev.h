@@ -107,4 +107,11 @@ char *naev_binary (void);
 void naev_quit (void);
 
 
+/*
+ * Data loading, done by main() but also used by the checks.
+ */
+void load_all (void);
+void unload_all (void);
+
+
 #endif /* NAEV_H */
@@ -21,6 +21,10 @@
  *  5) Makefile version
  *  6) ./ndata*
  *  7) dirname(argv[0])/ndata* (binary path)
+ *
+ * Lookups of files under dat/ go through an index of every file the data
+ *  sources hold, built on first use, so they don't have to probe each
+ *  location on disk every time.
  */
 
 #include "ndata.h"
@@ -29,6 +33,10 @@
 
 #if HAS_POSIX
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif /* HAS_POSIX */
 #if HAS_WIN32
 #include <windows.h>
@@ -49,6 +57,7 @@
 #include "npng.h"
 #include "nstring.h"
 #include "start.h"
+#include "array.h"
 
 
 #define NDATA_FILENAME  "ndata" /**< Generic ndata file name. */
@@ -61,6 +70,11 @@
 #define NDATA_SRC_DIRNAME        1
 #define NDATA_SRC_NDATADEF       2
 #define NDATA_SRC_BINARY         3
+#define NDATA_SRC_MAX            4 /**< Number of sources on disk. */
+
+
+#define NDATA_INDEX_PATH         "dat/" /**< Files below this path are indexed. */
+#define NDATA_INDEX_BUCKETS      4096 /**< Number of hash buckets of the index, must be a power of two. */
 
 
 /*
@@ -80,6 +94,38 @@ static int ndata_source             = 0;
 static char **ndata_fileList  = NULL; /**< List of files in the archive. */
 static size_t ndata_fileNList     = 0; /**< Number of files in ndata_fileList. */
 
+/*
+ * File index.
+ */
+/**
+ * @brief An indexed file.
+ */
+typedef struct NdataEntry_ {
+   char *name; /**< Path relative to the data root. */
+   uint32_t hash; /**< Hash of the name. */
+   int next; /**< Next entry in the same bucket, -1 if last. */
+   unsigned int sources; /**< Mask of the sources on disk holding the file, 0 if in the archive. */
+} NdataEntry;
+static NdataEntry *ndata_index  = NULL; /**< Indexed files (array.h). */
+static int *ndata_indexBuckets  = NULL; /**< First entry of each hash bucket, -1 if empty. */
+static int ndata_indexReady     = 0; /**< Whether the index is built. */
+static unsigned int ndata_gen   = 0; /**< Bumped whenever the data may have changed. */
+
+/*
+ * Mapped files.
+ */
+/**
+ * @brief A read only view of a file handed out by ndata_map().
+ */
+typedef struct NdataMap_ {
+   char *name; /**< Name of the file. */
+   void *data; /**< Data of the file. */
+   size_t size; /**< Size of the data. */
+   int refcount; /**< Users of the view. */
+   int mapped; /**< Whether data is mapped from disk or a copy to free. */
+} NdataMap;
+static NdataMap *ndata_maps     = NULL; /**< Views in use (array.h). */
+
 
 /*
  * Prototypes.
@@ -96,6 +142,15 @@ static char** ndata_listBackend( const char* path, size_t* nfiles, int dirs );
 static char **stripPath( const char **list, int nlist, const char *path );
 static char** filterList( const char** list, int nlist,
       const char* path, size_t* nfiles, int recursive );
+static int ndata_sourcePath( int src, const char *filename, char *path, size_t len );
+static int ndata_findSource( const char *filename );
+static int ndata_indexCovers( const char *filename );
+static uint32_t ndata_indexHash( const char *name );
+static NdataEntry* ndata_indexFind( const char *filename );
+static void ndata_indexAdd( const char *name, unsigned int sources );
+static void ndata_indexBuild (void);
+static void ndata_indexFree (void);
+static void* ndata_mapFile( const char *path, size_t *filesize );
 
 
 /**
@@ -128,6 +183,7 @@ int ndata_setPath( const char* path )
    free(ndata_dirname);
    ndata_filename = NULL;
    ndata_dirname  = NULL;
+   ndata_indexFree();
 
    if (path == NULL)
       return 0;
@@ -480,6 +536,8 @@ static int ndata_openFile (void)
    ndata_archive = nzip_open( ndata_filename );
    if (ndata_archive == NULL)
       WARN(_("Unable to open ndata from '%s'."), ndata_filename );
+   else
+      ndata_indexFree(); /* Index the archive instead. */
 
    /* Close lock. */
    SDL_mutexV(ndata_lock);
@@ -573,6 +631,24 @@ void ndata_close (void)
       ndata_fileNList = 0;
    }
 
+   /* Destroy the index. */
+   ndata_indexFree();
+
+   /* Views should have been released by now. */
+   if (ndata_maps != NULL) {
+      for (i=0; i<(unsigned int)array_size(ndata_maps); i++) {
+#if HAS_POSIX
+         if (ndata_maps[i].mapped)
+            munmap( ndata_maps[i].data, ndata_maps[i].size );
+         else
+#endif /* HAS_POSIX */
+            free( ndata_maps[i].data );
+         free( ndata_maps[i].name );
+      }
+      array_free( ndata_maps );
+      ndata_maps = NULL;
+   }
+
    /* Close the archive. */
    if (ndata_archive) {
       nzip_close(ndata_archive);
@@ -627,51 +703,94 @@ const char* ndata_getDirname(void)
 
 
 /**
- * @brief Checks to see if a file is in the NDATA.
- *    @param filename Name of the file to check.
- *    @return 1 if the file exists, 0 otherwise.
+ * @brief Gets the path of a file in one of the sources on disk.
+ *
+ *    @param src Source to get path in.
+ *    @param filename Name of the file relative to the data root.
+ *    @param[out] path Path of the file.
+ *    @param len Length of path.
+ *    @return 0 on success, -1 if the source isn't available.
  */
-int ndata_exists( const char* filename )
+static int ndata_sourcePath( int src, const char *filename, char *path, size_t len )
 {
-   char *buf, path[PATH_MAX];
-
-   /* See if needs to load ndata archive. */
-   if (ndata_archive == NULL) {
+   char *buf;
 
-      /* Try to read the file as locally. */
-      if (nfile_fileExists( filename ) && (ndata_source <= NDATA_SRC_LAIDOUT))
-         return 1;
+   switch (src) {
+      case NDATA_SRC_LAIDOUT:
+         nsnprintf( path, len, "%s", filename );
+         return 0;
 
-      /* We can try to use the dirname path. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         if (nfile_fileExists( path ))
-            return 1;
-      }
+      case NDATA_SRC_DIRNAME:
+         if ((ndata_filename != NULL) || (ndata_dirname == NULL))
+            return -1;
+         nsnprintf( path, len, "%s/%s", ndata_dirname, filename );
+         return 0;
 
-      /* We can also try default location. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
+      case NDATA_SRC_NDATADEF:
          buf = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
+         nsnprintf( path, len, "%s/%s", nfile_dirname(buf), filename );
          free(buf);
-         if (nfile_fileExists( path ))
-            return 1;
-      }
+         return 0;
 
-      /* Try binary location. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
+      case NDATA_SRC_BINARY:
          buf = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
+         nsnprintf( path, len, "%s/%s", nfile_dirname(buf), filename );
          free(buf);
-         if (nfile_fileExists( path ))
-            return 1;
-      }
+         return 0;
+   }
 
-      return 0;
+   return -1;
+}
+
+
+/**
+ * @brief Finds the first source on disk that has a file.
+ *
+ *    @param filename Name of the file to find.
+ *    @return The source holding the file or -1 if not found.
+ */
+static int ndata_findSource( const char *filename )
+{
+   NdataEntry *e;
+   char path[PATH_MAX];
+   int src;
+
+   /* Use the index when possible. */
+   if (ndata_indexCovers( filename )) {
+      e = ndata_indexFind( filename );
+      if (e == NULL)
+         return -1;
+      for (src=ndata_source; src<NDATA_SRC_MAX; src++)
+         if (e->sources & (1<<src))
+            return src;
+      return -1;
    }
 
+   /* Have to probe the disk. */
+   for (src=ndata_source; src<NDATA_SRC_MAX; src++) {
+      if (ndata_sourcePath( src, filename, path, sizeof(path) ))
+         continue;
+      if (nfile_fileExists( path ))
+         return src;
+   }
+   return -1;
+}
+
+
+/**
+ * @brief Checks to see if a file is in the NDATA.
+ *    @param filename Name of the file to check.
+ *    @return 1 if the file exists, 0 otherwise.
+ */
+int ndata_exists( const char* filename )
+{
+   /* See if needs to load ndata archive. */
+   if (ndata_archive == NULL)
+      return (ndata_findSource( filename ) >= 0);
+
    /* Try to get it from the archive. */
+   if (ndata_indexCovers( filename ))
+      return (ndata_indexFind( filename ) != NULL);
    return nzip_hasFile( ndata_archive, filename );
 }
 
@@ -687,67 +806,23 @@ void* ndata_read( const char* filename, size_t *filesize )
 {
    char *buf, path[PATH_MAX];
    size_t nbuf;
+   int src;
 
    /* See if needs to load ndata archive. */
    if (ndata_archive == NULL) {
 
-      /* Try to read the file as locally. */
-      if (nfile_fileExists( filename ) && (ndata_source <= NDATA_SRC_LAIDOUT)) {
-         buf = nfile_readFile( &nbuf, filename );
+      /* Try to read the file from disk. */
+      src = ndata_findSource( filename );
+      if ((src >= 0) && (ndata_sourcePath( src, filename, path, sizeof(path) ) == 0)) {
+         buf = nfile_readFile( &nbuf, path );
          if (buf != NULL) {
+            ndata_source = src;
             ndata_loadedfile = 1;
             *filesize = nbuf;
             return buf;
          }
       }
 
-      /* We can try to use the dirname path. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_DIRNAME;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
-      /* We can also try default location. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         buf = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_NDATADEF;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
-      /* Try binary location. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         buf = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_BINARY;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
       /* Load the ndata archive. */
       ndata_openFile();
    }
@@ -775,53 +850,18 @@ void* ndata_read( const char* filename, size_t *filesize )
  */
 SDL_RWops *ndata_rwops( const char* filename )
 {
-   char path[PATH_MAX], *tmp;
+   char path[PATH_MAX];
    SDL_RWops *rw;
+   int src;
 
    if (ndata_archive == NULL) {
 
-      /* Try to open from file. */
-      if (ndata_source <= NDATA_SRC_LAIDOUT) {
-         rw = SDL_RWFromFile( filename, "rb" );
-         if (rw != NULL) {
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from dirname. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         rw = SDL_RWFromFile( path, "rb" );
-         if (rw != NULL) {
-            ndata_source = NDATA_SRC_DIRNAME;
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from def. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         tmp = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(tmp), filename );
-         free(tmp);
-         rw = SDL_RWFromFile( path, "rb" );
-         if (rw != NULL) {
-            ndata_source = NDATA_SRC_NDATADEF;
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from binary. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         tmp = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(tmp), filename );
-         free(tmp);
+      /* Try to open from disk. */
+      src = ndata_findSource( filename );
+      if ((src >= 0) && (ndata_sourcePath( src, filename, path, sizeof(path) ) == 0)) {
          rw = SDL_RWFromFile( path, "rb" );
          if (rw != NULL) {
-            ndata_source = NDATA_SRC_BINARY;
+            ndata_source = src;
             ndata_loadedfile = 1;
             return rw;
          }
@@ -844,6 +884,341 @@ SDL_RWops *ndata_rwops( const char* filename )
 }
 
 
+/**
+ * @brief Maps a file on disk into memory.
+ *
+ *    @param path Path of the file.
+ *    @param[out] filesize Size of the file.
+ *    @return The mapped file or NULL if it can't be mapped.
+ */
+static void* ndata_mapFile( const char *path, size_t *filesize )
+{
+#if HAS_POSIX
+   int fd;
+   struct stat sb;
+   void *data;
+
+   fd = open( path, O_RDONLY );
+   if (fd < 0)
+      return NULL;
+   if ((fstat( fd, &sb ) != 0) || (sb.st_size <= 0)) {
+      close( fd );
+      return NULL;
+   }
+   data = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd ); /* The mapping keeps the file open. */
+   if (data == MAP_FAILED)
+      return NULL;
+
+   *filesize = sb.st_size;
+   return data;
+#else /* HAS_POSIX */
+   (void) path;
+   (void) filesize;
+   return NULL;
+#endif /* HAS_POSIX */
+}
+
+
+/**
+ * @brief Gets a read only view of a file in the ndata.
+ *
+ * Files laid out on disk are mapped into memory instead of being copied.
+ *  Anything else, like files in the ndata archive, falls back to
+ *  ndata_read(). Views of the same file are shared until every user has
+ *  released it with ndata_unmap().
+ *
+ * The data is not NUL terminated.
+ *
+ *    @param filename Name of the file to map.
+ *    @param[out] filesize Stores the size of the file.
+ *    @return The file data or NULL on error.
+ */
+const void* ndata_map( const char* filename, size_t *filesize )
+{
+   char path[PATH_MAX];
+   NdataMap *m;
+   void *data;
+   size_t size;
+   int i, src, mapped;
+
+   SDL_mutexP(ndata_lock);
+
+   /* Already mapped. */
+   if (ndata_maps == NULL)
+      ndata_maps = array_create( NdataMap );
+   for (i=0; i<array_size(ndata_maps); i++) {
+      if (strcmp( ndata_maps[i].name, filename ) == 0) {
+         ndata_maps[i].refcount++;
+         *filesize = ndata_maps[i].size;
+         SDL_mutexV(ndata_lock);
+         return ndata_maps[i].data;
+      }
+   }
+
+   /* Try to map it from disk. */
+   data   = NULL;
+   mapped = 0;
+   if (ndata_archive == NULL) {
+      src = ndata_findSource( filename );
+      if ((src >= 0) && (ndata_sourcePath( src, filename, path, sizeof(path) ) == 0)) {
+         data = ndata_mapFile( path, &size );
+         if (data != NULL) {
+            ndata_source     = src;
+            ndata_loadedfile = 1;
+            mapped           = 1;
+         }
+      }
+   }
+
+   /* Just read it otherwise. */
+   if (data == NULL) {
+      data = ndata_read( filename, &size );
+      if (data == NULL) {
+         *filesize = 0;
+         SDL_mutexV(ndata_lock);
+         return NULL;
+      }
+   }
+
+   m           = &array_grow( &ndata_maps );
+   m->name     = strdup( filename );
+   m->data     = data;
+   m->size     = size;
+   m->refcount = 1;
+   m->mapped   = mapped;
+
+   SDL_mutexV(ndata_lock);
+
+   *filesize = size;
+   return data;
+}
+
+
+/**
+ * @brief Releases a view obtained from ndata_map().
+ *
+ *    @param data Data of the view to release, NULL is ignored.
+ */
+void ndata_unmap( const void *data )
+{
+   NdataMap *m;
+   int i;
+
+   if ((data == NULL) || (ndata_maps == NULL))
+      return;
+
+   SDL_mutexP(ndata_lock);
+   for (i=0; i<array_size(ndata_maps); i++) {
+      m = &ndata_maps[i];
+      if (m->data != data)
+         continue;
+
+      m->refcount--;
+      if (m->refcount <= 0) {
+#if HAS_POSIX
+         if (m->mapped)
+            munmap( m->data, m->size );
+         else
+#endif /* HAS_POSIX */
+            free( m->data );
+         free( m->name );
+         array_erase( &ndata_maps, m, m+1 );
+      }
+      SDL_mutexV(ndata_lock);
+      return;
+   }
+   SDL_mutexV(ndata_lock);
+
+   WARN(_("Trying to unmap data that wasn't mapped by ndata!"));
+}
+
+
+/**
+ * @brief Checks to see if a file name is handled by the index.
+ *
+ * Only plain paths below NDATA_INDEX_PATH are, as those are the only ones
+ *  the index has the same name for as the caller.
+ */
+static int ndata_indexCovers( const char *filename )
+{
+   if (strncmp( filename, NDATA_INDEX_PATH, strlen(NDATA_INDEX_PATH) ) != 0)
+      return 0;
+   if ((strstr( filename, "//" ) != NULL) || (strstr( filename, "/." ) != NULL))
+      return 0;
+   return 1;
+}
+
+
+/**
+ * @brief Hashes a file name (FNV-1a).
+ */
+static uint32_t ndata_indexHash( const char *name )
+{
+   uint32_t h;
+   h = 2166136261u;
+   for (; *name != '\0'; name++) {
+      h ^= (unsigned char)*name;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Looks up a file in the index, building it if needed.
+ *
+ *    @param filename Name of the file to find.
+ *    @return The entry of the file or NULL if not indexed.
+ */
+static NdataEntry* ndata_indexFind( const char *filename )
+{
+   uint32_t h;
+   int i;
+
+   if (!ndata_indexReady)
+      ndata_indexBuild();
+
+   h = ndata_indexHash( filename );
+   for (i=ndata_indexBuckets[ h & (NDATA_INDEX_BUCKETS-1) ]; i>=0; i=ndata_index[i].next)
+      if ((ndata_index[i].hash == h) && (strcmp( ndata_index[i].name, filename ) == 0))
+         return &ndata_index[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Adds a file to the index being built, merging its sources if
+ *        already there.
+ */
+static void ndata_indexAdd( const char *name, unsigned int sources )
+{
+   NdataEntry *e;
+   uint32_t h;
+   int i, b;
+
+   h = ndata_indexHash( name );
+   b = h & (NDATA_INDEX_BUCKETS-1);
+   for (i=ndata_indexBuckets[b]; i>=0; i=ndata_index[i].next) {
+      if ((ndata_index[i].hash == h) && (strcmp( ndata_index[i].name, name ) == 0)) {
+         ndata_index[i].sources |= sources;
+         return;
+      }
+   }
+
+   e           = &array_grow( &ndata_index );
+   e->name     = strdup( name );
+   e->hash     = h;
+   e->sources  = sources;
+   e->next     = ndata_indexBuckets[b];
+   ndata_indexBuckets[b] = array_size(ndata_index)-1;
+}
+
+
+/**
+ * @brief Builds the file index.
+ *
+ * With an archive it's built from its file list, otherwise by scanning
+ *  NDATA_INDEX_PATH in every source on disk once.
+ */
+static void ndata_indexBuild (void)
+{
+   char path[PATH_MAX];
+   char **files;
+   size_t i, n, len;
+   int src;
+
+   SDL_mutexP(ndata_lock);
+
+   /* Was built while locked. */
+   if (ndata_indexReady) {
+      SDL_mutexV(ndata_lock);
+      return;
+   }
+
+   ndata_index        = array_create( NdataEntry );
+   ndata_indexBuckets = malloc( NDATA_INDEX_BUCKETS * sizeof(int) );
+   for (i=0; i<NDATA_INDEX_BUCKETS; i++)
+      ndata_indexBuckets[i] = -1;
+
+   if (ndata_archive != NULL) {
+      if (ndata_fileList == NULL)
+         ndata_fileList = nzip_listFiles( ndata_archive, &ndata_fileNList );
+      for (i=0; i<ndata_fileNList; i++)
+         if (ndata_indexCovers( ndata_fileList[i] ))
+            ndata_indexAdd( ndata_fileList[i], 0 );
+   }
+   else {
+      for (src=0; src<NDATA_SRC_MAX; src++) {
+         if (ndata_sourcePath( src, NDATA_INDEX_PATH, path, sizeof(path) ))
+            continue;
+         if (!nfile_dirExists( path ))
+            continue;
+
+         /* Names are returned with the path in front, we want them relative
+          * to the source. */
+         files = nfile_readDirRecursive( &n, path );
+         len   = strlen(path) - strlen(NDATA_INDEX_PATH);
+         for (i=0; i<n; i++) {
+            ndata_indexAdd( &files[i][len], 1<<src );
+            free( files[i] );
+         }
+         free( files );
+      }
+   }
+
+   ndata_indexReady = 1;
+   SDL_mutexV(ndata_lock);
+}
+
+
+/**
+ * @brief Frees the file index.
+ */
+static void ndata_indexFree (void)
+{
+   int i;
+
+   ndata_gen++;
+   ndata_indexReady = 0;
+   if (ndata_index != NULL) {
+      for (i=0; i<array_size(ndata_index); i++)
+         free( ndata_index[i].name );
+      array_free( ndata_index );
+      ndata_index = NULL;
+   }
+   free( ndata_indexBuckets );
+   ndata_indexBuckets = NULL;
+}
+
+
+/**
+ * @brief Gets the generation of the data.
+ *
+ * It changes whenever ndata is reopened, moved to another path or
+ *  invalidated, so caches of its contents know when to drop them.
+ *
+ *    @return The current generation.
+ */
+unsigned int ndata_generation (void)
+{
+   return ndata_gen;
+}
+
+
+/**
+ * @brief Drops the file index so it gets rebuilt on next use.
+ *
+ * Should be called whenever files in the data are written, renamed or
+ *  removed, e.g. by the developer mode editors.
+ */
+void ndata_invalidate (void)
+{
+   if (ndata_archive == NULL)
+      ndata_indexFree();
+}
+
+
 /**
  * @brief Removes a common path from a list of files, if present.
  *
@@ -941,7 +1316,9 @@ static char** ndata_listBackend( const char* path, size_t* nfiles, int recursive
 {
    (void) path;
    char **files, **tfiles, buf[PATH_MAX], *tmp;
-   size_t n;
+   const char **names;
+   size_t n, len;
+   int i, src;
    char** (*nfile_readFunc) ( size_t* nfiles, const char* path, ... ) = NULL;
 
    if (recursive)
@@ -953,6 +1330,26 @@ static char** ndata_listBackend( const char* path, size_t* nfiles, int recursive
    if (ndata_fileList != NULL)
       return filterList( (const char**) ndata_fileList, ndata_fileNList, path, nfiles, recursive );
 
+   /* List from the index, using the first source that has anything. */
+   if ((ndata_archive == NULL) && ndata_indexCovers( path )) {
+      if (!ndata_indexReady)
+         ndata_indexBuild();
+      len   = strlen( path );
+      names = malloc( (array_size(ndata_index)+1) * sizeof(char*) );
+      n     = 0;
+      for (src=ndata_source; (src<NDATA_SRC_MAX) && (n==0); src++)
+         for (i=0; i<array_size(ndata_index); i++)
+            if ((ndata_index[i].sources & (1<<src)) &&
+                  (strncmp( ndata_index[i].name, path, len ) == 0))
+               names[n++] = ndata_index[i].name;
+      if (n > 0) {
+         files = filterList( (const char**) names, n, path, nfiles, recursive );
+         free( names );
+         return files;
+      }
+      free( names );
+   }
+
    /* See if can load from local directory. */
    if (ndata_archive == NULL) {
 
@@ -83,9 +83,13 @@ const char* ndata_name (void);
  */
 int ndata_exists( const char* filename );
 void* ndata_read( const char* filename, size_t *filesize );
+const void* ndata_map( const char* filename, size_t *filesize );
+void ndata_unmap( const void *data );
 char** ndata_list( const char *path, size_t* nfiles );
 char** ndata_listRecursive( const char *path, size_t* nfiles );
 void ndata_sortName( char **files, size_t nfiles );
+void ndata_invalidate (void);
+unsigned int ndata_generation (void);
 
 
 /*
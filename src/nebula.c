@@ -33,7 +33,9 @@
 
 #define NEBULA_Z             16 /**< Z plane */
 #define NEBULA_PUFFS         32 /**< Amount of puffs to generate */
-#define NEBULA_PATH_BG       "nebu_bg_%dx%d_%02d.png" /**< Nebula path format. */
+#define NEBULA_PATH_BG       "nebu_tile_%d_%02d.png" /**< Nebula path format. */
+#define NEBULA_TILE          512 /**< Size of a tileable nebula layer (power of two). */
+#define NEBULA_RUGOSITY      3. /**< Noise lattice cells across a tile. */
 
 #define NEBULA_PUFF_BUFFER   300 /**< Nebula buffer */
 
@@ -44,10 +46,8 @@ extern void loadscreen_render( double done, const char *msg ); /**< from naev.c
 
 /* The nebula textures */
 static GLuint nebu_textures[NEBULA_Z]; /**< BG Nebula textures. */
-static int nebu_w    = 0; /**< BG Nebula width. */
-static int nebu_h    = 0; /**< BG Nebula height. */
-static int nebu_pw   = 0; /**< BG Padded Nebula width. */
-static int nebu_ph   = 0; /**< BG Padded Nebula height. */
+static int nebu_w    = 0; /**< BG Nebula tile width. */
+static int nebu_h    = 0; /**< BG Nebula tile height. */
 
 /* Information on rendering */
 static int cur_nebu[2]           = { 0, 1 }; /**< Nebulae currently rendering. */
@@ -135,22 +135,14 @@ static int nebu_init_recursive( int iter )
    if ((nebu_w == -9) && (nebu_h == -9))
       nebu_generate();
 
-   /* Set expected sizes */
-   nebu_w  = SCREEN_W;
-   nebu_h  = SCREEN_H;
-   if (gl_needPOT()) {
-      nebu_pw = gl_pot(nebu_w);
-      nebu_ph = gl_pot(nebu_h);
-   }
-   else {
-      nebu_pw = nebu_w;
-      nebu_ph = nebu_h;
-   }
+   /* Set expected sizes, tiles don't depend on the resolution. */
+   nebu_w  = NEBULA_TILE;
+   nebu_h  = NEBULA_TILE;
 
    /* Load each, checking for compatibility and padding */
    glGenTextures( NEBULA_Z, nebu_textures );
    for (i=0; i<NEBULA_Z; i++) {
-      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, nebu_w, nebu_h, i );
+      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, nebu_w, i );
 
       /* Check compatibility. */
       if (nebu_checkCompat( nebu_file ))
@@ -165,7 +157,7 @@ static int nebu_init_recursive( int iter )
                nebu_sur->w, nebu_sur->h, nebu_w, nebu_h );
 
       /* Load the texture */
-      ret = nebu_loadTexture( nebu_sur, nebu_pw, nebu_ph, nebu_textures[i] );
+      ret = nebu_loadTexture( nebu_sur, nebu_w, nebu_h, nebu_textures[i] );
       if (ret)
          goto no_nebula;
    }
@@ -194,6 +186,9 @@ no_nebula:
 
 /**
  * @brief Initializes the nebula VBO.
+ *
+ * The layers wrap around, so covering a new resolution only needs the texture
+ *  coordinates to repeat the tile more or fewer times.
  */
 void nebu_vbo_init (void)
 {
@@ -216,8 +211,8 @@ void nebu_vbo_init (void)
    vertex[6] = SCREEN_W;
    vertex[7] = SCREEN_H;
    /* Texture 0. */
-   tw = (double)nebu_w / (double)nebu_pw;
-   th = (double)nebu_h / (double)nebu_ph;
+   tw = (double)SCREEN_W / (double)nebu_w;
+   th = (double)SCREEN_H / (double)nebu_h;
    vertex[8]  = 0.;
    vertex[9]  = 0.;
    vertex[10] = tw;
@@ -273,7 +268,7 @@ static int nebu_loadTexture( SDL_Surface *sur, int w, int h, GLuint tex )
    if ((w!=0) && (h!=0) &&
          ((nebu_sur->w != w) || (nebu_sur->h != h))) {
       WARN(_("Nebula size doesn't match expected! (%dx%d instead of %dx%d)"),
-            nebu_sur->w, nebu_sur->h, nebu_pw, nebu_ph );
+            nebu_sur->w, nebu_sur->h, w, h );
       return -1;
    }
 
@@ -281,6 +276,8 @@ static int nebu_loadTexture( SDL_Surface *sur, int w, int h, GLuint tex )
    glBindTexture( GL_TEXTURE_2D, tex );
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
    /* Store into opengl saving only alpha channel in video memory */
    SDL_LockSurface( nebu_sur );
@@ -758,11 +755,11 @@ static int nebu_generate (void)
    int ret;
 
    /* Warn user of what is happening. */
-   loadscreen_render( 0.05, _("Generating Nebula (slow, run once)...") );
+   loadscreen_render( 0.05, _("Generating Nebula...") );
 
-   /* Get resolution to create at. */
-   w = SCREEN_W;
-   h = SCREEN_H;
+   /* Tiles are generated once, independently of the resolution. */
+   w = NEBULA_TILE;
+   h = NEBULA_TILE;
 
    /* Try to make the dir first if it fails. */
    cache = nfile_cachePath();
@@ -770,14 +767,16 @@ static int nebu_generate (void)
    nfile_dirMakeExist( "%s"NEBULA_PATH, cache );
 
    /* Generate all the nebula backgrounds */
-   nebu = noise_genNebulaMap( w, h, NEBULA_Z, 5. );
+   nebu = noise_genNebulaMap( w, h, NEBULA_Z, NEBULA_RUGOSITY );
+   if (nebu == NULL)
+      return -1;
 
    /* Start saving - compression can take a bit. */
    loadscreen_render( 0.05, _("Compressing Nebula layers...") );
 
    /* Save each nebula as an image */
    for (i=0; i<NEBULA_Z; i++) {
-      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, w, h, i );
+      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, w, i );
       ret = saveNebula( &nebu[ i*w*h ], w, h, nebu_file );
       if (ret != 0)
          break; /* An error has happened */
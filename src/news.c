@@ -74,6 +74,8 @@ static int news_parseArticle( xmlNodePtr parent );
 int news_saveArticles( xmlTextWriterPtr writer ); /* externed in save.c */
 int news_loadArticles( xmlNodePtr parent ); /* externed in load.c */
 static char* make_clean( char* unclean );
+static int news_saveArticle( xmlTextWriterPtr writer, news_t *article,
+      const char *ntitle, const char *ndesc );
 static char* get_fromclean( char *clean );
 static void clear_newslines (void);
 
@@ -560,6 +562,32 @@ static char* get_fromclean( char *clean)
 }
 
 
+/**
+ * @brief Saves the attributes of an article.
+ *
+ *    @param writer XML writer to use.
+ *    @param article Article to save.
+ *    @param ntitle Cleaned up title.
+ *    @param ndesc Cleaned up description.
+ *    @return 0 on success.
+ */
+static int news_saveArticle( xmlTextWriterPtr writer, news_t *article,
+      const char *ntitle, const char *ndesc )
+{
+   xmlw_attr(writer, "title", "%s", ntitle);
+   xmlw_attr(writer, "desc", "%s", ndesc);
+   xmlw_attr(writer, "faction", "%s", article->faction);
+   xmlw_attr(writer, "date", "%"PRIi64, article->date);
+   xmlw_attr(writer, "date_to_rm", "%"PRIi64, article->date_to_rm);
+   xmlw_attr(writer, "id", "%i", article->id);
+
+   if (article->tag != NULL)
+      xmlw_attr(writer, "tag", "%s", article->tag);
+
+   return 0;
+}
+
+
 /*
  * @brief saves all current articles
  *    @return 0 on success
@@ -568,6 +596,7 @@ int news_saveArticles( xmlTextWriterPtr writer )
 {
    news_t *article_ptr;
    char *ntitle, *ndesc;
+   int ret;
 
    article_ptr = news_list;
 
@@ -580,19 +609,11 @@ int news_saveArticles( xmlTextWriterPtr writer )
 
          ntitle = make_clean( article_ptr->title );
          ndesc  = make_clean( article_ptr->desc );
-
-         xmlw_attr(writer, "title", "%s", ntitle);
-         xmlw_attr(writer, "desc", "%s", ndesc);
-         xmlw_attr(writer, "faction", "%s", article_ptr->faction);
-         xmlw_attr(writer, "date", "%"PRIi64, article_ptr->date);
-         xmlw_attr(writer, "date_to_rm", "%"PRIi64, article_ptr->date_to_rm);
-         xmlw_attr(writer, "id", "%i", article_ptr->id);
-
-         if (article_ptr->tag != NULL)
-            xmlw_attr(writer, "tag", "%s", article_ptr->tag);
-
+         ret    = news_saveArticle( writer, article_ptr, ntitle, ndesc );
          free(ntitle);
          free(ndesc);
+         if (ret < 0)
+            return -1;
 
          xmlw_endElem(writer); /* "article" */
       }
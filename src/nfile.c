@@ -453,6 +453,54 @@ int nfile_fileExists( const char* path, ... )
 }
 
 
+/**
+ * @brief Gets the size and modification time of a file.
+ *
+ * The modification time is in nanoseconds with whatever precision the
+ *  platform gives, from an unspecified epoch. It is only meant to tell if the
+ *  file changed, which a whole second can hide.
+ *
+ *    @param[out] filesize Size of the file in bytes.
+ *    @param[out] mtime Last modification time of the file.
+ *    @param path printf formatted string pointing to the file.
+ *    @return 0 on success.
+ */
+int nfile_fileStat( size_t *filesize, int64_t *mtime, const char* path, ... )
+{
+   char file[PATH_MAX];
+   va_list ap;
+   struct stat buf;
+#if HAS_WIN32
+   WIN32_FILE_ATTRIBUTE_DATA attr;
+#endif /* HAS_WIN32 */
+
+   if (path == NULL)
+      return -1;
+   va_start(ap, path);
+   vsnprintf(file, PATH_MAX, path, ap);
+   va_end(ap);
+
+   if (stat(file,&buf) != 0)
+      return -1;
+
+   *filesize = buf.st_size;
+#if HAS_MACOS
+   *mtime    = (int64_t)buf.st_mtimespec.tv_sec * 1000000000 + buf.st_mtimespec.tv_nsec;
+#elif HAS_POSIX
+   *mtime    = (int64_t)buf.st_mtim.tv_sec * 1000000000 + buf.st_mtim.tv_nsec;
+#elif HAS_WIN32
+   /* Last write time in 100 ns steps. */
+   if (!GetFileAttributesEx( file, GetFileExInfoStandard, &attr ))
+      return -1;
+   *mtime    = (((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32) |
+         attr.ftLastWriteTime.dwLowDateTime) * 100;
+#else /* HAS_MACOS */
+   *mtime    = (int64_t)buf.st_mtime * 1000000000;
+#endif /* HAS_MACOS */
+   return 0;
+}
+
+
 /**
  * @brief Backup a file, if it exists.
  *
@@ -873,7 +921,10 @@ int nfile_delete( const char* file )
 }
 
 /**
- * @brief Renames a file.
+ * @brief Renames a file, replacing the destination if it exists.
+ *
+ * On the same filesystem the replacement is atomic, so readers see either
+ * the old or the new file but never a partially written one.
  *
  *    @param oldname Old name of the file.
  *    @param newname New name to set the file to.
@@ -889,12 +940,14 @@ int nfile_rename( const char* oldname, const char* newname )
       WARN(_("Can not rename to NULL file name"));
       return -1;
    }
-   if (nfile_fileExists( newname )) {
-      WARN(_("Error renaming %s to %s. %s already exists"),oldname,newname,newname);
+#if HAS_WIN32
+   if (!MoveFileEx( oldname, newname, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH )) {
+#else /* HAS_WIN32 */
+   if (rename(oldname,newname)) {
+#endif /* HAS_WIN32 */
+      WARN(_("Error renaming %s to %s"),oldname,newname);
       return -1;
    }
-   if (rename(oldname,newname))
-      WARN(_("Error renaming %s to %s"),oldname,newname);
    return 0;
 }
 
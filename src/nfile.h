@@ -18,6 +18,7 @@ char* nfile_dirname( char *path );
 int nfile_dirMakeExist( const char* path, ... ); /* Creates if doesn't exist, 0 success */
 int nfile_dirExists( const char* path, ... ); /* Returns 1 on exists. */
 int nfile_fileExists( const char* path, ... ); /* Returns 1 on exists */
+int nfile_fileStat( size_t *filesize, int64_t *mtime, const char* path, ... ); /* 0 on success */
 int nfile_backupIfExists( const char* path, ... );
 int nfile_copyIfExists( const char* path1, const char* path2 );
 char** nfile_readDir( size_t* nfiles, const char* path, ... );
@@ -32,10 +32,48 @@
 #include "nlua_commodity.h"
 #include "nlua_cli.h"
 #include "nstring.h"
+#include "nfile.h"
+#include "array.h"
+#include "conf.h"
+#include "md5.h"
+
+
+#define NLUA_CACHE_PATH    "luac/" /**< Subdirectory of the cache path for persisted bytecode. */
+#define NLUA_SHARED_MARKER "--@shared" /**< First line marking a module as shareable between environments. */
+#define NLUA_CHUNK_BUCKETS 256 /**< Number of hash buckets of the bytecode cache, must be a power of two. */
+
+
+/**
+ * @brief Compiled Lua chunk kept around so scripts don't get recompiled.
+ */
+typedef struct nlua_chunk_s {
+   char *path; /**< ndata path the chunk was loaded from. */
+   uint32_t hash; /**< Hash of the path. */
+   int next; /**< Next chunk in the same bucket, -1 if last. */
+   char *data; /**< Bytecode as output by lua_dump(). */
+   size_t len; /**< Length of the bytecode. */
+   int shared; /**< Chunk is a pure module that can be shared between environments. */
+} nlua_chunk;
+
+
+/**
+ * @brief Growable buffer used as the lua_dump() writer target.
+ */
+typedef struct nlua_dumpbuf_s {
+   char *data; /**< Data written so far. */
+   size_t len; /**< Length of the data. */
+   size_t max; /**< Allocated memory. */
+} nlua_dumpbuf;
 
 
 lua_State *naevL = NULL;
 nlua_env __NLUA_CURENV = LUA_NOREF;
+static nlua_chunk *nlua_chunks = NULL; /**< Cache of compiled ndata chunks. */
+static int *nlua_chunkBuckets = NULL; /**< First chunk of each hash bucket, -1 if empty. */
+static unsigned int nlua_chunkGen = 0; /**< ndata generation the chunks were compiled from. */
+static int nlua_sharedRef = LUA_NOREF; /**< Registry reference to the table of loaded shared modules. */
+static lua_Alloc nlua_allocf = NULL; /**< Allocator the state came with. */
+static size_t nlua_allocated = 0; /**< Bytes allocated by Lua so far. */
 
 
 /*
@@ -43,8 +81,24 @@ nlua_env __NLUA_CURENV = LUA_NOREF;
  */
 static int nlua_packfileLoader( lua_State* L );
 static lua_State *nlua_newState (void); /* creates a new state */
+static void* nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize );
 static int nlua_loadBasic( lua_State* L );
 static int nlua_errTrace( lua_State *L );
+/* bytecode cache */
+static uint32_t nlua_chunkHash( const char *path );
+static nlua_chunk* nlua_chunkGet( const char *path );
+static nlua_chunk* nlua_chunkAdd( const char *path, char *data, size_t len, int shared );
+static void nlua_chunkFree (void);
+static int nlua_dumpWriter( lua_State *L, const void *p, size_t sz, void *ud );
+static void nlua_chunkDigest( char digest[33], const char *name, const char *data, size_t len );
+static char* nlua_chunkReadCache( const char *digest, size_t *len );
+static void nlua_chunkWriteCache( const char *digest, const char *data, size_t len );
+/* shared modules */
+static void nlua_pushShared( lua_State *L );
+static int nlua_sharedLink( lua_State *L, int envtab, const char *path );
+static int nlua_sharedRun( lua_State *L, int envtab, const char *path );
+static int nlua_sharedNewindex( lua_State *L );
+static size_t nlua_memSize( lua_State *L, int idx, int seen );
 /* gettext */
 static int nlua_gettext( lua_State *L );
 static int nlua_ngettext( lua_State *L );
@@ -101,10 +155,36 @@ void lua_init(void) {
 }
 
 
+/**
+ * @brief Applies the garbage collector settings from the configuration.
+ */
+void nlua_setGC (void)
+{
+   if (conf.lua_gcpause > 0)
+      lua_gc( naevL, LUA_GCSETPAUSE, conf.lua_gcpause );
+   if (conf.lua_gcstepmul > 0)
+      lua_gc( naevL, LUA_GCSETSTEPMUL, conf.lua_gcstepmul );
+}
+
+
+/**
+ * @brief Gets how many bytes Lua has allocated since it was started.
+ *
+ * Never goes down, so the difference between two calls is the memory
+ *  churned in between regardless of collections.
+ */
+size_t nlua_allocCount (void)
+{
+   return nlua_allocated;
+}
+
+
 /*
  * @brief Closes the global Lua state.
  */
 void lua_exit(void) {
+   nlua_chunkFree();
+   nlua_sharedRef = LUA_NOREF;
    lua_close(naevL);
    naevL = NULL;
 }
@@ -149,6 +229,303 @@ int nlua_dofileenv(nlua_env env, const char *filename) {
 }
 
 
+/*
+ * @brief Run a script from ndata in Lua environment.
+ *
+ * The script is compiled through the bytecode cache, so running the same
+ * file again only has to load the bytecode.
+ *
+ *    @param env Lua environment.
+ *    @param path Path of the script in ndata.
+ *    @return 0 on success, LUA_ERRFILE if the file wasn't found, -1 on
+ *            other errors. Error message is left on the stack on failure.
+ */
+int nlua_dondataenv(nlua_env env, const char *path) {
+   int ret;
+   ret = nlua_loadndata(naevL, path);
+   if (ret != 0)
+      return (ret==LUA_ERRFILE) ? LUA_ERRFILE : -1;
+   nlua_pushenv(env);
+   lua_setfenv(naevL, -2);
+   if (nlua_pcall(env, 0, LUA_MULTRET) != 0)
+      return -1;
+   return 0;
+}
+
+
+/**
+ * @brief Loads a chunk from ndata, using the bytecode cache.
+ *
+ * Behaves like luaL_loadbuffer(): on success the compiled chunk is pushed
+ * onto the stack, otherwise the error message is.
+ *
+ *    @param L Lua state to load into.
+ *    @param path Path of the script in ndata.
+ *    @return 0 on success, LUA_ERRFILE if not found or a Lua error code.
+ */
+int nlua_loadndata( lua_State *L, const char *path )
+{
+   nlua_chunk *chunk;
+   nlua_dumpbuf dump;
+   char *buf, *cache, digest[33];
+   size_t bufsize, cachesize;
+   int ret, shared;
+
+   /* Already compiled. */
+   chunk = nlua_chunkGet( path );
+   if (chunk != NULL)
+      return luaL_loadbuffer( L, chunk->data, chunk->len, path );
+
+   if (!ndata_exists( path )) {
+      lua_pushfstring( L, _("cannot open %s: not found in ndata"), path );
+      return LUA_ERRFILE;
+   }
+   buf = ndata_read( path, &bufsize );
+   if (buf == NULL) {
+      lua_pushfstring( L, _("cannot read %s"), path );
+      return LUA_ERRFILE;
+   }
+
+   /* Modules opt into being shared with a marker on the first line. */
+   shared = (bufsize >= strlen(NLUA_SHARED_MARKER)) &&
+         (strncmp( buf, NLUA_SHARED_MARKER, strlen(NLUA_SHARED_MARKER) )==0);
+
+   /* Try the persistent cache, keyed by the hash of the source. */
+   digest[0] = '\0';
+   if (conf.lua_cache) {
+      nlua_chunkDigest( digest, path, buf, bufsize );
+      cache = nlua_chunkReadCache( digest, &cachesize );
+      if (cache != NULL) {
+         if (luaL_loadbuffer( L, cache, cachesize, path ) == 0) {
+            nlua_chunkAdd( path, cache, cachesize, shared );
+            free(buf);
+            return 0;
+         }
+         /* Stale or incompatible bytecode, just recompile. */
+         lua_pop(L,1);
+         free(cache);
+      }
+   }
+
+   /* Compile the source. */
+   ret = luaL_loadbuffer( L, buf, bufsize, path );
+   free(buf);
+   if (ret != 0)
+      return ret;
+
+   /* Dump the bytecode to the cache, the function stays on the stack. */
+   memset( &dump, 0, sizeof(dump) );
+   if (lua_dump( L, nlua_dumpWriter, &dump ) != 0) {
+      free( dump.data );
+      return 0;
+   }
+   nlua_chunkAdd( path, dump.data, dump.len, shared );
+   if (conf.lua_cache)
+      nlua_chunkWriteCache( digest, dump.data, dump.len );
+
+   return 0;
+}
+
+
+/**
+ * @brief Hashes a chunk path (FNV-1a).
+ */
+static uint32_t nlua_chunkHash( const char *path )
+{
+   uint32_t h;
+   h = 2166136261u;
+   for (; *path != '\0'; path++) {
+      h ^= (unsigned char)*path;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Looks up a compiled chunk in the cache.
+ *
+ * The cache and the shared modules run from it are dropped first if ndata
+ *  was reopened or changed since they were compiled.
+ */
+static nlua_chunk* nlua_chunkGet( const char *path )
+{
+   uint32_t h;
+   int i;
+
+   if (nlua_chunkGen != ndata_generation()) {
+      nlua_chunkFree();
+      if ((naevL != NULL) && (nlua_sharedRef != LUA_NOREF)) {
+         luaL_unref( naevL, LUA_REGISTRYINDEX, nlua_sharedRef );
+         nlua_sharedRef = LUA_NOREF;
+      }
+      nlua_chunkGen = ndata_generation();
+   }
+
+   if (nlua_chunks == NULL)
+      return NULL;
+
+   h = nlua_chunkHash( path );
+   for (i=nlua_chunkBuckets[ h & (NLUA_CHUNK_BUCKETS-1) ]; i>=0; i=nlua_chunks[i].next)
+      if ((nlua_chunks[i].hash == h) && (strcmp( nlua_chunks[i].path, path )==0))
+         return &nlua_chunks[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Adds a compiled chunk to the cache, taking ownership of data.
+ */
+static nlua_chunk* nlua_chunkAdd( const char *path, char *data, size_t len, int shared )
+{
+   nlua_chunk *chunk;
+   int i, b;
+
+   if (nlua_chunks == NULL) {
+      nlua_chunks       = array_create( nlua_chunk );
+      nlua_chunkBuckets = malloc( NLUA_CHUNK_BUCKETS * sizeof(int) );
+      for (i=0; i<NLUA_CHUNK_BUCKETS; i++)
+         nlua_chunkBuckets[i] = -1;
+   }
+
+   chunk       = &array_grow( &nlua_chunks );
+   chunk->path = strdup( path );
+   chunk->hash = nlua_chunkHash( path );
+   chunk->data = data;
+   chunk->len  = len;
+   chunk->shared = shared;
+
+   b           = chunk->hash & (NLUA_CHUNK_BUCKETS-1);
+   chunk->next = nlua_chunkBuckets[b];
+   nlua_chunkBuckets[b] = array_size(nlua_chunks)-1;
+   return chunk;
+}
+
+
+/**
+ * @brief Frees the bytecode cache.
+ */
+static void nlua_chunkFree (void)
+{
+   int i;
+
+   if (nlua_chunks == NULL)
+      return;
+
+   for (i=0; i<array_size(nlua_chunks); i++) {
+      free( nlua_chunks[i].path );
+      free( nlua_chunks[i].data );
+   }
+   array_free( nlua_chunks );
+   nlua_chunks = NULL;
+   free( nlua_chunkBuckets );
+   nlua_chunkBuckets = NULL;
+}
+
+
+/**
+ * @brief lua_dump() writer that appends to a nlua_dumpbuf.
+ */
+static int nlua_dumpWriter( lua_State *L, const void *p, size_t sz, void *ud )
+{
+   (void) L;
+   nlua_dumpbuf *dump = (nlua_dumpbuf*) ud;
+
+   if (dump->len + sz > dump->max) {
+      dump->max = MAX( 2*dump->max, dump->len + sz );
+      dump->data = realloc( dump->data, dump->max );
+      if (dump->data == NULL) {
+         WARN(_("Out of Memory"));
+         return 1;
+      }
+   }
+   memcpy( &dump->data[ dump->len ], p, sz );
+   dump->len += sz;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the hex md5 digest of some data.
+ *
+ *    @param[out] digest Where to write the digest.
+ *    @param name Name to hash in front of the data (can be NULL).
+ *    @param data Data to hash.
+ *    @param len Length of the data.
+ */
+static void nlua_chunkDigest( char digest[33], const char *name, const char *data, size_t len )
+{
+   int i;
+   md5_state_t md5;
+   md5_byte_t md5val[16];
+
+   md5_init( &md5 );
+   /* Chunk name is stored in the debug info, so it's part of the key. */
+   if (name != NULL)
+      md5_append( &md5, (const md5_byte_t*)name, strlen(name) );
+   md5_append( &md5, (const md5_byte_t*)data, len );
+   md5_finish( &md5, md5val );
+   for (i=0; i<16; i++)
+      nsnprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+}
+
+
+/**
+ * @brief Reads persisted bytecode for a source digest.
+ *
+ * The file consists of the md5 digest of the bytecode followed by the
+ * bytecode itself, so truncated or corrupted files are never loaded.
+ *
+ *    @param digest Digest of the source.
+ *    @param[out] len Length of the bytecode.
+ *    @return The bytecode or NULL if not available.
+ */
+static char* nlua_chunkReadCache( const char *digest, size_t *len )
+{
+   char *buf, *data, check[33];
+   size_t bufsize;
+
+   if (!nfile_fileExists( "%s"NLUA_CACHE_PATH"%s", nfile_cachePath(), digest ))
+      return NULL;
+
+   buf = nfile_readFile( &bufsize, "%s"NLUA_CACHE_PATH"%s", nfile_cachePath(), digest );
+   if ((buf == NULL) || (bufsize <= 32)) {
+      free(buf);
+      return NULL;
+   }
+
+   nlua_chunkDigest( check, NULL, &buf[32], bufsize-32 );
+   if (strncmp( check, buf, 32 ) != 0) {
+      free(buf);
+      return NULL;
+   }
+
+   *len = bufsize-32;
+   data = malloc( *len );
+   memcpy( data, &buf[32], *len );
+   free(buf);
+   return data;
+}
+
+
+/**
+ * @brief Persists bytecode for a source digest.
+ */
+static void nlua_chunkWriteCache( const char *digest, const char *data, size_t len )
+{
+   char *buf;
+
+   if (nfile_dirMakeExist( "%s"NLUA_CACHE_PATH, nfile_cachePath() ))
+      return;
+
+   buf = malloc( len+32 );
+   nlua_chunkDigest( buf, NULL, data, len ); /* buf[32] gets overwritten below. */
+   memcpy( &buf[32], data, len );
+   nfile_writeFile( buf, len+32, "%s"NLUA_CACHE_PATH"%s", nfile_cachePath(), digest );
+   free(buf);
+}
+
+
 /*
  * @brief Create an new environment in global Lua state.
  *
@@ -269,6 +646,7 @@ void nlua_register(nlua_env env, const char *libname,
 static lua_State *nlua_newState (void)
 {
    lua_State *L;
+   void *ud;
 
    /* try to create the new state */
    L = luaL_newstate();
@@ -277,10 +655,25 @@ static lua_State *nlua_newState (void)
       return NULL;
    }
 
+   /* Count allocations. */
+   nlua_allocf = lua_getallocf( L, &ud );
+   lua_setallocf( L, nlua_alloc, ud );
+
    return L;
 }
 
 
+/**
+ * @brief Allocator wrapper that counts the bytes Lua allocates.
+ */
+static void* nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+   if (nsize > osize)
+      nlua_allocated += nsize - osize;
+   return nlua_allocf( ud, ptr, osize, nsize );
+}
+
+
 /**
  * @brief Loads specially modified basic stuff.
  *
@@ -339,10 +732,9 @@ static int nlua_packfileLoader( lua_State* L )
 {
    const char *filename;
    char *path_filename;
-   char *buf;
-   int len;
-   size_t bufsize;
+   int len, ret;
    int envtab;
+   nlua_chunk *chunk;
 
    /* Environment table to load module into */
    envtab = lua_upvalueindex(1);
@@ -367,42 +759,52 @@ static int nlua_packfileLoader( lua_State* L )
       lua_setfield(L, envtab, "_include"); /* */
    }
 
-   /* Try to locate the data directly */
-   buf = NULL;
-   if (ndata_exists( filename ))
-      buf = ndata_read( filename, &bufsize );
-   /* If failed to load or doesn't exist try again with INCLUDE_PATH prefix. */
-   if (buf == NULL) {
-      /* Try to locate the data in the data path */
-      len           = strlen(LUA_INCLUDE_PATH)+strlen(filename)+2;
-      path_filename = malloc( len );
-      nsnprintf( path_filename, len, "%s%s", LUA_INCLUDE_PATH, filename );
-      if (ndata_exists( path_filename ))
-         buf = ndata_read( path_filename, &bufsize );
-      free( path_filename );
-   }
-
-   /* Must have buf by now. */
-   if (buf == NULL) {
-      DEBUG(_("include(): %s not found in ndata."), filename);
-      luaL_error(L, _("include(): %s not found in ndata."), filename);
-      return 1;
-   }
+   /* Resolve the path, preferring chunks that are already compiled. */
+   len           = strlen(LUA_INCLUDE_PATH)+strlen(filename)+2;
+   path_filename = malloc( len );
+   nsnprintf( path_filename, len, "%s%s", LUA_INCLUDE_PATH, filename );
+   if ((nlua_chunkGet( filename ) != NULL) ||
+         ((nlua_chunkGet( path_filename ) == NULL) && ndata_exists( filename )))
+      nsnprintf( path_filename, len, "%s", filename );
+
+   /* Shared modules only have to be linked into the environment. */
+   if (!nlua_sharedLink( L, envtab, path_filename )) {
+      ret = nlua_loadndata( L, path_filename );
+
+      /* Must have the chunk by now. */
+      if (ret == LUA_ERRFILE) {
+         free( path_filename );
+         lua_pop(L,1);
+         DEBUG(_("include(): %s not found in ndata."), filename);
+         luaL_error(L, _("include(): %s not found in ndata."), filename);
+         return 1;
+      }
+      else if (ret != 0) {
+         free( path_filename );
+         lua_error(L);
+         return 1;
+      }
 
-   if (luaL_loadbuffer(L, buf, bufsize, filename) != 0) {
-      lua_error(L);
-      return 1;
-   }
+      /* Pure modules are run once in their own environment. */
+      chunk = nlua_chunkGet( path_filename );
+      if ((chunk != NULL) && chunk->shared)
+         ret = nlua_sharedRun( L, envtab, path_filename );
+      else {
+         lua_pushvalue(L, envtab);
+         lua_setfenv(L, -2);
 
-   lua_pushvalue(L, envtab);
-   lua_setfenv(L, -2);
+         /* run the buffer */
+         ret = lua_pcall(L, 0, 1, 0);
+      }
 
-   /* run the buffer */
-   if (lua_pcall(L, 0, 1, 0) != 0) {
-      /* will push the current error from the dobuffer */
-      lua_error(L);
-      return 1;
+      if (ret != 0) {
+         free( path_filename );
+         /* will push the current error from the dobuffer */
+         lua_error(L);
+         return 1;
+      }
    }
+   free( path_filename );
 
    /* Mark as loaded. */
    /* val */
@@ -415,12 +817,303 @@ static int nlua_packfileLoader( lua_State* L )
    lua_setfield(L, -2, filename);   /* val, t */
    lua_pop(L, 1); /* val */
 
-   /* cleanup, success */
-   free(buf);
    return 1;
 }
 
 
+/**
+ * @brief Pushes the table of loaded shared modules, creating it if needed.
+ */
+static void nlua_pushShared( lua_State *L )
+{
+   if (nlua_sharedRef == LUA_NOREF) {
+      lua_newtable(L);
+      nlua_sharedRef = luaL_ref(L, LUA_REGISTRYINDEX);
+   }
+   lua_rawgeti(L, LUA_REGISTRYINDEX, nlua_sharedRef);
+}
+
+
+/**
+ * @brief Links an already loaded shared module into an environment.
+ *
+ * The globals exported by the module are referenced from the environment,
+ * nothing is executed or copied.
+ *
+ *    @param L Lua state.
+ *    @param envtab Stack index of the environment table.
+ *    @param path Resolved path of the module.
+ *    @return 1 if it was linked and the module return value was pushed,
+ *            0 if it isn't a loaded shared module.
+ */
+static int nlua_sharedLink( lua_State *L, int envtab, const char *path )
+{
+   nlua_pushShared(L); /* s */
+   lua_getfield(L, -1, path); /* s, m */
+   if (lua_isnil(L,-1)) {
+      lua_pop(L,2); /* */
+      return 0;
+   }
+
+   lua_getfield(L, -1, "exports"); /* s, m, e */
+   lua_pushnil(L); /* s, m, e, k */
+   while (lua_next(L, -2) != 0) { /* s, m, e, k, v */
+      lua_pushvalue(L, -2); /* s, m, e, k, v, k */
+      lua_insert(L, -2); /* s, m, e, k, k, v */
+      lua_rawset(L, envtab); /* s, m, e, k */
+   }
+   lua_pop(L,1); /* s, m */
+   lua_getfield(L, -1, "ret"); /* s, m, val */
+   lua_replace(L, -3); /* val, m */
+   lua_pop(L,1); /* val */
+   return 1;
+}
+
+
+/**
+ * @brief Runs a shared module chunk and links it into an environment.
+ *
+ * The chunk is run in its own environment with the standard libraries,
+ * after which the environment is made read-only and the new globals are
+ * recorded as the module exports.
+ *
+ *    @param L Lua state with the chunk at the top of the stack.
+ *    @param envtab Stack index of the environment table.
+ *    @param path Resolved path of the module.
+ *    @return 0 on success with the return value pushed, otherwise the
+ *            error message is pushed.
+ */
+static int nlua_sharedRun( lua_State *L, int envtab, const char *path )
+{
+   nlua_env env;
+   int ret;
+
+   env = nlua_newEnv(1);
+   nlua_loadStandard(env);
+   lua_rawgeti(L, LUA_REGISTRYINDEX, env); /* f, S */
+   luaL_unref(L, LUA_REGISTRYINDEX, env);
+
+   /* Remember what was there before running. */
+   lua_newtable(L); /* f, S, k */
+   lua_pushnil(L);
+   while (lua_next(L, -3) != 0) {
+      lua_pop(L,1);
+      lua_pushvalue(L,-1);
+      lua_pushboolean(L,1);
+      lua_rawset(L,-4);
+   }
+   lua_pushboolean(L,1);
+   lua_setfield(L, -2, "_include");
+   lua_insert(L, -3); /* k, f, S */
+
+   lua_pushvalue(L, -1); /* k, f, S, S */
+   lua_insert(L, -3); /* k, S, f, S */
+   lua_setfenv(L, -2); /* k, S, f */
+   ret = lua_pcall(L, 0, 1, 0);
+   if (ret != 0) { /* k, S, err */
+      lua_replace(L, -3); /* err, S */
+      lua_pop(L,1); /* err */
+      return ret;
+   }
+   /* k, S, val */
+   if (lua_isnil(L,-1)) {
+      lua_pop(L, 1);
+      lua_pushboolean(L, 1);
+   }
+
+   /* Create the module entry. */
+   lua_newtable(L); /* k, S, val, m */
+   lua_insert(L, -2); /* k, S, m, val */
+   lua_setfield(L, -2, "ret"); /* k, S, m */
+   lua_newtable(L); /* k, S, m, e */
+   lua_newtable(L); /* k, S, m, e, P */
+   lua_pushnil(L);
+   while (lua_next(L, -5) != 0) { /* k, S, m, e, P, key, v */
+      lua_pushvalue(L, -2); /* k, S, m, e, P, key, v, key */
+      lua_pushvalue(L, -2); /* k, S, m, e, P, key, v, key, v */
+      lua_rawset(L, -5); /* k, S, m, e, P, key, v */
+      lua_pushvalue(L, -2); /* k, S, m, e, P, key, v, key */
+      lua_rawget(L, -8); /* k, S, m, e, P, key, v, old */
+      if (lua_isnil(L,-1)) {
+         lua_pop(L,1); /* k, S, m, e, P, key, v */
+         lua_pushvalue(L, -2); /* k, S, m, e, P, key, v, key */
+         lua_insert(L, -2); /* k, S, m, e, P, key, key, v */
+         lua_rawset(L, -5); /* k, S, m, e, P, key */
+      }
+      else
+         lua_pop(L,2); /* k, S, m, e, P, key */
+   }
+   /* k, S, m, e, P */
+
+   /* Make the module environment read-only: its contents move to P which is
+    * only reachable through __index. */
+   lua_newtable(L); /* k, S, m, e, P, mt */
+   lua_pushvalue(L, LUA_GLOBALSINDEX);
+   lua_setfield(L, -2, "__index");
+   lua_setmetatable(L, -2); /* k, S, m, e, P */
+   lua_newtable(L); /* k, S, m, e, P, mt */
+   lua_insert(L, -2); /* k, S, m, e, mt, P */
+   lua_setfield(L, -2, "__index"); /* k, S, m, e, mt */
+   lua_pushstring(L, path);
+   lua_pushcclosure(L, nlua_sharedNewindex, 1);
+   lua_setfield(L, -2, "__newindex");
+   lua_pushvalue(L, -4); /* k, S, m, e, mt, S */
+   lua_insert(L, -2); /* k, S, m, e, S, mt */
+   lua_setmetatable(L, -2); /* k, S, m, e, S */
+   lua_pushnil(L);
+   while (lua_next(L, -2) != 0) { /* k, S, m, e, S, key, v */
+      lua_pop(L,1); /* k, S, m, e, S, key */
+      lua_pushvalue(L, -1); /* k, S, m, e, S, key, key */
+      lua_pushnil(L);
+      lua_rawset(L, -4); /* k, S, m, e, S, key */
+   }
+   lua_pop(L,1); /* k, S, m, e */
+   lua_setfield(L, -2, "exports"); /* k, S, m */
+   lua_insert(L, -2); /* k, m, S */
+   lua_setfield(L, -2, "env"); /* k, m */
+   lua_remove(L, -2); /* m */
+
+   /* Register and link it. */
+   nlua_pushShared(L); /* m, s */
+   lua_insert(L, -2); /* s, m */
+   lua_setfield(L, -2, path); /* s */
+   lua_pop(L,1); /* */
+   nlua_sharedLink( L, envtab, path ); /* val */
+   return 0;
+}
+
+
+/**
+ * @brief Errors on attempts to modify a shared module environment.
+ */
+static int nlua_sharedNewindex( lua_State *L )
+{
+   return luaL_error(L, _("Shared module '%s' can not set global '%s'."),
+         lua_tostring(L, lua_upvalueindex(1)), luaL_checkstring(L,2));
+}
+
+
+/**
+ * @brief Estimates the memory used by an environment.
+ *
+ * The estimate is based on the size of the tables, strings and closures
+ * reachable from the environment. Objects belonging to shared modules and
+ * library metatables are only accounted in the shared total.
+ *
+ *    @param env Environment to check.
+ *    @param[out] priv Estimated bytes used only by the environment.
+ *    @param[out] shared Estimated bytes of all loaded shared modules.
+ */
+void nlua_envMemory( nlua_env env, size_t *priv, size_t *shared )
+{
+   int seen;
+
+   lua_newtable(naevL); /* seen */
+   seen = lua_gettop(naevL);
+
+   /* Globals and library metatables are never counted. */
+   lua_pushvalue(naevL, LUA_GLOBALSINDEX);
+   lua_pushboolean(naevL, 1);
+   lua_rawset(naevL, seen);
+   lua_pushnil(naevL);
+   while (lua_next(naevL, LUA_REGISTRYINDEX) != 0) {
+      if (lua_type(naevL,-2) == LUA_TSTRING) {
+         lua_pushboolean(naevL, 1);
+         lua_rawset(naevL, seen);
+      }
+      else
+         lua_pop(naevL,1);
+   }
+
+   nlua_pushShared(naevL);
+   lua_pushboolean(naevL, 1);
+   lua_rawset(naevL, seen);
+   nlua_pushShared(naevL);
+   *shared = 0;
+   lua_pushnil(naevL);
+   while (lua_next(naevL, -2) != 0) {
+      *shared += nlua_memSize( naevL, lua_gettop(naevL), seen );
+      lua_pop(naevL,1);
+   }
+   lua_pop(naevL,1);
+
+   nlua_pushenv(env);
+   *priv = nlua_memSize( naevL, lua_gettop(naevL), seen );
+   lua_pop(naevL,2);
+}
+
+
+#define NLUA_MEM_TABLE     56 /**< Approximate size of a table header. */
+#define NLUA_MEM_NODE      40 /**< Approximate size of a table node. */
+#define NLUA_MEM_STRING    24 /**< Approximate size of a string header. */
+#define NLUA_MEM_CLOSURE   40 /**< Approximate size of a closure header. */
+#define NLUA_MEM_UPVAL     40 /**< Approximate size of an upvalue. */
+/**
+ * @brief Recursively estimates the size of a Lua value.
+ *
+ *    @param L Lua state.
+ *    @param idx Absolute stack index of the value.
+ *    @param seen Absolute stack index of the table of visited objects.
+ *    @return Estimated size in bytes of the not yet visited objects.
+ */
+static size_t nlua_memSize( lua_State *L, int idx, int seen )
+{
+   size_t size;
+   int i, top;
+
+   switch (lua_type(L, idx)) {
+      case LUA_TSTRING:
+         return NLUA_MEM_STRING + lua_objlen(L, idx) + 1;
+      case LUA_TTABLE:
+      case LUA_TFUNCTION:
+      case LUA_TUSERDATA:
+         break;
+      default:
+         return 0;
+   }
+
+   if (!lua_checkstack(L, 4))
+      return 0;
+
+   /* Only count each object once. */
+   lua_pushvalue(L, idx);
+   lua_rawget(L, seen);
+   i = lua_toboolean(L, -1);
+   lua_pop(L,1);
+   if (i)
+      return 0;
+   lua_pushvalue(L, idx);
+   lua_pushboolean(L, 1);
+   lua_rawset(L, seen);
+
+   top = lua_gettop(L);
+   if (lua_type(L, idx) == LUA_TUSERDATA)
+      size = lua_objlen(L, idx);
+   else if (lua_type(L, idx) == LUA_TFUNCTION) {
+      size = NLUA_MEM_CLOSURE;
+      for (i=1; lua_getupvalue(L, idx, i) != NULL; i++) {
+         size += NLUA_MEM_UPVAL + nlua_memSize( L, top+1, seen );
+         lua_pop(L,1);
+      }
+   }
+   else {
+      size = NLUA_MEM_TABLE;
+      lua_pushnil(L);
+      while (lua_next(L, idx) != 0) {
+         size += NLUA_MEM_NODE;
+         size += nlua_memSize( L, top+1, seen );
+         size += nlua_memSize( L, top+2, seen );
+         lua_pop(L,1);
+      }
+      if (lua_getmetatable(L, idx)) {
+         size += nlua_memSize( L, top+1, seen );
+         lua_pop(L,1);
+      }
+   }
+   return size;
+}
+
+
 /**
  * @brief Loads the standard Naev Lua API.
  *
@@ -22,6 +22,8 @@ extern nlua_env __NLUA_CURENV;
  */
 void lua_init(void);
 void lua_exit(void);
+void nlua_setGC (void);
+size_t nlua_allocCount (void);
 nlua_env nlua_newEnv(int rw);
 void nlua_freeEnv(nlua_env env);
 void nlua_pushenv(nlua_env env);
@@ -34,7 +36,10 @@ int nlua_dobufenv(nlua_env env,
                   size_t sz,
                   const char *name);
 int nlua_dofileenv(nlua_env env, const char *filename);
+int nlua_dondataenv(nlua_env env, const char *path);
+int nlua_loadndata( lua_State *L, const char *path );
 int nlua_loadStandard( nlua_env env );
+void nlua_envMemory( nlua_env env, size_t *priv, size_t *shared );
 int nlua_pcall( nlua_env env, int nargs, int nresults );
 
 #endif /* NLUA_H */
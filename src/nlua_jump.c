@@ -18,6 +18,7 @@
 #include "nlua_vec2.h"
 #include "nlua_system.h"
 #include "land_outfits.h"
+#include "map.h"
 #include "log.h"
 
 
@@ -449,9 +450,11 @@ static int jumpL_setKnown( lua_State *L )
    else
       jp_rmFlag( jp, JP_KNOWN );
 
-   /* Update outfits image array. */
-   if (changed)
+   /* Update outfits image array and map. */
+   if (changed) {
       outfits_updateEquipmentOutfits();
+      map_invalidate();
+   }
 
    return 0;
 }
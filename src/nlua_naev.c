@@ -27,6 +27,7 @@
 /* Naev methods. */
 static int naev_lang( lua_State *L );
 static int naev_ticks( lua_State *L );
+static int naev_memory( lua_State *L );
 static int naev_keyGet( lua_State *L );
 static int naev_keyEnable( lua_State *L );
 static int naev_keyEnableAll( lua_State *L );
@@ -36,6 +37,7 @@ static int naev_missionStart( lua_State *L );
 static const luaL_Reg naev_methods[] = {
    { "lang", naev_lang },
    { "ticks", naev_ticks },
+   { "memory", naev_memory },
    { "keyGet", naev_keyGet },
    { "keyEnable", naev_keyEnable },
    { "keyEnableAll", naev_keyEnableAll },
@@ -100,6 +102,28 @@ static int naev_ticks( lua_State *L )
 }
 
 
+/**
+ * @brief Gets an estimate of the memory used by the current environment.
+ *
+ * Shared modules (marked with "--@shared" on their first line) are loaded
+ * once for all environments, so they are reported separately.
+ *
+ *    @luatreturn number Estimated kilobytes used only by this environment.
+ *    @luatreturn number Estimated kilobytes used by all shared modules.
+ *    @luatreturn number Kilobytes used by the whole Lua state.
+ * @luafunc memory()
+ */
+static int naev_memory( lua_State *L )
+{
+   size_t priv, shared;
+   nlua_envMemory( __NLUA_CURENV, &priv, &shared );
+   lua_pushnumber(L, (double)priv / 1024.);
+   lua_pushnumber(L, (double)shared / 1024.);
+   lua_pushnumber(L, lua_gc(L, LUA_GCCOUNT, 0) + lua_gc(L, LUA_GCCOUNTB, 0) / 1024.);
+   return 3;
+}
+
+
 /**
  * @brief Gets the keybinding value by name.
  *
@@ -19,6 +19,7 @@
 #include "log.h"
 #include "rng.h"
 #include "slots.h"
+#include "icon.h"
 
 
 /* Outfit metatable methods. */
@@ -327,7 +328,7 @@ static int outfitL_slot( lua_State *L )
 static int outfitL_icon( lua_State *L )
 {
    Outfit *o = luaL_validoutfit(L,1);
-   lua_pushtex( L, gl_dupTexture( o->gfx_store ) );
+   lua_pushtex( L, icon_newTexture( o->gfx_store ) );
    return 1;
 }
 
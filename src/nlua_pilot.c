@@ -54,10 +54,47 @@ extern int pilot_nstack;
 extern Pilot *cur_pilot;
 
 
+/**
+ * @brief Criteria for selecting pilots from Lua.
+ */
+typedef struct PilotFilter_ {
+   int disabled; /**< Include disabled pilots. */
+   unsigned int hostile; /**< Only pilots hostile to this one, 0 for any. */
+   int ranged; /**< Only pilots within radius of pos. */
+   Vector2d pos; /**< Centre of the area. */
+   double radius; /**< Radius of the area. */
+   int nfactions; /**< Number of factions, -1 for any. */
+   int factions[]; /**< Factions to match. */
+} PilotFilter;
+
+
+/**
+ * @brief State of a pilot.each() iteration.
+ */
+typedef struct PilotIter_ {
+   int n; /**< Number of candidates. */
+   int cur; /**< Next candidate. */
+   unsigned int ids[]; /**< Candidates. */
+} PilotIter;
+
+
+#define PILOT_CACHE  "pilot_cache" /**< Registry table of the pilot userdata by id. */
+
+
+static Pilot **pilotL_candidates = NULL; /**< Pilots that may match a filter (array.h). */
+
+
 /*
  * Prototypes.
  */
 static Task *pilotL_newtask( lua_State *L, Pilot* p, const char *task );
+static PilotFilter* pilotL_newfilter( lua_State *L, int ind );
+static PilotFilter* pilotL_checkfilter( lua_State *L, int ind );
+static int pilotL_areHostile( const Pilot *p, const Pilot *t );
+static int pilotL_filterMatch( const PilotFilter *f, const Pilot *p, const Pilot *h );
+static int pilotL_filterCandidates( const PilotFilter *f );
+static int pilotL_eachNext( lua_State *L );
+static Vector2d* pilotL_checkpos( lua_State *L, int ind );
 static int pilotL_addFleetFrom( lua_State *L, int from_ship );
 static int outfit_compareActive( const void *slot1, const void *slot2 );
 
@@ -69,6 +106,8 @@ static int pilotL_remove( lua_State *L );
 static int pilotL_clear( lua_State *L );
 static int pilotL_toggleSpawn( lua_State *L );
 static int pilotL_getPilots( lua_State *L );
+static int pilotL_query( lua_State *L );
+static int pilotL_each( lua_State *L );
 static int pilotL_eq( lua_State *L );
 static int pilotL_name( lua_State *L );
 static int pilotL_id( lua_State *L );
@@ -84,6 +123,9 @@ static int pilotL_rename( lua_State *L );
 static int pilotL_position( lua_State *L );
 static int pilotL_velocity( lua_State *L );
 static int pilotL_dir( lua_State *L );
+static int pilotL_distance( lua_State *L );
+static int pilotL_distance2( lua_State *L );
+static int pilotL_angleTo( lua_State *L );
 static int pilotL_ew( lua_State *L );
 static int pilotL_temp( lua_State *L );
 static int pilotL_faction( lua_State *L );
@@ -157,6 +199,8 @@ static const luaL_Reg pilotL_methods[] = {
    { "add", pilotL_addFleet },
    { "rm", pilotL_remove },
    { "get", pilotL_getPilots },
+   { "query", pilotL_query },
+   { "each", pilotL_each },
    { "__eq", pilotL_eq },
    /* Info. */
    { "name", pilotL_name },
@@ -173,6 +217,9 @@ static const luaL_Reg pilotL_methods[] = {
    { "pos", pilotL_position },
    { "vel", pilotL_velocity },
    { "dir", pilotL_dir },
+   { "dist", pilotL_distance },
+   { "dist2", pilotL_distance2 },
+   { "angleTo", pilotL_angleTo },
    { "ew", pilotL_ew },
    { "temp", pilotL_temp },
    { "cooldown", pilotL_cooldown },
@@ -334,6 +381,9 @@ Pilot* luaL_validpilot( lua_State *L, int ind )
 /**
  * @brief Pushes a pilot on the stack.
  *
+ * The userdata of a pilot is kept in a weak table while scripts hold it, so
+ *  pushing the same pilot again doesn't create garbage.
+ *
  *    @param L Lua state to push pilot into.
  *    @param pilot Pilot to push.
  *    @return Newly pushed pilot.
@@ -341,10 +391,35 @@ Pilot* luaL_validpilot( lua_State *L, int ind )
 LuaPilot* lua_pushpilot( lua_State *L, LuaPilot pilot )
 {
    LuaPilot *p;
+
+   /* Get the cache, creating it if needed. */
+   lua_getfield(L, LUA_REGISTRYINDEX, PILOT_CACHE);
+   if (lua_isnil(L,-1)) {
+      lua_pop(L,1);
+      lua_newtable(L);
+      lua_newtable(L); /* metatable */
+      lua_pushstring(L, "v");
+      lua_setfield(L, -2, "__mode");
+      lua_setmetatable(L, -2);
+      lua_pushvalue(L, -1);
+      lua_setfield(L, LUA_REGISTRYINDEX, PILOT_CACHE);
+   }
+
+   /* Reuse the userdata if it's still around. */
+   lua_rawgeti(L, -1, pilot);
+   if (!lua_isnil(L,-1)) {
+      lua_remove(L,-2);
+      return (LuaPilot*) lua_touserdata(L,-1);
+   }
+   lua_pop(L,1);
+
    p = (LuaPilot*) lua_newuserdata(L, sizeof(LuaPilot));
    *p = pilot;
    luaL_getmetatable(L, PILOT_METATABLE);
    lua_setmetatable(L, -2);
+   lua_pushvalue(L, -1);
+   lua_rawseti(L, -3, pilot);
+   lua_remove(L,-2);
    return p;
 }
 /**
@@ -746,70 +821,292 @@ static int pilotL_toggleSpawn( lua_State *L )
  */
 static int pilotL_getPilots( lua_State *L )
 {
-   int i, j, k, d;
-   int *factions;
-   int nfactions;
+   int i, k;
+   PilotFilter *f;
+
+   /* Check for belonging to faction. */
+   if (!lua_istable(L,1) && !lua_isfaction(L,1) &&
+         !lua_isnil(L,1) && (lua_gettop(L) != 0))
+      NLUA_INVALID_PARAMETER(L);
+   f = pilotL_newfilter( L, 1 );
 
    /* Whether or not to get disabled. */
-   d = lua_toboolean(L,2);
+   f->disabled = lua_toboolean(L,2);
 
-   /* Check for belonging to faction. */
-   if (lua_istable(L,1) || lua_isfaction(L,1)) {
-      if (lua_isfaction(L,1)) {
-         nfactions = 1;
-         factions = malloc( sizeof(int) );
-         factions[0] = lua_tofaction(L,1);
-      }
-      else {
-         /* Get table length and preallocate. */
-         nfactions = (int) lua_objlen(L,1);
-         factions = malloc( sizeof(int) * nfactions );
-         /* Load up the table. */
-         lua_pushnil(L);
-         i = 0;
-         while (lua_next(L, -2) != 0) {
-            if (lua_isfaction(L,-1)) {
-               factions[i++] = lua_tofaction(L, -1);
-            }
-            lua_pop(L,1);
-         }
+   /* Now put all the matching pilots in a table. */
+   lua_newtable(L);
+   k = 1;
+   for (i=0; i<pilot_nstack; i++) {
+      if (pilotL_filterMatch( f, pilot_stack[i], NULL )) {
+         lua_pushpilot(L, pilot_stack[i]->id); /* value */
+         lua_rawseti(L,-2,k++); /* table[key] = value */
       }
+   }
 
-      /* Now put all the matching pilots in a table. */
-      lua_newtable(L);
-      k = 1;
-      for (i=0; i<pilot_nstack; i++) {
-         for (j=0; j<nfactions; j++) {
-            if ((pilot_stack[i]->faction == factions[j]) &&
-                  (d || !pilot_isDisabled(pilot_stack[i])) &&
-                  !pilot_isFlag(pilot_stack[i], PILOT_DELETE)) {
-               lua_pushnumber(L, k++); /* key */
-               lua_pushpilot(L, pilot_stack[i]->id); /* value */
-               lua_rawset(L,-3); /* table[key] = value */
-            }
-         }
-      }
+   return 1;
+}
 
-      /* clean up. */
-      free(factions);
+
+/**
+ * @brief Creates a filter on the stack with the factions at ind.
+ *
+ *    @param L Lua state.
+ *    @param ind Faction, table of factions or nil for any faction.
+ *    @return The new filter, matching all non-disabled pilots of the factions.
+ */
+static PilotFilter* pilotL_newfilter( lua_State *L, int ind )
+{
+   int n;
+   PilotFilter *f;
+
+   /* Count the factions. */
+   if (lua_isfaction(L,ind))
+      n = 1;
+   else if (lua_istable(L,ind))
+      n = (int) lua_objlen(L,ind);
+   else
+      n = 0;
+
+   f = lua_newuserdata( L, sizeof(PilotFilter) + n*sizeof(int) );
+   memset( f, 0, sizeof(PilotFilter) );
+
+   /* Load up the factions. */
+   if (lua_isfaction(L,ind)) {
+      f->factions[0] = lua_tofaction(L,ind);
+      f->nfactions   = 1;
    }
-   else if ((lua_isnil(L,1)) || (lua_gettop(L) == 0)) {
-      /* Now put all the matching pilots in a table. */
-      lua_newtable(L);
-      k = 1;
-      for (i=0; i<pilot_nstack; i++) {
-         if ((d || !pilot_isDisabled(pilot_stack[i])) &&
-               !pilot_isFlag(pilot_stack[i], PILOT_DELETE)) {
-            lua_pushnumber(L, k++); /* key */
-            lua_pushpilot(L, pilot_stack[i]->id); /* value */
-            lua_rawset(L,-3); /* table[key] = value */
-         }
+   else if (lua_istable(L,ind)) {
+      for (lua_pushnil(L); lua_next(L, (ind > 0) ? ind : ind-2) != 0; lua_pop(L,1))
+         if (lua_isfaction(L,-1) && (f->nfactions < n))
+            f->factions[ f->nfactions++ ] = lua_tofaction(L,-1);
+   }
+   else
+      f->nfactions = -1;
+
+   return f;
+}
+
+
+/**
+ * @brief Creates a filter on the stack from a table of criteria.
+ *
+ * The table may contain:
+ *  - factions: Faction or table of factions the pilots must belong to.
+ *  - disabled: Whether or not to include disabled pilots.
+ *  - hostile: Pilot the pilots must be hostile to.
+ *  - pos: Vec2 or Pilot to look around, must be used with radius.
+ *  - radius: Distance from pos the pilots must be within.
+ *
+ *    @param L Lua state.
+ *    @param ind Index of the table, nil or none is all non-disabled pilots.
+ *    @return The new filter.
+ */
+static PilotFilter* pilotL_checkfilter( lua_State *L, int ind )
+{
+   PilotFilter *f;
+
+   if (lua_isnoneornil(L,ind)) {
+      lua_pushnil(L);
+      f = pilotL_newfilter( L, -1 );
+      lua_remove(L,-2);
+      return f;
+   }
+   luaL_checktype(L, ind, LUA_TTABLE);
+   if (ind < 0)
+      ind = lua_gettop(L) + ind + 1;
+
+   lua_getfield(L, ind, "factions");
+   f = pilotL_newfilter( L, -1 );
+   lua_remove(L,-2);
+
+   lua_getfield(L, ind, "disabled");
+   f->disabled = lua_toboolean(L,-1);
+   lua_pop(L,1);
+
+   lua_getfield(L, ind, "hostile");
+   if (!lua_isnil(L,-1))
+      f->hostile = luaL_validpilot(L,-1)->id;
+   lua_pop(L,1);
+
+   lua_getfield(L, ind, "radius");
+   if (!lua_isnil(L,-1)) {
+      f->radius = luaL_checknumber(L,-1);
+      lua_getfield(L, ind, "pos");
+      f->pos    = *pilotL_checkpos(L,-1);
+      f->ranged = 1;
+      lua_pop(L,1);
+   }
+   lua_pop(L,1);
+
+   return f;
+}
+
+
+/**
+ * @brief Checks to see if two pilots are hostile to each other.
+ */
+static int pilotL_areHostile( const Pilot *p, const Pilot *t )
+{
+   if (pilot_isPlayer(p))
+      return pilot_isHostile(t);
+   if (pilot_isPlayer(t))
+      return pilot_isHostile(p);
+   return areEnemies( p->faction, t->faction );
+}
+
+
+/**
+ * @brief Checks to see if a pilot matches a filter.
+ *
+ *    @param f Filter to check against.
+ *    @param p Pilot to check.
+ *    @param h Pilot f->hostile refers to or NULL.
+ *    @return 1 if it matches.
+ */
+static int pilotL_filterMatch( const PilotFilter *f, const Pilot *p, const Pilot *h )
+{
+   int j;
+
+   if (pilot_isFlag(p, PILOT_DELETE))
+      return 0;
+   if (!f->disabled && pilot_isDisabled(p))
+      return 0;
+
+   if (f->nfactions >= 0) {
+      for (j=0; j<f->nfactions; j++)
+         if (p->faction == f->factions[j])
+            break;
+      if (j >= f->nfactions)
+         return 0;
+   }
+
+   if ((h != NULL) && ((h == p) || !pilotL_areHostile( h, p )))
+      return 0;
+
+   if (f->ranged && (vect_dist2( &p->solid->pos, &f->pos ) > pow2(f->radius)))
+      return 0;
+
+   return 1;
+}
+
+
+/**
+ * @brief Gets the pilots that may match a filter.
+ *
+ *    @return Number of candidates put in pilotL_candidates.
+ */
+static int pilotL_filterCandidates( const PilotFilter *f )
+{
+   int i;
+
+   /* Only look around the position. */
+   if (f->ranged)
+      return pilots_inRange( &pilotL_candidates, f->pos.x, f->pos.y, f->radius );
+
+   if (pilotL_candidates == NULL)
+      pilotL_candidates = array_create( Pilot* );
+   array_resize( &pilotL_candidates, pilot_nstack );
+   for (i=0; i<pilot_nstack; i++)
+      pilotL_candidates[i] = pilot_stack[i];
+   return pilot_nstack;
+}
+
+
+/**
+ * @brief Gets the pilots matching a filter.
+ *
+ * The filtering is done without creating the pilots that don't match, and
+ *  areas are looked up with the spatial index instead of checking every
+ *  pilot in the system.
+ *
+ * @usage p = pilot.query{ hostile=player.pilot(), pos=player.pos(), radius=3000 }
+ * @usage p = pilot.query{ factions=faction.get("Empire"), disabled=true }
+ *
+ *    @luatparam[opt] table filter Criteria with the fields factions, disabled,
+ *       hostile, pos and radius. Without it gets all non-disabled pilots.
+ *    @luatreturn {Pilot,...} A table containing the pilots.
+ * @luafunc query( filter )
+ */
+static int pilotL_query( lua_State *L )
+{
+   int i, k, n;
+   PilotFilter *f;
+   Pilot *h;
+
+   f = pilotL_checkfilter( L, 1 );
+   h = (f->hostile != 0) ? pilot_get( f->hostile ) : NULL;
+
+   lua_newtable(L);
+   if ((f->hostile != 0) && (h == NULL))
+      return 1;
+
+   k = 1;
+   n = pilotL_filterCandidates( f );
+   for (i=0; i<n; i++) {
+      if (pilotL_filterMatch( f, pilotL_candidates[i], h )) {
+         lua_pushpilot(L, pilotL_candidates[i]->id);
+         lua_rawseti(L,-2,k++);
       }
    }
-   else {
-      NLUA_INVALID_PARAMETER(L);
+
+   return 1;
+}
+
+
+/**
+ * @brief Gets the next pilot of a pilot.each() iteration.
+ */
+static int pilotL_eachNext( lua_State *L )
+{
+   PilotFilter *f;
+   PilotIter *it;
+   Pilot *p, *h;
+
+   f  = lua_touserdata(L, lua_upvalueindex(1));
+   it = lua_touserdata(L, lua_upvalueindex(2));
+   h  = (f->hostile != 0) ? pilot_get( f->hostile ) : NULL;
+   if ((f->hostile != 0) && (h == NULL))
+      return 0;
+
+   /* Pilots may change while the loop body runs, so check them now. */
+   while (it->cur < it->n) {
+      p = pilot_get( it->ids[ it->cur++ ] );
+      if ((p != NULL) && pilotL_filterMatch( f, p, h )) {
+         lua_pushpilot(L, p->id);
+         return 1;
+      }
    }
 
+   return 0;
+}
+
+
+/**
+ * @brief Iterates over the pilots matching a filter.
+ *
+ * Same as pilot.query() without building a table.
+ *
+ * @usage for p in pilot.each{ factions=faction.get("Pirate") } do p:setHostile() end
+ *
+ *    @luatparam[opt] table filter Criteria, see pilot.query().
+ *    @luatreturn function Iterator returning the next pilot, nil when done.
+ * @luafunc each( filter )
+ */
+static int pilotL_each( lua_State *L )
+{
+   int i, n;
+   PilotFilter *f;
+   PilotIter *it;
+
+   f  = pilotL_checkfilter( L, 1 );
+   n  = pilotL_filterCandidates( f );
+   it = lua_newuserdata( L, sizeof(PilotIter) + n*sizeof(unsigned int) );
+   it->n   = n;
+   it->cur = 0;
+   for (i=0; i<n; i++)
+      it->ids[i] = pilotL_candidates[i]->id;
+
+   lua_pushcclosure( L, pilotL_eachNext, 2 );
    return 1;
 }
 
@@ -1617,14 +1914,39 @@ static int pilotL_rename( lua_State *L )
    return 0;
 }
 
+/**
+ * @brief Pushes a vector, reusing the one at ind if there is one.
+ */
+static void pilotL_pushvector( lua_State *L, int ind, const Vector2d *v )
+{
+   if (lua_isvector(L,ind)) {
+      *lua_tovector(L,ind) = *v;
+      lua_pushvalue(L,ind);
+   }
+   else
+      lua_pushvector(L, *v);
+}
+
+/**
+ * @brief Gets a position from a pilot or vector parameter.
+ */
+static Vector2d* pilotL_checkpos( lua_State *L, int ind )
+{
+   if (lua_isvector(L,ind))
+      return lua_tovector(L,ind);
+   return &luaL_validpilot(L,ind)->solid->pos;
+}
+
 /**
  * @brief Gets the pilot's position.
  *
  * @usage v = p:pos()
+ * @usage p:pos( v ) -- Stores the position in v instead of creating a new vector
  *
  *    @luatparam Pilot p Pilot to get the position of.
+ *    @luatparam[opt] Vec2 v Vector to store the position in.
  *    @luatreturn Vec2 The pilot's current position.
- * @luafunc pos( p )
+ * @luafunc pos( p, v )
  */
 static int pilotL_position( lua_State *L )
 {
@@ -1634,7 +1956,7 @@ static int pilotL_position( lua_State *L )
    p     = luaL_validpilot(L,1);
 
    /* Push position. */
-   lua_pushvector(L, p->solid->pos);
+   pilotL_pushvector(L, 2, &p->solid->pos);
    return 1;
 }
 
@@ -1642,10 +1964,12 @@ static int pilotL_position( lua_State *L )
  * @brief Gets the pilot's velocity.
  *
  * @usage vel = p:vel()
+ * @usage p:vel( v ) -- Stores the velocity in v instead of creating a new vector
  *
  *    @luatparam Pilot p Pilot to get the velocity of.
+ *    @luatparam[opt] Vec2 v Vector to store the velocity in.
  *    @luatreturn Vec2 The pilot's current velocity.
- * @luafunc vel( p )
+ * @luafunc vel( p, v )
  */
 static int pilotL_velocity( lua_State *L )
 {
@@ -1655,7 +1979,73 @@ static int pilotL_velocity( lua_State *L )
    p     = luaL_validpilot(L,1);
 
    /* Push velocity. */
-   lua_pushvector(L, p->solid->vel);
+   pilotL_pushvector(L, 2, &p->solid->vel);
+   return 1;
+}
+
+/**
+ * @brief Gets the distance from the pilot to another pilot or a position.
+ *
+ * Cheaper than getting the positions and subtracting them.
+ *
+ * @usage d = p:dist( target )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 t Pilot or position to get the distance to.
+ *    @luatreturn number The distance between both.
+ * @luafunc dist( p, t )
+ */
+static int pilotL_distance( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   p = luaL_validpilot(L,1);
+   v = pilotL_checkpos(L,2);
+   lua_pushnumber( L, vect_dist( &p->solid->pos, v ) );
+   return 1;
+}
+
+/**
+ * @brief Gets the squared distance from the pilot to another pilot or a
+ *        position.
+ *
+ * @usage d2 = p:dist2( target )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 t Pilot or position to get the distance to.
+ *    @luatreturn number The squared distance between both.
+ * @luafunc dist2( p, t )
+ */
+static int pilotL_distance2( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   p = luaL_validpilot(L,1);
+   v = pilotL_checkpos(L,2);
+   lua_pushnumber( L, vect_dist2( &p->solid->pos, v ) );
+   return 1;
+}
+
+/**
+ * @brief Gets the angle from the pilot to another pilot or a position.
+ *
+ * @usage a = p:angleTo( target )
+ *
+ *    @luatparam Pilot p Pilot to get the angle from.
+ *    @luatparam Pilot|Vec2 t Pilot or position to get the angle to.
+ *    @luatreturn number The angle to the target (in degrees).
+ * @luafunc angleTo( p, t )
+ */
+static int pilotL_angleTo( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   p = luaL_validpilot(L,1);
+   v = pilotL_checkpos(L,2);
+   lua_pushnumber( L, vect_angle( &p->solid->pos, v ) * 180./M_PI );
    return 1;
 }
 
@@ -2567,7 +2957,7 @@ static int pilotL_addOutfit( lua_State *L )
 
       /* Add outfit - already tested. */
       ret = pilot_addOutfitRaw( p, o, p->outfits[i] );
-      pilot_calcStats( p );
+      pilot_calcStatsUpdate( p );
 
       /* Add ammo if needed. */
       if ((ret==0) && (outfit_ammo(o) != NULL))
@@ -2634,7 +3024,7 @@ static int pilotL_rmOutfit( lua_State *L )
          pilot_rmOutfitRaw( p, p->outfits[i] );
          removed++;
       }
-      pilot_calcStats( p ); /* Recalculate stats. */
+      pilot_calcStatsUpdate( p ); /* Recalculate stats. */
    }
    /* If outfit is "cores", we remove cores only. */
    else if (strcmp(outfit,"cores")==0) {
@@ -2644,7 +3034,7 @@ static int pilotL_rmOutfit( lua_State *L )
          pilot_rmOutfitRaw( p, p->outfits[i] );
          removed++;
       }
-      pilot_calcStats( p ); /* Recalculate stats. */
+      pilot_calcStatsUpdate( p ); /* Recalculate stats. */
    }
    else {
       /* Get the outfit. */
@@ -907,8 +907,9 @@ static int systemL_setknown( lua_State *L )
      }
    }
 
-   /* Update outfits image array. */
+   /* Update outfits image array and map. */
    outfits_updateEquipmentOutfits();
+   map_invalidate();
 
    return 0;
 }
@@ -86,6 +86,10 @@ int nlua_loadVector( nlua_env env )
  * my_vec = my_vec - your_vec -- my_vec is now (19,13)
  * @endcode
  *
+ * Operators always create a new vector, while the add, sub, mul and div
+ *  methods modify the vector in place and return it without allocating
+ *  anything, so they should be preferred in code that runs often like AI.
+ *
  * To call members of the metatable always use:
  * @code
  * vector:function( param )
@@ -291,7 +295,7 @@ static int vectorL_add__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x + x, v1->y + y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 ); /* Return self, no need to allocate. */
 
    return 1;
 }
@@ -367,7 +371,7 @@ static int vectorL_sub__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x - x, v1->y - y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 ); /* Return self, no need to allocate. */
    return 1;
 }
 
@@ -407,7 +411,7 @@ static int vectorL_mul__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x * mod, v1->y * mod );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 ); /* Return self, no need to allocate. */
    return 1;
 }
 
@@ -447,7 +451,7 @@ static int vectorL_div__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x / mod, v1->y / mod );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 ); /* Return self, no need to allocate. */
    return 1;
 }
 
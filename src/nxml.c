@@ -14,6 +14,8 @@
 #include "naev.h"
 
 #include "nstring.h"
+#include "ndata.h"
+#include "icon.h"
 
 
 /**
@@ -74,6 +76,35 @@ glTexture* xml_parseTexture( xmlNodePtr node,
 }
 
 
+/**
+ * @brief Parses an icon without loading its graphic.
+ *
+ *    @param node Node to parse.
+ *    @param path Path to get file from, should be in the format of
+ *           "PREFIX%sSUFFIX".
+ *    @param def Graphic to use if the file doesn't exist or NULL.
+ *    @return Handle of the icon (see icon_get()) or 0 if an error occurred.
+ */
+int xml_parseIcon( xmlNodePtr node, const char *path, const char *def )
+{
+   char *buf, filename[PATH_MAX];
+
+   /* Get graphic to use. */
+   buf = xml_get( node );
+   if (buf == NULL)
+      return 0;
+
+   /* Convert name. */
+   nsnprintf( filename, PATH_MAX, (path != NULL) ? path : "%s", buf );
+
+   /* Only check existence, loading is left to the icon cache. */
+   if ((def != NULL) && !ndata_exists( filename ))
+      return icon_new( def );
+
+   return icon_new( filename );
+}
+
+
 /**
  * @brief Sets up the standard xml write parameters.
  */
@@ -88,34 +88,34 @@
 /* encompassing element */
 #define xmlw_startElem(w,str)   \
 do {if (xmlTextWriterStartElement(w,(xmlChar*)str) < 0) { \
-   ERR("xmlw: unable to create start element"); return -1; } } while(0)
+   WARN("xmlw: unable to create start element"); return -1; } } while(0)
 #define xmlw_endElem(w) \
 do {if (xmlTextWriterEndElement(w) < 0) { \
-   ERR("xmlw: unable to create end element"); return -1; } } while(0)
+   WARN("xmlw: unable to create end element"); return -1; } } while(0)
 /* other stuff */
 #define xmlw_elemEmpty(w,n)   \
 do { xmlw_startElem(w,n); xmlw_endElem(w); } while(0)
 #define xmlw_elem(w,n,str,args...) \
 do { if (xmlTextWriterWriteFormatElement(w,(xmlChar*)n, \
       str, ## args) < 0) { \
-   ERR("xmlw: unable to write format element"); return -1; } } while(0)
+   WARN("xmlw: unable to write format element"); return -1; } } while(0)
 #define xmlw_raw(w,b,l) \
 do {if (xmlTextWriterWriteRawLen(w,(xmlChar*)b,l) < 0) { \
-   ERR("xmlw: unable to write raw element"); return -1; } } while(0)
+   WARN("xmlw: unable to write raw element"); return -1; } } while(0)
 #define xmlw_attr(w,str,val...)  \
 do {if (xmlTextWriterWriteFormatAttribute(w,(xmlChar*)str, \
       ## val) < 0) { \
-   ERR("xmlw: unable to write element attribute"); return -1; } } while(0)
+   WARN("xmlw: unable to write element attribute"); return -1; } } while(0)
 #define xmlw_str(w,str,val...) \
 do {if (xmlTextWriterWriteFormatString(w,str, ## val) < 0) { \
-   ERR("xmlw: unable to write element data"); return -1; } } while(0)
+   WARN("xmlw: unable to write element data"); return -1; } } while(0)
 /* document level */
 #define xmlw_start(w) \
 do {if (xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL) < 0) { \
-   ERR("xmlw: unable to start document"); return -1; } } while(0)
+   WARN("xmlw: unable to start document"); return -1; } } while(0)
 #define xmlw_done(w) \
 do {if (xmlTextWriterEndDocument(w) < 0) { \
-   ERR("xmlw: unable to end document"); return -1; } } while(0)
+   WARN("xmlw: unable to end document"); return -1; } } while(0)
 
 
 /*
@@ -124,6 +124,7 @@ do {if (xmlTextWriterEndDocument(w) < 0) { \
 glTexture* xml_parseTexture( xmlNodePtr node,
       const char *path, int defsx, int defsy,
       const unsigned int flags );
+int xml_parseIcon( xmlNodePtr node, const char *path, const char *def );
 
 
 /*
@@ -154,7 +154,9 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
          lua_pushnil(L); /* key, value, nil */
          while (lua_next(L, -2) != 0) {
             /* key, value, key, value */
-            ret |= nxml_persistDataNode( L, writer, 1 ); /* pops the value. */
+            /* A failed write leaves the stack unbalanced, so bail out. */
+            if (nxml_persistDataNode( L, writer, 1 ) < 0) /* pops the value. */
+               return -1;
             /* key, value, key */
          }
          /* key, value */
@@ -163,7 +165,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
 
       /* Normal number. */
       case LUA_TNUMBER:
-         nxml_saveData( writer, "number",
+         ret |= nxml_saveData( writer, "number",
                name, lua_tostring(L,-1), keynum );
          /* key, value */
          break;
@@ -174,14 +176,14 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
          if (lua_toboolean(L,-1)) buf[0] = '1';
          else buf[0] = '0';
          buf[1] = '\0';
-         nxml_saveData( writer, "bool",
+         ret |= nxml_saveData( writer, "bool",
                name, buf, keynum );
          /* key, value */
          break;
 
       /* String is saved normally. */
       case LUA_TSTRING:
-         nxml_saveData( writer, "string",
+         ret |= nxml_saveData( writer, "string",
                name, lua_tostring(L,-1), keynum );
          /* key, value */
          break;
@@ -191,7 +193,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
          if (lua_isplanet(L,-1)) {
             pnt = planet_getIndex( *lua_toplanet(L,-1) );
             if (pnt != NULL)
-               nxml_saveData( writer, "planet",
+               ret |= nxml_saveData( writer, "planet",
                      name, pnt->name, keynum );
             else
                WARN(_("Failed to save invalid planet."));
@@ -201,7 +203,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
          else if (lua_issystem(L,-1)) {
             ss = system_getIndex( lua_tosystem(L,-1) );
             if (ss != NULL)
-               nxml_saveData( writer, "system",
+               ret |= nxml_saveData( writer, "system",
                      name, ss->name, keynum );
             else
                WARN(_("Failed to save invalid system."));
@@ -212,7 +214,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
             str = faction_name( lua_tofaction(L,-1) );
             if (str == NULL)
                break;
-            nxml_saveData( writer, "faction",
+            ret |= nxml_saveData( writer, "faction",
                   name, str, keynum );
             /* key, value */
             break;
@@ -222,7 +224,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
             str = sh->name;
             if (str == NULL)
                break;
-            nxml_saveData( writer, "ship",
+            ret |= nxml_saveData( writer, "ship",
                   name, str, keynum );
             /* key, value */
             break;
@@ -230,7 +232,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
          else if (lua_istime(L,-1)) {
             t = *lua_totime(L,-1);
             nsnprintf( buf, sizeof(buf), "%"PRId64, t );
-            nxml_saveData( writer, "time",
+            ret |= nxml_saveData( writer, "time",
                   name, buf, keynum );
             /* key, value */
             break;
@@ -242,7 +244,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
             if ((ss == NULL) || (dest == NULL))
                WARN(_("Failed to save invalid jump."));
             else
-               nxml_saveJump( writer, name, ss->name, dest->name );
+               ret |= nxml_saveJump( writer, name, ss->name, dest->name );
          }
          /* Purpose fallthrough. */
 
@@ -270,19 +272,25 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer, int inta
  */
 int nxml_persistLua( nlua_env env, xmlTextWriterPtr writer )
 {
-   int ret = 0;
+   int ret, top;
 
+   ret = 0;
+   top = lua_gettop(naevL);
    nlua_pushenv(env);
 
    lua_pushnil(naevL);         /* nil */
    /* str, nil */
    while (lua_next(naevL, -2) != 0) {
       /* key, value */
-      ret |= nxml_persistDataNode( naevL, writer, 0 );
+      if (nxml_persistDataNode( naevL, writer, 0 ) < 0) {
+         ret = -1;
+         break;
+      }
       /* key */
    }
 
-   lua_pop(naevL, 1);
+   /* Failed writes can leave anything on the stack. */
+   lua_settop(naevL, top);
 
    return ret;
 }
@@ -251,8 +251,8 @@ void gl_renderCross( double x, double y, double r, const glColour *c )
  *    @param y Y position of the texture on the screen. (units pixels)
  *    @param w Width on the screen. (units pixels)
  *    @param h Height on the screen. (units pixels)
- *    @param tx X position within the texture. [0:1]
- *    @param ty Y position within the texture. [0:1]
+ *    @param tx X position within the image, see glTexture::ox. [0:1]
+ *    @param ty Y position within the image, see glTexture::oy. [0:1]
  *    @param tw Texture width. [0:1]
  *    @param th Texture height. [0:1]
  *    @param c Colour to use (modifies texture colour).
@@ -286,11 +286,11 @@ void gl_blitTexture(  const glTexture* texture,
    gl_vboActivateOffset( gl_renderVBO, GL_VERTEX_ARRAY, 0, 2, GL_FLOAT, 0 );
 
    /* Set the texture. */
-   tex[0] = (GLfloat)tx;
+   tex[0] = (GLfloat)(texture->ox + tx);
    tex[4] = tex[0];
    tex[2] = tex[0] + (GLfloat)tw;
    tex[6] = tex[2];
-   tex[1] = (GLfloat)ty;
+   tex[1] = (GLfloat)(texture->oy + ty);
    tex[3] = tex[1];
    tex[5] = tex[1] + (GLfloat)th;
    tex[7] = tex[5];
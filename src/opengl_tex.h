@@ -61,6 +61,10 @@ typedef struct glTexture_ {
    double srw; /**< Sprite render width - equivalent to sw/rw. */
    double srh; /**< Sprite render height - equivalent to sh/rh. */
 
+   /* atlas */
+   double ox; /**< X position of the image in a texture it shares (texture coordinates). */
+   double oy; /**< Y position of the image in a texture it shares (texture coordinates). */
+
    /* data */
    GLuint texture; /**< the opengl texture itself */
    uint8_t* trans; /**< maps the transparency */
@@ -2077,7 +2077,7 @@ static int outfit_parse( Outfit* temp, const char* file )
    const char *cprop;
    int group;
    size_t bufsize;
-   char *buf = ndata_read( file, &bufsize );
+   const char *buf = ndata_map( file, &bufsize );
 
    xmlDocPtr doc = xmlParseMemory( buf, bufsize );
 
@@ -2114,8 +2114,8 @@ static int outfit_parse( Outfit* temp, const char* file )
             xmlr_strd(cur,"typename",temp->typename);
             xmlr_int(cur,"priority",temp->priority);
             if (xml_isNode(cur,"gfx_store")) {
-               temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
+               temp->gfx_store = xml_parseIcon( cur,
+                     OUTFIT_GFX_PATH"store/%s.png", NULL );
                continue;
             }
             else if (xml_isNode(cur,"slot")) {
@@ -2219,7 +2219,7 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->slot.type==OUTFIT_SLOT_NULL,"slot");
    MELEMENT((temp->slot.type!=OUTFIT_SLOT_NA) && (temp->slot.size==OUTFIT_SLOT_SIZE_NA),"size");
-   MELEMENT(temp->gfx_store==NULL,"gfx_store");
+   MELEMENT(temp->gfx_store==0,"gfx_store");
    /*MELEMENT(temp->mass==0,"mass"); Not really needed */
    MELEMENT(temp->type==0,"type");
    /*MELEMENT(temp->price==0,"price");*/
@@ -2227,7 +2227,7 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
 #undef MELEMENT
 
    xmlFreeDoc(doc);
-   free(buf);
+   ndata_unmap(buf);
 
    return 0;
 }
@@ -2344,7 +2344,7 @@ int outfit_mapParse (void)
 {
    Outfit *o;
    size_t i, len, bufsize, nfiles;
-   char *buf;
+   const char *buf;
    xmlNodePtr node, cur;
    xmlDocPtr doc;
    char **map_files;
@@ -2357,7 +2357,7 @@ int outfit_mapParse (void)
       file = malloc( len );
       nsnprintf( file, len, "%s%s", MAP_DATA_PATH, map_files[i] );
 
-      buf = ndata_read( file, &bufsize );
+      buf = ndata_map( file, &bufsize );
       doc = xmlParseMemory( buf, bufsize );
 
       node = doc->xmlChildrenNode; /* first system node */
@@ -2365,7 +2365,7 @@ int outfit_mapParse (void)
          WARN( _("Malformed '%s' file: does not contain elements"), OUTFIT_DATA_PATH );
          free(file);
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          return -1;
       }
 
@@ -2375,7 +2375,7 @@ int outfit_mapParse (void)
       if (!outfit_isMap(o)) { /* If its not a map, we don't care. */
          free(file);
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -2392,7 +2392,7 @@ int outfit_mapParse (void)
       /* Clean up. */
       free(file);
       xmlFreeDoc(doc);
-      free(buf);
+      ndata_unmap(buf);
    }
 
    /* Clean up. */
@@ -2489,8 +2489,6 @@ void outfit_free (void)
       free(o->desc_short);
       free(o->license);
       free(o->name);
-      if (o->gfx_store)
-         gl_freeTexture(o->gfx_store);
    }
 
    array_free(outfit_stack);
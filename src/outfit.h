@@ -338,7 +338,7 @@ typedef struct Outfit_ {
    char *desc_short; /**< Short outfit description. */
    int priority;     /**< Sort priority, highest first. */
 
-   glTexture* gfx_store; /**< Store graphic. */
+   int gfx_store; /**< Store graphic icon, see icon_get(). */
 
    unsigned int properties; /**< Properties stored bitwise. */
 
@@ -60,6 +60,8 @@
 
 #define SIMPLEX_SCALE 0.5f
 
+#define NOISE_ROWS_PER_JOB 32 /**< Rows of a nebula slice generated per job. */
+
 
 /**
  * @brief Linearly Interpolates x between a and b.
@@ -85,14 +87,15 @@ struct perlin_data_s {
  * @brief Threading stuff.
  */
 typedef struct thread_args_ {
-   int z; /**< Z level working on. */
+   int nblocks; /**< Blocks of rows per slice. */
    float zoom; /**< Zoom level of detail. */
+   int period; /**< Lattice cells before the map wraps around. */
    int n; /**< Number of layers to generate. */
    int h; /**< Height. */
    int w; /**< Width. */
    perlin_data_t *noise; /**< Parent noise. */
    int octaves; /**< Octave parameters. */
-   float *max; /**< Maximum value. */
+   float *max; /**< Maximum value of each block. */
    float *nebula; /**< Nebula loading into. */
 } thread_args;
 
@@ -108,8 +111,10 @@ static float lattice3( perlin_data_t *pdata, int ix, float fx,
       int iy, float fy, int iz, float fz );
 static float lattice2( perlin_data_t *pdata, int ix, float fx, int iy, float fy );
 static float lattice1( perlin_data_t *pdata, int ix, float fx );
+static void noise_turbulenceRow3( perlin_data_t *pdata, float *out, float *scratch,
+      int w, float fy, float fz, int period, int octaves );
 /*Threading */
-static int noise_genNebulaMap_thread( void *data );
+static void noise_genNebulaMap_blocks( int start, int end, void *data );
 
 
 /**
@@ -585,75 +590,180 @@ float* noise_genRadarInt( const int w, const int h, float rug )
 
 
 /**
- * @brief Thread worker for generating nebula stuff.
+ * @brief Generates one row of tileable 3d turbulence.
+ *
+ * Lattice coordinates wrap every period cells along x and y (doubling with
+ *  each octave), so the row tiles seamlessly with the opposite edges of the
+ *  map. The y and z part of the lattice hash is constant along the row and is
+ *  hoisted out, leaving the per-pixel work as flat loops over the scratch
+ *  arrays that the compiler can vectorize; only the gradient gather remains
+ *  scalar.
  *
- *    @param data Data to pass.
+ *    @param pdata Perlin data to generate noise from.
+ *    @param out Row to write turbulence into (w elements).
+ *    @param scratch Scratch space of at least 4*w elements.
+ *    @param w Width of the row.
+ *    @param fy Y position of the row in lattice cells.
+ *    @param fz Z position of the row in lattice cells.
+ *    @param period Number of lattice cells across the row.
+ *    @param octaves Octaves to use.
  */
-static int noise_genNebulaMap_thread( void *data )
+static void noise_turbulenceRow3( perlin_data_t *pdata, float *out, float *scratch,
+      int w, float fy, float fz, int period, int octaves )
+{
+   int i, x, k, per;
+   int iy, iz, iy1, ix, ix1;
+   int hzy[4];
+   float ry, rz, wy, wz;
+   float scale, dx, fx, e;
+   float *rx, *wx, *val;
+   int *lx;
+   const float *g;
+   float v[8];
+
+   rx  = &scratch[0];
+   wx  = &scratch[w];
+   val = &scratch[2*w];
+   lx  = (int*) &scratch[3*w];
+
+   for (x=0; x<w; x++)
+      out[x] = 0.;
+
+   scale = 1.;
+   for (i=0; i<octaves; i++) {
+      per   = (int)(period * scale + 0.5);
+      dx    = (float)per / (float)w;
+      e     = pdata->exponent[i];
+
+      /* Row constants. */
+      iy    = (int)(fy*scale);
+      ry    = fy*scale - iy;
+      wy    = CUBIC(ry);
+      iz    = (int)(fz*scale);
+      rz    = fz*scale - iz;
+      wz    = CUBIC(rz);
+      iy   %= per;
+      iy1   = (iy+1) % per;
+      hzy[0] = pdata->map[ (pdata->map[ iz     & 0xFF ] + iy ) & 0xFF ];
+      hzy[1] = pdata->map[ (pdata->map[ iz     & 0xFF ] + iy1) & 0xFF ];
+      hzy[2] = pdata->map[ (pdata->map[ (iz+1) & 0xFF ] + iy ) & 0xFF ];
+      hzy[3] = pdata->map[ (pdata->map[ (iz+1) & 0xFF ] + iy1) & 0xFF ];
+
+      /* Positions and cubic weights along the row. */
+      for (x=0; x<w; x++) {
+         fx    = dx * (float)x;
+         lx[x] = (int)fx;
+         rx[x] = fx - (float)lx[x];
+         wx[x] = CUBIC(rx[x]);
+      }
+
+      /* Gradient gather and interpolation. */
+      for (x=0; x<w; x++) {
+         ix  = lx[x];
+         ix1 = (ix+1) % per;
+         for (k=0; k<4; k++) {
+            g = pdata->buffer[ pdata->map[ (hzy[k] + ix) & 0xFF ] ];
+            v[2*k]   = g[0]*rx[x] + g[1]*(ry - (k&1)) + g[2]*(rz - (k>>1));
+            g = pdata->buffer[ pdata->map[ (hzy[k] + ix1) & 0xFF ] ];
+            v[2*k+1] = g[0]*(rx[x]-1.) + g[1]*(ry - (k&1)) + g[2]*(rz - (k>>1));
+         }
+         val[x] = LERP(
+               LERP( LERP(v[0], v[1], wx[x]), LERP(v[2], v[3], wx[x]), wy ),
+               LERP( LERP(v[4], v[5], wx[x]), LERP(v[6], v[7], wx[x]), wy ),
+               wz );
+      }
+
+      /* Accumulate the octave. */
+      for (x=0; x<w; x++)
+         out[x] += fabsf( CLAMP(-0.99999f, 0.99999f, val[x]) ) * e;
+
+      scale *= pdata->lacunarity;
+   }
+
+   for (x=0; x<w; x++)
+      out[x] = CLAMP(-0.99999f, 0.99999f, out[x]);
+}
+
+
+/**
+ * @brief Threadpool worker for generating blocks of nebula rows.
+ *
+ *    @param start First block to generate.
+ *    @param end Block after the last to generate.
+ *    @param data Generation arguments.
+ */
+static void noise_genNebulaMap_blocks( int start, int end, void *data )
 {
    thread_args *args = (thread_args*) data;
-   float f[3];
-   float value;
-   int y, x;
+   float *row, *scratch;
+   float fy, fz;
+   int i, y, y0, y1, x, z;
    float max;
 
-   /* Generate the layer. */
-   max = 0;
-   f[2] = args->zoom * (float)args->z / (float)args->n;
+   scratch = malloc( sizeof(float) * 4 * args->w );
 
-   for (y=0; y<args->h; y++) {
-      f[1] = args->zoom * (float)y / (float)args->h;
+   for (i=start; i<end; i++) {
+      z  = i / args->nblocks;
+      y0 = (i % args->nblocks) * NOISE_ROWS_PER_JOB;
+      y1 = MIN( args->h, y0 + NOISE_ROWS_PER_JOB );
 
-      for (x=0; x<args->w; x++) {
-         f[0] = args->zoom * (float)x / (float)args->w;
+      /* Generate the rows. */
+      max = 0.;
+      fz  = args->zoom * (float)z / (float)args->n;
+      for (y=y0; y<y1; y++) {
+         fy  = (float)args->period * (float)y / (float)args->h;
+         row = &args->nebula[ z * args->w * args->h + y * args->w ];
 
-         value = noise_turbulence3( args->noise, f, args->octaves );
-         if (max < value)
-            max = value;
+         noise_turbulenceRow3( args->noise, row, scratch, args->w,
+               fy, fz, args->period, args->octaves );
 
-         args->nebula[args->z * args->w * args->h + y * args->w + x] = value;
-       }
-   }
+         for (x=0; x<args->w; x++)
+            if (max < row[x])
+               max = row[x];
+      }
 
-   /* Set up output. */
-   *args->max = max;
+      /* Set up output. */
+      args->max[i] = max;
+   }
 
    /* Clean up. */
-   free( args );
-   return 0;
+   free( scratch );
 }
 
 
 /**
- * @brief Generates a 3d nebula map.
+ * @brief Generates a 3d tileable nebula map.
+ *
+ * Each slice wraps around seamlessly on both axes, so it can be repeated to
+ *  cover any screen size. Work is split into blocks of rows across all the
+ *  slices to keep every core busy.
  *
  *    @param w Width of the map.
  *    @param h Height of the map.
  *    @param n Number of slices of the map (2d planes).
- *    @param rug Rugosity of the map.
+ *    @param rug Rugosity of the map (lattice cells across one tile).
  *    @return The map generated.
  */
 float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
 {
    int x, y, z, i;
    int octaves;
+   int period, njobs;
    float hurst;
    float lacunarity;
    perlin_data_t* noise;
    float *nebula;
    float value;
-   float zoom;
    float *_max;
    float max;
    unsigned int s;
-   thread_args *args;
-   ThreadQueue *vpool;
+   thread_args args;
 
    /* pretty default values */
    octaves     = 3;
    hurst       = NOISE_DEFAULT_HURST;
    lacunarity  = NOISE_DEFAULT_LACUNARITY;
-   zoom        = rug * ((float)h/768.)*((float)w/1024.);
+   period      = MAX( 1, (int)(rug + 0.5) );
 
    /* create noise and data */
    noise      = noise_new( 3, hurst, lacunarity );
@@ -669,33 +779,25 @@ float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
    DEBUG(_("Generating Nebula of size %dx%dx%d"), w, h, n);
 
    /* Prepare for generation. */
-   _max        = malloc( sizeof(float) * n );
-
-   /* Initialize vpool */
-   vpool = vpool_create();
-
-   /* Start to create the nebula */
-   for (z=0; z<n; z++) {
-      /* Make ze arguments! */
-      args     = malloc( sizeof(thread_args) );
-      args->z  = z;
-      args->zoom = zoom;
-      args->n  = n;
-      args->h  = h;
-      args->w  = w;
-      args->noise = noise;
-      args->octaves = octaves;
-      args->max = &_max[z];
-      args->nebula = nebula;
-
-      /* Launch ze thread. */
-      vpool_enqueue( vpool, noise_genNebulaMap_thread, args );
-   }
-
-   /* Wait for threads to signal completion. */
-   vpool_wait( vpool );
+   args.nblocks   = (h + NOISE_ROWS_PER_JOB - 1) / NOISE_ROWS_PER_JOB;
+   njobs          = n * args.nblocks;
+   _max           = malloc( sizeof(float) * njobs );
+
+   /* Make ze arguments! */
+   args.zoom      = rug;
+   args.period    = period;
+   args.n         = n;
+   args.h         = h;
+   args.w         = w;
+   args.noise     = noise;
+   args.octaves   = octaves;
+   args.max       = _max;
+   args.nebula    = nebula;
+
+   /* Generate all the blocks of rows of all the slices in parallel. */
+   threadpool_parallelFor( 0, njobs, 1, noise_genNebulaMap_blocks, &args );
    max = 0.;
-   for (i=0; i<n; i++) {
+   for (i=0; i<njobs; i++) {
       if (_max[i]>max)
          max = _max[i];
    }
@@ -15,6 +15,14 @@
 #include "log.h"
 
 
+/**
+ * @brief Set to 1 to check every closed form update against the Runge-Kutta
+ *        one and warn when they diverge (debug builds only, slow).
+ */
+#define SOLID_ANALYTIC_CHECK  0
+#define SOLID_ANALYTIC_TOL    0.05 /**< Relative divergence to warn about. */
+
+
 /*
  * M I S C
  */
@@ -398,6 +406,238 @@ static void solid_update_rk4 (Solid *obj, const double dt)
 }
 
 
+/**
+ * @brief Gets the time it takes a constant acceleration to bring a velocity
+ *        to a given speed.
+ *
+ * Solves |v + a*t| = speed for the positive root, assuming |v| <= speed.
+ *
+ *    @return Time to reach the speed or HUGE_VAL if it's never reached.
+ */
+static double solid_timeToSpeed( double vx, double vy, double ax, double ay,
+      double speed )
+{
+   double a, b, c, d;
+
+   a = ax*ax + ay*ay;
+   if (a <= 0.)
+      return HUGE_VAL;
+   b = 2.*(vx*ax + vy*ay);
+   c = vx*vx + vy*vy - speed*speed;
+   d = b*b - 4.*a*c;
+   if (d < 0.) /* Only from rounding, c <= 0. */
+      d = 0.;
+   return MAX( 0., (-b + sqrt(d)) / (2.*a) );
+}
+
+
+#if DEBUGGING && SOLID_ANALYTIC_CHECK
+/**
+ * @brief Compares a closed form update against the Runge-Kutta one.
+ *
+ *    @param ref Solid as it was before the update.
+ *    @param obj Solid after solid_update_analytic.
+ *    @param dt Time of the update.
+ */
+static void solid_analyticCheck( Solid *ref, const Solid *obj, const double dt )
+{
+   double dp, dv;
+
+   solid_update_rk4( ref, dt );
+   dp = vect_dist( &ref->pos, &obj->pos );
+   dv = vect_dist( &ref->vel, &obj->vel );
+   if ((dp > SOLID_ANALYTIC_TOL * MAX(1., VMOD(ref->vel)*dt)) ||
+         (dv > SOLID_ANALYTIC_TOL * MAX(1., VMOD(ref->vel))))
+      WARN("Solid update diverges from RK4 (dt=%.4f, speed=%.1f/%.1f): "
+            "position off by %.3f, velocity off by %.3f",
+            dt, VMOD(obj->vel), obj->speed_max, dp, dv );
+}
+#endif /* DEBUGGING && SOLID_ANALYTIC_CHECK */
+
+
+/**
+ * @brief Solves a piece of a tick with constant thrust in closed form.
+ *
+ * The piece is split at the times the speed crosses speed_max, and each part
+ *  is solved exactly:
+ *
+ *   below the limit:
+ *    v(t) = v + a*t
+ *    x(t) = p + v*t + a/2*t^2
+ *
+ *   above the limit, the same drag as solid_update_rk4 acts against the whole
+ *    velocity, 3*(|v| - speed_max)*v/|v|. Along the starting direction u of
+ *    the velocity this is a decay towards the limit:
+ *    s(t)  = s_eq + (s - s_eq)*e^(-3t), s_eq = speed_max + a.u/3
+ *    across it the velocity w (0 at the start) decays at k = 3*(1 - speed_max/|v|):
+ *    w(t)  = a.u'/k * (1 - e^(-kt))
+ *    taking u and k constant over the part.
+ *
+ *    @param[in,out] p Position.
+ *    @param[in,out] v Velocity.
+ *    @param ax X component of the thrust acceleration.
+ *    @param ay Y component of the thrust acceleration.
+ *    @param vmax Speed limit or negative if there is none.
+ *    @param dt Duration of the piece.
+ */
+#define SOLID_ANALYTIC_PIECES 3 /**< Maximum amount of parts a piece is split into. */
+static void solid_analyticPiece( Vector2d *p, Vector2d *v,
+      double ax, double ay, double vmax, double dt )
+{
+   int i, limit, limited;
+   double px,py, vx,vy;
+   double t, h, tc, vmod;
+   double ux,uy, apar,aperp, seq, e, s, ds, k, w, dw;
+
+   px = p->x;
+   py = p->y;
+   vx = v->x;
+   vy = v->y;
+   limit = (vmax >= 0.);
+
+   /* See if we start out being slowed down. */
+   if (limit) {
+      vmod    = MOD( vx, vy );
+      limited = (vmod > vmax) || ((vmod >= vmax) && (vx*ax + vy*ay > 0.));
+   }
+   else
+      limited = 0;
+
+   t = dt;
+   for (i=0; (i<SOLID_ANALYTIC_PIECES) && (t > 0.); i++) {
+      h = t;
+
+      if (!limited) {
+         /* Run until we hit the speed limit. */
+         if (limit && (i < SOLID_ANALYTIC_PIECES-1)) {
+            tc = solid_timeToSpeed( vx, vy, ax, ay, vmax );
+            if (tc < h) {
+               h       = tc;
+               limited = 1;
+            }
+         }
+
+         px += vx*h + 0.5*ax * h*h;
+         py += vy*h + 0.5*ay * h*h;
+         vx += ax*h;
+         vy += ay*h;
+      }
+      else {
+         /* Direction the drag acts against. */
+         vmod = MOD( vx, vy );
+         if (vmod > 0.) {
+            ux = vx / vmod;
+            uy = vy / vmod;
+         }
+         else {
+            vmod = MOD( ax, ay );
+            ux   = (vmod > 0.) ? ax / vmod : 1.;
+            uy   = (vmod > 0.) ? ay / vmod : 0.;
+            vmod = 0.;
+         }
+         apar  = ax*ux + ay*uy;
+         aperp = ay*ux - ax*uy;
+         seq   = vmax + apar/3.;
+
+         /* Braking brings us back under the limit at some point. */
+         if ((seq < vmax) && (i < SOLID_ANALYTIC_PIECES-1)) {
+            tc = (vmod > vmax) ? log( (vmod - seq) / (vmax - seq) ) / 3. : 0.;
+            if (tc < h) {
+               h       = tc;
+               limited = 0;
+            }
+         }
+
+         /* Along the velocity. */
+         e  = exp( -3.*h );
+         s  = seq + (vmod - seq)*e;
+         ds = seq*h + (vmod - seq)*(1. - e)/3.;
+
+         /* Across the velocity. */
+         k = (vmod > 0.) ? 3.*MAX( 0., 1. - vmax/vmod ) : 3.;
+         if (k*h > 1e-6) {
+            e  = exp( -k*h );
+            w  = aperp/k * (1. - e);
+            dw = aperp/k * (h - (1. - e)/k);
+         }
+         else {
+            w  = aperp*h;
+            dw = 0.5*aperp*h*h;
+         }
+
+         px += ds*ux - dw*uy;
+         py += ds*uy + dw*ux;
+         vx  = s*ux - w*uy;
+         vy  = s*uy + w*ux;
+      }
+
+      t -= h;
+   }
+
+   vect_csetmin( v, vx, vy );
+   vect_csetmin( p, px, py );
+}
+
+
+/**
+ * @brief Closed form method of updating a solid based on its acceleration.
+ *
+ * The tick is cut into as few pieces as possible while keeping the facing
+ *  and the direction of the velocity within SOLID_ANALYTIC_ANGLE over each
+ *  of them. Each piece applies the thrust along the facing halfway through
+ *  it and is solved by solid_analyticPiece(). At normal frame rates this is
+ *  a single piece, and even under heavy time compression it takes far fewer
+ *  steps than solid_update_rk4, with two sin/cos pairs per tick.
+ */
+#define SOLID_ANALYTIC_ANGLE  0.1 /**< Maximum turn of the facing or velocity in a piece (radians). */
+static void solid_update_analytic (Solid *obj, const double dt)
+{
+   int i, n, nmax;
+   double h, th, turn, c, s, cr, sr, tmp;
+#if DEBUGGING && SOLID_ANALYTIC_CHECK
+   Solid ref = *obj;
+#endif /* DEBUGGING && SOLID_ANALYTIC_CHECK */
+
+   th = obj->thrust / obj->mass;
+
+   /* How far the facing turns, and at most the velocity when held at the
+    * speed limit, where thrust across it is all that can turn it. */
+   turn = FABS( obj->dir_vel ) * dt;
+   if ((obj->speed_max > 0.) && (th > 0.))
+      turn = MAX( turn, th * dt / obj->speed_max );
+   n = 1 + (int)(turn / SOLID_ANALYTIC_ANGLE);
+
+   /* Never take more steps than solid_update_rk4. */
+   nmax = MAX( 1, (int)(dt / RK4_MIN_H) );
+   n    = MIN( n, nmax );
+   h    = dt / (double)n;
+
+   /* Facing halfway through the first piece, rotated from piece to piece. */
+   c  = cos( obj->dir + obj->dir_vel*h/2. );
+   s  = sin( obj->dir + obj->dir_vel*h/2. );
+   cr = cos( obj->dir_vel*h );
+   sr = sin( obj->dir_vel*h );
+   for (i=0; i<n; i++) {
+      solid_analyticPiece( &obj->pos, &obj->vel, th*c, th*s, obj->speed_max, h );
+      tmp = c*cr - s*sr;
+      s   = s*cr + c*sr;
+      c   = tmp;
+   }
+
+   vect_cset( &obj->vel, obj->vel.x, obj->vel.y );
+   vect_cset( &obj->pos, obj->pos.x, obj->pos.y );
+
+   /* Rotation. */
+   obj->dir += obj->dir_vel*dt;
+   if (obj->dir >= 2.*M_PI)
+      obj->dir -= 2.*M_PI;
+   else if (obj->dir < 0.)
+      obj->dir += 2.*M_PI;
+
+#if DEBUGGING && SOLID_ANALYTIC_CHECK
+   solid_analyticCheck( &ref, obj, dt );
+#endif /* DEBUGGING && SOLID_ANALYTIC_CHECK */
+}
 /**
  * @brief Gets the maximum speed of any object with speed and thrust.
  */
@@ -459,6 +699,10 @@ void solid_init( Solid* dest, const double mass, const double dir,
          dest->update = solid_update_euler;
          break;
 
+      case SOLID_UPDATE_ANALYTIC:
+         dest->update = solid_update_analytic;
+         break;
+
       default:
          WARN(_("Solid initialization did not specify correct update function!"));
          dest->update = solid_update_rk4;
@@ -29,6 +29,7 @@
  */
 #define SOLID_UPDATE_RK4      0 /**< Default Runge-Kutta 3-4 update. */
 #define SOLID_UPDATE_EULER    1 /**< Simple Euler update. */
+#define SOLID_UPDATE_ANALYTIC 2 /**< Closed form constant thrust update. */
 
 
 /**
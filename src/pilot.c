@@ -45,12 +45,18 @@
 #include "camera.h"
 #include "damagetype.h"
 #include "pause.h"
+#include "pilot_ew.h"
+#include "spatial.h"
+#include "array.h"
 
 
 #define PILOT_CHUNK_MIN 128 /**< Minimum chunks to increment pilot_stack by */
 #define PILOT_CHUNK_MAX 2048 /**< Maximum chunks to increment pilot_stack by */
 #define CHUNK_SIZE      32 /**< Size to allocate memory by. */
 
+#define PILOT_GRID_CELL   2000. /**< Size of the cells of the pilot spatial index. */
+#define PILOT_LOD_RANGE2  4. /**< Squared multiple of the player's sensor range past which pilots may be coarsely simulated. */
+
 /* ID Generators. */
 static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniqueness */
 
@@ -66,6 +72,36 @@ static double pilot_commTimeout  = 15.; /**< Time for text above pilot to time o
 static double pilot_commFade     = 5.; /**< Time for text above pilot to fade out. */
 
 
+/* Coarse simulation of distant pilots. */
+static double pilot_lodStep      = 0.; /**< Coarse step for distant pilots, 0 to simulate everyone fully. */
+static int pilot_nlod            = 0; /**< Pilots extrapolated during the last update. */
+
+
+/* Spatial index of pilot_stack. */
+static SpatialGrid pilot_grid; /**< Index of the pilots by position. */
+static int pilot_gridInit        = 0; /**< Whether pilot_grid is allocated. */
+static int pilot_gridDirty       = 1; /**< Index must be rebuilt before the next query. */
+static int *pilot_gridIds        = NULL; /**< Query results (array.h). */
+static double pilot_gridSize     = 0.; /**< Largest ship sprite dimension in the index. */
+static Pilot **pilot_explodeNear = NULL; /**< Pilots near an explosion (array.h). */
+static Pilot **pilot_renderList  = NULL; /**< Pilots on the screen (array.h). */
+static int pilot_ndrawn          = 0; /**< Pilots drawn during the last frame. */
+static int pilot_nculled         = 0; /**< Pilots skipped for being off the screen. */
+
+#if EXPL_CHECK
+/**
+ * @brief A pilot hit by an explosion in the old loop over the whole stack.
+ */
+typedef struct PilotExplodeHit_ {
+   unsigned int id; /**< Pilot hit. */
+   double damage; /**< Damage done. */
+   Vector2d vel; /**< Direction of the impact. */
+} PilotExplodeHit;
+static PilotExplodeHit *pilot_explodeOld = NULL; /**< Hits of the current explosion (array.h). */
+static int pilot_explodeNold             = 0; /**< Hits of pilot_explodeOld matched so far. */
+#endif /* EXPL_CHECK */
+
+
 
 /*
  * Prototypes
@@ -73,6 +109,17 @@ static double pilot_commFade     = 5.; /**< Time for text above pilot to fade ou
 /* Update. */
 static void pilot_hyperspace( Pilot* pilot, double dt );
 static void pilot_refuel( Pilot *p, double dt );
+static int pilot_isCoarse( const Pilot *p );
+static void pilot_lodUpdate( Pilot *p, double dt );
+static void pilot_gridBuild (void);
+static int pilot_gridResults( Pilot ***pilots );
+static int pilot_cmpIndex( const void *p1, const void *p2 );
+static double pilot_explodeFactor( const Pilot *p, double x, double y, double rad2 );
+#if EXPL_CHECK
+static void pilot_explodeCheckStart( double x, double y, double radius, const Damage *dmg );
+static void pilot_explodeCheckHit( const Pilot *p, const Damage *dmg, const Solid *s );
+static void pilot_explodeCheckEnd( double x, double y );
+#endif /* EXPL_CHECK */
 /* Clean up. */
 static void pilot_dead( Pilot* p, unsigned int killer );
 /* Targetting. */
@@ -1452,7 +1499,7 @@ void pilot_updateDisable( Pilot* p, const unsigned int shooter )
 
       /* Disable active outfits. */
       if (pilot_outfitOffAll( p ) > 0)
-         pilot_calcStats( p );
+         pilot_calcStatsUpdate( p );
 
       pilot_setFlag( p,PILOT_DISABLED ); /* set as disabled */
       /* Run hook */
@@ -1527,24 +1574,45 @@ static void pilot_dead( Pilot* p, unsigned int killer )
 
 
 /**
- * @brief Makes the pilot explosion.
- *    @param x X position of the pilot.
- *    @param y Y position of the pilot.
- *    @param radius Radius of the explosion.
- *    @param dmg Damage of the explosion.
- *    @param parent The exploding pilot.
+ * @brief Gets how much of an explosion's damage a pilot takes.
+ *
+ *    @return Fraction of the damage taken, 0 if not hit.
+ */
+static double pilot_explodeFactor( const Pilot *p, double x, double y, double rad2 )
+{
+   double dist;
+
+   dist = pow2(p->solid->pos.x - x) + pow2(p->solid->pos.y - y);
+   /* Take into account ship size. */
+   dist -= pow2(p->ship->gfx_space->sw);
+   dist = MAX(0,dist);
+
+   if (dist >= rad2)
+      return 0.;
+   return 1. - sqrt(dist / rad2);
+}
+
+
+#if EXPL_CHECK
+/**
+ * @brief Gets the pilots the old loop over the whole stack hits, with the
+ *        damage it does to them.
  */
-void pilot_explode( double x, double y, double radius, const Damage *dmg, const Pilot *parent )
+static void pilot_explodeCheckStart( double x, double y, double radius, const Damage *dmg )
 {
    int i;
    double rx, ry;
    double dist, rad2;
    Pilot *p;
-   Solid s; /* Only need to manipulate mass and vel. */
-   Damage ddmg;
+   PilotExplodeHit *h;
+
+   if (pilot_explodeOld == NULL)
+      pilot_explodeOld = array_create( PilotExplodeHit );
+   else
+      array_resize( &pilot_explodeOld, 0 );
+   pilot_explodeNold = 0;
 
    rad2 = radius*radius;
-   ddmg = *dmg;
 
    for (i=0; i<pilot_nstack; i++) {
       p = pilot_stack[i];
@@ -1559,23 +1627,112 @@ void pilot_explode( double x, double y, double radius, const Damage *dmg, const
 
       /* Pilot is hit. */
       if (dist < rad2) {
+         h           = &array_grow( &pilot_explodeOld );
+         h->id       = p->id;
+         h->damage   = dmg->damage * (1. - sqrt(dist / rad2));
+         h->vel.x    = rx;
+         h->vel.y    = ry;
+      }
+   }
+}
+
+
+/**
+ * @brief Checks a pilot hit is the next one of the old loop.
+ */
+static void pilot_explodeCheckHit( const Pilot *p, const Damage *dmg, const Solid *s )
+{
+   const PilotExplodeHit *h;
+
+   expl_checkPilots++;
+   if (pilot_explodeNold >= array_size(pilot_explodeOld)) {
+      WARN(_("Explosion hit pilot %u the old loop missed"), p->id);
+      expl_checkErrors++;
+      return;
+   }
+   h = &pilot_explodeOld[ pilot_explodeNold++ ];
+   /* Same formula, but keep x87 excess precision from tripping it. */
+   if ((h->id != p->id) || (fabs(h->damage - dmg->damage) > 1e-9 * h->damage) ||
+         (h->vel.x != s->vel.x) || (h->vel.y != s->vel.y)) {
+      WARN(_("Explosion hit pilot %u for %f instead of pilot %u for %f"),
+            p->id, dmg->damage, h->id, h->damage);
+      expl_checkErrors++;
+   }
+}
+
+
+/**
+ * @brief Checks no pilot hit by the old loop was left out.
+ */
+static void pilot_explodeCheckEnd( double x, double y )
+{
+   if (pilot_explodeNold != array_size(pilot_explodeOld)) {
+      WARN(_("Explosion at (%.0f,%.0f) hit %d pilots instead of %d"),
+            x, y, pilot_explodeNold, array_size(pilot_explodeOld));
+      expl_checkErrors++;
+   }
+}
+#endif /* EXPL_CHECK */
+
+
+/**
+ * @brief Makes the pilot explosion.
+ *    @param x X position of the pilot.
+ *    @param y Y position of the pilot.
+ *    @param radius Radius of the explosion.
+ *    @param dmg Damage of the explosion.
+ *    @param parent Id of the exploding pilot or 0.
+ */
+void pilot_explode( double x, double y, double radius, const Damage *dmg, unsigned int parent )
+{
+   int i;
+   double f, rad2;
+   Pilot *p;
+   Solid s; /* Only need to manipulate mass and vel. */
+   Damage ddmg;
+
+   rad2 = radius*radius;
+   ddmg = *dmg;
+
+   /* Only look at pilots close enough with the largest ship around, with a
+    * margin for rounding. */
+   if (pilot_gridDirty)
+      pilot_gridBuild();
+   pilots_inRange( &pilot_explodeNear, x, y, sqrt( rad2 + pow2(pilot_gridSize) ) + 1. );
+#if EXPL_CHECK
+   pilot_explodeCheckStart( x, y, radius, dmg );
+#endif /* EXPL_CHECK */
+
+   for (i=0; i<array_size(pilot_explodeNear); i++) {
+      p = pilot_explodeNear[i];
+
+      /* Pilot is hit. */
+      f = pilot_explodeFactor( p, x, y, rad2 );
+      if (f > 0.) {
 
          /* Adjust damage based on distance. */
-         ddmg.damage = dmg->damage * (1. - sqrt(dist / rad2));
+         ddmg.damage = dmg->damage * f;
 
          /* Impact settings. */
          s.mass =  pow2(dmg->damage) / 30.;
-         s.vel.x = rx;
-         s.vel.y = ry;
+         s.vel.x = p->solid->pos.x - x;
+         s.vel.y = p->solid->pos.y - y;
+
+#if EXPL_CHECK
+         pilot_explodeCheckHit( p, &ddmg, &s );
+#endif /* EXPL_CHECK */
 
          /* Actual damage calculations. */
-         pilot_hit( p, &s, (parent!=NULL) ? parent->id : 0, &ddmg, 1 );
+         pilot_hit( p, &s, parent, &ddmg, 1 );
 
          /* Shock wave from the explosion. */
          if (p->id == PILOT_PLAYER)
             spfx_shake( pow2(ddmg.damage) / pow2(100.) * SHAKE_MAX );
       }
    }
+#if EXPL_CHECK
+   pilot_explodeCheckEnd( x, y );
+#endif /* EXPL_CHECK */
 }
 
 
@@ -1968,7 +2125,7 @@ void pilot_update( Pilot* pilot, const double dt )
 
    /* Must recalculate stats because something changed state. */
    if (nchg > 0)
-      pilot_calcStats( pilot );
+      pilot_calcStatsUpdate( pilot );
 
    /* Player damage decay. */
    if (pilot->player_damage > 0.)
@@ -2406,7 +2563,7 @@ void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction, const
    pilot->faction = faction;
 
    /* solid */
-   pilot->solid = solid_create(ship->mass, dir, pos, vel, SOLID_UPDATE_RK4);
+   pilot->solid = solid_create(ship->mass, dir, pos, vel, SOLID_UPDATE_ANALYTIC);
 
    /* First pass to make sure requirements make sense. */
    pilot->armour = pilot->armour_max = 1.; /* hack to have full armour */
@@ -2558,6 +2715,7 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
    /* Set the pilot in the stack -- must be there before initializing */
    pilot_stack[pilot_nstack] = dyn;
    pilot_nstack++; /* there's a new pilot */
+   pilot_gridDirty = 1;
 
    /* Initialize the pilot. */
    pilot_init( dyn, ship, name, faction, ai, dir, pos, vel, flags );
@@ -2844,6 +3002,7 @@ void pilot_destroy(Pilot* p)
    /* pilot is eliminated */
    pilot_free(p);
    pilot_nstack--;
+   pilot_gridDirty = 1;
 
    /* copy other pilots down */
    memmove(&pilot_stack[i], &pilot_stack[i+1], (pilot_nstack-i)*sizeof(Pilot*));
@@ -2866,6 +3025,24 @@ void pilots_free (void)
    pilot_stack = NULL;
    player.p = NULL;
    pilot_nstack = 0;
+
+   /* Free the spatial index. */
+   if (pilot_gridInit) {
+      spatial_free( &pilot_grid );
+      pilot_gridInit = 0;
+   }
+   array_free( pilot_gridIds );
+   array_free( pilot_explodeNear );
+   array_free( pilot_renderList );
+   pilot_gridIds     = NULL;
+   pilot_explodeNear = NULL;
+   pilot_renderList  = NULL;
+#if EXPL_CHECK
+   array_free( pilot_explodeOld );
+   pilot_explodeOld  = NULL;
+#endif /* EXPL_CHECK */
+   pilot_gridDirty = 1;
+   pilot_freeVisibility();
 }
 
 
@@ -2891,6 +3068,7 @@ void pilots_clean (int persist)
    }
 
    pilot_nstack = persist_count;
+   pilot_gridDirty = 1;
 
    /* Clear global hooks. */
    pilots_clearGlobalHooks();
@@ -2920,6 +3098,84 @@ void pilots_cleanAll (void)
       player.p = NULL;
    }
    pilot_nstack = 0;
+   pilot_gridDirty = 1;
+}
+
+
+/**
+ * @brief Sets the step distant pilots are coarsely simulated with.
+ *
+ * Pilots far outside the player's sensor range only think and update once
+ *  their accumulated time reaches the step, and are moved in a straight line
+ *  in between. Pilots are flushed to the current time as soon as they stop
+ *  being coarse, including when the step is set back to 0.
+ *
+ *    @param step Coarse step or 0 to simulate all pilots every update.
+ */
+void pilots_setLOD( double step )
+{
+   pilot_lodStep = step;
+}
+
+
+/**
+ * @brief Gets how many pilots were extrapolated instead of updated in the
+ *        last call to pilots_update().
+ */
+int pilots_getLOD (void)
+{
+   return pilot_nlod;
+}
+
+
+/**
+ * @brief Checks to see if a pilot may be coarsely simulated.
+ */
+static int pilot_isCoarse( const Pilot *p )
+{
+   double d;
+
+   if ((player.p == NULL) || pilot_isPlayer(p) || (p->parent == PLAYER_ID) ||
+         (p->target == PLAYER_ID) || (player.p->target == p->id))
+      return 0;
+
+   /* Anything fancy needs the fine step. */
+   if (pilot_isFlag(p, PILOT_HYP_PREP) || pilot_isFlag(p, PILOT_HYP_BEGIN) ||
+         pilot_isFlag(p, PILOT_HYP_END) || pilot_isFlag(p, PILOT_HYPERSPACE) ||
+         pilot_isFlag(p, PILOT_BOARDING) || pilot_isFlag(p, PILOT_REFUELBOARDING) ||
+         pilot_isFlag(p, PILOT_LANDING) || pilot_isFlag(p, PILOT_TAKEOFF) ||
+         pilot_isFlag(p, PILOT_DEAD))
+      return 0;
+
+   d = vect_dist2( &p->solid->pos, &player.p->solid->pos );
+   return (d * p->ew_hide > PILOT_LOD_RANGE2 * pilot_sensorRange() * player.p->ew_detect);
+}
+
+
+/**
+ * @brief Decides how much time a pilot is simulated for this update.
+ *
+ * Sets lod_run to the time to think and update for, 0 if the pilot was
+ *  only extrapolated.
+ */
+static void pilot_lodUpdate( Pilot *p, double dt )
+{
+   double ext;
+
+   p->lod_dt += dt;
+   if ((pilot_lodStep > 0.) && (p->lod_dt < pilot_lodStep) && pilot_isCoarse(p)) {
+      vect_cadd( &p->solid->pos, p->solid->vel.x*dt, p->solid->vel.y*dt );
+      p->lod_run = 0.;
+      pilot_nlod++;
+      return;
+   }
+
+   /* Undo the extrapolation and simulate all the time at once. */
+   ext = p->lod_dt - dt;
+   if (ext > 0.)
+      vect_cadd( &p->solid->pos, -p->solid->vel.x*ext, -p->solid->vel.y*ext );
+   p->lod_run = p->lod_dt;
+   p->lod_dt  = 0.;
 }
 
 
@@ -2933,6 +3189,8 @@ void pilots_update( double dt )
    int i;
    Pilot *p;
 
+   pilot_nlod = 0;
+
    /* Now update all the pilots. */
    for (i=0; i<pilot_nstack; i++) {
       p = pilot_stack[i];
@@ -2948,6 +3206,11 @@ void pilots_update( double dt )
       if (pilot_isFlag(p, PILOT_INVISIBLE))
          continue;
 
+      /* Distant pilots may skip this update. */
+      pilot_lodUpdate( p, dt );
+      if (p->lod_run <= 0.)
+         continue;
+
       /* See if should think. */
       if ((p->think==NULL) || (p->ai==NULL))
          continue;
@@ -2958,7 +3221,7 @@ void pilots_update( double dt )
 
       /* Hyperspace gets special treatment */
       if (pilot_isFlag(p, PILOT_HYP_PREP))
-         pilot_hyperspace(p, dt);
+         pilot_hyperspace(p, p->lod_run);
       /* Entering hyperspace. */
       else if (pilot_isFlag(p, PILOT_HYP_END)) {
          if (VMOD(p->solid->vel) < 2*solid_maxspeed( p->solid, p->speed, p->thrust) )
@@ -2970,7 +3233,7 @@ void pilots_update( double dt )
             /* Must not be landing nor taking off. */
             !pilot_isFlag(p, PILOT_LANDING) &&
             !pilot_isFlag(p, PILOT_TAKEOFF))
-         p->think(p, dt);
+         p->think(p, p->lod_run);
    }
 
    /* Now update all the pilots. */
@@ -2985,10 +3248,118 @@ void pilots_update( double dt )
       if (pilot_isFlag(p, PILOT_INVISIBLE))
          continue;
 
+      /* Skipped by the coarse simulation. */
+      if (p->lod_run <= 0.)
+         continue;
+
       /* Just update the pilot. */
       if (p->update) /* update */
-         p->update( p, dt );
+         p->update( p, p->lod_run );
+   }
+
+   /* Everyone moved. */
+   pilot_gridDirty = 1;
+   pilot_updateVisibility();
+}
+
+
+/**
+ * @brief Rebuilds the spatial index of the pilots.
+ */
+static void pilot_gridBuild (void)
+{
+   int i;
+
+   if (!pilot_gridInit) {
+      spatial_init( &pilot_grid, PILOT_GRID_CELL );
+      pilot_gridInit = 1;
+   }
+
+   spatial_clear( &pilot_grid );
+   pilot_gridSize = 0.;
+   for (i=0; i<pilot_nstack; i++) {
+      spatial_insert( &pilot_grid, i,
+            pilot_stack[i]->solid->pos.x, pilot_stack[i]->solid->pos.y );
+      pilot_gridSize = MAX( pilot_gridSize, pilot_stack[i]->ship->gfx_space->sw );
+      pilot_gridSize = MAX( pilot_gridSize, pilot_stack[i]->ship->gfx_space->sh );
    }
+   pilot_gridDirty = 0;
+}
+
+
+/**
+ * @brief Compares pilot_stack indexes for qsort.
+ */
+static int pilot_cmpIndex( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
+
+/**
+ * @brief Converts the results of a pilot_grid query to pilots.
+ */
+static int pilot_gridResults( Pilot ***pilots )
+{
+   int i;
+
+   if (*pilots == NULL)
+      *pilots = array_create( Pilot* );
+   else
+      array_resize( pilots, 0 );
+
+   /* Keep the order of the stack. */
+   qsort( pilot_gridIds, array_size(pilot_gridIds), sizeof(int), pilot_cmpIndex );
+   for (i=0; i<array_size(pilot_gridIds); i++)
+      array_push_back( pilots, pilot_stack[ pilot_gridIds[i] ] );
+
+   return array_size(*pilots);
+}
+
+
+/**
+ * @brief Gets the pilots within a distance of a position.
+ *
+ * Uses the positions of the pilots as of the last update, moving a pilot
+ *  elsewhere in the middle of a frame won't be seen until the next one.
+ * Includes invisible and dead pilots, it's up to the caller to skip them.
+ *  Pilots are in the same order as in the stack.
+ *
+ *    @param[in,out] pilots Array (array.h) to fill with the pilots, created
+ *           if NULL. Only valid until pilots are added or destroyed.
+ *    @param x X position to look around.
+ *    @param y Y position to look around.
+ *    @param r Distance to look at.
+ *    @return Number of pilots found.
+ */
+int pilots_inRange( Pilot ***pilots, double x, double y, double r )
+{
+   if (pilot_gridDirty)
+      pilot_gridBuild();
+   spatial_query( &pilot_grid, &pilot_gridIds, x, y, r );
+   return pilot_gridResults( pilots );
+}
+
+
+/**
+ * @brief Gets the pilots inside a rectangle.
+ *
+ * See pilots_inRange() for the caveats.
+ *
+ *    @param[in,out] pilots Array (array.h) to fill with the pilots, created
+ *           if NULL.
+ *    @param x1 Left of the rectangle.
+ *    @param y1 Bottom of the rectangle.
+ *    @param x2 Right of the rectangle.
+ *    @param y2 Top of the rectangle.
+ *    @return Number of pilots found.
+ */
+int pilots_inRect( Pilot ***pilots, double x1, double y1, double x2, double y2 )
+{
+   if (pilot_gridDirty)
+      pilot_gridBuild();
+   spatial_queryRect( &pilot_grid, &pilot_gridIds, x1, y1, x2, y2 );
+   return pilot_gridResults( pilots );
 }
 
 
@@ -2999,19 +3370,47 @@ void pilots_update( double dt )
  */
 void pilots_render( double dt )
 {
-   int i;
-   for (i=0; i<pilot_nstack; i++) {
+   int i, n;
+   double x1, y1, x2, y2, r;
+   Pilot *p;
+
+   /* Only look at the pilots whose sprite can overlap the screen. */
+   if (pilot_gridDirty)
+      pilot_gridBuild();
+   cam_getBounds( &x1, &y1, &x2, &y2 );
+   r = pilot_gridSize / 2.;
+   n = pilots_inRect( &pilot_renderList, x1-r, y1-r, x2+r, y2+r );
+   pilot_ndrawn  = n;
+   pilot_nculled = pilot_nstack - n;
+
+   for (i=0; i<n; i++) {
+      p = pilot_renderList[i];
 
       /* Invisible, not doing anything. */
-      if (pilot_isFlag(pilot_stack[i], PILOT_INVISIBLE))
+      if (pilot_isFlag(p, PILOT_INVISIBLE)) {
+         pilot_ndrawn--;
          continue;
+      }
 
-      if (pilot_stack[i]->render != NULL) /* render */
-         pilot_stack[i]->render(pilot_stack[i], dt);
+      if (p->render != NULL) /* render */
+         p->render(p, dt);
    }
 }
 
 
+/**
+ * @brief Gets how many pilots were drawn and culled in the last frame.
+ *
+ *    @param[out] drawn Pilots drawn.
+ *    @param[out] culled Pilots skipped for being off the screen.
+ */
+void pilots_renderStats( int *drawn, int *culled )
+{
+   *drawn  = pilot_ndrawn;
+   *culled = pilot_nculled;
+}
+
+
 /**
  * @brief Renders all the pilots overlays.
  *
@@ -3061,7 +3460,7 @@ void pilot_clearTimers( Pilot *pilot )
 
    /* Must recalculate stats. */
    if (n > 0)
-      pilot_calcStats( pilot );
+      pilot_calcStatsUpdate( pilot );
 }
 
 
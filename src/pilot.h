@@ -184,6 +184,10 @@ typedef struct PilotOutfitSlot_ {
    int level;        /**< Level in current weapon set (-1 is none). */
    int weapset;      /**< First weapon set that uses the outfit (-1 is none). */
 
+   /* Contribution currently in the pilot's stat sums. */
+   Outfit *stats_outfit; /**< Outfit whose stats are summed, NULL if none. */
+   int stats_on;     /**< Whether its active effects are summed. */
+
    /* Type-specific data. */
    union {
       unsigned int beamid;    /**< ID of the beam used in this outfit, only used for beams. */
@@ -261,6 +265,37 @@ typedef struct Escort_s {
 } Escort_t;
 
 
+/**
+ * @brief Additive outfit contributions to a pilot's stats.
+ *
+ * Kept up to date slot by slot, the derived stats are then calculated from
+ *  these without going over the outfits again.
+ */
+typedef struct PilotStatsSum_ {
+   double cpu;          /**< CPU usage (negative). */
+   double mass_outfit;  /**< Outfit mass, without ammo or relative mass. */
+   double mass_core;    /**< Mass of the core outfits. */
+   double mass_rel;     /**< Relative mass modifier. */
+   double thrust;       /**< Thrust bonus. */
+   double turn;         /**< Turn bonus. */
+   double speed;        /**< Speed bonus. */
+   double absorb;       /**< Damage absorption bonus. */
+   double armour;       /**< Armour bonus. */
+   double armour_regen; /**< Armour regeneration bonus. */
+   double shield;       /**< Shield bonus. */
+   double shield_regen; /**< Shield regeneration bonus. */
+   double energy;       /**< Energy bonus. */
+   double energy_regen; /**< Energy regeneration bonus. */
+   double energy_loss;  /**< Energy drained by active outfits. */
+   double fuel;         /**< Fuel bonus. */
+   double cargo;        /**< Cargo bonus. */
+   double crew_rel;     /**< Relative crew modifier. */
+   int jammers;         /**< Jammers turned on. */
+   ShipStats stats;     /**< Raw sums of outfit ship stats. */
+   ShipStats amount;    /**< Number of outfits improving each stat. */
+} PilotStatsSum;
+
+
 /**
  * @brief The representation of an in-game pilot.
  */
@@ -328,6 +363,7 @@ typedef struct Pilot_ {
    double ew_evasion; /**< Dynamic evasion factor. */
    double ew_detect; /**< Static detection factor. */
    double ew_jump_detect; /** Static jump detection factor */
+   int ew_index;     /**< Row in the sensor visibility cache. */
 
    /* Heat. */
    double heat_T;    /**< Ship temperature. [K] */
@@ -341,6 +377,8 @@ typedef struct Pilot_ {
 
    /* Ship statistics. */
    ShipStats stats;  /**< Pilot's copy of ship statistics. */
+   PilotStatsSum stats_sum; /**< Outfit contributions to the statistics. */
+   unsigned int stats_dirty; /**< Derived statistics needing recalculation. */
 
    /* Associated functions */
    void (*think)(struct Pilot_*, const double); /**< AI thinking for the pilot */
@@ -426,6 +464,8 @@ typedef struct Pilot_ {
                               In per one of max shield + armour. */
    double engine_glow; /**< Amount of engine glow to display. */
    int messages;       /**< Queued messages (Lua ref). */
+   double lod_dt;      /**< Time accumulated while coarsely simulated. */
+   double lod_run;     /**< Time simulated in the current update, 0 if extrapolated. */
 } Pilot;
 
 
@@ -468,7 +508,7 @@ void pilot_setTarget( Pilot* p, unsigned int id );
 double pilot_hit( Pilot* p, const Solid* w, const unsigned int shooter,
       const Damage *dmg, int reset );
 void pilot_updateDisable( Pilot* p, const unsigned int shooter );
-void pilot_explode( double x, double y, double radius, const Damage *dmg, const Pilot *parent );
+void pilot_explode( double x, double y, double radius, const Damage *dmg, unsigned int parent );
 double pilot_face( Pilot* p, const double dir );
 int pilot_brake( Pilot* p );
 double pilot_brakeDist( Pilot *p, Vector2d *pos );
@@ -527,8 +567,13 @@ void pilot_setTurn( Pilot *p, double turn );
  */
 void pilot_update( Pilot* pilot, const double dt );
 void pilots_update( double dt );
+void pilots_setLOD( double step );
+int pilots_getLOD (void);
+int pilots_inRange( Pilot ***pilots, double x, double y, double r );
+int pilots_inRect( Pilot ***pilots, double x1, double y1, double x2, double y2 );
 void pilots_render( double dt );
 void pilots_renderOverlay( double dt );
+void pilots_renderStats( int *drawn, int *culled );
 void pilot_render( Pilot* pilot, const double dt );
 void pilot_renderOverlay( Pilot* p, const double dt );
 
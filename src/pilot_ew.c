@@ -19,13 +19,33 @@
 #include "log.h"
 #include "space.h"
 #include "player.h"
+#include "array.h"
+
+
+/*
+ * pilot stuff
+ */
+extern Pilot** pilot_stack;
+extern int pilot_nstack;
 
 static double sensor_curRange    = 0.; /**< Current base sensor range, used to calculate
                                          what is in range and what isn't. */
 
+/* Visibility between pilots as of the last update. */
+static unsigned int *ew_visIds   = NULL; /**< Id of the pilot of each row (array.h). */
+static signed char *ew_vis       = NULL; /**< Result of pilot_inRangePilot() for each pair, by observer (array.h). */
+static Pilot **ew_visNear        = NULL; /**< Pilots near the observer (array.h). */
+static int ew_nvis               = 0; /**< Pilots in the cache. */
+
 #define EVASION_SCALE        1.3225 /**< 1.15 squared. Ensures that ships have higher evasion than hide. */
 #define SENSOR_DEFAULT_RANGE 7500   /**< The default sensor range for all ships. */
 
+
+/*
+ * Prototypes.
+ */
+static int pilot_ewSense( const Pilot *p, const Pilot *target );
+
 /**
  * @brief Updates the pilot's static electronic warfare properties.
  *
@@ -129,6 +149,76 @@ void pilot_updateSensorRange (void)
    /* Speeds up calculations as we compare it against vectors later on
     * and we want to avoid actually calculating the sqrt(). */
    sensor_curRange = pow2(sensor_curRange);
+
+   /* Ranges changed. */
+   ew_nvis = 0;
+}
+
+
+/**
+ * @brief Computes which pilots can see each other after they moved.
+ *
+ * Sensors are checked once per frame here instead of pair by pair on every
+ *  call to pilot_inRangePilot(). Observers only look at the pilots close
+ *  enough to be detected even with the lowest hide in the system.
+ */
+void pilot_updateVisibility (void)
+{
+   int i, j, n;
+   double hide, r;
+   Pilot *p;
+
+   if (ew_visIds == NULL) {
+      ew_visIds = array_create( unsigned int );
+      ew_vis    = array_create( signed char );
+   }
+
+   n = pilot_nstack;
+   array_resize( &ew_visIds, n );
+   array_resize( &ew_vis, n*n );
+   memset( ew_vis, 0, n*n * sizeof(signed char) );
+
+   hide = HUGE_VAL;
+   for (i=0; i<n; i++) {
+      p = pilot_stack[i];
+      p->ew_index  = i;
+      ew_visIds[i] = p->id;
+      hide = MIN( hide, p->ew_hide );
+   }
+
+   for (i=0; i<n; i++) {
+      p = pilot_stack[i];
+      r = sensor_curRange * p->ew_detect;
+
+      /* Nothing hides, everyone is in range. */
+      if (hide <= 0.) {
+         for (j=0; j<n; j++)
+            ew_vis[ i*n + j ] = pilot_ewSense( p, pilot_stack[j] );
+         continue;
+      }
+
+      pilots_inRange( &ew_visNear, p->solid->pos.x, p->solid->pos.y,
+            sqrt( MAX( 0., r / hide ) ) );
+      for (j=0; j<array_size(ew_visNear); j++)
+         ew_vis[ i*n + ew_visNear[j]->ew_index ] = pilot_ewSense( p, ew_visNear[j] );
+   }
+
+   ew_nvis = n;
+}
+
+
+/**
+ * @brief Frees the sensor visibility cache.
+ */
+void pilot_freeVisibility (void)
+{
+   array_free( ew_visIds );
+   array_free( ew_vis );
+   array_free( ew_visNear );
+   ew_visIds  = NULL;
+   ew_vis     = NULL;
+   ew_visNear = NULL;
+   ew_nvis    = 0;
 }
 
 
@@ -175,14 +265,34 @@ int pilot_inRange( const Pilot *p, double x, double y )
  */
 int pilot_inRangePilot( const Pilot *p, const Pilot *target )
 {
-   double d, sense;
-
    /* Special case player or omni-visible. */
    if ((pilot_isPlayer(p) && pilot_isFlag(target, PILOT_VISPLAYER)) ||
          pilot_isFlag(target, PILOT_VISIBLE) ||
          target->parent == p->id)
       return 1;
 
+   /* Use the cache if both pilots were there on the last update. */
+   if ((p->ew_index >= 0) && (p->ew_index < ew_nvis) &&
+         (ew_visIds[ p->ew_index ] == p->id) &&
+         (target->ew_index >= 0) && (target->ew_index < ew_nvis) &&
+         (ew_visIds[ target->ew_index ] == target->id))
+      return ew_vis[ p->ew_index*ew_nvis + target->ew_index ];
+
+   return pilot_ewSense( p, target );
+}
+
+
+/**
+ * @brief Checks to see if a pilot's sensors pick up another.
+ *
+ *    @param p Pilot who is trying to check to see if other is in sensor range.
+ *    @param target Target of p to check to see if is in sensor range.
+ *    @return 1 if they are in range, 0 if they aren't and -1 if they are detected fuzzily.
+ */
+static int pilot_ewSense( const Pilot *p, const Pilot *target )
+{
+   double d, sense;
+
    /* Get distance. */
    d = vect_dist2( &p->solid->pos, &target->solid->pos );
 
@@ -16,6 +16,8 @@
  */
 void pilot_updateSensorRange (void);
 double pilot_sensorRange( void );
+void pilot_updateVisibility (void);
+void pilot_freeVisibility (void);
 int pilot_inRange( const Pilot *p, double x, double y );
 int pilot_inRangePilot( const Pilot *p, const Pilot *target );
 int pilot_inRangePlanet( const Pilot *p, int target );
@@ -24,10 +24,24 @@
 #include "nstring.h"
 
 
+/**
+ * @brief Set to 1 to check incremental stats against a full recalculation on
+ *        every update (debug builds only, slow).
+ */
+#define PILOT_STATS_CHECK  0
+
+
 /*
  * Prototypes.
  */
 static int pilot_hasOutfitLimit( Pilot *p, const char *limit );
+static void pilot_calcStatsAdd( PilotStatsSum *sum, const Outfit *o, int on, int sign );
+static unsigned int pilot_calcStatsAffects( const Outfit *o, int on );
+static void pilot_calcStatsMass( Pilot* pilot );
+static void pilot_calcStatsMods( Pilot* pilot );
+#if DEBUGGING && PILOT_STATS_CHECK
+static void pilot_calcStatsCheck( Pilot *pilot );
+#endif /* DEBUGGING && PILOT_STATS_CHECK */
 
 
 /**
@@ -401,7 +415,7 @@ int pilot_addOutfit( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s )
    ret = pilot_addOutfitRaw( pilot, outfit, s );
 
    /* Recalculate the stats */
-   pilot_calcStats(pilot);
+   pilot_calcStatsUpdate(pilot);
 
    return ret;
 }
@@ -464,7 +478,7 @@ int pilot_rmOutfit( Pilot* pilot, PilotOutfitSlot *s )
    ret = pilot_rmOutfitRaw( pilot, s );
 
    /* recalculate the stats */
-   pilot_calcStats(pilot);
+   pilot_calcStatsUpdate(pilot);
 
    return ret;
 }
@@ -859,133 +873,258 @@ char* pilot_getOutfits( const Pilot* pilot )
 
 
 /**
- * @brief Recalculates the pilot's stats based on his outfits.
+ * @brief Adds or removes an outfit's contribution to the stat sums.
  *
- *    @param pilot Pilot to recalculate his stats.
+ *    @param sum Sums to update.
+ *    @param o Outfit to add or remove.
+ *    @param on Whether the active effects of the outfit apply.
+ *    @param sign 1 to add, -1 to remove.
  */
-void pilot_calcStats( Pilot* pilot )
+static void pilot_calcStatsAdd( PilotStatsSum *sum, const Outfit *o, int on, int sign )
 {
-   int i;
-   Outfit* o;
-   PilotOutfitSlot *slot;
-   double ac, sc, ec; /* temporary health coefficients to set */
-   ShipStats amount, *s, *default_s;
+   /* Always there. */
+   sum->cpu          += sign * outfit_cpu(o);
+   sum->mass_outfit  += sign * o->mass;
+   if (sp_required( o->slot.spid ))
+      sum->mass_core += sign * o->mass;
+
+   /* Active outfits must be on to affect stuff. */
+   if (!on)
+      return;
 
-   /*
-    * set up the basic stuff
-    */
-   /* mass */
-   pilot->solid->mass   = pilot->ship->mass;
-   pilot->base_mass     = pilot->solid->mass;
-   /* cpu */
-   pilot->cpu           = 0.;
-   /* movement */
-   pilot->thrust_base   = pilot->ship->thrust;
-   pilot->turn_base     = pilot->ship->turn;
-   pilot->speed_base    = pilot->ship->speed;
-   /* crew */
-   pilot->crew          = pilot->ship->crew;
-   /* cargo */
-   pilot->cap_cargo     = pilot->ship->cap_cargo;
-   /* fuel_consumption. */
-   pilot->fuel_consumption = pilot->ship->fuel_consumption;
-   /* health */
-   ac = (pilot->armour_max > 0.) ? pilot->armour / pilot->armour_max : 0.;
-   sc = (pilot->shield_max > 0.) ? pilot->shield / pilot->shield_max : 0.;
-   ec = (pilot->energy_max > 0.) ? pilot->energy / pilot->energy_max : 0.;
-   pilot->armour_max    = pilot->ship->armour;
-   pilot->shield_max    = pilot->ship->shield;
-   pilot->fuel_max      = pilot->ship->fuel;
-   pilot->armour_regen  = pilot->ship->armour_regen;
-   pilot->shield_regen  = pilot->ship->shield_regen;
-   /* Absorption. */
-   pilot->dmg_absorb    = pilot->ship->dmg_absorb;
-   /* Energy. */
-   pilot->energy_max    = pilot->ship->energy;
-   pilot->energy_regen  = pilot->ship->energy_regen;
-   pilot->energy_loss   = 0.; /* Initially no net loss. */
-   /* Stats. */
-   s = &pilot->stats;
-   *s = pilot->ship->stats_array;
-   memset( &amount, 0, sizeof(ShipStats) );
+   if (outfit_isMod(o)) { /* Modification */
+      /* Movement. */
+      sum->thrust       += sign * o->u.mod.thrust;
+      sum->turn         += sign * o->u.mod.turn;
+      sum->speed        += sign * o->u.mod.speed;
+      /* Health. */
+      sum->absorb       += sign * o->u.mod.absorb;
+      sum->armour       += sign * o->u.mod.armour;
+      sum->armour_regen += sign * o->u.mod.armour_regen;
+      sum->shield       += sign * o->u.mod.shield;
+      sum->shield_regen += sign * o->u.mod.shield_regen;
+      sum->energy       += sign * o->u.mod.energy;
+      sum->energy_regen += sign * o->u.mod.energy_regen;
+      sum->energy_loss  += sign * o->u.mod.energy_loss;
+      /* Fuel. */
+      sum->fuel         += sign * o->u.mod.fuel;
+      /* Misc. */
+      sum->cargo        += sign * o->u.mod.cargo;
+      sum->mass_rel     += sign * o->u.mod.mass_rel;
+      sum->crew_rel     += sign * o->u.mod.crew_rel;
+      /* Stats. */
+      ss_statsAccumulate( &sum->stats, &sum->amount, o->u.mod.stats, sign );
+   }
+   else if (outfit_isAfterburner(o)) /* Afterburner */
+      sum->energy_loss  += sign * o->u.afb.energy;
+   else if (outfit_isJammer(o)) { /* Jammer */
+      sum->jammers      += sign;
+      sum->energy_loss  += sign * o->u.jam.energy;
+   }
+}
 
-   /*
-    * Now add outfit changes
-    */
-   pilot->mass_outfit   = 0.;
-   pilot->jamming       = 0;
-   for (i=0; i<pilot->noutfits; i++) {
-      slot = pilot->outfits[i];
-      o    = slot->outfit;
 
-      /* Outfit must exist. */
-      if (o==NULL)
-         continue;
+/**
+ * @brief Gets what derived stats an outfit's contribution affects.
+ */
+static unsigned int pilot_calcStatsAffects( const Outfit *o, int on )
+{
+   if (on && (outfit_isMod(o) || outfit_isAfterburner(o) || outfit_isJammer(o)))
+      return PILOT_STATS_DIRTY_MODS | PILOT_STATS_DIRTY_MASS;
+   return PILOT_STATS_DIRTY_MASS;
+}
 
-      /* Modify CPU. */
-      pilot->cpu           += outfit_cpu(o);
 
-      /* Add mass. */
-      pilot->mass_outfit   += o->mass;
+/**
+ * @brief Brings a slot's contribution to the pilot's stat sums up to date.
+ *
+ * Only applies the difference between what was summed for the slot and what
+ *  it holds now. Derived stats are just flagged as dirty, use
+ *  pilot_calcStatsUpdate() to recalculate them.
+ *
+ *    @param pilot Pilot owning the slot.
+ *    @param s Slot to update.
+ */
+void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *s )
+{
+   Outfit *o;
+   int on;
 
-      /* Keep a separate counter for required (core) outfits. */
-      if (sp_required( o->slot.spid ))
-         pilot->base_mass += o->mass;
+   o  = s->outfit;
+   on = (o != NULL) && !(s->active && (s->state != PILOT_OUTFIT_ON));
+   if ((o == s->stats_outfit) && (on == s->stats_on))
+      return;
 
-      /* Add ammo mass. */
-      if (outfit_ammo(o) != NULL)
-         if (slot->u.ammo.outfit != NULL)
-            pilot->mass_outfit += slot->u.ammo.quantity * slot->u.ammo.outfit->mass;
+   /* Take out the old contribution. */
+   if (s->stats_outfit != NULL) {
+      pilot_calcStatsAdd( &pilot->stats_sum, s->stats_outfit, s->stats_on, -1 );
+      pilot->stats_dirty |= pilot_calcStatsAffects( s->stats_outfit, s->stats_on );
+   }
 
-      if (outfit_isAfterburner(o)) /* Afterburner */
-         pilot->afterburner = pilot->outfits[i]; /* Set afterburner */
+   /* Put in the new one. */
+   if (o != NULL) {
+      pilot_calcStatsAdd( &pilot->stats_sum, o, on, 1 );
+      pilot->stats_dirty |= pilot_calcStatsAffects( o, on );
 
-      /* Active outfits must be on to affect stuff. */
-      if (slot->active && !(slot->state==PILOT_OUTFIT_ON))
-         continue;
+      if (outfit_isAfterburner(o)) { /* Afterburner */
+         pilot->afterburner = s; /* Set afterburner */
+         if (on)
+            pilot_setFlag( pilot, PILOT_AFTERBURNER ); /* We use old school flags for this still... */
+      }
+   }
 
-      if (outfit_isMod(o)) { /* Modification */
-         /* Movement. */
-         pilot->thrust_base   += o->u.mod.thrust;
-         pilot->turn_base     += o->u.mod.turn;
-         pilot->speed_base    += o->u.mod.speed;
-         /* Health. */
-         pilot->dmg_absorb    += o->u.mod.absorb;
-         pilot->armour_max    += o->u.mod.armour;
-         pilot->armour_regen  += o->u.mod.armour_regen;
-         pilot->shield_max    += o->u.mod.shield;
-         pilot->shield_regen  += o->u.mod.shield_regen;
-         pilot->energy_max    += o->u.mod.energy;
-         pilot->energy_regen  += o->u.mod.energy_regen;
-         pilot->energy_loss   += o->u.mod.energy_loss;
-         /* Fuel. */
-         pilot->fuel_max      += o->u.mod.fuel;
-         /* Misc. */
-         pilot->cap_cargo     += o->u.mod.cargo;
-         pilot->mass_outfit   += o->u.mod.mass_rel * pilot->ship->mass;
-         pilot->crew          += o->u.mod.crew_rel * pilot->ship->crew;
-         /*
-          * Stats.
-          */
-         ss_statsModFromList( s, o->u.mod.stats, &amount );
+   s->stats_outfit   = o;
+   s->stats_on       = on;
+}
 
-      }
-      else if (outfit_isAfterburner(o)) { /* Afterburner */
-         pilot_setFlag( pilot, PILOT_AFTERBURNER ); /* We use old school flags for this still... */
-         pilot->energy_loss += pilot->afterburner->outfit->u.afb.energy; /* energy loss */
-      }
-      else if (outfit_isJammer(o)) { /* Jammer */
-         pilot->jamming        = 1;
-         pilot->energy_loss   += o->u.jam.energy;
-      }
+
+#if DEBUGGING && PILOT_STATS_CHECK
+/**
+ * @brief Checks the incremental stat sums against summing from scratch.
+ */
+static void pilot_calcStatsCheck( Pilot *pilot )
+{
+   int i, ss;
+   PilotStatsSum sum;
+   const PilotStatsSum *cur;
+   PilotOutfitSlot *s;
+
+   memset( &sum, 0, sizeof(PilotStatsSum) );
+   for (i=0; i<pilot->noutfits; i++) {
+      s = pilot->outfits[i];
+      if (s->outfit != NULL)
+         pilot_calcStatsAdd( &sum, s->outfit,
+               !(s->active && (s->state != PILOT_OUTFIT_ON)), 1 );
+   }
+
+#define CHECK(f) \
+   if (fabs(sum.f - cur->f) > 1e-6 * MAX( 1., fabs(sum.f) )) \
+      WARN(_("Pilot '%s': incremental stat '%s' is %f instead of %f"), \
+            pilot->name, #f, cur->f, sum.f )
+   cur = &pilot->stats_sum;
+   CHECK(cpu);
+   CHECK(mass_outfit);
+   CHECK(mass_core);
+   CHECK(mass_rel);
+   CHECK(thrust);
+   CHECK(turn);
+   CHECK(speed);
+   CHECK(absorb);
+   CHECK(armour);
+   CHECK(armour_regen);
+   CHECK(shield);
+   CHECK(shield_regen);
+   CHECK(energy);
+   CHECK(energy_regen);
+   CHECK(energy_loss);
+   CHECK(fuel);
+   CHECK(cargo);
+   CHECK(crew_rel);
+#undef CHECK
+   if (sum.jammers != cur->jammers)
+      WARN(_("Pilot '%s': incremental stat '%s' is %d instead of %d"),
+            pilot->name, "jammers", cur->jammers, sum.jammers );
+   ss = ss_statsCompare( &sum.stats, &cur->stats );
+   if (ss == 0)
+      ss = ss_statsCompare( &sum.amount, &cur->amount );
+   if (ss != 0)
+      WARN(_("Pilot '%s': incremental ship stat '%s' doesn't match full recalculation"),
+            pilot->name, ss_nameFromType( ss ) );
+}
+#endif /* DEBUGGING && PILOT_STATS_CHECK */
+
+
+/**
+ * @brief Recalculates the stats derived from mass and CPU.
+ *
+ *    @param pilot Pilot to recalculate.
+ */
+static void pilot_calcStatsMass( Pilot* pilot )
+{
+   int i;
+   PilotOutfitSlot *slot;
+   const PilotStatsSum *sum;
+
+   sum = &pilot->stats_sum;
+
+   /* CPU is negative, this just sets it so it's based off of cpu_max. */
+   pilot->cpu           = (int)sum->cpu + pilot->cpu_max;
+
+   /* Mass. */
+   pilot->base_mass     = pilot->ship->mass + sum->mass_core;
+   pilot->mass_outfit   = sum->mass_outfit + sum->mass_rel * pilot->ship->mass;
+   for (i=0; i<pilot->noutfits; i++) {
+      slot = pilot->outfits[i];
+      /* Add ammo mass. */
+      if ((slot->outfit != NULL) && (outfit_ammo(slot->outfit) != NULL) &&
+            (slot->u.ammo.outfit != NULL))
+         pilot->mass_outfit += slot->u.ammo.quantity * slot->u.ammo.outfit->mass;
    }
+   pilot->solid->mass   = pilot->stats.mass_mod*pilot->ship->mass +
+         pilot->stats.cargo_inertia*pilot->mass_cargo + pilot->mass_outfit;
 
    if (!pilot_isFlag( pilot, PILOT_AFTERBURNER ))
       pilot->solid->speed_max = pilot->speed;
 
-   /* Slot voodoo. */
+   /* Calculate the heat. */
+   pilot_heatCalc( pilot );
+
+   /* Modulate by mass. */
+   pilot_updateMass( pilot );
+}
+
+
+/**
+ * @brief Recalculates the stats derived from outfit modifications.
+ *
+ *    @param pilot Pilot to recalculate.
+ */
+static void pilot_calcStatsMods( Pilot* pilot )
+{
+   double ac, sc, ec; /* temporary health coefficients to set */
+   ShipStats *s, *default_s;
+   const ShipStats *amount;
+   const PilotStatsSum *sum;
+
+   sum = &pilot->stats_sum;
+
+   /* health */
+   ac = (pilot->armour_max > 0.) ? pilot->armour / pilot->armour_max : 0.;
+   sc = (pilot->shield_max > 0.) ? pilot->shield / pilot->shield_max : 0.;
+   ec = (pilot->energy_max > 0.) ? pilot->energy / pilot->energy_max : 0.;
+
+   /* movement */
+   pilot->thrust_base   = pilot->ship->thrust + sum->thrust;
+   pilot->turn_base     = pilot->ship->turn + sum->turn;
+   pilot->speed_base    = pilot->ship->speed + sum->speed;
+   /* crew */
+   pilot->crew          = pilot->ship->crew * (1. + sum->crew_rel);
+   /* cargo */
+   pilot->cap_cargo     = pilot->ship->cap_cargo + sum->cargo;
+   /* fuel_consumption. */
+   pilot->fuel_consumption = pilot->ship->fuel_consumption;
+   /* health */
+   pilot->armour_max    = pilot->ship->armour + sum->armour;
+   pilot->shield_max    = pilot->ship->shield + sum->shield;
+   pilot->fuel_max      = pilot->ship->fuel + sum->fuel;
+   pilot->armour_regen  = pilot->ship->armour_regen + sum->armour_regen;
+   pilot->shield_regen  = pilot->ship->shield_regen + sum->shield_regen;
+   /* Absorption. */
+   pilot->dmg_absorb    = pilot->ship->dmg_absorb + sum->absorb;
+   /* Energy. */
+   pilot->energy_max    = pilot->ship->energy + sum->energy;
+   pilot->energy_regen  = pilot->ship->energy_regen + sum->energy_regen;
+   pilot->energy_loss   = sum->energy_loss;
+   /* Jamming. */
+   pilot->jamming       = (sum->jammers > 0);
+
+   /* Stats. */
    s = &pilot->stats;
    default_s = &pilot->ship->stats_array;
+   ss_statsResolve( s, default_s, &sum->stats );
+   amount = &sum->amount;
+
+   /* Slot voodoo. */
 
    /* Fire rate:
     *  amount = p * exp( -0.15 * (n-1) )
@@ -994,19 +1133,19 @@ void pilot_calcStats( Pilot* pilot )
     *  3x 15% -> 33.33%
     *  6x 15% -> 42.51%
     */
-   if (amount.fwd_firerate > 0) {
-      s->fwd_firerate = default_s->fwd_firerate + (s->fwd_firerate-default_s->fwd_firerate) * exp( -0.15 * (double)(MAX(amount.fwd_firerate-1.,0)) );
+   if (amount->fwd_firerate > 0) {
+      s->fwd_firerate = default_s->fwd_firerate + (s->fwd_firerate-default_s->fwd_firerate) * exp( -0.15 * (double)(MAX(amount->fwd_firerate-1.,0)) );
    }
    /* Cruiser. */
-   if (amount.tur_firerate > 0) {
-      s->tur_firerate = default_s->tur_firerate + (s->tur_firerate-default_s->tur_firerate) * exp( -0.15 * (double)(MAX(amount.tur_firerate-1.,0)) );
+   if (amount->tur_firerate > 0) {
+      s->tur_firerate = default_s->tur_firerate + (s->tur_firerate-default_s->tur_firerate) * exp( -0.15 * (double)(MAX(amount->tur_firerate-1.,0)) );
    }
    /*
     * Electronic warfare setting base parameters.
     */
-   s->ew_hide           = default_s->ew_hide + (s->ew_hide-default_s->ew_hide)                      * exp( -0.2 * (double)(MAX(amount.ew_hide-1.,0)) );
-   s->ew_detect         = default_s->ew_detect + (s->ew_detect-default_s->ew_detect)                * exp( -0.2 * (double)(MAX(amount.ew_detect-1.,0)) );
-   s->ew_jump_detect    = default_s->ew_jump_detect + (s->ew_jump_detect-default_s->ew_jump_detect) * exp( -0.2 * (double)(MAX(amount.ew_jump_detect-1.,0)) );
+   s->ew_hide           = default_s->ew_hide + (s->ew_hide-default_s->ew_hide)                      * exp( -0.2 * (double)(MAX(amount->ew_hide-1.,0)) );
+   s->ew_detect         = default_s->ew_detect + (s->ew_detect-default_s->ew_detect)                * exp( -0.2 * (double)(MAX(amount->ew_detect-1.,0)) );
+   s->ew_jump_detect    = default_s->ew_jump_detect + (s->ew_jump_detect-default_s->ew_jump_detect) * exp( -0.2 * (double)(MAX(amount->ew_jump_detect-1.,0)) );
 
    /* Square the internal values to speed up comparisons. */
    pilot->ew_base_hide   = pow2( s->ew_hide );
@@ -1029,7 +1168,6 @@ void pilot_calcStats( Pilot* pilot )
    pilot->energy_regen *= s->energy_regen_mod;
    /* cpu */
    pilot->cpu_max       = (int)floor((float)(pilot->ship->cpu + s->cpu_max)*s->cpu_mod);
-   pilot->cpu          += pilot->cpu_max; /* CPU is negative, this just sets it so it's based off of cpu_max. */
    /* Misc. */
    pilot->dmg_absorb    = MAX( 0., pilot->dmg_absorb );
    pilot->crew         *= s->crew_mod;
@@ -1056,21 +1194,66 @@ void pilot_calcStats( Pilot* pilot )
 
    /* Cargo has to be reset. */
    pilot_cargoCalc(pilot);
+}
 
-   /* Calculate mass. */
-   pilot->solid->mass = s->mass_mod*pilot->ship->mass + pilot->stats.cargo_inertia*pilot->mass_cargo + pilot->mass_outfit;
 
-   /* Calculate the heat. */
-   pilot_heatCalc( pilot );
+/**
+ * @brief Updates the pilot's stats after changes to his outfits.
+ *
+ * Slots whose outfit or state changed have their contribution swapped in the
+ *  stat sums, and only the derived stats they affect are recalculated.
+ *
+ *    @param pilot Pilot to update.
+ */
+void pilot_calcStatsUpdate( Pilot* pilot )
+{
+   int i;
 
-   /* Modulate by mass. */
-   pilot_updateMass( pilot );
+   for (i=0; i<pilot->noutfits; i++)
+      pilot_calcStatsSlot( pilot, pilot->outfits[i] );
+
+   if (pilot->stats_dirty == 0)
+      return;
+
+#if DEBUGGING && PILOT_STATS_CHECK
+   pilot_calcStatsCheck( pilot );
+#endif /* DEBUGGING && PILOT_STATS_CHECK */
+
+   if (pilot->stats_dirty & PILOT_STATS_DIRTY_MODS)
+      pilot_calcStatsMods( pilot );
+   pilot_calcStatsMass( pilot );
+   pilot->stats_dirty = 0;
 
    /* Update GUI as necessary. */
    gui_setGeneric( pilot );
 }
 
 
+/**
+ * @brief Recalculates the pilot's stats based on his outfits.
+ *
+ * Sums the contributions of all the outfits from scratch, use
+ *  pilot_calcStatsUpdate() when only some outfits changed.
+ *
+ *    @param pilot Pilot to recalculate his stats.
+ */
+void pilot_calcStats( Pilot* pilot )
+{
+   int i;
+
+   /* Forget what was summed. */
+   memset( &pilot->stats_sum, 0, sizeof(PilotStatsSum) );
+   for (i=0; i<pilot->noutfits; i++) {
+      pilot->outfits[i]->stats_outfit = NULL;
+      pilot->outfits[i]->stats_on     = 0;
+   }
+
+   /* Everything has to be derived again. */
+   pilot->stats_dirty = PILOT_STATS_DIRTY_MODS | PILOT_STATS_DIRTY_MASS;
+   pilot_calcStatsUpdate( pilot );
+}
+
+
 /**
  * @brief Cures the pilot as if he was landed.
  */
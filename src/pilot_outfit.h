@@ -10,6 +10,11 @@
 #include "pilot.h"
 
 
+/* Derived stats needing recalculation (Pilot stats_dirty). */
+#define PILOT_STATS_DIRTY_MASS   (1<<0) /**< Mass, CPU, heat and speed. */
+#define PILOT_STATS_DIRTY_MODS   (1<<1) /**< Everything depending on outfit modifications. */
+
+
 /* Raw changes. */
 int pilot_addOutfitRaw( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s );
 int pilot_addOutfitTest( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s, int warn );
@@ -39,6 +44,8 @@ void pilot_lockClear( Pilot *p );
 /* Other. */
 char* pilot_getOutfits( const Pilot *pilot );
 void pilot_calcStats( Pilot *pilot );
+void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *s );
+void pilot_calcStatsUpdate( Pilot *pilot );
 void pilot_updateMass( Pilot *pilot );
 void pilot_healLanded( Pilot *pilot );
 
@@ -245,7 +245,7 @@ void pilot_weapSetPress( Pilot* p, int id, int type )
          }
          /* Must recalculate stats. */
          if (n > 0)
-            pilot_calcStats( p );
+            pilot_calcStatsUpdate( p );
 
          break;
    }
@@ -834,7 +834,7 @@ void pilot_shootStop( Pilot* p, int level )
 
    /* Must recalculate. */
    if (recalc)
-      pilot_calcStats( p );
+      pilot_calcStatsUpdate( p );
 }
 
 
@@ -1471,7 +1471,7 @@ void pilot_afterburn (Pilot *p)
       p->afterburner->state  = PILOT_OUTFIT_ON;
       p->afterburner->stimer = outfit_duration( p->afterburner->outfit );
       pilot_setFlag(p,PILOT_AFTERBURNER);
-      pilot_calcStats( p );
+      pilot_calcStatsUpdate( p );
 
       /* @todo Make this part of a more dynamic activated outfit sound system. */
       sound_playPos(p->afterburner->outfit->u.afb.sound_on,
@@ -1498,7 +1498,7 @@ void pilot_afterburnOver (Pilot *p)
    if (p->afterburner->state == PILOT_OUTFIT_ON) {
       p->afterburner->state  = PILOT_OUTFIT_OFF;
       pilot_rmFlag(p,PILOT_AFTERBURNER);
-      pilot_calcStats( p );
+      pilot_calcStatsUpdate( p );
 
       /* @todo Make this part of a more dynamic activated outfit sound system. */
       sound_playPos(p->afterburner->outfit->u.afb.sound_off,
@@ -2910,12 +2910,14 @@ int player_save( xmlTextWriterPtr writer )
 
    /* Current ship. */
    xmlw_elem(writer,"location","%s",land_planet->name);
-   player_saveShip( writer, player.p ); /* current ship */
+   if (player_saveShip( writer, player.p ) < 0) /* current ship */
+      return -1;
 
    /* Ships. */
    xmlw_startElem(writer,"ships");
    for (i=0; i<player_nstack; i++)
-      player_saveShip( writer, player_stack[i].p );
+      if (player_saveShip( writer, player_stack[i].p ) < 0)
+         return -1;
    xmlw_endElem(writer); /* "ships" */
 
    /* GUIs. */
@@ -2963,7 +2965,8 @@ int player_save( xmlTextWriterPtr writer )
 
    /* Escorts. */
    xmlw_startElem(writer, "escorts");
-   player_saveEscorts(writer);
+   if (player_saveEscorts(writer) < 0)
+      return -1;
    xmlw_endElem(writer); /* "escorts" */
 
    return 0;
@@ -3016,21 +3019,24 @@ static int player_saveShip( xmlTextWriterPtr writer, Pilot* ship )
    for (i=0; i<ship->outfit_nstructure; i++) {
       if (ship->outfit_structure[i].outfit==NULL)
          continue;
-      player_saveShipSlot( writer, &ship->outfit_structure[i], i );
+      if (player_saveShipSlot( writer, &ship->outfit_structure[i], i ) < 0)
+         return -1;
    }
    xmlw_endElem(writer); /* "outfits_structure" */
    xmlw_startElem(writer,"outfits_utility");
    for (i=0; i<ship->outfit_nutility; i++) {
       if (ship->outfit_utility[i].outfit==NULL)
          continue;
-      player_saveShipSlot( writer, &ship->outfit_utility[i], i );
+      if (player_saveShipSlot( writer, &ship->outfit_utility[i], i ) < 0)
+         return -1;
    }
    xmlw_endElem(writer); /* "outfits_utility" */
    xmlw_startElem(writer,"outfits_weapon");
    for (i=0; i<ship->outfit_nweapon; i++) {
       if (ship->outfit_weapon[i].outfit==NULL)
          continue;
-      player_saveShipSlot( writer, &ship->outfit_weapon[i], i );
+      if (player_saveShipSlot( writer, &ship->outfit_weapon[i], i ) < 0)
+         return -1;
    }
    xmlw_endElem(writer); /* "outfits_weapon" */
 
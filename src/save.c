@@ -13,6 +13,14 @@
 #include "naev.h"
 
 #include <errno.h> /* errno */
+#include <fcntl.h>
+#include <zlib.h>
+#if HAS_POSIX
+#include <unistd.h>
+#endif /* HAS_POSIX */
+#if HAS_WIN32
+#include <io.h>
+#endif /* HAS_WIN32 */
 
 #include "log.h"
 #include "nxml.h"
@@ -33,12 +41,30 @@
 #include "load.h"
 
 
+#ifndef O_BINARY
+#define O_BINARY  0 /**< Only needed on Windows. */
+#endif /* O_BINARY */
+
+
+/**
+ * @brief Savegame file being streamed to.
+ */
+typedef struct SaveFile_ {
+   int fd; /**< File descriptor, kept to sync the file to disk. */
+   gzFile gz; /**< Stream written to, compressed or not. */
+   int failed; /**< A write failed. */
+} SaveFile;
+
+
 int save_loaded   = 0; /**< Just loaded the savegame. */
 
 
 /*
  * prototypes
  */
+static int save_fileOpen( SaveFile *sf, const char *path );
+static int save_fileWrite( void *ctx, const char *buf, int len );
+static int save_fileClose( SaveFile *sf );
 /* externs */
 /* player.c */
 extern int player_save( xmlTextWriterPtr writer ); /**< Saves player related stuff. */
@@ -59,9 +85,47 @@ extern int space_sysSave( xmlTextWriterPtr writer ); /**< Saves the space stuff.
 /* unidiff.c */
 extern int diff_save( xmlTextWriterPtr writer ); /**< Saves the universe diffs. */
 /* static */
+static int save_header( xmlTextWriterPtr writer );
 static int save_data( xmlTextWriterPtr writer );
 
 
+/**
+ * @brief Saves the header with the information shown in the load menu.
+ *
+ * It goes right after the version so the load menu can stream it without
+ * having to parse the whole save.
+ *
+ *    @param writer XML writer to use.
+ *    @return 0 on success.
+ */
+static int save_header( xmlTextWriterPtr writer )
+{
+   int scu, stp, stu;
+   double rem;
+
+   xmlw_startElem(writer,"header");
+   xmlw_attr(writer,"name","%s",player.name);
+   xmlw_elem(writer,"location","%s",land_planet->name);
+   xmlw_elem(writer,"credits","%"CREDITS_PRI,player.p->credits);
+
+   xmlw_startElem(writer,"time");
+   ntime_getR( &scu, &stp, &stu, &rem );
+   xmlw_elem(writer,"SCU","%d", scu);
+   xmlw_elem(writer,"STP","%d", stp);
+   xmlw_elem(writer,"STU","%d", stu);
+   xmlw_endElem(writer); /* "time" */
+
+   xmlw_startElem(writer,"ship");
+   xmlw_attr(writer,"name","%s",player.p->name);
+   xmlw_attr(writer,"model","%s",player.p->ship->name);
+   xmlw_endElem(writer); /* "ship" */
+
+   xmlw_endElem(writer); /* "header" */
+
+   return 0;
+}
+
+
 /**
  * @brief Saves all the player's game data.
  *
@@ -86,27 +150,13 @@ static int save_data( xmlTextWriterPtr writer )
 
 
 /**
- * @brief Saves the current game.
+ * @brief Writes the whole savegame document to a writer.
  *
+ *    @param writer XML writer to use.
  *    @return 0 on success.
  */
-int save_all (void)
+static int save_write( xmlTextWriterPtr writer )
 {
-   char file[PATH_MAX];
-   xmlDocPtr doc;
-   xmlTextWriterPtr writer;
-
-   /* Do not save during tutorial. Or if saving is off. */
-   if (player_isTut() || player_isFlag(PLAYER_NOSAVE))
-      return 0;
-
-   /* Create the writer. */
-   writer = xmlNewTextWriterDoc(&doc, conf.save_compress);
-   if (writer == NULL) {
-      ERR(_("testXmlwriterDoc: Error creating the xml writer"));
-      return -1;
-   }
-
    /* Set the writer parameters. */
    xmlw_setParams( writer );
 
@@ -120,49 +170,165 @@ int save_all (void)
    xmlw_elem( writer, "data", "%s", ndata_name() );
    xmlw_endElem(writer); /* "version" */
 
-   /* Save the data. */
-   if (save_data(writer) < 0) {
-      ERR(_("Trying to save game data"));
-      goto err_writer;
+   /* Save the header and the data. */
+   if ((save_header(writer) < 0) || (save_data(writer) < 0)) {
+      WARN(_("Trying to save game data"));
+      return -1;
    }
 
    /* Finish element. */
    xmlw_endElem(writer); /* "naev_save" */
-   xmlw_done(writer);
 
-   /* Write to file. */
+   return 0;
+}
+
+
+/**
+ * @brief Opens a file to stream a savegame to.
+ *
+ *    @param[out] sf File to open.
+ *    @param path Path of the file, it is truncated if it exists.
+ *    @return 0 on success.
+ */
+static int save_fileOpen( SaveFile *sf, const char *path )
+{
+   int fd;
+
+   sf->failed = 0;
+   sf->fd     = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644 );
+   if (sf->fd < 0)
+      return -1;
+
+   /* The stream gets its own descriptor so ours stays open to sync once the
+    * stream is closed. */
+   fd = dup( sf->fd );
+   sf->gz = (fd < 0) ? NULL : gzdopen( fd, conf.save_compress ? "wb" : "wbT" );
+   if (sf->gz == NULL) {
+      if (fd >= 0)
+         close( fd );
+      close( sf->fd );
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Output callback for the savegame writer.
+ */
+static int save_fileWrite( void *ctx, const char *buf, int len )
+{
+   SaveFile *sf = (SaveFile*) ctx;
+
+   if ((len > 0) && (gzwrite( sf->gz, buf, len ) != len)) {
+      sf->failed = 1;
+      return -1;
+   }
+   return len;
+}
+
+
+/**
+ * @brief Finishes a savegame file and makes sure it's on the disk.
+ *
+ *    @param sf File to close.
+ *    @return 0 if everything written made it to the disk.
+ */
+static int save_fileClose( SaveFile *sf )
+{
+   int ret;
+
+   ret = sf->failed ? -1 : 0;
+   if (gzclose( sf->gz ) != Z_OK) /* Writes the end of the stream. */
+      ret = -1;
+#if HAS_WIN32
+   if (_commit( sf->fd ))
+#else /* HAS_WIN32 */
+   if (fsync( sf->fd ))
+#endif /* HAS_WIN32 */
+      ret = -1;
+   if (close( sf->fd ))
+      ret = -1;
+   return ret;
+}
+
+
+/**
+ * @brief Saves the current game.
+ *
+ *    @return 0 on success.
+ */
+int save_all (void)
+{
+   char file[PATH_MAX], tmpfile[PATH_MAX];
+   SaveFile sf;
+   xmlOutputBufferPtr out;
+   xmlTextWriterPtr writer;
+   int ret;
+
+   /* Do not save during tutorial. Or if saving is off. */
+   if (player_isTut() || player_isFlag(PLAYER_NOSAVE))
+      return 0;
+
+   /* Make sure the save directory exists. */
    if ((nfile_dirMakeExist("%s", nfile_dataPath()) < 0) ||
          (nfile_dirMakeExist("%ssaves", nfile_dataPath()) < 0)) {
       WARN(_("Failed to create save directory '%ssaves'."), nfile_dataPath());
-      goto err_writer;
+      return -1;
    }
    nsnprintf(file, PATH_MAX, "%ssaves/%s.ns", nfile_dataPath(), player.name);
+   nsnprintf(tmpfile, PATH_MAX, "%s.tmp", file);
 
    /* Back up old savegame. */
    if (!save_loaded) {
       if (nfile_backupIfExists(file) < 0) {
          WARN(_("Aborting save..."));
-         goto err_writer;
+         return -1;
       }
    }
    save_loaded = 0;
 
-   /* Critical section, if crashes here player's game gets corrupted.
-    * Luckily we have a copy just in case... */
-   xmlFreeTextWriter(writer);
-   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
-      WARN(_("Failed to write savegame!  You'll most likely have to restore it by copying your backup savegame over your current savegame."));
-      goto err;
+   /* Stream the savegame straight to a temporary file, so no document tree
+    * has to be built in memory. */
+   if (save_fileOpen( &sf, tmpfile ) < 0) {
+      WARN(_("Unable to open '%s' for writing!"), tmpfile);
+      return -1;
+   }
+   out    = xmlOutputBufferCreateIO( save_fileWrite, NULL, &sf, NULL );
+   writer = (out == NULL) ? NULL : xmlNewTextWriter( out );
+   if (writer == NULL) {
+      WARN(_("Unable to open '%s' for writing!"), tmpfile);
+      if (out != NULL)
+         xmlOutputBufferClose( out );
+      save_fileClose( &sf );
+      nfile_delete( tmpfile );
+      return -1;
+   }
+   ret = save_write( writer );
+   if ((ret == 0) && (xmlTextWriterEndDocument( writer ) < 0))
+      ret = -1;
+   if ((ret == 0) && (xmlTextWriterFlush( writer ) < 0))
+      ret = -1;
+   xmlFreeTextWriter( writer );
+
+   /* Any error (disk full, I/O error) while writing, closing or syncing
+    * means the temporary file can't be trusted. */
+   if (save_fileClose( &sf ) < 0)
+      ret = -1;
+   if (ret < 0) {
+      WARN(_("Failed to write savegame!"));
+      nfile_delete(tmpfile);
+      return -1;
    }
-   xmlFreeDoc(doc);
 
-   return 0;
+   /* Only replace the old savegame once the new one is complete, so a crash
+    * while saving never leaves a truncated savegame behind. */
+   if (nfile_rename(tmpfile, file) < 0) {
+      WARN(_("Failed to write savegame!  The new savegame was left at '%s'."), tmpfile);
+      return -1;
+   }
 
-err_writer:
-   xmlFreeTextWriter(writer);
-err:
-   xmlFreeDoc(doc);
-   return -1;
+   return 0;
 }
 
 /**
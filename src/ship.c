@@ -1018,7 +1018,8 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 int ships_load (void)
 {
    size_t bufsize, nfiles;
-   char *buf, **ship_files, *file;
+   const char *buf;
+   char **ship_files, *file;
    int i, sl;
    xmlNodePtr node;
    xmlDocPtr doc;
@@ -1040,11 +1041,11 @@ int ships_load (void)
       nsnprintf( file, sl, "%s%s", SHIP_DATA_PATH, ship_files[i] );
 
       /* Load the XML. */
-      buf  = ndata_read( file, &bufsize );
+      buf  = ndata_map( file, &bufsize );
       doc  = xmlParseMemory( buf, bufsize );
 
       if (doc == NULL) {
-         free(buf);
+         ndata_unmap(buf);
          WARN(_("%s file is invalid xml!"), file);
          free(file);
          continue;
@@ -1053,7 +1054,7 @@ int ships_load (void)
       node = doc->xmlChildrenNode; /* First ship node */
       if (node == NULL) {
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          WARN(_("Malformed %s file: does not contain elements"), file);
          free(file);
          continue;
@@ -1067,7 +1068,7 @@ int ships_load (void)
 
       /* Clean up. */
       xmlFreeDoc(doc);
-      free(buf);
+      ndata_unmap(buf);
    }
 
    /* Shrink stack. */
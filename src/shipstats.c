@@ -13,6 +13,8 @@
 
 #include "naev.h"
 
+#include <math.h>
+
 #include "log.h"
 #include "nstring.h"
 
@@ -336,6 +338,139 @@ int ss_statsModFromList( ShipStats *stats, const ShipStatList* list, const ShipS
 }
 
 
+/**
+ * @brief Accumulates a stat list into raw sums.
+ *
+ * Unlike ss_statsModFromList() values are not clamped and booleans are
+ *  counted, so a list added with sign 1 can later be taken out exactly with
+ *  sign -1. Use ss_statsResolve() to get the final stats.
+ *
+ *    @param sum Raw sums to update (start zeroed).
+ *    @param amount Counts of stats with a positive effect to update.
+ *    @param list List to accumulate.
+ *    @param sign 1 to add the list, -1 to remove it.
+ */
+void ss_statsAccumulate( ShipStats *sum, ShipStats *amount, const ShipStatList* list, int sign )
+{
+   char *ptr, *aptr;
+   const ShipStatList *ll;
+   const ShipStatsLookup *sl;
+
+   ptr  = (char*) sum;
+   aptr = (char*) amount;
+   for (ll = list; ll != NULL; ll = ll->next) {
+      sl = &ss_lookup[ ll->type ];
+      switch (sl->data) {
+         case SS_DATA_TYPE_DOUBLE:
+         case SS_DATA_TYPE_DOUBLE_ABSOLUTE:
+            *(double*) &ptr[ sl->offset ] += sign * ll->d.d;
+            if ((sl->inverted && (ll->d.d < 0.)) ||
+                  (!sl->inverted && (ll->d.d > 0.)))
+               *(double*) &aptr[ sl->offset ] += sign;
+            break;
+
+         case SS_DATA_TYPE_INTEGER:
+            *(int*) &ptr[ sl->offset ] += sign * ll->d.i;
+            if ((sl->inverted && (ll->d.i < 0)) ||
+                  (!sl->inverted && (ll->d.i > 0)))
+               *(int*) &aptr[ sl->offset ] += sign;
+            break;
+
+         case SS_DATA_TYPE_BOOLEAN:
+            *(int*) &ptr[ sl->offset ] += sign;
+            break;
+      }
+   }
+}
+
+
+/**
+ * @brief Gets final stats from base stats and raw sums.
+ *
+ *    @param[out] stats Stats to set.
+ *    @param base Base stats (usually the ship's).
+ *    @param sum Raw sums from ss_statsAccumulate().
+ */
+void ss_statsResolve( ShipStats *stats, const ShipStats *base, const ShipStats *sum )
+{
+   int i;
+   char *ptr;
+   const char *bptr, *sptr;
+   double *dbl;
+   const ShipStatsLookup *sl;
+
+   *stats = *base;
+   ptr    = (char*) stats;
+   bptr   = (const char*) base;
+   sptr   = (const char*) sum;
+   for (i=0; i<SS_TYPE_SENTINEL; i++) {
+      sl = &ss_lookup[ i ];
+      if (sl->name == NULL)
+         continue;
+
+      switch (sl->data) {
+         case SS_DATA_TYPE_DOUBLE:
+         case SS_DATA_TYPE_DOUBLE_ABSOLUTE:
+            dbl   = (double*) &ptr[ sl->offset ];
+            *dbl  = *(const double*) &bptr[ sl->offset ] +
+                  *(const double*) &sptr[ sl->offset ];
+            if ((sl->data==SS_DATA_TYPE_DOUBLE) && (*dbl < 0.)) /* Don't let the values go negative. */
+               *dbl = 0.;
+            break;
+
+         case SS_DATA_TYPE_INTEGER:
+            *(int*) &ptr[ sl->offset ] = *(const int*) &bptr[ sl->offset ] +
+                  *(const int*) &sptr[ sl->offset ];
+            break;
+
+         case SS_DATA_TYPE_BOOLEAN:
+            *(int*) &ptr[ sl->offset ] = *(const int*) &bptr[ sl->offset ] ||
+                  (*(const int*) &sptr[ sl->offset ] > 0);
+            break;
+      }
+   }
+}
+
+
+/**
+ * @brief Compares two sets of stats, allowing for rounding errors.
+ *
+ *    @return 0 if they match, otherwise the type of the first mismatch.
+ */
+int ss_statsCompare( const ShipStats *a, const ShipStats *b )
+{
+   int i;
+   double da, db;
+   const char *aptr, *bptr;
+   const ShipStatsLookup *sl;
+
+   aptr = (const char*) a;
+   bptr = (const char*) b;
+   for (i=0; i<SS_TYPE_SENTINEL; i++) {
+      sl = &ss_lookup[ i ];
+      if (sl->name == NULL)
+         continue;
+
+      switch (sl->data) {
+         case SS_DATA_TYPE_DOUBLE:
+         case SS_DATA_TYPE_DOUBLE_ABSOLUTE:
+            da = *(const double*) &aptr[ sl->offset ];
+            db = *(const double*) &bptr[ sl->offset ];
+            if (fabs(da-db) > 1e-6 * MAX( 1., MAX( fabs(da), fabs(db) ) ))
+               return i;
+            break;
+
+         case SS_DATA_TYPE_INTEGER:
+         case SS_DATA_TYPE_BOOLEAN:
+            if (*(const int*) &aptr[ sl->offset ] != *(const int*) &bptr[ sl->offset ])
+               return i;
+            break;
+      }
+   }
+   return 0;
+}
+
+
 /**
  * @brief Gets the name from type.
  *
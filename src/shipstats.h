@@ -233,6 +233,9 @@ void ss_free( ShipStatList *ll );
 int ss_statsInit( ShipStats *stats );
 int ss_statsModSingle( ShipStats *stats, const ShipStatList* list, const ShipStats *amount );
 int ss_statsModFromList( ShipStats *stats, const ShipStatList* list, const ShipStats *amount );
+void ss_statsAccumulate( ShipStats *sum, ShipStats *amount, const ShipStatList* list, int sign );
+void ss_statsResolve( ShipStats *stats, const ShipStats *base, const ShipStats *sum );
+int ss_statsCompare( const ShipStats *a, const ShipStats *b );
 
 /*
  * Lookup.
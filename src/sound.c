@@ -23,6 +23,7 @@
 #include "sound_openal.h"
 #include "sound_sdlmix.h"
 #include "log.h"
+#include "array.h"
 #include "nstring.h"
 #include "ndata.h"
 #include "music.h"
@@ -40,6 +41,18 @@
 #define voiceUnlock()      SDL_UnlockMutex(voice_mutex)
 
 
+/*
+ * Voice identifiers are made of a slot index and the generation of the slot,
+ * so a stale identifier never matches a voice that reused the slot.
+ */
+#define VOICE_SLOT_BITS    16 /**< Bits of the identifier used for the slot. */
+#define VOICE_SLOT_MASK    ((1<<VOICE_SLOT_BITS)-1) /**< Mask to get the slot. */
+#define VOICE_GEN_MASK     0x7FFF /**< Generations wrap so identifiers stay positive. */
+
+
+#define SOUND_MAX_INSTANCES   8 /**< Maximum number of voices playing the same sound. */
+
+
 /*
  * Global sound properties.
  */
@@ -57,10 +70,12 @@ static int sound_nlist        = 0; /**< Number of available sounds. */
 /*
  * Voices.
  */
-static int voice_genid        = 0; /**< Voice identifier generator. */
-alVoice *voice_active         = NULL; /**< Active voices. */
-static alVoice *voice_pool    = NULL; /**< Pool of free voices. */
+alVoice **voice_active        = NULL; /**< Active voices (array.h). */
+static alVoice **voice_slots  = NULL; /**< All the voices, indexed by slot (array.h). */
+static int *voice_free        = NULL; /**< Free slots (array.h). */
 static SDL_mutex *voice_mutex = NULL; /**< Lock for voices. */
+static int voice_nvirtual     = 0; /**< Virtual voices as of the last update. */
+static int voice_ncapped      = 0; /**< Voices refused for being over the instance cap. */
 
 
 /*
@@ -254,6 +269,11 @@ int sound_init (void)
    if (voice_mutex == NULL)
       WARN(_("Unable to create voice mutex."));
 
+   /* Create voice arrays. */
+   voice_active = array_create( alVoice* );
+   voice_slots  = array_create( alVoice* );
+   voice_free   = array_create( int );
+
    /* Load available sounds. */
    ret = sound_makeList();
    if (ret != 0)
@@ -292,7 +312,6 @@ int sound_init (void)
 void sound_exit (void)
 {
    int i;
-   alVoice *v;
 
    /* Nothing to disable. */
    if (sound_disabled || !sound_initialized)
@@ -304,16 +323,14 @@ void sound_exit (void)
    if (voice_mutex != NULL) {
       voiceLock();
       /* free the voices. */
-      while (voice_active != NULL) {
-         v = voice_active;
-         voice_active = v->next;
-         free(v);
-      }
-      while (voice_pool != NULL) {
-         v = voice_pool;
-         voice_pool = v->next;
-         free(v);
-      }
+      for (i=0; i<array_size(voice_slots); i++)
+         free( voice_slots[i] );
+      array_free( voice_slots );
+      array_free( voice_active );
+      array_free( voice_free );
+      voice_slots  = NULL;
+      voice_active = NULL;
+      voice_free   = NULL;
       voiceUnlock();
 
       /* Destroy voice lock. */
@@ -392,9 +409,16 @@ int sound_play( int sound )
 
    /* Gets a new voice. */
    v = voice_new();
+   if (v == NULL)
+      return -1;
 
    /* Get the sound. */
    s = &sound_list[sound];
+   if (s->ninstances >= SOUND_MAX_INSTANCES) {
+      voice_ncapped++;
+      return 0;
+   }
+   v->snd = s;
 
    /* Try to play the sound. */
    if (sound_sys_play( v, s ))
@@ -402,7 +426,6 @@ int sound_play( int sound )
 
    /* Set state and add to list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -451,9 +474,16 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 
    /* Gets a new voice. */
    v = voice_new();
+   if (v == NULL)
+      return -1;
 
    /* Get the sound. */
    s = &sound_list[sound];
+   if (s->ninstances >= SOUND_MAX_INSTANCES) {
+      voice_ncapped++;
+      return 0;
+   }
+   v->snd = s;
 
    /* Try to play the sound. */
    if (sound_sys_playPos( v, s, px, py, vx, vy ))
@@ -461,7 +491,6 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 
    /* Actually add the voice to the list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -471,6 +500,9 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 /**
  * @brief Updates the position of a voice.
  *
+ * The position is only stored, backends push it once per frame from
+ *  sound_update().
+ *
  *    @param voice Identifier of the voice to update.
  *    @param x New x position to update to.
  *    @param y New y position to update to.
@@ -501,7 +533,8 @@ int sound_updatePos( int voice, double px, double py, double vx, double vy )
  */
 int sound_update( double dt )
 {
-   alVoice *v, *tv;
+   int i, n;
+   alVoice *v;
 
    /* Update music if needed. */
    music_update(dt);
@@ -512,46 +545,38 @@ int sound_update( double dt )
    /* System update. */
    sound_sys_update();
 
-   if (voice_active == NULL)
+   voice_nvirtual = 0;
+   if (array_size(voice_active) == 0)
       return 0;
 
    voiceLock();
 
    /* The actual control loop. */
-   for (v=voice_active; v!=NULL; v=v->next) {
+   n = array_size(voice_active);
+   for (i=n-1; i>=0; i--) {
+      v = voice_active[i];
 
       /* Run first to clear in same iteration. */
       sound_sys_updateVoice( v );
 
       /* Destroy and toss into pool. */
       if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY)) {
+         v->snd->ninstances--;
+
+         /* Swap with the last active voice, order doesn't matter. */
+         n--;
+         voice_active[i] = voice_active[n];
+         voice_active[i]->active = i;
 
-         /* Remove from active list. */
-         tv = v->prev;
-         if (tv == NULL) {
-            voice_active = v->next;
-            if (voice_active != NULL)
-               voice_active->prev = NULL;
-         }
-         else {
-            tv->next = v->next;
-            if (tv->next != NULL)
-               tv->next->prev = tv;
-         }
-
-         /* Add to free pool. */
-         v->next = voice_pool;
-         v->prev = NULL;
-         voice_pool = v;
-         if (v->next != NULL)
-            v->next->prev = v;
-
-         /* Avoid loop blockage. */
-         v = (tv != NULL) ? tv->next : voice_active;
-         if (v == NULL)
-            break;
+         /* Invalidate the identifier and free the slot. */
+         v->id     = 0;
+         v->active = -1;
+         array_push_back( &voice_free, v->slot );
       }
+      else if (v->flags & VOICE_VIRTUAL)
+         voice_nvirtual++;
    }
+   array_resize( &voice_active, n );
 
    voiceUnlock();
 
@@ -559,6 +584,21 @@ int sound_update( double dt )
 }
 
 
+/**
+ * @brief Gets statistics about the voices.
+ *
+ *    @param[out] active Number of active voices, including virtual ones.
+ *    @param[out] virtual Number of voices that are not being mixed.
+ *    @param[out] capped Number of voices refused for being over the instance cap.
+ */
+void sound_stats( int *active, int *virtual, int *capped )
+{
+   *active  = (voice_active == NULL) ? 0 : array_size(voice_active);
+   *virtual = voice_nvirtual;
+   *capped  = voice_ncapped;
+}
+
+
 /**
  * @brief Pauses all the sounds.
  */
@@ -594,17 +634,19 @@ void sound_resume (void)
  */
 void sound_stopAll (void)
 {
+   int i;
    alVoice *v;
 
    if (sound_disabled)
       return;
 
    /* Make sure there are voices. */
-   if (voice_active==NULL)
+   if (array_size(voice_active) == 0)
       return;
 
    voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next) {
+   for (i=0; i<array_size(voice_active); i++) {
+      v = voice_active[i];
       sound_sys_stop( v );
       v->state = VOICE_STOPPED;
    }
@@ -821,6 +863,10 @@ static int sound_load( alSound *snd, const char *filename )
    if (sound_disabled)
       return -1;
 
+   /* Backends that can measure it will overwrite it. */
+   snd->loudness   = 1.;
+   snd->ninstances = 0;
+
    return sound_sys_load( snd, filename );
 }
 
@@ -988,21 +1034,35 @@ void voice_unlock (void)
 /**
  * @brief Gets a new voice ready to be used.
  *
+ * The voice stays free until it is added with voice_add(), so it can just be
+ *  dropped if the backend fails to play it.
+ *
  *    @return New voice ready to use.
  */
 alVoice* voice_new (void)
 {
    alVoice *v;
-
-   /* No free voices, allocate a new one. */
-   if (voice_pool == NULL) {
+   int slot;
+
+   /* No free slots, allocate a new one. */
+   if (array_size(voice_free) == 0) {
+      slot = array_size(voice_slots);
+      if (slot > VOICE_SLOT_MASK) {
+         WARN(_("Out of voice slots!"));
+         return NULL;
+      }
       v = calloc( 1, sizeof(alVoice) );
-      voice_pool = v;
-      return v;
+      v->slot   = slot;
+      v->active = -1;
+      voiceLock();
+      array_push_back( &voice_slots, v );
+      array_push_back( &voice_free, slot );
+      voiceUnlock();
    }
 
    /* First free voice. */
-   v = voice_pool; /* We do not touch the next nor prev, it's still in the pool. */
+   v = voice_slots[ array_back(voice_free) ];
+   v->flags = 0;
    return v;
 }
 
@@ -1010,34 +1070,27 @@ alVoice* voice_new (void)
 /**
  * @brief Adds a voice to the active voice stack.
  *
+ * This also gives the voice a new identifier.
+ *
  *    @param v Voice to add to the active voice stack.
  *    @return 0 on success.
  */
 int voice_add( alVoice* v )
 {
-   alVoice *tv;
-
-   /* Remove from pool. */
-   if (v->prev != NULL) {
-      tv = v->prev;
-      tv->next = v->next;
-      if (tv->next != NULL)
-         tv->next->prev = tv;
-   }
-   else { /* Set pool to be the next. */
-      voice_pool = v->next;
-      if (voice_pool != NULL)
-         voice_pool->prev = NULL;
-   }
-
-   /* Insert to the front of active voices. */
    voiceLock();
-   tv = voice_active;
-   v->next = tv;
-   v->prev = NULL;
-   voice_active = v;
-   if (tv != NULL)
-      tv->prev = v;
+
+   /* Remove from the free slots, always the last one by voice_new. */
+   array_resize( &voice_free, array_size(voice_free)-1 );
+
+   /* New generation for the slot. */
+   v->gen = (v->gen % VOICE_GEN_MASK) + 1;
+   v->id  = (v->gen << VOICE_SLOT_BITS) | v->slot;
+
+   /* Add to active voices. */
+   v->active = array_size(voice_active);
+   array_push_back( &voice_active, v );
+   v->snd->ninstances++;
+
    voiceUnlock();
    return 0;
 }
@@ -1046,23 +1099,27 @@ int voice_add( alVoice* v )
 /**
  * @brief Gets a voice by identifier.
  *
+ * Only the main thread adds and removes voices, so it can look them up without
+ *  taking the voice lock.
+ *
  *    @param id Identifier to look for.
  *    @return Voice matching identifier or NULL if not found.
  */
 alVoice* voice_get( int id )
 {
    alVoice *v;
+   int slot;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
+   if (id <= 0)
       return NULL;
 
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next)
-      if (v->id == id)
-         break;
-   voiceUnlock();
+   slot = id & VOICE_SLOT_MASK;
+   if (slot >= array_size(voice_slots))
+      return NULL;
+
+   v = voice_slots[slot];
+   if (v->id != id)
+      return NULL;
 
    return v;
 }
-
@@ -20,6 +20,7 @@
 #include "sound.h"
 #include "ndata.h"
 #include "log.h"
+#include "array.h"
 #include "conf.h"
 
 
@@ -57,6 +58,12 @@
 
 #define SOUND_FADEOUT         100
 
+#define SOUND_REFERENCE_DIST  500. /**< Distance under which sounds don't get louder. */
+#define SOUND_MAX_DIST        25000. /**< Distance over which sounds don't get quieter. */
+#define SOUND_PRIORITY_RELATIVE 2. /**< Priority weight of sounds not placed in space. */
+#define SOUND_PRIORITY_MIN    1e-4 /**< Priority under which voices are inaudible. */
+#define SOUND_PRIORITY_STEAL  1.5 /**< How much more important a voice must be to steal a source. */
+
 
 #define soundLock()     SDL_mutexP(sound_lock)
 #define soundUnlock()   SDL_mutexV(sound_lock)
@@ -77,6 +84,10 @@ static ALCdevice *al_device   = NULL; /**< OpenAL device. */
 static ALfloat svolume        = 1.; /**< Sound global volume (logarithmic). */
 static ALfloat svolume_lin    = 1.; /**< Sound global volume (linear). */
 static ALfloat svolume_speed  = 1.; /**< Sound global volume modulator for speed. */
+static ALfloat listener_pos[2] = { 0., 0. }; /**< Position of the listener. */
+static int sound_paused       = 0; /**< Whether voices are paused. */
+static double al_clock        = 0.; /**< Seconds of sound played while not paused. */
+static unsigned int al_clockTicks = 0; /**< Ticks al_clock was last updated at. */
 alInfo_t al_info; /**< OpenAL context info. */
 
 
@@ -137,9 +148,15 @@ static int al_enableEFX (void);
 /*
  * General.
  */
-static ALuint sound_al_getSource (void);
+static ALuint sound_al_getSource( double priority );
 static int al_playVoice( alVoice *v, alSound *s,
       ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative );
+static double al_voicePriority( alVoice *v );
+static double al_clockUpdate (void);
+static double al_voiceElapsed( alVoice *v );
+static void al_bindVoice( alVoice *v, double offset );
+static ALuint al_unbindVoice( alVoice *v );
+static double sound_al_loudness( const void *data, size_t len, int bytes, int is_signed );
 static int sound_al_loadWav( alSound *snd, SDL_RWops *rw );
 static int sound_al_loadOgg( alSound *snd, OggVorbis_File *vf );
 /*
@@ -316,8 +333,8 @@ int sound_al_init (void)
        *  inverse    2        500      1.000   0.333   0.052   0.026
        *  exponent   2        500      1.000   0.250   0.010   0.003
        */
-      alSourcef( s, AL_REFERENCE_DISTANCE, 500. ); /* Close distance to clamp at (doesn't get louder). */
-      alSourcef( s, AL_MAX_DISTANCE,       25000. ); /* Max distance to clamp at (doesn't get quieter). */
+      alSourcef( s, AL_REFERENCE_DISTANCE, SOUND_REFERENCE_DIST ); /* Close distance to clamp at (doesn't get louder). */
+      alSourcef( s, AL_MAX_DISTANCE,       SOUND_MAX_DIST ); /* Max distance to clamp at (doesn't get quieter). */
       alSourcef( s, AL_ROLLOFF_FACTOR,     1. ); /* Determines how it drops off. */
 
       /* Set the filter. */
@@ -579,6 +596,11 @@ static int sound_al_loadWav( alSound *snd, SDL_RWops *rw )
          return -1;
    }
 
+   /* Measure for voice priorities. */
+   snd->loudness = sound_al_loudness( wav_buffer, wav_length,
+         ((format==AL_FORMAT_MONO8) || (format==AL_FORMAT_STEREO8)) ? 1 : 2,
+         (wav_spec.format == AUDIO_S8) || (wav_spec.format == AUDIO_S16LSB) );
+
    /* Load into openal. */
    soundLock();
    /* Create new buffer. */
@@ -593,6 +615,41 @@ static int sound_al_loadWav( alSound *snd, SDL_RWops *rw )
 }
 
 
+/**
+ * @brief Measures how loud a sound buffer is.
+ *
+ *    @param data PCM data.
+ *    @param len Length of the data in bytes.
+ *    @param bytes Bytes per sample (1 or 2).
+ *    @param is_signed Whether the samples are signed.
+ *    @return RMS amplitude of the data in [0,1].
+ */
+static double sound_al_loudness( const void *data, size_t len, int bytes, int is_signed )
+{
+   size_t i, n;
+   const Uint8 *p8;
+   Sint16 s16;
+   double x, sum;
+
+   n = len / bytes;
+   if (n == 0)
+      return 0.;
+
+   p8  = data;
+   sum = 0.;
+   for (i=0; i<n; i++) {
+      if (bytes == 1)
+         x = (is_signed ? (double)(Sint8)p8[i] : (double)p8[i] - 128.) / 128.;
+      else {
+         memcpy( &s16, &p8[2*i], sizeof(s16) );
+         x = (is_signed ? (double)s16 : (double)(Uint16)s16 - 32768.) / 32768.;
+      }
+      sum += x*x;
+   }
+   return sqrt( sum / (double)n );
+}
+
+
 /**
  * @brief Gets the vorbisfile error in human readable form..
  */
@@ -652,6 +709,9 @@ static int sound_al_loadOgg( alSound *snd, OggVorbis_File *vf )
       i += ov_read( vf, &buf[i], len-i, VORBIS_ENDIAN, 2, 1, &section );
    }
 
+   /* Measure for voice priorities. */
+   snd->loudness = sound_al_loudness( buf, len, 2, 1 );
+
    soundLock();
    /* Create new buffer. */
    alGenBuffers( 1, &snd->u.al.buf );
@@ -807,54 +867,105 @@ double sound_al_getVolumeLog(void)
 
 /**
  * @brief Gets a free OpenAL source.
+ *
+ * When there are no free sources, the least important voice playing gets its
+ *  source taken away if it is much less important than the one asking.
+ *
+ *    @param priority Priority of the voice that wants the source.
+ *    @return The source or 0 if none is available.
  */
-static ALuint sound_al_getSource (void)
+static ALuint sound_al_getSource( double priority )
 {
+   int i;
    ALuint source;
+   alVoice *v, *worst;
 
-   /* Make sure there's enough. */
-   if (source_nstack <= 0)
+   /* Pull one off the stack. */
+   if (source_nstack > 0) {
+      source_nstack--;
+      source = source_stack[source_nstack];
+      return source;
+   }
+
+   /* Find the least important voice with a source. */
+   worst = NULL;
+   for (i=0; i<array_size(voice_active); i++) {
+      v = voice_active[i];
+      if ((v->u.al.source == 0) || (v->state != VOICE_PLAYING))
+         continue;
+      if ((worst == NULL) || (v->u.al.priority < worst->u.al.priority))
+         worst = v;
+   }
+   if ((worst == NULL) || (worst->u.al.priority * SOUND_PRIORITY_STEAL >= priority))
       return 0;
 
-   /* Pull one off the stack. */
-   source_nstack--;
-   source = source_stack[source_nstack];
+   /* Steal its source, it keeps on playing virtually. */
+   return al_unbindVoice( worst );
+}
 
-   return source;
+
+/**
+ * @brief Computes the priority of a voice.
+ *
+ * Uses the same distance attenuation as the sources, so it approximates how
+ *  loud the voice actually is.
+ */
+static double al_voicePriority( alVoice *v )
+{
+   double d, loudness;
+
+   loudness = (v->snd != NULL) ? v->snd->loudness : 1.;
+   if (v->u.al.relative)
+      return SOUND_PRIORITY_RELATIVE * loudness;
+
+   d = hypot( v->u.al.pos[0] - listener_pos[0], v->u.al.pos[1] - listener_pos[1] );
+   d = CLAMP( SOUND_REFERENCE_DIST, SOUND_MAX_DIST, d );
+   return loudness * SOUND_REFERENCE_DIST / d;
 }
 
 
 /**
- * @brief Plays a voice.
+ * @brief Advances the sound clock, which stands still while paused and runs
+ *        at the sound speed.
+ *
+ *    @return The current sound clock.
  */
-static int al_playVoice( alVoice *v, alSound *s,
-      ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative )
+static double al_clockUpdate (void)
 {
-   /* Must be below the limit. */
-   if (sound_speed > SOUND_SPEED_PLAY_LIMIT)
-      return 0;
+   unsigned int t;
 
-   /* Set up the source and buffer. */
-   v->u.al.source = sound_al_getSource();
-   if (v->u.al.source == 0)
-      return -1;
-   v->u.al.buffer = s->u.al.buf;
+   t = SDL_GetTicks();
+   if (!sound_paused)
+      al_clock += (double)(t - al_clockTicks) / 1000. * sound_speed;
+   al_clockTicks = t;
+   return al_clock;
+}
 
+
+/**
+ * @brief Gets how long a voice has been playing, in seconds of sound.
+ */
+static double al_voiceElapsed( alVoice *v )
+{
+   return al_clockUpdate() - v->u.al.start;
+}
+
+
+/**
+ * @brief Binds a voice to its source and starts playing.
+ *
+ *    @param v Voice with a source set.
+ *    @param offset Offset in seconds to start playing at.
+ */
+static void al_bindVoice( alVoice *v, double offset )
+{
    soundLock();
 
    /* Attach buffer. */
    alSourcei( v->u.al.source, AL_BUFFER, v->u.al.buffer );
 
    /* Enable positional sound. */
-   alSourcei( v->u.al.source, AL_SOURCE_RELATIVE, relative );
-
-   /* Update position. */
-   v->u.al.pos[0] = px;
-   v->u.al.pos[1] = py;
-   v->u.al.pos[2] = 0.;
-   v->u.al.vel[0] = vx;
-   v->u.al.vel[1] = vy;
-   v->u.al.vel[2] = 0.;
+   alSourcei( v->u.al.source, AL_SOURCE_RELATIVE, v->u.al.relative );
 
    /* Set up properties. */
    alSourcef(  v->u.al.source, AL_GAIN, svolume*svolume_speed );
@@ -864,6 +975,10 @@ static int al_playVoice( alVoice *v, alSound *s,
    /* Defaults just in case. */
    alSourcei( v->u.al.source, AL_LOOPING, AL_FALSE );
 
+   /* Resume where the virtual voice would be. */
+   if (offset > 0.)
+      alSourcef( v->u.al.source, AL_SEC_OFFSET, offset );
+
    /* Start playing. */
    alSourcePlay( v->u.al.source );
 
@@ -872,6 +987,71 @@ static int al_playVoice( alVoice *v, alSound *s,
 
    soundUnlock();
 
+   v->flags &= ~(VOICE_VIRTUAL | VOICE_MOVED);
+}
+
+
+/**
+ * @brief Takes the source away from a voice, making it virtual.
+ *
+ *    @param v Voice to unbind.
+ *    @return The source that was freed.
+ */
+static ALuint al_unbindVoice( alVoice *v )
+{
+   ALuint source;
+
+   source = v->u.al.source;
+
+   soundLock();
+   alSourceStop( source );
+   alSourcei( source, AL_BUFFER, AL_NONE );
+   al_checkErr();
+   soundUnlock();
+
+   v->u.al.source = 0;
+   v->flags      |= VOICE_VIRTUAL;
+   return source;
+}
+
+
+/**
+ * @brief Plays a voice.
+ *
+ * Voices that can't get a source are virtual, they keep track of time and
+ *  get a source later if they become important enough.
+ */
+static int al_playVoice( alVoice *v, alSound *s,
+      ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative )
+{
+   /* Must be below the limit. */
+   if (sound_speed > SOUND_SPEED_PLAY_LIMIT) {
+      v->u.al.source = 0;
+      return 0;
+   }
+
+   /* Set up the voice. */
+   v->u.al.buffer   = s->u.al.buf;
+   v->u.al.relative = relative;
+   v->u.al.start    = al_clockUpdate();
+   v->u.al.pos[0]   = px;
+   v->u.al.pos[1]   = py;
+   v->u.al.pos[2]   = 0.;
+   v->u.al.vel[0]   = vx;
+   v->u.al.vel[1]   = vy;
+   v->u.al.vel[2]   = 0.;
+   v->u.al.priority = al_voicePriority( v );
+
+   /* Get a source, inaudible voices don't even try. */
+   v->u.al.source = 0;
+   if (v->u.al.priority >= SOUND_PRIORITY_MIN)
+      v->u.al.source = sound_al_getSource( v->u.al.priority );
+   if (v->u.al.source == 0) {
+      v->flags |= VOICE_VIRTUAL;
+      return 0;
+   }
+
+   al_bindVoice( v, 0. );
    return 0;
 }
 
@@ -917,6 +1097,7 @@ int sound_al_updatePos( alVoice *v,
    v->u.al.pos[1] = py;
    v->u.al.vel[0] = vx;
    v->u.al.vel[1] = vy;
+   v->flags      |= VOICE_MOVED;
 
    return 0;
 }
@@ -930,6 +1111,25 @@ int sound_al_updatePos( alVoice *v,
 void sound_al_updateVoice( alVoice *v )
 {
    ALint state;
+   double t;
+
+   /* Virtual voice, see if it's done or can get a source again. */
+   if (v->flags & VOICE_VIRTUAL) {
+      if ((v->state != VOICE_PLAYING) || sound_paused)
+         return;
+      t = al_voiceElapsed( v );
+      if (t >= v->snd->length) {
+         v->state = VOICE_STOPPED;
+         return;
+      }
+      v->u.al.priority = al_voicePriority( v );
+      if (v->u.al.priority < SOUND_PRIORITY_MIN)
+         return;
+      v->u.al.source = sound_al_getSource( v->u.al.priority );
+      if (v->u.al.source != 0)
+         al_bindVoice( v, t );
+      return;
+   }
 
    /* Invalid source, mark to delete. */
    if (v->u.al.source == 0) {
@@ -961,15 +1161,25 @@ void sound_al_updateVoice( alVoice *v )
       return;
    }
 
-   /* Set up properties. */
+   /* Set up properties, position only if it was updated this frame. */
    alSourcef(  v->u.al.source, AL_GAIN, svolume*svolume_speed );
-   alSourcefv( v->u.al.source, AL_POSITION, v->u.al.pos );
-   alSourcefv( v->u.al.source, AL_VELOCITY, v->u.al.vel );
+   if (v->flags & VOICE_MOVED) {
+      alSourcefv( v->u.al.source, AL_POSITION, v->u.al.pos );
+      alSourcefv( v->u.al.source, AL_VELOCITY, v->u.al.vel );
+      v->flags &= ~VOICE_MOVED;
+   }
 
    /* Check for errors. */
    al_checkErr();
 
    soundUnlock();
+
+   /* Keep the priority current, inaudible voices give up their source. */
+   v->u.al.priority = al_voicePriority( v );
+   if (v->u.al.priority < SOUND_PRIORITY_MIN) {
+      source_stack[source_nstack] = al_unbindVoice( v );
+      source_nstack++;
+   }
 }
 
 
@@ -995,6 +1205,8 @@ void sound_al_stop( alVoice* voice )
  */
 void sound_al_pause (void)
 {
+   al_clockUpdate();
+   sound_paused = 1;
    soundLock();
    al_pausev( source_ntotal, source_total );
    /* Check for errors. */
@@ -1008,6 +1220,8 @@ void sound_al_pause (void)
  */
 void sound_al_resume (void)
 {
+   al_clockUpdate(); /* Skips the time spent paused. */
+   sound_paused = 0;
    soundLock();
    al_resumev( source_ntotal, source_total );
    /* Check for errors. */
@@ -1025,6 +1239,7 @@ void sound_al_setSpeed( double s )
    alGroup_t *g;
 
    soundLock();
+   al_clockUpdate(); /* Time so far runs at the old speed. */
    sound_speed = s; /* Set the speed. */
    /* Do all the groupless. */
    for (i=0; i<source_ntotal; i++)
@@ -1078,6 +1293,8 @@ int sound_al_updateListener( double dir, double px, double py,
    pos[1] = py;
    pos[2] = 0.;
    alListenerfv( AL_POSITION, pos );
+   listener_pos[0] = px;
+   listener_pos[1] = py;
    vel[0] = vx;
    vel[1] = vy;
    vel[2] = 0.;
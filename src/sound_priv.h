@@ -25,6 +25,8 @@
  */
 #define VOICE_LOOPING      (1<<10) /* voice loops */
 #define VOICE_STATIC       (1<<11) /* voice isn't relative */
+#define VOICE_MOVED        (1<<12) /* voice position changed since last update */
+#define VOICE_VIRTUAL      (1<<13) /* voice is tracked but not being mixed */
 
 
 #define MUSIC_FADEOUT_DELAY   1000 /**< Time it takes to fade out. */
@@ -39,6 +41,8 @@
 typedef struct alSound_ {
    char *name; /**< Buffer's name. */
    double length; /**< Length of the buffer. */
+   double loudness; /**< RMS amplitude of the buffer, in [0,1]. */
+   int ninstances; /**< Number of voices currently playing the sound. */
 
    /*
     * Backend specific.
@@ -79,13 +83,14 @@ typedef enum voice_state_ {
  * A voice would be any object that is creating sound.
  */
 typedef struct alVoice_ {
-   struct alVoice_ *prev; /**< Linked list previous member. */
-   struct alVoice_ *next; /**< Linked list next member. */
-
-   int id; /**< Identifier of the voice. */
+   int id; /**< Identifier of the voice, 0 when free. */
+   int slot; /**< Slot of the voice. */
+   int gen; /**< Generation of the slot, part of the identifier. */
+   int active; /**< Position in the active voices, -1 when free. */
 
    voice_state_t state; /**< Current state of the sound. */
    unsigned int flags; /**< Voice flags. */
+   alSound *snd; /**< Sound being played. */
 
    /*
     * Backend specific.
@@ -95,8 +100,11 @@ typedef struct alVoice_ {
       struct {
          ALfloat pos[3]; /**< Position of the voice. */
          ALfloat vel[3]; /**< Velocity of the voice. */
-         ALuint source; /**< Source current in use. */
+         ALuint source; /**< Source current in use, 0 if virtual. */
          ALuint buffer; /**< Buffer attached to the voice. */
+         ALint relative; /**< Whether the voice is relative to the listener. */
+         double priority; /**< Priority to get a source. */
+         double start; /**< Sound clock at which the voice started playing. */
       } al; /**< For OpenAL backend. */
 #endif /* USE_OPENAL */
 #if USE_SDLMIX
@@ -111,7 +119,7 @@ typedef struct alVoice_ {
 /*
  * Sound list.
  */
-extern alVoice *voice_active; /**< Active voices. */
+extern alVoice **voice_active; /**< Active voices (array.h). */
 
 
 /*
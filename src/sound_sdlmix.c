@@ -24,6 +24,7 @@
 
 #include "sound_priv.h"
 #include "log.h"
+#include "array.h"
 #include "ndata.h"
 #include "music.h"
 #include "physics.h"
@@ -698,14 +699,17 @@ void sound_mix_updateVoice( alVoice *v )
  */
 static void voice_mix_markStopped( int channel )
 {
+   int i;
    alVoice *v;
 
    voice_lock();
-   for (v=voice_active; v!=NULL; v=v->next)
+   for (i=0; i<array_size(voice_active); i++) {
+      v = voice_active[i];
       if (v->u.mix.channel == channel) {
          v->state = VOICE_STOPPED;
          break;
       }
+   }
    voice_unlock();
 }
 
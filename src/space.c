@@ -27,6 +27,7 @@
 #include "player.h"
 #include "pause.h"
 #include "weapon.h"
+#include "explosion.h"
 #include "toolkit.h"
 #include "spfx.h"
 #include "ntime.h"
@@ -52,6 +53,7 @@
 #include "damagetype.h"
 #include "hook.h"
 #include "dev_uniedit.h"
+#include "camera.h"
 
 
 #define XML_PLANET_TAG        "asset" /**< Individual planet xml tag. */
@@ -115,6 +117,8 @@ static int space_fchg = 0; /**< Faction change counter, to avoid unnecessary cal
 static int space_simulating = 0; /**< Are we simulating space? */
 glTexture **asteroid_gfx = NULL;
 static size_t nasterogfx = 0; /**< Nb of asteroid gfx. */
+static int asteroid_ndrawn = 0; /**< Asteroids drawn during the last frame. */
+static int asteroid_nculled = 0; /**< Asteroids skipped for being off the screen. */
 
 
 /*
@@ -1385,6 +1389,7 @@ void space_init( const char* sysname )
    ovr_mrkClear(); /* Clear markers when jumping. */
    pilots_clean(1); /* destroy non-persistant pilots */
    weapon_clear(); /* get rid of all the weapons */
+   expl_clear(); /* get rid of pending explosion damage */
    spfx_clear(); /* get rid of the explosions */
    gatherable_free(); /* get rid of gatherable stuff. */
    gatherable_free();
@@ -1639,7 +1644,8 @@ Planet *planet_new (void)
 static int planets_load ( void )
 {
    size_t bufsize;
-   char *buf, **planet_files, *file;
+   const char *buf;
+   char **planet_files, *file;
    xmlNodePtr node;
    xmlDocPtr doc;
    Planet *p;
@@ -1649,14 +1655,14 @@ static int planets_load ( void )
    /* Load landing stuff. */
    landing_env = nlua_newEnv(0);
    nlua_loadStandard(landing_env);
-   buf         = ndata_read( LANDING_DATA_PATH, &bufsize );
+   buf         = ndata_map( LANDING_DATA_PATH, &bufsize );
    if (nlua_dobufenv(landing_env, buf, bufsize, LANDING_DATA_PATH) != 0) {
       WARN( _("Failed to load landing file: %s\n"
             "%s\n"
             "Most likely Lua file has improper syntax, please check"),
             LANDING_DATA_PATH, lua_tostring(naevL,-1));
    }
-   free(buf);
+   ndata_unmap(buf);
 
    /* Initialize stack if needed. */
    if (planet_stack == NULL) {
@@ -1671,12 +1677,12 @@ static int planets_load ( void )
       len  = (strlen(PLANET_DATA_PATH)+strlen(planet_files[i])+2);
       file = malloc( len );
       nsnprintf( file, len,"%s%s",PLANET_DATA_PATH,planet_files[i]);
-      buf  = ndata_read( file, &bufsize );
+      buf  = ndata_map( file, &bufsize );
       doc  = xmlParseMemory( buf, bufsize );
       if (doc == NULL) {
          WARN(_("%s file is invalid xml!"),file);
          free(file);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -1685,7 +1691,7 @@ static int planets_load ( void )
          WARN(_("Malformed %s file: does not contain elements"),file);
          free(file);
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -1697,7 +1703,7 @@ static int planets_load ( void )
       /* Clean up. */
       free(file);
       xmlFreeDoc(doc);
-      free(buf);
+      ndata_unmap(buf);
    }
 
    /* Clean up. */
@@ -2625,6 +2631,7 @@ void system_setFaction( StarSystem *sys )
    /* Sort presences in descending order. */
    qsort( sys->presence, sys->npresence, sizeof(SystemPresence), sys_cmpSysFaction );
 
+   map_invalidate();
    sys->faction = -1;
    for (i=0; i<sys->npresence; i++) {
       for (j=0; j<sys->nplanets; j++) { /** @todo Handle multiple different factions. */
@@ -3351,7 +3358,8 @@ static int asteroidTypes_load (void)
 static int systems_load (void)
 {
    size_t bufsize;
-   char *buf, **system_files, *file;
+   const char *buf;
+   char **system_files, *file;
    xmlNodePtr node;
    xmlDocPtr doc;
    StarSystem *sys;
@@ -3376,11 +3384,11 @@ static int systems_load (void)
       file = malloc( len );
       nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
       /* Load the file. */
-      buf = ndata_read( file, &bufsize );
+      buf = ndata_map( file, &bufsize );
       doc = xmlParseMemory( buf, bufsize );
       if (doc == NULL) {
          WARN(_("%s file is invalid xml!"),file);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -3388,7 +3396,7 @@ static int systems_load (void)
       if (node == NULL) {
          WARN(_("Malformed %s file: does not contain elements"),file);
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -3398,7 +3406,7 @@ static int systems_load (void)
 
       /* Clean up. */
       xmlFreeDoc(doc);
-      free(buf);
+      ndata_unmap(buf);
       free( file );
    }
 
@@ -3411,18 +3419,18 @@ static int systems_load (void)
       file = malloc( len );
       nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
       /* Load the file. */
-      buf = ndata_read( file, &bufsize );
+      buf = ndata_map( file, &bufsize );
       free( file );
       doc = xmlParseMemory( buf, bufsize );
       if (doc == NULL) {
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
       node = doc->xmlChildrenNode; /* first planet node */
       if (node == NULL) {
          xmlFreeDoc(doc);
-         free(buf);
+         ndata_unmap(buf);
          continue;
       }
 
@@ -3430,7 +3438,7 @@ static int systems_load (void)
 
       /* Clean up. */
       xmlFreeDoc(doc);
-      free(buf);
+      ndata_unmap(buf);
    }
 
    DEBUG( ngettext( "Loaded %d Star System", "Loaded %d Star Systems", systems_nstack ), systems_nstack );
@@ -3506,11 +3514,17 @@ void space_renderOverlay( const double dt )
 void planets_render (void)
 {
    int i, j;
-   double x, y;
+   double x, y, r;
+   double x1, y1, x2, y2;
    AsteroidAnchor *ast;
+   Asteroid *a;
+   glTexture *gfx;
    Pilot *pplayer;
    Solid *psolid;
 
+   asteroid_ndrawn  = 0;
+   asteroid_nculled = 0;
+
    /* Must be a system. */
    if (cur_system==NULL)
       return;
@@ -3530,10 +3544,26 @@ void planets_render (void)
       psolid  = pplayer->solid;
 
    /* Render the asteroids & debris. */
+   cam_getBounds( &x1, &y1, &x2, &y2 );
    for (i=0; i < cur_system->nasteroids; i++) {
       ast = &cur_system->asteroids[i];
-      for (j=0; j < ast->nb; j++)
-        space_renderAsteroid( &ast->asteroids[j] );
+      for (j=0; j < ast->nb; j++) {
+         a = &ast->asteroids[j];
+
+         /* Skip the ones off the screen, scanned ones have labels around. */
+         if (!a->scanned) {
+            gfx = asteroid_types[a->type].gfxs[a->gfxID];
+            r   = MAX( gfx->sw, gfx->sh ) / 2.;
+            if ((a->pos.x + r < x1) || (a->pos.x - r > x2) ||
+                  (a->pos.y + r < y1) || (a->pos.y - r > y2)) {
+               asteroid_nculled++;
+               continue;
+            }
+         }
+
+         space_renderAsteroid( a );
+         asteroid_ndrawn++;
+      }
 
       if (pplayer != NULL) {
          x = psolid->pos.x - SCREEN_W/2;
@@ -3551,6 +3581,19 @@ void planets_render (void)
 }
 
 
+/**
+ * @brief Gets how many asteroids were drawn and culled in the last frame.
+ *
+ *    @param[out] drawn Asteroids drawn.
+ *    @param[out] culled Asteroids skipped for being off the screen.
+ */
+void space_renderStats( int *drawn, int *culled )
+{
+   *drawn  = asteroid_ndrawn;
+   *culled = asteroid_nculled;
+}
+
+
 /**
  * @brief Renders a jump point.
  */
@@ -3782,6 +3825,7 @@ void space_clearKnown (void)
 {
    int i, j;
    StarSystem *sys;
+   map_invalidate();
    for (i=0; i<systems_nstack; i++) {
       sys = &systems_stack[i];
       sys_rmFlag(sys,SYSTEM_KNOWN);
@@ -3799,6 +3843,7 @@ void space_clearKnown (void)
 void space_clearMarkers (void)
 {
    int i;
+   map_invalidate();
    for (i=0; i<systems_nstack; i++) {
       sys_rmFlag(&systems_stack[i], SYSTEM_MARKED);
       systems_stack[i].markers_computer = 0;
@@ -3815,6 +3860,7 @@ void space_clearMarkers (void)
 void space_clearComputerMarkers (void)
 {
    int i;
+   map_invalidate();
    for (i=0; i<systems_nstack; i++)
       sys_rmFlag(&systems_stack[i],SYSTEM_CMARKED);
 }
@@ -3836,6 +3882,7 @@ int space_addMarker( int sys, SysMarker type )
    ssys = system_getIndex(sys);
    if (ssys == NULL)
       return -1;
+   map_invalidate();
 
    /* Get the marker. */
    switch (type) {
@@ -3880,6 +3927,7 @@ int space_rmMarker( int sys, SysMarker type )
    ssys = system_getIndex(sys);
    if (ssys == NULL)
       return -1;
+   map_invalidate();
 
    /* Get the marker. */
    switch (type) {
@@ -371,6 +371,7 @@ int system_rmFleet( StarSystem *sys, Fleet *fleet );
 void space_render( const double dt );
 void space_renderOverlay( const double dt );
 void planets_render (void);
+void space_renderStats( int *drawn, int *culled );
 
 /*
  * Presence stuff.
@@ -0,0 +1,237 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file spatial.c
+ *
+ * @brief Spatial index for points, used to find objects near a position
+ *        without looking at all of them.
+ *
+ * Positions are put into square cells which are hashed into a fixed number
+ *  of buckets, so the index works for any system size. It is meant to be
+ *  cleared and filled again every frame, which only touches the buckets and
+ *  an array of entries.
+ *
+ * Queries return the ids of the entries inside the area, the caller has to
+ *  map them back to objects.
+ */
+
+
+#include "spatial.h"
+
+#include "naev.h"
+
+#include <math.h>
+#include "nstring.h"
+
+#include "array.h"
+
+
+#define SPATIAL_BUCKETS    1024 /**< Amount of buckets, must be a power of two. */
+
+
+/*
+ * Prototypes.
+ */
+static unsigned int spatial_hash( int cx, int cy );
+static int spatial_cell( const SpatialGrid *grid, double x );
+static int spatial_inside( const SpatialEntry *e,
+      double x1, double y1, double x2, double y2, double r2 );
+static int spatial_collect( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2, double r2 );
+
+
+/**
+ * @brief Hashes a cell into a bucket.
+ */
+static unsigned int spatial_hash( int cx, int cy )
+{
+   return ((unsigned int)cx * 73856093U ^ (unsigned int)cy * 19349663U) &
+         (SPATIAL_BUCKETS-1);
+}
+
+
+/**
+ * @brief Gets the cell coordinate of a position.
+ */
+static int spatial_cell( const SpatialGrid *grid, double x )
+{
+   return (int)floor( x / grid->cell );
+}
+
+
+/**
+ * @brief Initializes a spatial index.
+ *
+ *    @param grid Index to initialize.
+ *    @param cell Size of the cells, should be around the size of the usual
+ *           query.
+ */
+void spatial_init( SpatialGrid *grid, double cell )
+{
+   grid->cell    = cell;
+   grid->buckets = array_create( int );
+   grid->entries = array_create( SpatialEntry );
+   array_resize( &grid->buckets, SPATIAL_BUCKETS );
+   memset( grid->buckets, -1, SPATIAL_BUCKETS * sizeof(int) );
+}
+
+
+/**
+ * @brief Frees a spatial index.
+ *
+ *    @param grid Index to free.
+ */
+void spatial_free( SpatialGrid *grid )
+{
+   array_free( grid->buckets );
+   array_free( grid->entries );
+   grid->buckets = NULL;
+   grid->entries = NULL;
+}
+
+
+/**
+ * @brief Removes all the entries of a spatial index.
+ *
+ *    @param grid Index to clear.
+ */
+void spatial_clear( SpatialGrid *grid )
+{
+   if (array_size(grid->entries) == 0)
+      return;
+   array_resize( &grid->entries, 0 );
+   memset( grid->buckets, -1, SPATIAL_BUCKETS * sizeof(int) );
+}
+
+
+/**
+ * @brief Adds a point to a spatial index.
+ *
+ *    @param grid Index to add to.
+ *    @param id Identifier returned by queries.
+ *    @param x X position of the point.
+ *    @param y Y position of the point.
+ */
+void spatial_insert( SpatialGrid *grid, int id, double x, double y )
+{
+   SpatialEntry *e;
+   unsigned int h;
+
+   e     = &array_grow( &grid->entries );
+   e->id = id;
+   e->x  = x;
+   e->y  = y;
+   e->cx = spatial_cell( grid, x );
+   e->cy = spatial_cell( grid, y );
+
+   h     = spatial_hash( e->cx, e->cy );
+   e->next = grid->buckets[h];
+   grid->buckets[h] = array_size(grid->entries)-1;
+}
+
+
+/**
+ * @brief Checks to see if an entry is inside the area being queried.
+ */
+static int spatial_inside( const SpatialEntry *e,
+      double x1, double y1, double x2, double y2, double r2 )
+{
+   if ((e->x < x1) || (e->x > x2) || (e->y < y1) || (e->y > y2))
+      return 0;
+   /* Circle test, centre is the middle of the rectangle. */
+   if ((r2 >= 0.) &&
+         (pow2(e->x - (x1+x2)/2.) + pow2(e->y - (y1+y2)/2.) > r2))
+      return 0;
+   return 1;
+}
+
+
+/**
+ * @brief Gets the entries inside a rectangle and optionally a circle.
+ *
+ *    @param r2 Squared radius of the circle inscribed in the rectangle or
+ *           negative to only use the rectangle.
+ */
+static int spatial_collect( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2, double r2 )
+{
+   int i, cx, cy, cx1, cy1, cx2, cy2;
+   double ncells;
+   const SpatialEntry *e;
+
+   if (*ids == NULL)
+      *ids = array_create( int );
+   else
+      array_resize( ids, 0 );
+
+   if ((x2 < x1) || (y2 < y1))
+      return 0;
+
+   /* Big areas are faster to check entry by entry. */
+   ncells = (floor(x2/grid->cell) - floor(x1/grid->cell) + 1.) *
+         (floor(y2/grid->cell) - floor(y1/grid->cell) + 1.);
+   if (ncells > array_size(grid->entries)) {
+      for (i=0; i<array_size(grid->entries); i++) {
+         e = &grid->entries[i];
+         if (spatial_inside( e, x1, y1, x2, y2, r2 ))
+            array_push_back( ids, e->id );
+      }
+      return array_size(*ids);
+   }
+
+   cx1 = spatial_cell( grid, x1 );
+   cy1 = spatial_cell( grid, y1 );
+   cx2 = spatial_cell( grid, x2 );
+   cy2 = spatial_cell( grid, y2 );
+   for (cx=cx1; cx<=cx2; cx++) {
+      for (cy=cy1; cy<=cy2; cy++) {
+         for (i=grid->buckets[ spatial_hash(cx,cy) ]; i>=0; i=e->next) {
+            e = &grid->entries[i];
+            /* Other cells share the bucket. */
+            if ((e->cx != cx) || (e->cy != cy))
+               continue;
+            if (spatial_inside( e, x1, y1, x2, y2, r2 ))
+               array_push_back( ids, e->id );
+         }
+      }
+   }
+
+   return array_size(*ids);
+}
+
+
+/**
+ * @brief Gets the entries inside a rectangle.
+ *
+ *    @param grid Index to query.
+ *    @param[in,out] ids Array (array.h) to fill with the ids, created if NULL.
+ *    @param x1 Left of the rectangle.
+ *    @param y1 Bottom of the rectangle.
+ *    @param x2 Right of the rectangle.
+ *    @param y2 Top of the rectangle.
+ *    @return Number of ids found.
+ */
+int spatial_queryRect( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2 )
+{
+   return spatial_collect( grid, ids, x1, y1, x2, y2, -1. );
+}
+
+
+/**
+ * @brief Gets the entries inside a circle.
+ *
+ *    @param grid Index to query.
+ *    @param[in,out] ids Array (array.h) to fill with the ids, created if NULL.
+ *    @param x X position of the centre.
+ *    @param y Y position of the centre.
+ *    @param r Radius of the circle.
+ *    @return Number of ids found.
+ */
+int spatial_query( const SpatialGrid *grid, int **ids,
+      double x, double y, double r )
+{
+   return spatial_collect( grid, ids, x-r, y-r, x+r, y+r, pow2(r) );
+}
@@ -0,0 +1,55 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef SPATIAL_H
+#  define SPATIAL_H
+
+
+/**
+ * @brief An entry of the spatial index.
+ */
+typedef struct SpatialEntry_ {
+   int id; /**< Identifier given by the user of the index. */
+   int next; /**< Next entry in the same bucket or -1. */
+   int cx; /**< Cell X coordinate. */
+   int cy; /**< Cell Y coordinate. */
+   double x; /**< X position. */
+   double y; /**< Y position. */
+} SpatialEntry;
+
+
+/**
+ * @brief Uniform grid of points hashed into buckets, so it doesn't need the
+ *        bounds of the system.
+ */
+typedef struct SpatialGrid_ {
+   double cell; /**< Size of a cell. */
+   int *buckets; /**< First entry of each bucket or -1 (array.h). */
+   SpatialEntry *entries; /**< Entries in the index (array.h). */
+} SpatialGrid;
+
+
+/*
+ * Creation and destruction.
+ */
+void spatial_init( SpatialGrid *grid, double cell );
+void spatial_free( SpatialGrid *grid );
+
+/*
+ * Filling.
+ */
+void spatial_clear( SpatialGrid *grid );
+void spatial_insert( SpatialGrid *grid, int id, double x, double y );
+
+/*
+ * Queries.
+ */
+int spatial_queryRect( const SpatialGrid *grid, int **ids,
+      double x1, double y1, double x2, double y2 );
+int spatial_query( const SpatialGrid *grid, int **ids,
+      double x, double y, double r );
+
+
+#endif /* SPATIAL_H */
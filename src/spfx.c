@@ -30,6 +30,7 @@
 #include "nxml.h"
 #include "debris.h"
 #include "perlin.h"
+#include "camera.h"
 
 
 #define SPFX_XML_ID     "spfxs" /**< XML Document tag. */
@@ -37,8 +38,9 @@
 
 #define SPFX_GFX_SUF    ".png" /**< Suffix of graphics. */
 
-#define SPFX_CHUNK_MAX  16384 /**< Maximum chunk to alloc when needed */
 #define SPFX_CHUNK_MIN  256 /**< Minimum chunk to alloc when needed */
+#define SPFX_LAYER_MAX  16384 /**< Maximum number of effects in a layer. */
+#define SPFX_NLAYERS    2 /**< Number of layers. */
 
 #define SHAKE_MASS      (1./400.) /** Shake mass. */
 #define SHAKE_K         (1./50.) /**< Constant for virtual spring. */
@@ -89,28 +91,41 @@ static int spfx_neffects = 0; /**< Total number of special effects. */
 
 
 /**
- * @struct SPFX
+ * @struct SPFX_Layer
  *
- * @brief An actual in-game active special effect.
+ * @brief A layer of actual in-game active special effects.
+ *
+ * Effects are stored as a structure of arrays that is always kept packed,
+ *  dead effects get replaced by the last one. Layers grow up to
+ *  SPFX_LAYER_MAX effects, past that new effects are dropped.
  */
-typedef struct SPFX_ {
-   Vector2d pos; /**< Current position. */
-   Vector2d vel; /**< Current velocity. */
+typedef struct SPFX_Layer_ {
+   int n; /**< Number of active effects. */
+   int m; /**< Number of effects allocated. */
+
+   double *px; /**< Current X positions. */
+   double *py; /**< Current Y positions. */
+   double *vx; /**< Current X velocities. */
+   double *vy; /**< Current Y velocities. */
+   double *timer; /**< Time left. */
+   int *effect; /**< The real effects. */
+   int *lastframe; /**< Needed when paused. */
+} SPFX_Layer;
 
-   int lastframe; /**< Needed when paused */
-   int effect; /**< The real effect */
 
-   double timer; /**< Time left */
-} SPFX;
+/* front layer is for effects on player, back is for the rest */
+static SPFX_Layer spfx_layers[SPFX_NLAYERS]; /**< Special effect layers. */
 
 
-/* front stack is for effects on player, back is for the rest */
-static SPFX *spfx_stack_front = NULL; /**< Frontal special effect layer. */
-static int spfx_nstack_front = 0; /**< Number of special effects in front. */
-static int spfx_mstack_front = 0; /**< Memory allocated for frontal special effects. */
-static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
-static int spfx_nstack_back = 0; /**< Number of special effects in back. */
-static int spfx_mstack_back = 0; /**< Memory allocated for special effects in back. */
+/*
+ * Batched rendering.
+ */
+static gl_vbo *spfx_vbo       = NULL; /**< VBO with interleaved vertex and texture coordinates. */
+static GLfloat *spfx_vertex   = NULL; /**< Vertex data being built. */
+static int spfx_mvertex       = 0; /**< Quads allocated in the vertex data and VBO. */
+static int *spfx_offsets      = NULL; /**< First quad of each effect in the batch. */
+static int spfx_ndrawn        = 0; /**< Effects drawn during the last frame. */
+static int spfx_nculled       = 0; /**< Effects skipped for being off the screen. */
 
 
 /*
@@ -119,8 +134,9 @@ static int spfx_mstack_back = 0; /**< Memory allocated for special effects in ba
 /* General. */
 static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent );
 static void spfx_base_free( SPFX_Base *effect );
-static void spfx_destroy( SPFX *layer, int *nlayer, int spfx );
-static void spfx_update_layer( SPFX *layer, int *nlayer, const double dt );
+static int spfx_layerGrow( SPFX_Layer *l );
+static void spfx_layerFree( SPFX_Layer *l );
+static void spfx_update_layer( SPFX_Layer *l, const double dt );
 /* Haptic. */
 static int spfx_hapticInit (void);
 static void spfx_hapticRumble( double mod );
@@ -290,12 +306,18 @@ void spfx_free (void)
 
    /* get rid of all the particles and free the stacks */
    spfx_clear();
-   if (spfx_stack_front) free(spfx_stack_front);
-   spfx_stack_front = NULL;
-   spfx_mstack_front = 0;
-   if (spfx_stack_back) free(spfx_stack_back);
-   spfx_stack_back = NULL;
-   spfx_mstack_back = 0;
+   for (i=0; i<SPFX_NLAYERS; i++)
+      spfx_layerFree( &spfx_layers[i] );
+
+   /* Free the rendering data. */
+   if (spfx_vbo != NULL)
+      gl_vboDestroy( spfx_vbo );
+   spfx_vbo = NULL;
+   free( spfx_vertex );
+   spfx_vertex  = NULL;
+   spfx_mvertex = 0;
+   free( spfx_offsets );
+   spfx_offsets = NULL;
 
    /* now clear the effects */
    for (i=0; i<spfx_neffects; i++)
@@ -309,6 +331,47 @@ void spfx_free (void)
 }
 
 
+/**
+ * @brief Grows a layer.
+ *
+ *    @param l Layer to grow.
+ *    @return 0 on success, -1 if it's already full.
+ */
+static int spfx_layerGrow( SPFX_Layer *l )
+{
+   if (l->m >= SPFX_LAYER_MAX)
+      return -1;
+
+   l->m = (l->m == 0) ? SPFX_CHUNK_MIN : MIN( 2*l->m, SPFX_LAYER_MAX );
+   l->px        = realloc( l->px,        l->m*sizeof(double) );
+   l->py        = realloc( l->py,        l->m*sizeof(double) );
+   l->vx        = realloc( l->vx,        l->m*sizeof(double) );
+   l->vy        = realloc( l->vy,        l->m*sizeof(double) );
+   l->timer     = realloc( l->timer,     l->m*sizeof(double) );
+   l->effect    = realloc( l->effect,    l->m*sizeof(int) );
+   l->lastframe = realloc( l->lastframe, l->m*sizeof(int) );
+   return 0;
+}
+
+
+/**
+ * @brief Frees a layer.
+ *
+ *    @param l Layer to free.
+ */
+static void spfx_layerFree( SPFX_Layer *l )
+{
+   free( l->px );
+   free( l->py );
+   free( l->vx );
+   free( l->vy );
+   free( l->timer );
+   free( l->effect );
+   free( l->lastframe );
+   memset( l, 0, sizeof(SPFX_Layer) );
+}
+
+
 /**
  * @brief Creates a new special effect.
  *
@@ -324,10 +387,11 @@ void spfx_add( int effect,
       const double vx, const double vy,
       const int layer )
 {
-   SPFX *cur_spfx;
+   SPFX_Layer *l;
    double ttl, anim;
+   int i;
 
-   if ((effect < 0) || (effect > spfx_neffects)) {
+   if ((effect < 0) || (effect >= spfx_neffects)) {
       WARN(_("Trying to add spfx with invalid effect!"));
       return;
    }
@@ -335,44 +399,29 @@ void spfx_add( int effect,
    /*
     * Select the Layer
     */
-   if (layer == SPFX_LAYER_FRONT) { /* front layer */
-      if (spfx_mstack_front < spfx_nstack_front+1) { /* need more memory */
-         if (spfx_mstack_front == 0)
-            spfx_mstack_front = SPFX_CHUNK_MIN;
-         else
-            spfx_mstack_front += MIN( spfx_mstack_front, SPFX_CHUNK_MAX );
-         spfx_stack_front = realloc( spfx_stack_front, spfx_mstack_front*sizeof(SPFX) );
-      }
-      cur_spfx = &spfx_stack_front[spfx_nstack_front];
-      spfx_nstack_front++;
-   }
-   else if (layer == SPFX_LAYER_BACK) { /* back layer */
-      if (spfx_mstack_back < spfx_nstack_back+1) { /* need more memory */
-         if (spfx_mstack_back == 0)
-            spfx_mstack_back = SPFX_CHUNK_MIN;
-         else
-            spfx_mstack_back += MIN( spfx_mstack_back, SPFX_CHUNK_MAX );
-         spfx_stack_back = realloc( spfx_stack_back, spfx_mstack_back*sizeof(SPFX) );
-      }
-      cur_spfx = &spfx_stack_back[spfx_nstack_back];
-      spfx_nstack_back++;
-   }
-   else {
+   if ((layer != SPFX_LAYER_FRONT) && (layer != SPFX_LAYER_BACK)) {
       WARN(_("Invalid SPFX layer."));
       return;
    }
+   l = &spfx_layers[layer];
+   if ((l->n >= l->m) && (spfx_layerGrow( l ) < 0))
+      return; /* Layer is full, not worth slowing down for. */
+   i = l->n++;
 
    /* The actual adding of the spfx */
-   cur_spfx->effect = effect;
-   vect_csetmin( &cur_spfx->pos, px, py );
-   vect_csetmin( &cur_spfx->vel, vx, vy );
+   l->effect[i]    = effect;
+   l->px[i]        = px;
+   l->py[i]        = py;
+   l->vx[i]        = vx;
+   l->vy[i]        = vy;
+   l->lastframe[i] = 0;
    /* Timer magic if ttl != anim */
    ttl = spfx_effects[effect].ttl;
    anim = spfx_effects[effect].anim;
    if (ttl != anim)
-      cur_spfx->timer = ttl + RNGF()*anim;
+      l->timer[i] = ttl + RNGF()*anim;
    else
-      cur_spfx->timer = ttl;
+      l->timer[i] = ttl;
 }
 
 
@@ -383,13 +432,9 @@ void spfx_clear (void)
 {
    int i;
 
-   /* Clear front layer */
-   for (i=spfx_nstack_front-1; i>=0; i--)
-      spfx_destroy( spfx_stack_front, &spfx_nstack_front, i );
-
-   /* Clear back layer */
-   for (i=spfx_nstack_back-1; i>=0; i--)
-      spfx_destroy( spfx_stack_back, &spfx_nstack_back, i );
+   /* Clear the layers. */
+   for (i=0; i<SPFX_NLAYERS; i++)
+      spfx_layers[i].n = 0;
 
    /* Clear rumble */
    shake_set = 0;
@@ -399,19 +444,6 @@ void spfx_clear (void)
    vectnull( &shake_vel );
 }
 
-/**
- * @brief Destroys an active spfx.
- *
- *    @param layer Layer the spfx is on.
- *    @param nlayer Pointer to the number of elements in the layer.
- *    @param spfx Position of the spfx in the stack.
- */
-static void spfx_destroy( SPFX *layer, int *nlayer, int spfx )
-{
-   (*nlayer)--;
-   memmove( &layer[spfx], &layer[spfx+1], (*nlayer-spfx)*sizeof(SPFX) );
-}
-
 
 /**
  * @brief Updates all the spfx.
@@ -420,35 +452,45 @@ static void spfx_destroy( SPFX *layer, int *nlayer, int spfx )
  */
 void spfx_update( const double dt )
 {
-   spfx_update_layer( spfx_stack_front, &spfx_nstack_front, dt );
-   spfx_update_layer( spfx_stack_back, &spfx_nstack_back, dt );
+   int i;
+   for (i=0; i<SPFX_NLAYERS; i++)
+      spfx_update_layer( &spfx_layers[i], dt );
 }
 
 
 /**
- * @brief Updates an individual spfx.
+ * @brief Updates an individual spfx layer.
  *
- *    @param layer Layer the spfx is on.
- *    @param nlayer Pointer to the associated nlayer.
+ *    @param l Layer to update.
  *    @param dt Current delta tick.
  */
-static void spfx_update_layer( SPFX *layer, int *nlayer, const double dt )
+static void spfx_update_layer( SPFX_Layer *l, const double dt )
 {
-   int i;
-
-   for (i=0; i<*nlayer; i++) {
-      layer[i].timer -= dt; /* less time to live */
-
-      /* time to die! */
-      if (layer[i].timer < 0.) {
-         spfx_destroy( layer, nlayer, i );
-         i--;
+   int i, n;
+
+   /* Straight passes over the arrays so the compiler can vectorize them. */
+   n = l->n;
+   for (i=0; i<n; i++)
+      l->timer[i] -= dt; /* less time to live */
+   for (i=0; i<n; i++)
+      l->px[i] += dt*l->vx[i];
+   for (i=0; i<n; i++)
+      l->py[i] += dt*l->vy[i];
+
+   /* time to die! replace with the last one */
+   for (i=n-1; i>=0; i--) {
+      if (l->timer[i] >= 0.)
          continue;
-      }
-
-      /* actually update it */
-      vect_cadd( &layer[i].pos, dt*VX(layer[i].vel), dt*VY(layer[i].vel) );
+      n--;
+      l->px[i]        = l->px[n];
+      l->py[i]        = l->py[n];
+      l->vx[i]        = l->vx[n];
+      l->vy[i]        = l->vy[n];
+      l->timer[i]     = l->timer[n];
+      l->effect[i]    = l->effect[n];
+      l->lastframe[i] = l->lastframe[n];
    }
+   l->n = n;
 }
 
 
@@ -702,53 +744,132 @@ void spfx_cinematic (void)
 /**
  * @brief Renders the entire spfx layer.
  *
+ * All the effects of the layer are put in a single VBO grouped by effect, so
+ *  there's only one draw call per type of effect.
+ *
  *    @param layer Layer to render.
  */
 void spfx_render( const int layer )
 {
-   SPFX *spfx_stack;
-   int i, spfx_nstack;
+   SPFX_Layer *l;
    SPFX_Base *effect;
-   int sx, sy;
-   double time;
-
+   glTexture *gfx;
+   int i, k, n, sx, sy;
+   int *start, *end;
+   double time, z, x, y, w, h, tx, ty, tw, th;
+   GLfloat *v;
 
    /* get the appropriate layer */
-   switch (layer) {
-      case SPFX_LAYER_FRONT:
-         spfx_stack = spfx_stack_front;
-         spfx_nstack = spfx_nstack_front;
-         break;
-
-      case SPFX_LAYER_BACK:
-         spfx_stack = spfx_stack_back;
-         spfx_nstack = spfx_nstack_back;
-         break;
-
-      default:
-         WARN(_("Rendering invalid SPFX layer."));
-         return;
+   if ((layer != SPFX_LAYER_FRONT) && (layer != SPFX_LAYER_BACK)) {
+      WARN(_("Rendering invalid SPFX layer."));
+      return;
    }
+   l = &spfx_layers[layer];
 
-   /* Now render the layer */
-   for (i=spfx_nstack-1; i>=0; i--) {
-      effect = &spfx_effects[ spfx_stack[i].effect ];
-
-      /* Simplifies */
-      sx = (int)effect->gfx->sx;
-      sy = (int)effect->gfx->sy;
+   /* Back layer is rendered first, start counting the frame. */
+   if (layer == SPFX_LAYER_BACK) {
+      spfx_ndrawn  = 0;
+      spfx_nculled = 0;
+   }
+   if (l->n == 0)
+      return;
 
+   /* Make sure there's room for all of them. */
+   if (spfx_mvertex < l->n) {
+      spfx_mvertex = l->m;
+      spfx_vertex  = realloc( spfx_vertex, sizeof(GLfloat) * 6*4 * spfx_mvertex );
+      if (spfx_vbo == NULL)
+         spfx_vbo = gl_vboCreateStream( sizeof(GLfloat) * 6*4 * spfx_mvertex, NULL );
+      else
+         gl_vboData( spfx_vbo, sizeof(GLfloat) * 6*4 * spfx_mvertex, NULL );
+   }
+   if (spfx_offsets == NULL)
+      spfx_offsets = malloc( sizeof(int) * 2*spfx_neffects );
+   start = spfx_offsets;
+   end   = &spfx_offsets[ spfx_neffects ];
+
+   /* Update the frames and count the effects of each type. */
+   memset( end, 0, sizeof(int) * spfx_neffects );
+   for (i=0; i<l->n; i++) {
+      effect = &spfx_effects[ l->effect[i] ];
       if (!paused) { /* don't calculate frame if paused */
-         time = 1. - fmod(spfx_stack[i].timer,effect->anim) / effect->anim;
-         spfx_stack[i].lastframe = sx * sy * MIN(time, 1.);
+         sx = (int)effect->gfx->sx;
+         sy = (int)effect->gfx->sy;
+         time = 1. - fmod(l->timer[i],effect->anim) / effect->anim;
+         l->lastframe[i] = sx * sy * MIN(time, 1.);
       }
+      end[ l->effect[i] ]++;
+   }
+   n = 0;
+   for (i=0; i<spfx_neffects; i++) {
+      start[i] = n;
+      n       += end[i];
+      end[i]   = start[i];
+   }
 
-      /* Renders */
-      gl_blitSprite( effect->gfx,
-            VX(spfx_stack[i].pos), VY(spfx_stack[i].pos),
-            spfx_stack[i].lastframe % sx,
-            spfx_stack[i].lastframe / sx,
-            NULL );
+   /* Build the quads, skipping the ones off screen. */
+   z = cam_getZoom();
+   for (i=0; i<l->n; i++) {
+      gfx = spfx_effects[ l->effect[i] ].gfx;
+      gl_gameToScreenCoords( &x, &y, l->px[i] - gfx->sw/2., l->py[i] - gfx->sh/2. );
+      w = gfx->sw*z;
+      h = gfx->sh*z;
+      if ((x < -w) || (x > SCREEN_W+w) || (y < -h) || (y > SCREEN_H+h)) {
+         spfx_nculled++;
+         continue;
+      }
+      spfx_ndrawn++;
+
+      /* Texture coordinates of the frame. */
+      sx = (int)gfx->sx;
+      tx = gfx->sw*(double)(l->lastframe[i] % sx)/gfx->rw;
+      ty = gfx->sh*(gfx->sy-(double)(l->lastframe[i] / sx)-1)/gfx->rh;
+      tw = gfx->srw;
+      th = gfx->srh;
+
+      /* Two triangles, interleaved as x, y, s, t. */
+      k = end[ l->effect[i] ]++;
+      v = &spfx_vertex[ k*6*4 ];
+      v[0]  = x;     v[1]  = y;     v[2]  = tx;    v[3]  = ty;
+      v[4]  = x+w;   v[5]  = y;     v[6]  = tx+tw; v[7]  = ty;
+      v[8]  = x;     v[9]  = y+h;   v[10] = tx;    v[11] = ty+th;
+      v[12] = x+w;   v[13] = y;     v[14] = tx+tw; v[15] = ty;
+      v[16] = x+w;   v[17] = y+h;   v[18] = tx+tw; v[19] = ty+th;
+      v[20] = x;     v[21] = y+h;   v[22] = tx;    v[23] = ty+th;
+   }
+   gl_vboSubData( spfx_vbo, 0, sizeof(GLfloat) * 6*4 * n, spfx_vertex );
+
+   /* Render each type of effect in one go. */
+   glEnable(GL_TEXTURE_2D);
+   glColor4d( 1., 1., 1., 1. );
+   gl_vboActivateOffset( spfx_vbo, GL_VERTEX_ARRAY, 0,
+         2, GL_FLOAT, 4*sizeof(GLfloat) );
+   gl_vboActivateOffset( spfx_vbo, GL_TEXTURE_COORD_ARRAY, 2*sizeof(GLfloat),
+         2, GL_FLOAT, 4*sizeof(GLfloat) );
+   for (i=0; i<spfx_neffects; i++) {
+      if (end[i] <= start[i])
+         continue;
+      glBindTexture( GL_TEXTURE_2D, spfx_effects[i].gfx->texture );
+      glDrawArrays( GL_TRIANGLES, 6*start[i], 6*(end[i]-start[i]) );
    }
+
+   /* Clear state. */
+   gl_vboDeactivate();
+   glDisable(GL_TEXTURE_2D);
+
+   /* anything failed? */
+   gl_checkErr();
 }
 
+
+/**
+ * @brief Gets how many effects were drawn and culled in the last frame.
+ *
+ *    @param[out] drawn Effects drawn.
+ *    @param[out] culled Effects skipped for being off the screen.
+ */
+void spfx_renderStats( int *drawn, int *culled )
+{
+   *drawn  = spfx_ndrawn;
+   *culled = spfx_nculled;
+}
@@ -33,6 +33,7 @@ void spfx_add( const int effect,
  */
 void spfx_update( const double dt );
 void spfx_render( const int layer );
+void spfx_renderStats( int *drawn, int *culled );
 void spfx_clear (void);
 
 
@@ -0,0 +1,123 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file check_game.c
+ *
+ * @brief Starts and stops the game for the checks that need it loaded.
+ *
+ * The checks are linked with the whole game, built with NAEV_NO_MAIN so its
+ *  main() is out of the way.
+ */
+
+
+#include "check_game.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "cond.h"
+#include "conf.h"
+#include "console.h"
+#include "event.h"
+#include "font.h"
+#include "gui.h"
+#include "input.h"
+#include "log.h"
+#include "map.h"
+#include "mission.h"
+#include "music.h"
+#include "ndata.h"
+#include "nebula.h"
+#include "nlua.h"
+#include "nstring.h"
+#include "nxml.h"
+#include "opengl.h"
+#include "rng.h"
+#include "sound.h"
+#include "start.h"
+#include "threadpool.h"
+#include "toolkit.h"
+
+
+/**
+ * @brief Does what main() does up to the main menu, minus the bits that need
+ *        a user.
+ *
+ * Loading the data needs an OpenGL context, so a display.
+ *
+ *    @param datapath User data path to use instead of the user's.
+ *    @return 0 on success, CHECK_SKIP if there is no display.
+ */
+int check_gameInit( const char *datapath )
+{
+   char buf[PATH_MAX];
+   const char *srcdir;
+
+   SDL_Init(0);
+   threadpool_init();
+   if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+      LOG( "Unable to initialize SDL Video: %s", SDL_GetError() );
+      return CHECK_SKIP;
+   }
+
+   LIBXML_TEST_VERSION
+   xmlInitParser();
+   input_init();
+   lua_init();
+
+   /* Defaults, but keep away from the user's data and sound. */
+   conf_setDefaults();
+   conf.datapath = strdup( datapath );
+   srcdir = getenv( "srcdir" );
+   nsnprintf( buf, sizeof(buf), "%s/..", (srcdir != NULL) ? srcdir : ".." );
+   conf.ndata    = strdup( buf );
+   conf.nosound  = 1;
+   sound_disabled = 1;
+   music_disabled = 1;
+
+   if (ndata_open() != 0) {
+      WARN( "Failed to open ndata." );
+      return -1;
+   }
+   if (start_load()) {
+      WARN( "Failed to load module start data." );
+      return -1;
+   }
+   rng_init();
+   if (gl_init())
+      return CHECK_SKIP;
+
+   gl_fontInit( NULL, "Arial", FONT_DEFAULT_PATH, conf.font_size_def );
+   gl_fontInit( &gl_smallFont, "Arial", FONT_DEFAULT_PATH, conf.font_size_small );
+   gl_fontInit( &gl_defFontMono, "Monospace", FONT_MONOSPACE_PATH, conf.font_size_def );
+   nebu_init();
+   gui_init();
+   toolkit_init();
+   map_init();
+   cond_init();
+   cli_init();
+   load_all();
+
+   /* Events and missions can open dialogues nobody would close, so the
+    * checks only get the state they set up. */
+   events_exit();
+   missions_free();
+
+   return 0;
+}
+
+
+/**
+ * @brief Stops what check_gameInit() started.
+ */
+void check_gameExit (void)
+{
+   threadpool_exit();
+   SDL_Quit();
+}
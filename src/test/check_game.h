@@ -0,0 +1,17 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef CHECK_GAME_H
+#  define CHECK_GAME_H
+
+
+#define CHECK_SKIP      77 /**< Exit status automake reports as a skipped check. */
+
+
+int check_gameInit( const char *datapath );
+void check_gameExit (void);
+
+
+#endif /* CHECK_GAME_H */
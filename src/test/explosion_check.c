@@ -0,0 +1,215 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file explosion_check.c
+ *
+ * @brief Regression check of the explosion damage done through the spatial
+ *        indexes against the old loops over every pilot and weapon.
+ *
+ * Lays out a field of pilots of every size with bolts and missiles between
+ *  them, then replays a fixed set of explosions in batches through
+ *  expl_explodeDamage() and expl_update(). The game is built with EXPL_CHECK
+ *  on, so each explosion is also run through the old loops: every pilot must
+ *  be hit with the same damage and impact, in the same order, and the same
+ *  weapons must be removed.
+ *
+ * Nothing moves during the check, so the one step shift of the damage of
+ *  pilots blowing up (see explosion.c) is left out of it.
+ *
+ * Needs a display, see check_gameInit(), without one the check is skipped.
+ *  Run by "make check".
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+#include "damagetype.h"
+#include "explosion.h"
+#include "faction.h"
+#include "log.h"
+#include "outfit.h"
+#include "physics.h"
+#include "pilot.h"
+#include "ship.h"
+#include "weapon.h"
+
+#include "check_game.h"
+
+
+#if !EXPL_CHECK
+#error "explosion_check needs the game built with EXPL_CHECK."
+#endif /* !EXPL_CHECK */
+
+
+#define CHECK_DATAPATH  "explosion_check.d" /**< User data path, relative to where the check runs. */
+#define CHECK_SIDE      12 /**< Pilots on each side of the field. */
+#define CHECK_SPACING   150. /**< Distance between the pilots. */
+
+
+/**
+ * @brief An explosion to replay.
+ */
+typedef struct CheckExplosion_ {
+   double x; /**< X position of the centre. */
+   double y; /**< Y position of the centre. */
+   double radius; /**< Radius. */
+   double damage; /**< Damage at the centre. */
+   int mode; /**< What is affected, see EXPL_MODE_*. */
+   int last; /**< Last of its batch, the damage is done after it. */
+} CheckExplosion;
+
+/**
+ * @brief The explosions, in batches like the ones of a frame.
+ */
+static const CheckExplosion check_expl[] = {
+   /* A pilot blowing up, alone in the frame. */
+   { 600., 600., 60., 40., EXPL_MODE_SHIP, 1 },
+   /* A small fight, overlapping blasts of every kind. */
+   { 300., 450., 120., 30., EXPL_MODE_SHIP, 0 },
+   { 340., 470., 150., 30., EXPL_MODE_SHIP | EXPL_MODE_MISSILE, 0 },
+   { 900., 150., 200., 50., EXPL_MODE_MISSILE, 0 },
+   { 920., 180., 200., 50., EXPL_MODE_BOLT, 0 },
+   { 1200., 1200., 80., 20., EXPL_MODE_SHIP | EXPL_MODE_BOLT, 1 },
+   /* Big ones covering many cells, one off the field. */
+   { 825., 825., 700., 10., EXPL_MODE_SHIP | EXPL_MODE_MISSILE | EXPL_MODE_BOLT, 0 },
+   { -400., 1700., 450., 10., EXPL_MODE_SHIP | EXPL_MODE_MISSILE | EXPL_MODE_BOLT, 0 },
+   { 5000., 5000., 300., 10., EXPL_MODE_SHIP | EXPL_MODE_MISSILE | EXPL_MODE_BOLT, 1 },
+   /* Right on pilots, edges of the field. */
+   { 0., 0., 50., 25., EXPL_MODE_SHIP | EXPL_MODE_BOLT, 0 },
+   { 1650., 0., 250., 25., EXPL_MODE_SHIP | EXPL_MODE_MISSILE, 0 },
+   { 1650., 1650., 30., 25., EXPL_MODE_SHIP, 1 },
+};
+
+
+/*
+ * prototypes
+ */
+static int check_field (void);
+static void check_replay (void);
+
+
+/**
+ * @brief Lays out the pilots and the weapons between them.
+ *
+ *    @return 0 on success.
+ */
+static int check_field (void)
+{
+   Ship *ships;
+   Outfit *outfits, *bolt, *launcher;
+   int nships, noutfits;
+   int i, j, f;
+   unsigned int id;
+   PilotFlags flags;
+   Vector2d pos, vel;
+   Pilot *shooter;
+
+   ships   = ship_getAll( &nships );
+   outfits = outfit_getAll( &noutfits );
+   f       = faction_get( "Independent" );
+   if ((nships == 0) || (f < 0))
+      return -1;
+
+   /* Something to fire bolts and missiles with. */
+   bolt     = NULL;
+   launcher = NULL;
+   for (i=0; i<noutfits; i++) {
+      if ((bolt == NULL) && outfit_isBolt( &outfits[i] ))
+         bolt = &outfits[i];
+      if ((launcher == NULL) && outfit_isLauncher( &outfits[i] ) &&
+            (outfit_ammo( &outfits[i] ) != NULL))
+         launcher = &outfits[i];
+   }
+   if ((bolt == NULL) || (launcher == NULL)) {
+      WARN( "No bolt or launcher outfit to check with." );
+      return -1;
+   }
+
+   /* Pilots that neither think nor die. */
+   pilot_clearFlagsRaw( flags );
+   pilot_setFlagRaw( flags, PILOT_NO_OUTFITS );
+   pilot_setFlagRaw( flags, PILOT_NODEATH );
+   vectnull( &vel );
+
+   /* Far away from the explosions. */
+   vect_cset( &pos, 1e5, 1e5 );
+   id      = pilot_create( &ships[0], NULL, f, NULL, 0., &pos, &vel, flags );
+   shooter = pilot_get( id );
+   if (shooter == NULL)
+      return -1;
+
+   /* Ships of every size, slightly off the grid. */
+   for (i=0; i<CHECK_SIDE; i++) {
+      for (j=0; j<CHECK_SIDE; j++) {
+         vect_cset( &pos, i*CHECK_SPACING + (i*37 + j*91) % 50,
+               j*CHECK_SPACING + (i*53 + j*29) % 50 );
+         pilot_create( &ships[ (i*CHECK_SIDE + j) % nships ], NULL, f, NULL,
+               0., &pos, &vel, flags );
+
+         vect_cset( &pos, i*CHECK_SPACING + 60., j*CHECK_SPACING + 20. );
+         weapon_add( bolt, 0., 0., &pos, &vel, shooter, 0, 0. );
+         vect_cset( &pos, i*CHECK_SPACING + 20., j*CHECK_SPACING + 70. );
+         weapon_add( launcher, 0., 0., &pos, &vel, shooter, 0, 0. );
+      }
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Replays the explosions.
+ */
+static void check_replay (void)
+{
+   int i;
+   Damage dmg;
+
+   dmg.type          = dtype_get( "explosion_splash" );
+   dmg.penetration   = 1.;
+   dmg.disable       = 0.;
+   for (i=0; i<(int)(sizeof(check_expl)/sizeof(CheckExplosion)); i++) {
+      dmg.damage = check_expl[i].damage;
+      expl_explodeDamage( check_expl[i].x, check_expl[i].y,
+            check_expl[i].radius, &dmg, NULL, check_expl[i].mode );
+      if (check_expl[i].last)
+         expl_update();
+   }
+}
+
+
+int main( int argc, char** argv )
+{
+   int ret;
+
+   (void) argc;
+   (void) argv;
+
+   ret = check_gameInit( CHECK_DATAPATH );
+   if (ret != 0)
+      return (ret == CHECK_SKIP) ? CHECK_SKIP : 1;
+   if (check_field())
+      return 1;
+
+   check_replay();
+
+   printf( "%-4s %d pilot hits and %d weapons removed checked, %d differences\n",
+         (expl_checkErrors == 0) ? "ok" : "FAIL",
+         expl_checkPilots, expl_checkWeapons, expl_checkErrors );
+   /* Make sure the check wasn't empty. */
+   if ((expl_checkPilots == 0) || (expl_checkWeapons == 0)) {
+      printf( "FAIL nothing was hit\n" );
+      ret = 1;
+   }
+   if (expl_checkErrors > 0)
+      ret = 1;
+
+   check_gameExit();
+   return ret;
+}
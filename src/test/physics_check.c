@@ -0,0 +1,195 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file physics_check.c
+ *
+ * @brief Regression check of SOLID_UPDATE_ANALYTIC against SOLID_UPDATE_RK4.
+ *
+ * Replays traces of pilot inputs (thrust and turning per tick) on two solids,
+ *  one with each update method, at frame rate and at time compressed tick
+ *  lengths. Fails when the closed form trajectory strays further than
+ *  CHECK_TOL from the Runge-Kutta one, measured against the distance
+ *  travelled for positions and the speed limit for velocities.
+ *
+ * Run by "make check".
+ */
+
+
+#include "naev.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "log.h"
+#include "physics.h"
+
+
+#define CHECK_TOL       0.05 /**< Maximum relative divergence. */
+#define CHECK_MINDIST   50. /**< Distance below which position errors are absolute (about a ship). */
+
+
+/**
+ * @brief A stretch of a recorded input trace.
+ */
+typedef struct CheckInput_ {
+   double time; /**< Duration of the stretch in seconds, 0 ends the trace. */
+   double thrust; /**< Thrust as a fraction of the ship's. */
+   double turn; /**< Turning as a fraction of the ship's, negative is clockwise. */
+   double speed; /**< Speed limit as a fraction of the ship's. */
+} CheckInput;
+
+/**
+ * @brief A ship the traces are flown with.
+ */
+typedef struct CheckShip_ {
+   const char *name; /**< Name to report. */
+   double mass; /**< Mass. */
+   double thrust; /**< Thrust force. */
+   double turn; /**< Turn rate (rad/s). */
+   double speed; /**< Speed limit. */
+} CheckShip;
+
+/**
+ * @brief A named input trace.
+ */
+typedef struct CheckTrace_ {
+   const char *name; /**< Name to report. */
+   double vel; /**< Initial speed as a fraction of the limit, along the facing. */
+   CheckInput input[8]; /**< Stretches of input. */
+} CheckTrace;
+
+
+/**
+ * @brief Ships, from a fighter to a slow capital ship.
+ */
+static const CheckShip check_ships[] = {
+   { "fighter",   20.,  20. * 220., 3.5, 350. },
+   { "freighter", 300., 300. * 90., 1.2, 180. },
+   { "capital",   4000., 4000. * 25., 0.4, 90. }
+};
+
+/**
+ * @brief Input traces, modelled on AI and player manoeuvres.
+ */
+static const CheckTrace check_traces[] = {
+   { "accelerate", 0., {
+      { 6., 1., 0., 1. }, { 0., 0., 0., 0. } } },
+   { "turning thrust", 0., {
+      { 5., 1., 1., 1. }, { 0., 0., 0., 0. } } },
+   { "perpendicular thrust at top speed", 1., {
+      { 0.5, 0., 1., 1. }, { 3., 1., 0., 1. }, { 0., 0., 0., 0. } } },
+   { "orbit", 1., {
+      { 8., 1., 0.3, 1. }, { 0., 0., 0., 0. } } },
+   { "turn around and brake", 1., {
+      { 1.5, 0., 1., 1. }, { 3., 1., 0., 1. }, { 0., 0., 0., 0. } } },
+   { "afterburner", 0., {
+      { 3., 1., 0., 1.8 }, { 2., 1., 0.2, 1.8 }, { 4., 1., -0.2, 1. },
+      { 2., 0., 0., 1. }, { 0., 0., 0., 0. } } },
+   { "dogfight", 0.5, {
+      { 0.7, 1., 1., 1. }, { 0.4, 0., -1., 1. }, { 1.1, 1., 0., 1. },
+      { 0.9, 1., -1., 1. }, { 0.5, 0., 1., 1. }, { 1.3, 1., 0.5, 1. },
+      { 0.8, 0., 0., 1. }, { 0., 0., 0., 0. } } }
+};
+
+/**
+ * @brief Tick lengths to check, from frame rate to heavy time compression.
+ */
+static const double check_dt[] = { 1./60., 0.1, 0.25, 0.5 };
+
+
+/**
+ * @brief Logs without the in-game console.
+ */
+int logprintf( FILE *stream, int newline, const char *fmt, ... )
+{
+   va_list ap;
+   int n;
+
+   va_start( ap, fmt );
+   n = vfprintf( stream, fmt, ap );
+   va_end( ap );
+   if (newline)
+      n += fprintf( stream, "\n" );
+   return n;
+}
+
+
+/**
+ * @brief Flies a trace with both update methods and measures the divergence.
+ *
+ *    @param ship Ship to fly.
+ *    @param trace Trace to replay.
+ *    @param dt Tick length.
+ *    @param[out] perr Largest position error relative to the distance flown.
+ *    @param[out] verr Largest velocity error relative to the speed limit.
+ */
+static void check_fly( const CheckShip *ship, const CheckTrace *trace,
+      double dt, double *perr, double *verr )
+{
+   Solid ref, sol;
+   Vector2d pos, vel;
+   const CheckInput *in;
+   double t, dist, vmax;
+
+   vect_cset( &pos, 0., 0. );
+   vect_pset( &vel, trace->vel * ship->speed, 0. );
+   solid_init( &ref, ship->mass, 0., &pos, &vel, SOLID_UPDATE_RK4 );
+   solid_init( &sol, ship->mass, 0., &pos, &vel, SOLID_UPDATE_ANALYTIC );
+
+   *perr = 0.;
+   *verr = 0.;
+   dist  = 0.;
+   for (in=trace->input; in->time > 0.; in++) {
+      for (t=0.; t < in->time - 1e-9; t+=dt) {
+         vmax = in->speed * ship->speed;
+         ref.thrust    = sol.thrust    = in->thrust * ship->thrust;
+         ref.dir_vel   = sol.dir_vel   = in->turn * ship->turn;
+         ref.speed_max = sol.speed_max = vmax;
+
+         dist += VMOD(ref.vel) * dt;
+         ref.update( &ref, dt );
+         sol.update( &sol, dt );
+
+         *perr = MAX( *perr, vect_dist( &ref.pos, &sol.pos ) / MAX( CHECK_MINDIST, dist ) );
+         *verr = MAX( *verr, vect_dist( &ref.vel, &sol.vel ) / vmax );
+      }
+   }
+}
+
+
+/**
+ * @brief Runs every trace with every ship at every tick length.
+ *
+ *    @return 0 if everything is within tolerance.
+ */
+int main( int argc, char** argv )
+{
+   int i, j, k, failed;
+   double perr, verr;
+
+   (void) argc;
+   (void) argv;
+
+   failed = 0;
+   for (i=0; i<(int)(sizeof(check_ships)/sizeof(CheckShip)); i++) {
+      for (j=0; j<(int)(sizeof(check_traces)/sizeof(CheckTrace)); j++) {
+         for (k=0; k<(int)(sizeof(check_dt)/sizeof(double)); k++) {
+            check_fly( &check_ships[i], &check_traces[j], check_dt[k],
+                  &perr, &verr );
+            printf( "%-4s %-10s %-34s dt=%.3f  pos %6.2f%%  vel %6.2f%%\n",
+                  ((perr > CHECK_TOL) || (verr > CHECK_TOL)) ? "FAIL" : "ok",
+                  check_ships[i].name, check_traces[j].name, check_dt[k],
+                  100.*perr, 100.*verr );
+            if ((perr > CHECK_TOL) || (verr > CHECK_TOL))
+               failed++;
+         }
+      }
+   }
+
+   if (failed)
+      printf( "%d trajectories diverge from RK4 by more than %.0f%%\n",
+            failed, 100.*CHECK_TOL );
+   return (failed > 0);
+}
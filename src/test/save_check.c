@@ -0,0 +1,487 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file save_check.c
+ *
+ * @brief Regression checks of the savegame writer.
+ *
+ * Starts the game without its main loop on a throwaway data path, creates a
+ *  player landed in the start system and saves it. Loading that savegame with
+ *  load_game() and saving again must give back the same header, player,
+ *  faction, variable and hook sections. A write error while saving must fail
+ *  the save without touching the previous savegame or leaving the temporary
+ *  file behind.
+ *
+ * Needs a display, see check_gameInit(), without one the check is skipped.
+ *  Run by "make check".
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAS_POSIX
+#include <signal.h>
+#include <sys/resource.h>
+#endif /* HAS_POSIX */
+
+#include "SDL.h"
+
+#include "economy.h"
+#include "faction.h"
+#include "hook.h"
+#include "land.h"
+#include "load.h"
+#include "log.h"
+#include "news.h"
+#include "nfile.h"
+#include "nlua.h"
+#include "nstring.h"
+#include "ntime.h"
+#include "nxml.h"
+#include "player.h"
+#include "save.h"
+#include "ship.h"
+#include "space.h"
+#include "start.h"
+
+#include "check_game.h"
+
+
+#define CHECK_DATAPATH  "save_check.d" /**< User data path, relative to where the check runs. */
+#define CHECK_NAME      "Save Check" /**< Name of the player, and so of the savegame. */
+#define CHECK_CREDITS   1234567 /**< Credits the player has. */
+#define CHECK_FSIZE     512 /**< File size limit that makes the writes fail. */
+#define CHECK_FACTION   "Empire" /**< Faction the player has a standing with. */
+#define CHECK_STANDING  42.5 /**< Standing with CHECK_FACTION. */
+#define CHECK_MISSION   4242 /**< Parent of the hooks, the mission itself isn't needed. */
+
+
+/**
+ * @brief Sets the variables, then checks them once loaded back.
+ */
+static const char check_varSet[] =
+   "var.push( \"save_check_num\", 1337 )\n"
+   "var.push( \"save_check_str\", \"round trip\" )\n"
+   "var.push( \"save_check_bool\", true )\n";
+static const char check_varGet[] =
+   "assert( var.peek( \"save_check_num\" ) == 1337 )\n"
+   "assert( var.peek( \"save_check_str\" ) == \"round trip\" )\n"
+   "assert( var.peek( \"save_check_bool\" ) == true )\n";
+
+/**
+ * @brief Savegame sections compared after loading, hooks only as a set
+ *        because loading reverses their order.
+ */
+static const char *check_sections[] = {
+   "header", "player", "factions", "vars", NULL };
+
+
+extern int save_loaded; /**< From save.c */
+
+
+/*
+ * prototypes
+ */
+static int check_newPlayer (void);
+static int check_lua( const char *code );
+static int check_setState (void);
+static void check_savePath( char *path, size_t len );
+static xmlNodePtr check_section( xmlDocPtr doc, const char *name );
+static char* check_dump( xmlNodePtr node );
+static int check_sameSection( xmlDocPtr a, xmlDocPtr b, const char *name );
+static int check_sameHooks( xmlDocPtr a, xmlDocPtr b );
+static int check_roundTrip (void);
+static int check_writeError (void);
+
+
+/**
+ * @brief Creates a player landed in the start system, like player_new()
+ *        without asking anything.
+ *
+ *    @return 0 on success.
+ */
+static int check_newPlayer (void)
+{
+   Ship *ship;
+   Planet *pnt;
+   int i;
+
+   player_cleanup();
+   player.name = strdup( CHECK_NAME );
+   ntime_set( start_date() );
+
+   ship = ship_get( start_ship() );
+   if ((ship == NULL) || (player_newShip( ship, "Checker", 0, 1 ) == NULL)) {
+      WARN( "Unable to create the player's ship." );
+      return -1;
+   }
+   space_init( start_system() );
+   player.p->credits = CHECK_CREDITS;
+   economy_init();
+   news_init();
+
+   /* Saving needs somewhere to be landed. */
+   pnt = NULL;
+   for (i=0; i<cur_system->nplanets; i++) {
+      if (planet_hasService( cur_system->planets[i], PLANET_SERVICE_LAND )) {
+         pnt = cur_system->planets[i];
+         break;
+      }
+   }
+   if (pnt == NULL) {
+      WARN( "No planet to land on in '%s'.", cur_system->name );
+      return -1;
+   }
+   land( pnt, 0 );
+
+   return 0;
+}
+
+
+/**
+ * @brief Runs Lua code with the standard libraries.
+ *
+ *    @param code Code to run.
+ *    @return 0 on success.
+ */
+static int check_lua( const char *code )
+{
+   nlua_env env;
+   int ret;
+
+   env = nlua_newEnv(1);
+   nlua_loadStandard(env);
+   ret = nlua_dobufenv( env, code, strlen(code), "save_check" );
+   if (ret != 0) {
+      WARN( "%s", lua_tostring(naevL,-1) );
+      lua_pop(naevL,1);
+   }
+   nlua_freeEnv(env);
+   return ret;
+}
+
+
+/**
+ * @brief Gives the player a faction standing, variables and hooks to save.
+ *
+ *    @return 0 on success.
+ */
+static int check_setState (void)
+{
+   int f;
+
+   f = faction_get( CHECK_FACTION );
+   if (f < 0)
+      return -1;
+   faction_setPlayer( f, CHECK_STANDING );
+   faction_setKnown( f, 1 );
+
+   if (check_lua( check_varSet ))
+      return -1;
+
+   /* Stacks that landing and loading don't run. */
+   hook_addMisn( CHECK_MISSION, "check_takeoff", "takeoff" );
+   hook_addMisn( CHECK_MISSION, "check_jumpin", "jumpin" );
+   hook_addDateMisn( CHECK_MISSION, "check_date", 1000 );
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets the path of the player's savegame.
+ */
+static void check_savePath( char *path, size_t len )
+{
+   nsnprintf( path, len, "%ssaves/%s.ns", nfile_dataPath(), player.name );
+}
+
+
+/**
+ * @brief Gets a section of a savegame.
+ */
+static xmlNodePtr check_section( xmlDocPtr doc, const char *name )
+{
+   xmlNodePtr node;
+
+   node = xmlDocGetRootElement( doc );
+   if (node == NULL)
+      return NULL;
+   for (node=node->xmlChildrenNode; node!=NULL; node=node->next)
+      if (xml_isNode(node,name))
+         return node;
+   return NULL;
+}
+
+
+/**
+ * @brief Dumps a node as XML text.
+ *
+ *    @return Newly allocated text.
+ */
+static char* check_dump( xmlNodePtr node )
+{
+   xmlBufferPtr buf;
+   char *str;
+
+   buf = xmlBufferCreate();
+   xmlNodeDump( buf, node->doc, node, 0, 0 );
+   str = strdup( (const char*) xmlBufferContent(buf) );
+   xmlBufferFree( buf );
+   return str;
+}
+
+
+/**
+ * @brief Checks a section is the same in both savegames.
+ *
+ *    @return 1 if it's the same.
+ */
+static int check_sameSection( xmlDocPtr a, xmlDocPtr b, const char *name )
+{
+   xmlNodePtr na, nb;
+   char *sa, *sb;
+   int same;
+
+   na = check_section( a, name );
+   nb = check_section( b, name );
+   if ((na == NULL) || (nb == NULL))
+      return 0;
+
+   sa   = check_dump( na );
+   sb   = check_dump( nb );
+   same = (strcmp( sa, sb ) == 0);
+   if (!same)
+      printf( "--- saved\n%s\n--- loaded and saved again\n%s\n", sa, sb );
+   free( sa );
+   free( sb );
+   return same;
+}
+
+
+/**
+ * @brief Checks both savegames have the same hooks, in any order.
+ *
+ *    @return 1 if they're the same.
+ */
+static int check_sameHooks( xmlDocPtr a, xmlDocPtr b )
+{
+   xmlNodePtr ha, hb, na, nb;
+   char *sa, *sb;
+   int na_hooks, nb_hooks, found;
+
+   ha = check_section( a, "hooks" );
+   hb = check_section( b, "hooks" );
+   if ((ha == NULL) || (hb == NULL))
+      return 0;
+
+   /* Every hook of the first has to be in the second, and there have to be
+    * as many, saved hooks have unique IDs. */
+   na_hooks = 0;
+   for (na=ha->xmlChildrenNode; na!=NULL; na=na->next) {
+      if (!xml_isNode(na,"hook"))
+         continue;
+      na_hooks++;
+      sa    = check_dump( na );
+      found = 0;
+      for (nb=hb->xmlChildrenNode; (nb!=NULL) && !found; nb=nb->next) {
+         if (!xml_isNode(nb,"hook"))
+            continue;
+         sb    = check_dump( nb );
+         found = (strcmp( sa, sb ) == 0);
+         free( sb );
+      }
+      if (!found)
+         printf( "--- hook lost loading\n%s\n", sa );
+      free( sa );
+      if (!found)
+         return 0;
+   }
+   nb_hooks = 0;
+   for (nb=hb->xmlChildrenNode; nb!=NULL; nb=nb->next)
+      if (xml_isNode(nb,"hook"))
+         nb_hooks++;
+   if (na_hooks != nb_hooks)
+      printf( "--- %d hooks saved, %d after loading\n", na_hooks, nb_hooks );
+   return (na_hooks == nb_hooks);
+}
+
+
+/**
+ * @brief Loads the savegame back and saves it again, the sections must be the
+ *        same.
+ *
+ *    @return Number of failures.
+ */
+static int check_roundTrip (void)
+{
+   char path[PATH_MAX];
+   xmlDocPtr a, b;
+   int i, failed, f;
+
+   check_savePath( path, sizeof(path) );
+   a = xmlParseFile( path );
+   if (a == NULL) {
+      printf( "FAIL round trip: unable to parse '%s'\n", path );
+      return 1;
+   }
+
+   failed = 0;
+   if (load_game( path, 0 ) < 0) {
+      printf( "FAIL round trip: load_game() failed\n" );
+      xmlFreeDoc( a );
+      return 1;
+   }
+
+   /* Check what was loaded first, saving it again could hide a loss. */
+   f = faction_get( CHECK_FACTION );
+   if ((player.name == NULL) || (strcmp( player.name, CHECK_NAME ) != 0)) {
+      printf( "FAIL round trip: player name\n" );
+      failed++;
+   }
+   if (player.p->credits != CHECK_CREDITS) {
+      printf( "FAIL round trip: %"CREDITS_PRI" credits instead of %d\n",
+            player.p->credits, CHECK_CREDITS );
+      failed++;
+   }
+   if ((f < 0) || (FABS( faction_getPlayer(f) - CHECK_STANDING ) > 1e-6) ||
+         !faction_isKnown(f)) {
+      printf( "FAIL round trip: standing with %s\n", CHECK_FACTION );
+      failed++;
+   }
+   if (check_lua( check_varGet )) {
+      printf( "FAIL round trip: variables\n" );
+      failed++;
+   }
+
+   /* Saving again must give back the same sections. */
+   if (save_all() < 0) {
+      printf( "FAIL round trip: unable to save the loaded game\n" );
+      xmlFreeDoc( a );
+      return failed+1;
+   }
+   b = xmlParseFile( path );
+   if (b == NULL) {
+      printf( "FAIL round trip: unable to parse '%s'\n", path );
+      xmlFreeDoc( a );
+      return failed+1;
+   }
+   for (i=0; check_sections[i]!=NULL; i++) {
+      if (!check_sameSection( a, b, check_sections[i] )) {
+         printf( "FAIL round trip: %s section\n", check_sections[i] );
+         failed++;
+      }
+   }
+   if (!check_sameHooks( a, b )) {
+      printf( "FAIL round trip: hooks section\n" );
+      failed++;
+   }
+   if (!failed)
+      printf( "ok   round trip\n" );
+
+   xmlFreeDoc( a );
+   xmlFreeDoc( b );
+   return failed;
+}
+
+
+/**
+ * @brief Makes every write of a save past CHECK_FSIZE bytes fail, like a full
+ *        disk would.
+ *
+ *    @return Number of failures.
+ */
+static int check_writeError (void)
+{
+#if HAS_POSIX
+   char path[PATH_MAX], tmppath[PATH_MAX];
+   char *before, *after;
+   size_t nbefore, nafter;
+   struct rlimit lim, old;
+   int ret, failed;
+
+   check_savePath( path, sizeof(path) );
+   nsnprintf( tmppath, sizeof(tmppath), "%s.tmp", path );
+   before = nfile_readFile( &nbefore, "%s", path );
+   if (before == NULL) {
+      printf( "FAIL write error: no savegame to start from\n" );
+      return 1;
+   }
+
+   /* Writing past the limit raises SIGXFSZ, with it ignored the write fails
+    * with EFBIG instead. Skip the backup, it would be past the limit too. */
+   signal( SIGXFSZ, SIG_IGN );
+   getrlimit( RLIMIT_FSIZE, &old );
+   lim = old;
+   lim.rlim_cur = CHECK_FSIZE;
+   if (setrlimit( RLIMIT_FSIZE, &lim )) {
+      printf( "skip write error: unable to limit the file size\n" );
+      free( before );
+      return 0;
+   }
+   save_loaded = 1;
+   ret = save_all();
+   setrlimit( RLIMIT_FSIZE, &old );
+   signal( SIGXFSZ, SIG_DFL );
+
+   failed = 0;
+   after  = nfile_readFile( &nafter, "%s", path );
+   if (ret >= 0) {
+      printf( "FAIL write error: save_all() succeeded\n" );
+      failed++;
+   }
+   if ((after == NULL) || (nafter != nbefore) || memcmp( before, after, nbefore )) {
+      printf( "FAIL write error: the old savegame was changed\n" );
+      failed++;
+   }
+   if (nfile_fileExists( "%s", tmppath )) {
+      printf( "FAIL write error: '%s' was left behind\n", tmppath );
+      failed++;
+   }
+   if (!failed)
+      printf( "ok   write error\n" );
+
+   free( before );
+   free( after );
+   return failed;
+#else /* HAS_POSIX */
+   printf( "skip write error: needs POSIX file size limits\n" );
+   return 0;
+#endif /* HAS_POSIX */
+}
+
+
+int main( int argc, char** argv )
+{
+   char path[PATH_MAX];
+   int ret, failed;
+
+   (void) argc;
+   (void) argv;
+
+   ret = check_gameInit( CHECK_DATAPATH );
+   if (ret != 0)
+      return (ret == CHECK_SKIP) ? CHECK_SKIP : 1;
+   if (check_newPlayer() || check_setState())
+      return 1;
+
+   /* Start from a fresh savegame. */
+   check_savePath( path, sizeof(path) );
+   nfile_delete( path );
+   if (save_all() < 0) {
+      printf( "FAIL unable to save the game\n" );
+      return 1;
+   }
+
+   failed  = check_roundTrip();
+   failed += check_writeError();
+
+   nfile_delete( path );
+   check_gameExit();
+   return (failed > 0);
+}
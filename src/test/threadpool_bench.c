@@ -0,0 +1,436 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file threadpool_bench.c
+ *
+ * @brief Benchmark of the work-stealing threadpool against the old one.
+ *
+ * Runs two workloads serially, on the old single-queue pool (threadpool_old.c)
+ *  and on the current pool:
+ *
+ *  - Nebula generation: 3d turbulence over the slices of a nebula map, split
+ *    one job per slice as the old noise_genNebulaMap() did, and in blocks of
+ *    rows with threadpool_parallelFor() as it does now.
+ *  - Batch data loading: many small jobs of uneven cost, as when parsing a
+ *    directory of data files, and the same split into nested groups, which
+ *    only the current pool can run.
+ *
+ * Each case reports the best time of BENCH_RUNS runs. The results of every
+ *  case are compared against the serial ones, so a broken pool fails the run.
+ *
+ * Built by "make check" but not run by it, as timings depend on the machine.
+ * Usage: threadpool_bench [width height slices]
+ */
+
+
+#include "naev.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "log.h"
+#include "perlin.h"
+#include "threadpool.h"
+
+
+#define BENCH_RUNS      5 /**< Runs per case, the best is reported. */
+#define BENCH_ROWS      32 /**< Rows per job when splitting slices. */
+#define BENCH_FILES     4096 /**< Jobs in the loading batch. */
+#define BENCH_GROUPS    64 /**< Groups the nested loading batch is split in. */
+#define BENCH_OCTAVES   3 /**< Octaves of turbulence, as for nebulae. */
+
+
+/*
+ * The old pool, see threadpool_old.c.
+ */
+int oldpool_init( void );
+ThreadQueue* oldvpool_create( void );
+void oldvpool_enqueue( ThreadQueue* queue, int (*function)(void *), void *data );
+void oldvpool_wait( ThreadQueue* queue );
+
+
+/**
+ * @brief Nebula being generated.
+ */
+typedef struct BenchNebula_ {
+   perlin_data_t *noise; /**< Noise to sample. */
+   float *map;    /**< Output, w*h*n. */
+   int w;         /**< Width. */
+   int h;         /**< Height. */
+   int n;         /**< Slices. */
+   float zoom;    /**< Zoom of the noise. */
+} BenchNebula;
+
+/**
+ * @brief A job over some rows of a nebula slice.
+ */
+typedef struct BenchRows_ {
+   BenchNebula *neb; /**< Nebula. */
+   int z;         /**< Slice. */
+   int y0;        /**< First row. */
+   int y1;        /**< Row after the last. */
+} BenchRows;
+
+/**
+ * @brief A data file to "load".
+ */
+typedef struct BenchFile_ {
+   int size;      /**< Bytes to parse. */
+   unsigned int seed; /**< Contents. */
+   unsigned int hash; /**< Output. */
+} BenchFile;
+
+/**
+ * @brief A group of data files loaded by a single job.
+ */
+typedef struct BenchGroup_ {
+   BenchFile *files; /**< Files of the group. */
+   int n;         /**< Number of files. */
+} BenchGroup;
+
+
+/**
+ * @brief Logs without the in-game console.
+ */
+int logprintf( FILE *stream, int newline, const char *fmt, ... )
+{
+   va_list ap;
+   int n;
+
+   va_start( ap, fmt );
+   n = vfprintf( stream, fmt, ap );
+   va_end( ap );
+   if (newline)
+      n += fprintf( stream, "\n" );
+   return n;
+}
+
+
+/**
+ * @brief Generates some rows of a nebula slice, like the old per slice job.
+ */
+static int bench_nebulaRows( void *data )
+{
+   BenchRows *rows = (BenchRows*) data;
+   BenchNebula *neb = rows->neb;
+   float f[3];
+   int x, y;
+
+   f[2] = neb->zoom * (float)rows->z / (float)neb->n;
+   for (y=rows->y0; y<rows->y1; y++) {
+      f[1] = neb->zoom * (float)y / (float)neb->h;
+      for (x=0; x<neb->w; x++) {
+         f[0] = neb->zoom * (float)x / (float)neb->w;
+         neb->map[ (rows->z*neb->h + y)*neb->w + x ] =
+               noise_turbulence3( neb->noise, f, BENCH_OCTAVES );
+      }
+   }
+   return 0;
+}
+
+
+/**
+ * @brief threadpool_parallelFor() callback over blocks of rows of all slices.
+ */
+static void bench_nebulaBlocks( int start, int end, void *data )
+{
+   BenchNebula *neb = (BenchNebula*) data;
+   BenchRows rows;
+   int i, nblocks;
+
+   nblocks  = (neb->h + BENCH_ROWS - 1) / BENCH_ROWS;
+   rows.neb = neb;
+   for (i=start; i<end; i++) {
+      rows.z   = i / nblocks;
+      rows.y0  = (i % nblocks) * BENCH_ROWS;
+      rows.y1  = MIN( neb->h, rows.y0 + BENCH_ROWS );
+      bench_nebulaRows( &rows );
+   }
+}
+
+
+/**
+ * @brief "Parses" a data file: hashes pseudo-random contents.
+ */
+static int bench_loadFile( void *data )
+{
+   BenchFile *file = (BenchFile*) data;
+   unsigned int h, s;
+   int i;
+
+   h = 2166136261u;
+   s = file->seed;
+   for (i=0; i<file->size; i++) {
+      s  = s * 1103515245u + 12345u;
+      h  = (h ^ (s >> 16)) * 16777619u;
+   }
+   file->hash = h;
+   return 0;
+}
+
+
+/**
+ * @brief Loads a group of files, submitting each as a job and waiting.
+ */
+static int bench_loadGroup( void *data )
+{
+   BenchGroup *group = (BenchGroup*) data;
+   ThreadCounter counter;
+   int i;
+
+   counter.count = 0;
+   for (i=0; i<group->n; i++)
+      threadpool_submit( bench_loadFile, &group->files[i], &counter );
+   threadpool_wait( &counter );
+   return 0;
+}
+
+
+/**
+ * @brief Prints the time of a case and checks its results.
+ *
+ *    @return 1 if the results differ from the reference ones.
+ */
+static int bench_report( const char *name, unsigned int ms,
+      const void *res, const void *ref, size_t size )
+{
+   int bad = (memcmp( res, ref, size ) != 0);
+   printf( "   %-40s %6u ms%s\n", name, ms, bad ? "  WRONG RESULTS" : "" );
+   return bad;
+}
+
+
+/**
+ * @brief Nebula generation benchmark.
+ *
+ *    @return Number of cases with wrong results.
+ */
+static int bench_nebula( int w, int h, int n )
+{
+   BenchNebula neb;
+   BenchRows *slices;
+   ThreadQueue *q;
+   float *ref;
+   unsigned int s, best;
+   int i, r, njobs, failed;
+
+   neb.noise   = noise_new( 3, NOISE_DEFAULT_HURST, NOISE_DEFAULT_LACUNARITY );
+   neb.w       = w;
+   neb.h       = h;
+   neb.n       = n;
+   neb.zoom    = 5.;
+   neb.map     = malloc( sizeof(float) * w*h*n );
+   ref         = malloc( sizeof(float) * w*h*n );
+   slices      = malloc( sizeof(BenchRows) * n );
+   for (i=0; i<n; i++) {
+      slices[i].neb  = &neb;
+      slices[i].z    = i;
+      slices[i].y0   = 0;
+      slices[i].y1   = h;
+   }
+   njobs    = n * ((h + BENCH_ROWS - 1) / BENCH_ROWS);
+   failed   = 0;
+   printf( "Nebula generation, %dx%dx%d:\n", w, h, n );
+
+   /* Serial reference. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      for (i=0; i<n; i++)
+         bench_nebulaRows( &slices[i] );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   memcpy( ref, neb.map, sizeof(float) * w*h*n );
+   failed += bench_report( "serial", best, neb.map, ref, sizeof(float)*w*h*n );
+
+   /* Old pool, one job per slice. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      memset( neb.map, 0, sizeof(float) * w*h*n );
+      s = SDL_GetTicks();
+      q = oldvpool_create();
+      for (i=0; i<n; i++)
+         oldvpool_enqueue( q, bench_nebulaRows, &slices[i] );
+      oldvpool_wait( q );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   failed += bench_report( "old vpool, job per slice", best, neb.map, ref, sizeof(float)*w*h*n );
+
+   /* New pool through the vpool interface. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      memset( neb.map, 0, sizeof(float) * w*h*n );
+      s = SDL_GetTicks();
+      q = vpool_create();
+      for (i=0; i<n; i++)
+         vpool_enqueue( q, bench_nebulaRows, &slices[i] );
+      vpool_wait( q );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   failed += bench_report( "vpool, job per slice", best, neb.map, ref, sizeof(float)*w*h*n );
+
+   /* New pool in blocks of rows, as noise_genNebulaMap() does. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      memset( neb.map, 0, sizeof(float) * w*h*n );
+      s = SDL_GetTicks();
+      threadpool_parallelFor( 0, njobs, 1, bench_nebulaBlocks, &neb );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   failed += bench_report( "parallelFor, blocks of rows", best, neb.map, ref, sizeof(float)*w*h*n );
+
+   noise_delete( neb.noise );
+   free( neb.map );
+   free( ref );
+   free( slices );
+   return failed;
+}
+
+
+/**
+ * @brief Batch data loading benchmark.
+ *
+ *    @return Number of cases with wrong results.
+ */
+static int bench_load( void )
+{
+   BenchFile *files;
+   BenchGroup groups[BENCH_GROUPS];
+   unsigned int *ref, *res;
+   unsigned int s, best, seed;
+   ThreadQueue *q;
+   ThreadCounter counter;
+   int i, r, per, failed;
+
+   /* Mostly small files with a few big ones. */
+   files = malloc( sizeof(BenchFile) * BENCH_FILES );
+   seed  = 1;
+   for (i=0; i<BENCH_FILES; i++) {
+      seed           = seed * 1103515245u + 12345u;
+      files[i].seed  = seed;
+      files[i].size  = 2000 + (seed >> 16) % 20000;
+      if ((seed >> 8) % 32 == 0)
+         files[i].size *= 20;
+   }
+   per = BENCH_FILES / BENCH_GROUPS;
+   for (i=0; i<BENCH_GROUPS; i++) {
+      groups[i].files   = &files[i*per];
+      groups[i].n       = per;
+   }
+   ref      = malloc( sizeof(unsigned int) * BENCH_FILES );
+   res      = malloc( sizeof(unsigned int) * BENCH_FILES );
+   failed   = 0;
+   printf( "Batch data loading, %d files:\n", BENCH_FILES );
+
+#define BENCH_RESULTS(out) \
+   for (i=0; i<BENCH_FILES; i++) { \
+      (out)[i]       = files[i].hash; \
+      files[i].hash  = 0; \
+   }
+
+   /* Serial reference. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      for (i=0; i<BENCH_FILES; i++)
+         bench_loadFile( &files[i] );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   BENCH_RESULTS( ref );
+   failed += bench_report( "serial", best, ref, ref, 0 );
+
+   /* Old pool. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      q = oldvpool_create();
+      for (i=0; i<BENCH_FILES; i++)
+         oldvpool_enqueue( q, bench_loadFile, &files[i] );
+      oldvpool_wait( q );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   BENCH_RESULTS( res );
+   failed += bench_report( "old vpool, job per file", best, res, ref, sizeof(unsigned int)*BENCH_FILES );
+
+   /* New pool through the vpool interface. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      q = vpool_create();
+      for (i=0; i<BENCH_FILES; i++)
+         vpool_enqueue( q, bench_loadFile, &files[i] );
+      vpool_wait( q );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   BENCH_RESULTS( res );
+   failed += bench_report( "vpool, job per file", best, res, ref, sizeof(unsigned int)*BENCH_FILES );
+
+   /* New pool with counters. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      counter.count = 0;
+      for (i=0; i<BENCH_FILES; i++)
+         threadpool_submit( bench_loadFile, &files[i], &counter );
+      threadpool_wait( &counter );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   BENCH_RESULTS( res );
+   failed += bench_report( "submit, job per file", best, res, ref, sizeof(unsigned int)*BENCH_FILES );
+
+   /* Nested jobs, which would deadlock the old pool. */
+   best = (unsigned int)-1;
+   for (r=0; r<BENCH_RUNS; r++) {
+      s = SDL_GetTicks();
+      counter.count = 0;
+      for (i=0; i<BENCH_GROUPS; i++)
+         threadpool_submit( bench_loadGroup, &groups[i], &counter );
+      threadpool_wait( &counter );
+      best = MIN( best, SDL_GetTicks() - s );
+   }
+   BENCH_RESULTS( res );
+   failed += bench_report( "submit, nested groups of files", best, res, ref, sizeof(unsigned int)*BENCH_FILES );
+
+#undef BENCH_RESULTS
+
+   free( files );
+   free( ref );
+   free( res );
+   return failed;
+}
+
+
+/**
+ * @brief Runs the benchmarks.
+ *
+ *    @return 0 if every case got the same results as the serial run.
+ */
+int main( int argc, char** argv )
+{
+   int w, h, n, failed;
+
+   /* Same size as the nebula tiles (NEBULA_TILE, NEBULA_Z). */
+   w = 512;
+   h = 512;
+   n = 16;
+   if (argc >= 4) {
+      w = MAX( 1, atoi( argv[1] ) );
+      h = MAX( 1, atoi( argv[2] ) );
+      n = MAX( 1, atoi( argv[3] ) );
+   }
+
+   oldpool_init();
+   threadpool_init();
+
+   failed  = bench_nebula( w, h, n );
+   failed += bench_load();
+
+   threadpool_exit();
+   return (failed > 0);
+}
@@ -2,618 +2,588 @@
  * See Licensing and Copyright notice in threadpool.h
  */
 /*
- * @brief A simple threadpool implementation using a single queue.
+ * @brief A work-stealing threadpool.
  *
- * The queue is inspired by this paper (look for the queue with two locks):
+ * Every worker thread owns a deque of jobs. Jobs submitted from a worker go to
+ *  the back of its own deque and are popped from the back again (LIFO), which
+ *  keeps nested jobs hot in the cache. Idle workers steal from the front of
+ *  the other deques (FIFO), so the oldest and usually largest chunks of work
+ *  move first. Threads that are not workers (the main thread) submit into a
+ *  shared deque that everyone steals from.
  *
- * Maged M. Michael and Michael L. Scott. 1998. Nonblocking algorithms and
- * preemption-safe locking on multiprogrammed shared memory multiprocessors. J.
- * Parallel Distrib. Comput. 51, 1 (May 1998), 1-26. DOI=10.1006/jpdc.1998.1446
- * http://dx.doi.org/10.1006/jpdc.1998.1446
+ * Completion is tracked with ThreadCounter: each submitted job increments it
+ *  and decrements it when done. Waiting on a counter runs pending jobs instead
+ *  of blocking, so jobs may submit and wait on other jobs without running out
+ *  of threads.
  *
- * @ARTICLE{Michael98non-blockingalgorithms,
- *    author = {Maged M. Michael and Michael L. Scott},
- *    title = {Non-Blocking Algorithms and Preemption-Safe Locking on Multiprogrammed Shared Memory Multiprocessors},
- *    journal = {Journal of Parallel and Distributed Computing},
- *    year = {1998},
- *    volume = {51},
- *    pages = {1--26},
- * }
- *
- * @note The algorithm/strategy for killing idle workers should be moved into
- *       the threadhandler and it should also be improved (the current strategy
- *       is probably not very good).
+ * The deques are protected by a mutex each instead of being lock-free, as SDL
+ *  1.2 has no atomic operations. Jobs are expected to be coarse enough (see the
+ *  grain in threadpool_parallelFor) that this doesn't matter.
  */
 
 
 #include "threadpool.h"
 
+#include "naev.h"
+
 #include "SDL.h"
 #include "SDL_thread.h"
 
 #include <stdlib.h>
 
 #include "log.h"
+#include "array.h"
+
 
+#define THREADPOOL_DEQUE_INIT 64 /**< Initial capacity of a worker deque. */
+#define THREADPOOL_WORKERS    4 /**< Workers to use if CPU count is unknown. */
 
-#define THREADPOOL_TIMEOUT (5 * 100) /* The time a worker thread waits in ms. */
-#define THREADSIG_STOP     (1) /* The signal to stop a worker thread */
-#define THREADSIG_RUN      (0) /* The signal to indicate the worker thread is running */
 
+/**
+ * @brief A job in a deque.
+ */
+typedef struct ThreadJob_ {
+   int (*function)(void *);   /**< The function to be called. */
+   void *data;                /**< And its arguments. */
+   ThreadCounter *counter;    /**< Counter to decrement when done, may be NULL. */
+} ThreadJob;
 
 /**
- * Threads to use.
+ * @brief Double ended job queue (ring buffer).
  */
-static int MAXTHREADS = 8; /* Bit overkill, but oh well. */
+typedef struct ThreadDeque_ {
+   SDL_mutex *lock;  /**< Protects the deque. */
+   ThreadJob *jobs;  /**< Ring buffer of jobs. */
+   int head;         /**< Index of the oldest job, where thieves take. */
+   int n;            /**< Number of jobs in the deque. */
+   int cap;          /**< Capacity of the ring buffer. */
+} ThreadDeque;
 
+/**
+ * @brief Worker thread data.
+ */
+typedef struct ThreadWorker_ {
+   int id;              /**< Index of the worker, and of its deque. */
+   unsigned long tid;   /**< SDL thread identifier. */
+   SDL_Thread *thread;  /**< The thread itself. */
+} ThreadWorker;
 
 /**
- * @brief Node in the thread queue.
+ * @brief A chunk of a threadpool_parallelFor range.
  */
-typedef struct Node_ {
-   void *data;          /* The element in the list */
-   struct Node_ *next;  /* The next node in the list */
-} Node;
+typedef struct ThreadRange_ {
+   void (*function)(int, int, void *); /**< Function to run over the range. */
+   void *data;    /**< User data. */
+   int start;     /**< First index. */
+   int end;       /**< Index after the last. */
+} ThreadRange;
 
 /**
- * @brief Threadqueue itself.
+ * @brief Virtual thread pool (batch of jobs to run and wait on).
  */
 struct ThreadQueue_ {
-   Node *first;         /* The first node */
-   Node *last;          /* The second node */
-   /* A semaphore to ensure reads only happen when the queue is not empty */
-   SDL_sem *semaphore;
-   SDL_mutex *t_lock;   /* Tail lock. Lock when reading/updating tail */
-   SDL_mutex *h_lock;   /* Same as tail lock, except it's head lock */
+   ThreadJob *jobs;  /**< Jobs in the batch (array.h). */
 };
 
-/**
- * @brief Data for the threadqueue.
+
+static int tp_nworkers           = 0; /**< Number of worker threads. */
+static ThreadWorker *tp_workers  = NULL; /**< Worker threads. */
+static ThreadDeque *tp_deques    = NULL; /**< Deques, one per worker plus a shared one. */
+static SDL_mutex *tp_lock        = NULL; /**< Protects tp_pending, counters and sleeping. */
+static SDL_cond *tp_cond         = NULL; /**< Signalled on new jobs and finished counters. */
+static int tp_pending            = 0; /**< Jobs sitting in the deques. */
+static int tp_quit               = 0; /**< Workers should exit once out of jobs. */
+
+
+/*
+ * Prototypes.
  */
-typedef struct ThreadQueueData_ {
-   int (*function)(void *);  /* The function to be called */
-   void *data;               /* And its arguments */
-} ThreadQueueData;
+static void tp_dequeInit( ThreadDeque *dq );
+static void tp_dequePush( ThreadDeque *dq, const ThreadJob *job );
+static int tp_dequePopBack( ThreadDeque *dq, ThreadJob *job );
+static int tp_dequePopFront( ThreadDeque *dq, ThreadJob *job );
+static int tp_self (void);
+static int tp_getJob( int self, ThreadJob *job );
+static void tp_runJob( ThreadJob *job );
+static int threadpool_worker( void *data );
+static int threadpool_rangeWorker( void *data );
+
 
 /**
- * @brief Thread data.
+ * @brief Initializes an empty deque.
  */
-typedef struct ThreadData_ {
-   int (*function)(void *); /* The function to be called */
-   void *data;             /* Arguments to the above function */
-   int signal;             /* Signals to the thread */
-   SDL_sem *semaphore;     /* The semaphore to signal new jobs or new signal in the
-                              'signal' variable */
-   ThreadQueue *idle;      /* The queue with idle threads */
-   ThreadQueue *stopped;   /* The queue with stopped threads */
-} ThreadData;
+static void tp_dequeInit( ThreadDeque *dq )
+{
+   dq->lock = SDL_CreateMutex();
+   dq->cap  = THREADPOOL_DEQUE_INIT;
+   dq->jobs = malloc( sizeof(ThreadJob) * dq->cap );
+   dq->head = 0;
+   dq->n    = 0;
+}
+
 
 /**
- * @brief Virtual thread pool data.
+ * @brief Pushes a job at the back of a deque, growing it if needed.
  */
-typedef struct vpoolThreadData_ {
-   SDL_cond *cond;         /* Condition variable for signalling all jobs in the vpool
-                              are done */
-   SDL_mutex *mutex;       /* The mutex to use with the above condition variable */
-   int *count;             /* Variable to count number of finished jobs in the vpool */
-   ThreadQueueData *node;  /* The job to be done */
-} vpoolThreadData;
+static void tp_dequePush( ThreadDeque *dq, const ThreadJob *job )
+{
+   ThreadJob *jobs;
+   int i;
+
+   SDL_mutexP( dq->lock );
+   if (dq->n >= dq->cap) {
+      /* Unwrap into a buffer twice as large. */
+      jobs = malloc( sizeof(ThreadJob) * 2 * dq->cap );
+      for (i=0; i<dq->n; i++)
+         jobs[i] = dq->jobs[ (dq->head + i) % dq->cap ];
+      free( dq->jobs );
+      dq->jobs = jobs;
+      dq->head = 0;
+      dq->cap *= 2;
+   }
+   dq->jobs[ (dq->head + dq->n) % dq->cap ] = *job;
+   dq->n++;
+   SDL_mutexV( dq->lock );
+}
+
 
-/* The global threadpool queue */
-static ThreadQueue *global_queue = NULL;
+/**
+ * @brief Pops the newest job of a deque (owner side).
+ *
+ *    @return 1 if a job was popped.
+ */
+static int tp_dequePopBack( ThreadDeque *dq, ThreadJob *job )
+{
+   int ret;
+
+   ret = 0;
+   SDL_mutexP( dq->lock );
+   if (dq->n > 0) {
+      dq->n--;
+      *job = dq->jobs[ (dq->head + dq->n) % dq->cap ];
+      ret  = 1;
+   }
+   SDL_mutexV( dq->lock );
+   return ret;
+}
 
 
-/*
- * Prototypes.
+/**
+ * @brief Pops the oldest job of a deque (thief side).
+ *
+ *    @return 1 if a job was popped.
  */
-static ThreadQueue* tq_create (void);
-static void tq_enqueue( ThreadQueue *q, void *data );
-static void* tq_dequeue( ThreadQueue *q );
-static void tq_destroy( ThreadQueue *q );
-static int threadpool_worker( void *data );
-static int threadpool_handler( void *data );
-static int vpool_worker( void *data );
+static int tp_dequePopFront( ThreadDeque *dq, ThreadJob *job )
+{
+   int ret;
+
+   ret = 0;
+   SDL_mutexP( dq->lock );
+   if (dq->n > 0) {
+      *job     = dq->jobs[ dq->head ];
+      dq->head = (dq->head + 1) % dq->cap;
+      dq->n--;
+      ret      = 1;
+   }
+   SDL_mutexV( dq->lock );
+   return ret;
+}
 
 
 /**
- * @brief Creates a concurrent queue.
+ * @brief Gets the deque owned by the calling thread.
  *
- * The basic concept is that we have a separate lock for both head and tail, so
- *  we can operate separately on either head or tail. This lets us enqueue at
- *  tail and dequeue at the head in true FIFO fashion.
+ *    @return Index of the worker deque, or the shared deque for other threads.
+ */
+static int tp_self (void)
+{
+   int i;
+   unsigned long tid;
+
+   tid = (unsigned long) SDL_ThreadID();
+   for (i=0; i<tp_nworkers; i++)
+      if (tp_workers[i].tid == tid)
+         return i;
+   return tp_nworkers;
+}
+
+
+/**
+ * @brief Gets a job to run, first from our own deque and then by stealing.
  *
- *    @return The ThreadQueue.
+ *    @param self Deque owned by the calling thread.
+ *    @param[out] job Job obtained.
+ *    @return 1 if a job was obtained.
  */
-static ThreadQueue* tq_create (void)
+static int tp_getJob( int self, ThreadJob *job )
 {
-   ThreadQueue *q;
-   Node *n;
+   int i, n, victim;
+
+   n = tp_nworkers + 1;
+   if (!tp_dequePopBack( &tp_deques[self], job )) {
+      for (i=1; i<n; i++) {
+         victim = (self + i) % n;
+         if (tp_dequePopFront( &tp_deques[victim], job ))
+            break;
+      }
+      if (i >= n)
+         return 0;
+   }
+
+   SDL_mutexP( tp_lock );
+   tp_pending--;
+   SDL_mutexV( tp_lock );
+   return 1;
+}
 
-   /* Queue memory allocation. */
-   q        = calloc( 1, sizeof(ThreadQueue) );
 
-   /* Allocate and insert the dummy node */
-   n        = calloc( 1, sizeof(Node) );
-   n->next  = NULL;
-   q->first = n;
-   q->last  = n;
+/**
+ * @brief Runs a job and signals its counter.
+ */
+static void tp_runJob( ThreadJob *job )
+{
+   job->function( job->data );
 
-   /* Create locks. */
-   q->t_lock      = SDL_CreateMutex();
-   q->h_lock      = SDL_CreateMutex();
-   q->semaphore   = SDL_CreateSemaphore( 0 );
+   if (job->counter == NULL)
+      return;
 
-   return q;
+   SDL_mutexP( tp_lock );
+   job->counter->count--;
+   if (job->counter->count <= 0)
+      SDL_CondBroadcast( tp_cond );
+   SDL_mutexV( tp_lock );
 }
 
+
 /**
- * @brief Enqueue data to the ThreadQueue q.
+ * @brief The worker function for the threadpool.
+ *
+ * Runs jobs from its own deque, steals when empty and sleeps when there is
+ *  nothing left anywhere. Exits once out of jobs after threadpool_exit().
  *
- *    @param q The queue to be inserted into.
- *    @param data The element to be stored in the queue.
+ *    @param data A pointer to the ThreadWorker.
  */
-static void tq_enqueue( ThreadQueue *q, void *data )
+static int threadpool_worker( void *data )
 {
-   Node *n;
+   ThreadWorker *work;
+   ThreadJob job;
 
-   /* Allocate new struct. */
-   n        = calloc( 1, sizeof(Node) );
-   n->data  = data;
-   n->next  = NULL;
+   work = (ThreadWorker*) data;
 
-   /* Lock */
-   SDL_mutexP( q->t_lock );
+   /* Wait for threadpool_init() to publish the thread identifiers. */
+   SDL_mutexP( tp_lock );
+   SDL_mutexV( tp_lock );
+
+   while (1) {
+      if (tp_getJob( work->id, &job )) {
+         tp_runJob( &job );
+         continue;
+      }
 
-   /* Enqueue. */
-   q->last->next  = n;
-   q->last        = n;
+      /* Nothing to do, sleep until a job is submitted. */
+      SDL_mutexP( tp_lock );
+      if (tp_quit) {
+         SDL_mutexV( tp_lock );
+         break;
+      }
+      if (tp_pending <= 0)
+         SDL_CondWait( tp_cond, tp_lock );
+      SDL_mutexV( tp_lock );
+   }
 
-   /* Signal and unlock. This wil break if someone tries to enqueue 2^32+1
-    * elements or something. */
-   SDL_SemPost( q->semaphore );
-   SDL_mutexV( q->t_lock );
+   return 0;
 }
 
+
 /**
- * @brief Dequeue from the ThreadQueue q.
- *
- * @attention The callee should ALWAYS have called SDL_SemWait() on the semaphore.
+ * @brief Initialize the global threadpool.
  *
- *    @param q The queue to dequeue from.
- *    @return A void pointer to the element from the queue.
+ *    @return Returns 0 on success and -1 if there's already a threadpool.
  */
-static void* tq_dequeue( ThreadQueue *q )
+int threadpool_init (void)
 {
-   void *d;
-   Node *newhead, *node;
-
-   /* Lock the head. */
-   SDL_mutexP( q->h_lock );
-
-   /* Start running. */
-   node     = q->first;
-   newhead  = node->next;
-
-   /* Head not consistent. */
-   if (newhead == NULL) {
-      WARN(_("Tried to dequeue while the queue was empty!"));
-      /* Ugly fix :/ */
-      /*
-      SDL_mutexV(q->h_lock);
-      return NULL;
-      */
-      /* We prefer to wait until the cache updates :/ */
-      do {
-         node     = q->first;
-         newhead  = node->next;
-      } while (newhead == NULL);
+   int i;
+
+   /* There's already a pool */
+   if (tp_deques != NULL) {
+      WARN(_("Threadpool has already been initialized!"));
+      return -1;
    }
 
-   /* Remember the value and assign newhead as the new dummy element. */
-   d        = newhead->data;
-   q->first = newhead;
+   /* The thread waiting on jobs helps out, so leave it a core. */
+#if SDL_VERSION_ATLEAST(1,3,0)
+   tp_nworkers = MAX( 1, SDL_GetCPUCount() - 1 );
+#else /* SDL_VERSION_ATLEAST(1,3,0) */
+   tp_nworkers = THREADPOOL_WORKERS;
+#endif /* SDL_VERSION_ATLEAST(1,3,0) */
 
-   /* Unlock */
-   SDL_mutexV( q->h_lock );
+   tp_lock     = SDL_CreateMutex();
+   tp_cond     = SDL_CreateCond();
+   tp_pending  = 0;
+
+   /* One deque per worker and a shared one for other threads. */
+   tp_deques   = calloc( tp_nworkers+1, sizeof(ThreadDeque) );
+   for (i=0; i<tp_nworkers+1; i++)
+      tp_dequeInit( &tp_deques[i] );
+
+   /* Identifiers are set while holding the lock, which the workers take
+    * before doing anything, so tp_self() always sees them. */
+   tp_workers  = calloc( tp_nworkers, sizeof(ThreadWorker) );
+   SDL_mutexP( tp_lock );
+   for (i=0; i<tp_nworkers; i++) {
+      tp_workers[i].id     = i;
+      tp_workers[i].thread = SDL_CreateThread( threadpool_worker,
+#if SDL_VERSION_ATLEAST(1,3,0)
+            "threadpool_worker",
+#endif /* SDL_VERSION_ATLEAST(1,3,0) */
+            &tp_workers[i] );
+      tp_workers[i].tid    = (unsigned long) SDL_GetThreadID( tp_workers[i].thread );
+   }
+   SDL_mutexV( tp_lock );
 
-   free( node );
-   return d;
+   DEBUG(_("Threadpool started with %d workers"), tp_nworkers);
+   return 0;
 }
 
+
 /**
- * @brief Destroys and frees a ThreadQueue.
+ * @brief Stops the global threadpool.
  *
- * Frees all elements too.
- *
- *    @param q The ThreadQueue to free.
+ * Jobs still pending are run before the workers exit, then every worker is
+ *  joined.
  */
-static void tq_destroy( ThreadQueue *q )
+void threadpool_exit (void)
 {
-   /* Iterate through the list and free the nodes */
-   while (q->first->next != NULL)
-      free( tq_dequeue(q) ); /* Locks q->t_lock, so we must destroy mutex after. */
+   int i;
+
+   if (tp_deques == NULL)
+      return;
 
-   /* Clean up threading structures. */
-   SDL_DestroySemaphore( q->semaphore );
-   SDL_DestroyMutex( q->h_lock );
-   SDL_DestroyMutex( q->t_lock );
+   SDL_mutexP( tp_lock );
+   tp_quit = 1;
+   SDL_CondBroadcast( tp_cond );
+   SDL_mutexV( tp_lock );
 
-   free( q->first );
-   free( q );
+   for (i=0; i<tp_nworkers; i++)
+      SDL_WaitThread( tp_workers[i].thread, NULL );
+   free( tp_workers );
+   tp_workers  = NULL;
+
+   for (i=0; i<tp_nworkers+1; i++) {
+      SDL_DestroyMutex( tp_deques[i].lock );
+      free( tp_deques[i].jobs );
+   }
+   free( tp_deques );
+   tp_deques   = NULL;
+   tp_nworkers = 0;
+
+   SDL_DestroyCond( tp_cond );
+   SDL_DestroyMutex( tp_lock );
+   tp_cond     = NULL;
+   tp_lock     = NULL;
+   tp_pending  = 0;
+   tp_quit     = 0;
 }
 
 
 /**
- * @brief Enqueues a new job for the threadpool.
+ * @brief Submits a job to the threadpool.
  *
- * @warning Do NOT enqueue a job that has to wait for another job to be done as
- *          this could lead to a deadlock.
+ * Jobs submitted from a worker go to its own deque, other threads use the
+ *  shared one.
  *
  *    @param function The function (job) to be called (executed).
  *    @param data The arguments for the function.
+ *    @param counter Counter to track completion with, may be NULL.
  *    @return Returns 0 on success and -2 if there was no threadpool.
  */
-int threadpool_newJob( int (*function)(void *), void *data )
+int threadpool_submit( int (*function)(void *), void *data, ThreadCounter *counter )
 {
-   ThreadQueueData *node;
+   ThreadJob job;
 
-   if (global_queue == NULL) {
+   if (tp_deques == NULL) {
       WARN(_("Threadpool has not been initialized yet!"));
       return -2;
    }
 
-   /* Allocate and set parameters. */
-   node           = calloc( 1, sizeof(ThreadQueueData) );
-   node->data     = data;
-   node->function = function;
+   job.function = function;
+   job.data     = data;
+   job.counter  = counter;
+
+   /* Counter must be up before the job can possibly finish. */
+   SDL_mutexP( tp_lock );
+   if (counter != NULL)
+      counter->count++;
+   SDL_mutexV( tp_lock );
+
+   tp_dequePush( &tp_deques[ tp_self() ], &job );
 
-   /* Actually enque. */
-   tq_enqueue( global_queue, node );
+   /* Broadcast, a thread waiting on a counter that is already done won't pick
+    * it up. */
+   SDL_mutexP( tp_lock );
+   tp_pending++;
+   SDL_CondBroadcast( tp_cond );
+   SDL_mutexV( tp_lock );
 
    return 0;
 }
 
+
 /**
- * @brief The worker function for the threadpool.
+ * @brief Enqueues a new job for the threadpool without tracking it.
  *
- * It waits for a signal from the handler. If it receives THREADSIG_STOP it
- *  means the worker thread should stop. Else it dequeues a job from the
- *  global_queue and executes it.
- *
- *    @param data A pointer to the ThreadData struct used for a lot of stuff.
+ *    @param function The function (job) to be called (executed).
+ *    @param data The arguments for the function.
+ *    @return Returns 0 on success and -2 if there was no threadpool.
  */
-static int threadpool_worker( void *data )
+int threadpool_newJob( int (*function)(void *), void *data )
 {
-   ThreadData *work;
-
-   work = (ThreadData*) data;
-
-   /* Work loop */
-   while (1) {
-      /* Wait for new signal */
-      while (SDL_SemWait( work->semaphore ) == -1) {
-          /* Putting this in a while-loop is probably a really bad idea, but I
-           * don't have any better ideas. */
-          WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      /* Break if received signal to stop */
-      if (work->signal == THREADSIG_STOP)
-         break;
-
-      /* Do work :-) */
-      work->function( work->data );
-
-      /* Enqueue itself in the idle worker threads queue */
-      tq_enqueue( work->idle, work );
-   }
-   /* Enqueue itself in the stopped worker threads queue when stopped */
-   tq_enqueue( work->stopped, work );
-
-   return 0;
+   return threadpool_submit( function, data, NULL );
 }
 
+
 /**
- * @brief Handles assigning jobs to the workers and killing them if necessary.
- *
- * @note Stopping the threeadpool_handler is not yet implemented.
+ * @brief Blocks until every job tracked by a counter is done.
  *
- * Process is:
+ * The calling thread runs pending jobs while it waits, so this may be called
+ *  from inside a job.
  *
- * 1) Wait for job
- * 2) if Timed out -> kill idle, putting on stopped, go to 1)
- * 3) Have thread run job
- * 3.1) Grab a job from the queue
- * 3.2) If idle thread, grab idle thread
- *      else if stopped threads, reactivate stopped thread
- *      else wait for running thread
- * 4) Go to 1)
- *
- *    @param data Not used. SDL threading requires functions to take a void
- *                pointer as argument.
- *    @return Not really implemented yet.
+ *    @param counter Counter to wait on.
  */
-static int threadpool_handler( void *data )
+void threadpool_wait( ThreadCounter *counter )
 {
-   (void) data;
-   int i, nrunning, newthread;
-   ThreadData *threadargs, *threadarg;
-   /* Queues for idle workers and stopped workers */
-   ThreadQueue *idle, *stopped;
-   ThreadQueueData *node;
-
-   /* Initialize the idle and stopped queues. */
-   idle     = tq_create();
-   stopped  = tq_create();
-
-   /* Allocate threadargs to communicate with workers */
-   threadargs = calloc( MAXTHREADS, sizeof(ThreadData) );
-
-   /* Initialize threadargs */
-   for (i=0; i<MAXTHREADS; i++) {
-      threadargs[i].function  = NULL;
-      threadargs[i].data      = NULL;
-      threadargs[i].semaphore = SDL_CreateSemaphore( 0 ); /* Used to give orders. */
-      threadargs[i].idle      = idle;
-      threadargs[i].stopped   = stopped;
-      threadargs[i].signal    = THREADSIG_RUN;
-      /* 'Workers' that do not have a thread are considered stopped */
-      tq_enqueue( stopped, &threadargs[i] );
-   }
+   ThreadJob job;
+   int self;
 
-   /* Set the number of running threads to 0 */
-   nrunning = 0;
+   if (tp_deques == NULL)
+      return;
 
-   /*
-    * Thread handler main loop.
-    */
+   self = tp_self();
    while (1) {
-      /*
-       * We must now wait, this shall be done on each active thread. However they will
-       * be put to sleep as time passes. When we receive a command we'll proceed to process
-       * it.
-       */
-      if (nrunning > 0) {
-         /*
-          * Here we'll wait until thread gets work to do. If it doesn't it will
-          * just stop a worker thread and wait until it gets something to do.
-          */
-         if (SDL_SemWaitTimeout( global_queue->semaphore, THREADPOOL_TIMEOUT ) != 0) {
-            /* There weren't any new jobs so we'll start killing threads ;) */
-            if (SDL_SemTryWait( idle->semaphore ) == 0) {
-               threadarg         = tq_dequeue( idle );
-               /* Set signal to stop worker thread */
-               threadarg->signal = THREADSIG_STOP;
-               /* Signal thread and decrement running threads counter */
-               SDL_SemPost( threadarg->semaphore );
-               nrunning -= 1;
-            }
-
-            /* We just go back to waiting on a thread. */
-            continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
-      else {
-         /*
-          * Here we wait for a new job. No threads are alive at this point and the
-          * threadpool is just patiently waiting for work to arrive.
-          */
-         if (SDL_SemWait( global_queue->semaphore ) == -1) {
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-             continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
-
-      /*
-       * Get a new job from the queue. This should be safe as we have received
-       * a permission from the global_queue->semaphore.
-       */
-      node        = tq_dequeue( global_queue );
-      newthread   = 0;
-
-      /*
-       * Choose where to get the thread. Either idle, revive stopped or block until
-       * another thread becomes idle.
-       */
-      /* Idle thread available */
-      if (SDL_SemTryWait(idle->semaphore) == 0)
-         threadarg         = tq_dequeue( idle );
-      /* Make a new thread */
-      else if (SDL_SemTryWait(stopped->semaphore) == 0) {
-         threadarg         = tq_dequeue( stopped );
-         threadarg->signal = THREADSIG_RUN;
-         newthread         = 1;
+      SDL_mutexP( tp_lock );
+      if (counter->count <= 0) {
+         SDL_mutexV( tp_lock );
+         break;
       }
-      /* Wait for idle thread */
-      else {
-         while (SDL_SemWait(idle->semaphore) == -1) {
-             /* Bad idea */
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-         }
-         threadarg         = tq_dequeue( idle );
+      /* Remaining jobs are running elsewhere, wait for them to finish. */
+      if (tp_pending <= 0) {
+         SDL_CondWait( tp_cond, tp_lock );
+         SDL_mutexV( tp_lock );
+         continue;
       }
+      SDL_mutexV( tp_lock );
 
-      /* Assign arguments for the thread */
-      threadarg->function  = node->function;
-      threadarg->data      = node->data;
-      /* Signal the thread that there's a new job */
-      SDL_SemPost( threadarg->semaphore );
-
-      /* Start a new thread and increment the thread counter */
-      if (newthread) {
-         SDL_CreateThread( threadpool_worker,
-#if SDL_VERSION_ATLEAST(1,3,0)
-               "threadpool_worker",
-#endif /* SDL_VERSION_ATLEAST(1,3,0) */
-               threadarg );
-         nrunning += 1;
-      }
-
-      /* Free the now unused job from the global_queue */
-      free(node);
+      /* Help out in the meantime. */
+      if (tp_getJob( self, &job ))
+         tp_runJob( &job );
    }
-   /** @TODO A way to stop the threadpool. */
+}
 
-   /* Clean up. */
-   tq_destroy( idle );
-   tq_destroy( stopped );
-   free( threadargs );
 
+/**
+ * @brief Job running a chunk of a threadpool_parallelFor range.
+ */
+static int threadpool_rangeWorker( void *data )
+{
+   ThreadRange *range = (ThreadRange*) data;
+   range->function( range->start, range->end, range->data );
    return 0;
 }
 
+
 /**
- * @brief Initialize the global threadpool.
+ * @brief Runs a function over an index range in parallel and waits for it.
  *
- *    @return Returns 0 on success and -1 if there's already a threadpool.
+ * The range [start,end) is split into chunks of grain indices, each run as a
+ *  job that calls function(chunk_start, chunk_end, data).
+ *
+ *    @param start First index.
+ *    @param end Index after the last.
+ *    @param grain Indices per job (at least 1).
+ *    @param function Function to run over each chunk.
+ *    @param data User data to pass.
  */
-int threadpool_init (void)
+void threadpool_parallelFor( int start, int end, int grain,
+      void (*function)(int, int, void *), void *data )
 {
-#if SDL_VERSION_ATLEAST(1,3,0)
-   MAXTHREADS = SDL_GetCPUCount() + 1; /* SDL 1.3 is pretty cool. */
-#endif /* SDL_VERSION_ATLEAST(1,3,0) */
-
-   /* There's already a queue */
-   if (global_queue != NULL) {
-      WARN(_("Threadpool has already been initialized!"));
-      return -1;
+   int i, n;
+   ThreadRange *ranges;
+   ThreadCounter counter;
+
+   if (end <= start)
+      return;
+   grain = MAX( 1, grain );
+   n     = (end - start + grain - 1) / grain;
+
+   /* Not worth (or able) to go parallel. */
+   if ((n == 1) || (tp_deques == NULL)) {
+      function( start, end, data );
+      return;
    }
 
-   /* Create the global queue queue */
-   global_queue = tq_create();
-
-   /* Initialize the threadpool handler. */
-   SDL_CreateThread( threadpool_handler,
-#if SDL_VERSION_ATLEAST(1,3,0)
-               "threadpool_handler",
-#endif /* SDL_VERSION_ATLEAST(1,3,0) */
-               NULL );
-
-   return 0;
+   ranges = malloc( sizeof(ThreadRange) * n );
+   counter.count = 0;
+   for (i=0; i<n; i++) {
+      ranges[i].function = function;
+      ranges[i].data     = data;
+      ranges[i].start    = start + i*grain;
+      ranges[i].end      = MIN( end, ranges[i].start + grain );
+      threadpool_submit( threadpool_rangeWorker, &ranges[i], &counter );
+   }
+   threadpool_wait( &counter );
+   free( ranges );
 }
 
+
 /**
  * @brief Creates a new vpool queue.
  *
  * This is just an interface to make running a number of jobs and then wait for
- *  them to finish more pleasant. You should not nest vpools as of now as there
- *  are only a limit number of worker threads and we can't have them wait for a
- *  thread to finish that doesn't exist.
- *
- * If you really want to sort of nest vpools, you should start a new thread
- *  instead of using the threadpool. I might add a vpool_waitInANewThread
- *  function some day.
+ *  them to finish more pleasant.
  *
  *    @return Returns a ThreadQueue to be used.
  */
 ThreadQueue* vpool_create (void)
 {
-   return tq_create();
+   ThreadQueue *queue;
+
+   queue       = malloc( sizeof(ThreadQueue) );
+   queue->jobs = array_create( ThreadJob );
+   return queue;
 }
 
+
 /**
  * @brief Enqueue a job in the vpool queue.
- *
- * @warning Do NOT enqueue jobs that wait for another job to be done, as this
- *          could lead to a deadlock.
- *
- * @warning Do NOT enqueue jobs that wait for a vpool, as this could lead to a
- *          deadlock.
  */
 void vpool_enqueue( ThreadQueue *queue, int (*function)(void *), void *data )
 {
-   ThreadQueueData *node;
-
-   /* Allocate and set up data. */
-   node           = calloc( 1, sizeof(ThreadQueueData) );
-   node->data     = data;
-   node->function = function;
+   ThreadJob *job;
 
-   /* Add to vpool. */
-   tq_enqueue( queue, node );
+   job            = &array_grow( &queue->jobs );
+   job->function  = function;
+   job->data      = data;
+   job->counter   = NULL;
 }
 
-/**
- * @brief A special vpool worker that signals the waiting thread when all jobs
- *        are done.
- *
- * It uses a mutex+condition variable+counter.
- */
-static int vpool_worker( void *data )
-{
-   int cnt;
-   vpoolThreadData *work;
-
-   work = (vpoolThreadData*) data;
-
-   /* Do work */
-   work->node->function( work->node->data );
 
-   /* Decrement the counter and signal vpool_wait if all threads are done */
-   SDL_mutexP( work->mutex );
-   cnt   = *(work->count) - 1;
-   if (cnt <= 0)                    /* All jobs done. */
-      SDL_CondSignal( work->cond );  /* Signal waiting thread */
-   *(work->count) = cnt;
-   SDL_mutexV( work->mutex );
-
-   return 0;
-}
-
-/* @brief Run every job in the vpool queue and block until every job in the
+/**
+ * @brief Run every job in the vpool queue and block until every job in the
  *        queue is done.
  *
  * @note It destroys the queue when it's done.
  */
 void vpool_wait( ThreadQueue *queue )
 {
-   int i, cnt;
-   SDL_cond *cond;
-   SDL_mutex *mutex;
-   vpoolThreadData *arg;
-   ThreadQueueData *node;
-
-   /* Create temporary threading structures. */
-   cond  = SDL_CreateCond();
-   mutex = SDL_CreateMutex();
-   /* This might be a little ugly (and inefficient?) */
-   cnt   = SDL_SemValue( queue->semaphore );
-
-   /* Allocate all vpoolThreadData objects */
-   arg = calloc( cnt, sizeof(vpoolThreadData) );
-
-   SDL_mutexP( mutex );
-   /* Initialize the vpoolThreadData */
-   for (i=0; i<cnt; i++) {
-      /* This is needed to keep the invariants of the queue */
-      while (SDL_SemWait( queue->semaphore ) == -1) {
-          /* Again, a really bad idea */
-          WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      node = tq_dequeue( queue );
+   int i;
+   ThreadCounter counter;
 
-      /* Set up arguments. */
-      arg[i].node    = node;
-      arg[i].cond    = cond;
-      arg[i].mutex   = mutex;
-      arg[i].count   = &cnt;
+   counter.count = 0;
+   for (i=0; i<array_size(queue->jobs); i++)
+      if (threadpool_submit( queue->jobs[i].function, queue->jobs[i].data, &counter ))
+         queue->jobs[i].function( queue->jobs[i].data );
+   threadpool_wait( &counter );
 
-      /* Launch new job. */
-      threadpool_newJob( vpool_worker, &arg[i] );
-   }
-
-   /* Wait for the threads to finish */
-   SDL_CondWait( cond, mutex );
-   SDL_mutexV( mutex );
-
-   /* Clean up */
-   SDL_DestroyMutex( mutex );
-   SDL_DestroyCond( cond );
-   tq_destroy( queue );
-   free( arg );
+   array_free( queue->jobs );
+   free( queue );
 }
-
-
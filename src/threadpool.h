@@ -21,18 +21,37 @@
 struct ThreadQueue_;
 typedef struct ThreadQueue_ ThreadQueue;
 
+/* Tracks completion of a group of jobs. Zero-initialize before use, it is
+ * incremented on submit and decremented when each job is done. */
+typedef struct ThreadCounter_ {
+   int count;
+} ThreadCounter;
+
 
 /* Initializes the threadpool */
 int threadpool_init( void );
 
+/* Runs the pending jobs and joins the worker threads */
+void threadpool_exit( void );
+
 /* Enqueues a new job */
 int threadpool_newJob( int (*function)(void *), void *data );
 
+/* Submits a job tracked by counter (may be NULL). Jobs may submit more jobs. */
+int threadpool_submit( int (*function)(void *), void *data, ThreadCounter *counter );
+
+/* Waits for every job of counter to be done, running pending jobs meanwhile.
+ * Safe to call from inside a job. */
+void threadpool_wait( ThreadCounter *counter );
+
+/* Runs function over [start,end) in chunks of grain indices and waits. */
+void threadpool_parallelFor( int start, int end, int grain,
+      void (*function)(int, int, void *), void *data );
+
 /* Creates a new vpool queue */
 ThreadQueue* vpool_create( void );
 
-/* Enqueue a job in the vpool queue. Do NOT enqueue a job that has to wait for
- * another job to be done as this could lead to a deadlock. */
+/* Enqueue a job in the vpool queue. */
 void vpool_enqueue( ThreadQueue* queue, int (*function)(void *), void *data );
 
 /* Run every job in the vpool queue and block untill every job in the queue is
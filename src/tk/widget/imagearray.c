@@ -18,6 +18,7 @@
 
 
 /* Render. */
+static void iar_getRows( Widget* iar, double h, int *jstart, int *jend );
 static void iar_render( Widget* iar, double bx, double by );
 static void iar_renderOverlay( Widget* iar, double bx, double by );
 /* Key. */
@@ -105,6 +106,7 @@ void window_addImageArray( const unsigned int wid,
    wgt->dat.iar.ih         = ih;
    wgt->dat.iar.fptr       = call;
    wgt->dat.iar.rmptr      = rmcall;
+   wgt->dat.iar.loadptr    = NULL;
    wgt->dat.iar.xelem      = floor((w - 10.) / (double)(wgt->dat.iar.iw+10));
    wgt->dat.iar.yelem      = (wgt->dat.iar.xelem == 0) ? 0 :
          (int)wgt->dat.iar.nelements / wgt->dat.iar.xelem + 1;
@@ -126,6 +128,22 @@ static void iar_getDim( Widget* iar, double *w, double *h )
 }
 
 
+/**
+ * @brief Gets the range of rows that are at least partially in view.
+ *
+ *    @param iar Image array to get rows of.
+ *    @param h Height of an element.
+ *    @param[out] jstart First visible row.
+ *    @param[out] jend One past the last visible row.
+ */
+static void iar_getRows( Widget* iar, double h, int *jstart, int *jend )
+{
+   *jstart = MAX( 0, (int)floor( iar->dat.iar.pos / h ) );
+   *jend   = MIN( iar->dat.iar.yelem,
+         (int)ceil( (iar->dat.iar.pos + iar->h) / h ) );
+}
+
+
 /**
  * @brief Renders an image array.
  *
@@ -135,7 +153,7 @@ static void iar_getDim( Widget* iar, double *w, double *h )
  */
 static void iar_render( Widget* iar, double bx, double by )
 {
-   int i,j, pos;
+   int i,j, pos, jstart, jend;
    double x,y, w,h, xcurs,ycurs;
    double scroll_pos;
    int xelem, yelem;
@@ -178,16 +196,11 @@ static void iar_render( Widget* iar, double bx, double by )
     * Main drawing loop.
     */
    gl_clipRect( x, y, iar->w, iar->h );
-   ycurs = y + iar->h - h + iar->dat.iar.pos;
-   for (j=0; j<yelem; j++) {
+   iar_getRows( iar, h, &jstart, &jend );
+   ycurs = y + iar->h - h + iar->dat.iar.pos - jstart * h;
+   for (j=jstart; j<jend; j++) {
       xcurs = x + xspace;
 
-      /*  Skip rows that are wholly outside of the viewport. */
-      if ((ycurs > y + iar->h) || (ycurs + h < y)) {
-         ycurs -= h;
-         continue;
-      }
-
       for (i=0; i<xelem; i++) {
 
          /* Get position. */
@@ -216,7 +229,10 @@ static void iar_render( Widget* iar, double bx, double by )
                fontcolour = cBlack;
          }
 
-         /* image */
+         /* image, loaded the first time it becomes visible. */
+         if ((iar->dat.iar.images[pos] == NULL) && (iar->dat.iar.loadptr != NULL)
+               && (iar->dat.iar.captions[pos] != NULL))
+            iar->dat.iar.images[pos] = iar->dat.iar.loadptr( iar->dat.iar.captions[pos] );
          if (iar->dat.iar.images[pos] != NULL)
             gl_blitScale( iar->dat.iar.images[pos],
                   xcurs + 5., ycurs + gl_smallFont.h + 7.,
@@ -927,6 +943,46 @@ int toolkit_setImageArrayQuantity( const unsigned int wid, const char* name,
 }
 
 
+/**
+ * @brief Sets the quantity text of a single element in the image array.
+ *
+ * Allows updating an element in place instead of regenerating the widget.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param pos Element to update.
+ *    @param quantity Quantity text to set (freed) or NULL to clear it.
+ *    @return 0 on success.
+ */
+int toolkit_setImageArrayQuantityElem( const unsigned int wid, const char* name,
+      int pos, char *quantity )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL) {
+      free(quantity);
+      return -1;
+   }
+
+   if ((pos < 0) || (pos >= wgt->dat.iar.nelements)) {
+      WARN("Element %d out of range for image array '%s'.", pos, name);
+      free(quantity);
+      return -1;
+   }
+
+   /* Create the quantity array if needed. */
+   if (wgt->dat.iar.quantity == NULL) {
+      if (quantity == NULL)
+         return 0;
+      wgt->dat.iar.quantity = calloc( wgt->dat.iar.nelements, sizeof(char*) );
+   }
+
+   /* Set. */
+   free( wgt->dat.iar.quantity[pos] );
+   wgt->dat.iar.quantity[pos] = quantity;
+   return 0;
+}
+
+
 /**
  * @brief Sets the slot type text for the images in the image array.
  *
@@ -982,6 +1038,52 @@ int toolkit_setImageArrayBackground( const unsigned int wid, const char* name,
 }
 
 
+/**
+ * @brief Sets the function used to load images on demand.
+ *
+ * Elements whose image is NULL are passed to the loader by caption the first
+ *  time they are scrolled into view, so only visible images have to be
+ *  resident. The loaded textures are not freed by the image array.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param load Function that gets the image of an element from its caption.
+ *    @return 0 on success.
+ */
+int toolkit_setImageArrayLoader( const unsigned int wid, const char* name,
+      glTexture* (*load) (const char*) )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL)
+      return -1;
+
+   wgt->dat.iar.loadptr = load;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the captions of the elements in the image array.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param[out] n Number of elements.
+ *    @return The captions of the image array (not to be modified or freed).
+ */
+char** toolkit_getImageArrayCaptions( const unsigned int wid, const char* name,
+      int *n )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL) {
+      *n = 0;
+      return NULL;
+   }
+
+   *n = wgt->dat.iar.nelements;
+   return wgt->dat.iar.captions;
+}
+
+
 /**
  * @brief Stores several image array attributes.
  *
@@ -35,6 +35,7 @@ typedef struct WidgetImageArrayData_ {
    int ih; /**< Image height to use. */
    void (*fptr) (unsigned int,char*); /**< Modify callback - triggered on selection. */
    void (*rmptr) (unsigned int,char*); /**< Right click callback. */
+   glTexture* (*loadptr) (const char*); /**< Loads the image of an element on demand. */
 } WidgetImageArrayData;
 
 
@@ -66,10 +67,16 @@ int toolkit_setImageArrayOffset( const unsigned int wid, const char* name, doubl
 int toolkit_setImageArrayAlt( const unsigned int wid, const char* name, char **alt );
 int toolkit_setImageArrayQuantity( const unsigned int wid, const char* name,
       char **quantity );
+int toolkit_setImageArrayQuantityElem( const unsigned int wid, const char* name,
+      int pos, char *quantity );
 int toolkit_setImageArraySlotType( const unsigned int wid, const char* name,
       char **slottype );
 int toolkit_setImageArrayBackground( const unsigned int wid, const char* name,
       glColour *bg );
+int toolkit_setImageArrayLoader( const unsigned int wid, const char* name,
+      glTexture* (*load) (const char*) );
+char** toolkit_getImageArrayCaptions( const unsigned int wid, const char* name,
+      int *n );
 int toolkit_saveImageArrayData( const unsigned int wid, const char *name,
       iar_data_t *iar_data );
 
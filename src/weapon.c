@@ -31,6 +31,8 @@
 #include "gui.h"
 #include "camera.h"
 #include "ai.h"
+#include "spatial.h"
+#include "array.h"
 
 
 #define weapon_isSmart(w)     (w->think != NULL) /**< Checks if the weapon w is smart. */
@@ -101,11 +103,23 @@ static int mwfrontLayer = 0; /**< alloced memory size */
 static gl_vbo  *weapon_vbo     = NULL; /**< Weapon VBO. */
 static GLfloat *weapon_vboData = NULL; /**< Data of weapon VBO. */
 static int weapon_vboSize      = 0; /**< Size of the VBO. */
+static Weapon **weapon_renderList = NULL; /**< Weapons of a layer on the screen (array.h). */
+static int weapon_ndrawn      = 0; /**< Weapons drawn during the last frame. */
+static int weapon_nculled     = 0; /**< Weapons skipped for being off the screen. */
 
 
 /* Internal stuff. */
 static unsigned int beam_idgen = 0; /**< Beam identifier generator. */
 
+/* Explosions. */
+#define WEAPON_EXPL_CELL   500. /**< Size of the cells of the explosion index. */
+static SpatialGrid weapon_explGrid; /**< Weapons that may be caught in explosions. */
+static int *weapon_explIds    = NULL; /**< Weapons near an explosion (array.h). */
+static char *weapon_explHit   = NULL; /**< Weapons caught in an explosion (array.h). */
+#if EXPL_CHECK
+static char *weapon_explOld   = NULL; /**< Weapons the old loops catch (array.h). */
+#endif /* EXPL_CHECK */
+
 
 /*
  * Prototypes
@@ -123,14 +137,20 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       const Pilot *parent, const unsigned int target, double time );
 /* Updating. */
 static void weapon_render( Weapon* w, const double dt );
+static int weapon_onScreen( const Weapon *w,
+      double x1, double y1, double x2, double y2 );
 static void weapons_updateLayer( const double dt, const WeaponLayer layer );
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer );
 /* Destruction. */
 static void weapon_destroy( Weapon* w, WeaponLayer layer );
 static void weapon_free( Weapon* w );
+static int weapon_explodeAffects( const Weapon *w, int mode );
 static void weapon_explodeLayer( WeaponLayer layer,
-      double x, double y, double radius,
-      const Pilot *parent, int mode );
+      const ExplosionDamage *expl, int n, int mode );
+#if EXPL_CHECK
+static void weapon_explodeCheck( Weapon **curLayer, int nLayer,
+      const ExplosionDamage *expl, int n );
+#endif /* EXPL_CHECK */
 /* Hitting. */
 static int weapon_checkCanHit( Weapon* w, Pilot *p );
 static void weapon_hit( Weapon* w, Pilot* p, WeaponLayer layer, Vector2d* pos );
@@ -649,11 +669,15 @@ void weapons_render( const WeaponLayer layer, const double dt )
    Weapon** wlayer;
    int* nlayer;
    int i;
+   double x1, y1, x2, y2;
 
    switch (layer) {
       case WEAPON_LAYER_BG:
          wlayer = wbackLayer;
          nlayer = &nwbackLayer;
+         /* Background is rendered first, start counting the frame. */
+         weapon_ndrawn  = 0;
+         weapon_nculled = 0;
          break;
       case WEAPON_LAYER_FG:
          wlayer = wfrontLayer;
@@ -665,8 +689,64 @@ void weapons_render( const WeaponLayer layer, const double dt )
          return;
    }
 
+   /* Get the weapons on the screen. */
+   if (weapon_renderList == NULL)
+      weapon_renderList = array_create( Weapon* );
+   else
+      array_resize( &weapon_renderList, 0 );
+   cam_getBounds( &x1, &y1, &x2, &y2 );
    for (i=0; i<(*nlayer); i++)
-      weapon_render( wlayer[i], dt );
+      if (weapon_onScreen( wlayer[i], x1, y1, x2, y2 ))
+         array_push_back( &weapon_renderList, wlayer[i] );
+   weapon_ndrawn  += array_size(weapon_renderList);
+   weapon_nculled += (*nlayer) - array_size(weapon_renderList);
+
+   for (i=0; i<array_size(weapon_renderList); i++)
+      weapon_render( weapon_renderList[i], dt );
+}
+
+
+/**
+ * @brief Checks to see if a weapon can be seen on the screen.
+ *
+ * Beams are always rendered as they can be long and animate while rendering.
+ *  Spinning sprites don't advance while off the screen.
+ *
+ *    @param w Weapon to check.
+ *    @param x1 Left of the screen in game coordinates.
+ *    @param y1 Bottom of the screen in game coordinates.
+ *    @param x2 Right of the screen in game coordinates.
+ *    @param y2 Top of the screen in game coordinates.
+ *    @return 1 if the weapon should be rendered.
+ */
+static int weapon_onScreen( const Weapon *w,
+      double x1, double y1, double x2, double y2 )
+{
+   glTexture *gfx;
+   double r;
+
+   if (outfit_isBeam(w->outfit))
+      return 1;
+
+   gfx = outfit_gfx(w->outfit);
+   if (gfx == NULL)
+      return 1;
+   r = MAX( gfx->sw, gfx->sh ) / 2.;
+   return (w->solid->pos.x + r >= x1) && (w->solid->pos.x - r <= x2) &&
+         (w->solid->pos.y + r >= y1) && (w->solid->pos.y - r <= y2);
+}
+
+
+/**
+ * @brief Gets how many weapons were drawn and culled in the last frame.
+ *
+ *    @param[out] drawn Weapons drawn.
+ *    @param[out] culled Weapons skipped for being off the screen.
+ */
+void weapons_renderStats( int *drawn, int *culled )
+{
+   *drawn  = weapon_ndrawn;
+   *culled = weapon_nculled;
 }
 
 
@@ -1398,7 +1478,7 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
    /* Set up ammo details. */
    mass        = w->outfit->mass;
    w->timer    = ammo->u.amm.duration;
-   w->solid    = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
+   w->solid    = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_ANALYTIC );
    if (w->outfit->u.amm.thrust != 0.) {
       weapon_setThrust( w, w->outfit->u.amm.thrust * mass );
       w->solid->speed_max = w->outfit->u.amm.speed; /* Limit speed, we only care if it has thrust. */
@@ -1846,34 +1926,71 @@ void weapon_exit (void)
       gl_vboDestroy( weapon_vbo );
       weapon_vbo = NULL;
    }
+
+   /* Destroy explosion index. */
+   if (weapon_explGrid.buckets != NULL) {
+      spatial_free( &weapon_explGrid );
+      array_free( weapon_explIds );
+      array_free( weapon_explHit );
+      weapon_explIds = NULL;
+      weapon_explHit = NULL;
+#if EXPL_CHECK
+      array_free( weapon_explOld );
+      weapon_explOld = NULL;
+#endif /* EXPL_CHECK */
+   }
+
+   /* Destroy render list. */
+   array_free( weapon_renderList );
+   weapon_renderList = NULL;
+}
+
+
+/**
+ * @brief Clears the missiles and bolts caught in explosions.
+ *
+ *    @param expl Explosions to check.
+ *    @param n Number of explosions.
+ */
+void weapons_explode( const ExplosionDamage *expl, int n )
+{
+   int i, mode;
+
+   /* Only missiles and bolts can be caught. */
+   mode = 0;
+   for (i=0; i<n; i++)
+      mode |= expl[i].mode;
+   if (!(mode & (EXPL_MODE_MISSILE | EXPL_MODE_BOLT)))
+      return;
+
+   weapon_explodeLayer( WEAPON_LAYER_FG, expl, n, mode );
+   weapon_explodeLayer( WEAPON_LAYER_BG, expl, n, mode );
 }
 
 
 /**
- * @brief Clears possible exploded weapons.
+ * @brief Checks to see if an explosion mode affects a weapon.
  */
-void weapon_explode( double x, double y, double radius,
-      int dtype, double damage,
-      const Pilot *parent, int mode )
+static int weapon_explodeAffects( const Weapon *w, int mode )
 {
-   (void)dtype;
-   (void)damage;
-   weapon_explodeLayer( WEAPON_LAYER_FG, x, y, radius, parent, mode );
-   weapon_explodeLayer( WEAPON_LAYER_BG, x, y, radius, parent, mode );
+   return ((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(w->outfit)) ||
+         ((mode & EXPL_MODE_BOLT) && outfit_isBolt(w->outfit));
 }
 
 
 /**
  * @brief Explodes all the things on a layer.
+ *
+ * The weapons that can be caught are put in a spatial index once, and the
+ *  ones inside any explosion are removed from the layer in a single pass.
  */
 static void weapon_explodeLayer( WeaponLayer layer,
-      double x, double y, double radius,
-      const Pilot *parent, int mode )
+      const ExplosionDamage *expl, int n, int mode )
 {
-   (void)parent;
-   int i;
+   int i, j;
    Weapon **curLayer;
    int *nLayer;
+   Weapon *w;
    double dist, rad2;
 
    /* set the proper layer */
@@ -1892,22 +2009,114 @@ static void weapon_explodeLayer( WeaponLayer layer,
          return;
    }
 
-   rad2 = radius*radius;
+   if (weapon_explGrid.buckets == NULL) {
+      spatial_init( &weapon_explGrid, WEAPON_EXPL_CELL );
+      weapon_explHit = array_create( char );
+   }
+
+   /* Index the weapons that may be caught. */
+   spatial_clear( &weapon_explGrid );
+   for (i=0; i<*nLayer; i++)
+      if (weapon_explodeAffects( curLayer[i], mode ))
+         spatial_insert( &weapon_explGrid, i,
+               curLayer[i]->solid->pos.x, curLayer[i]->solid->pos.y );
+   if (array_size(weapon_explGrid.entries) == 0)
+      return;
+   array_resize( &weapon_explHit, *nLayer );
+   memset( weapon_explHit, 0, *nLayer );
+
+   /* Mark the weapons affected. */
+   for (i=0; i<n; i++) {
+      if (!(expl[i].mode & (EXPL_MODE_MISSILE | EXPL_MODE_BOLT)))
+         continue;
+      rad2 = pow2(expl[i].radius);
+      spatial_query( &weapon_explGrid, &weapon_explIds,
+            expl[i].x, expl[i].y, expl[i].radius );
+      for (j=0; j<array_size(weapon_explIds); j++) {
+         w = curLayer[ weapon_explIds[j] ];
+         if (!weapon_explodeAffects( w, expl[i].mode ))
+            continue;
+
+         dist = pow2(w->solid->pos.x - expl[i].x) +
+               pow2(w->solid->pos.y - expl[i].y);
+         if (dist < rad2)
+            weapon_explHit[ weapon_explIds[j] ] = 1;
+      }
+   }
+#if EXPL_CHECK
+   weapon_explodeCheck( curLayer, *nLayer, expl, n );
+#endif /* EXPL_CHECK */
 
    /* Now try to destroy the weapons affected. */
+   j = 0;
    for (i=0; i<*nLayer; i++) {
-      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(curLayer[i]->outfit)) ||
-            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(curLayer[i]->outfit))) {
+      if (weapon_explHit[i])
+         weapon_free( curLayer[i] );
+      else
+         curLayer[j++] = curLayer[i];
+   }
+   for (i=j; i<*nLayer; i++)
+      curLayer[i] = NULL;
+   *nLayer = j;
+}
+
+
+#if EXPL_CHECK
+/**
+ * @brief Checks the weapons marked in weapon_explHit are the ones the old
+ *        loop, run for each explosion in turn, destroys.
+ *
+ * The old loop removed the weapons as it went, which doesn't change which of
+ *  the others are caught, so marking them is enough.
+ */
+static void weapon_explodeCheck( Weapon **curLayer, int nLayer,
+      const ExplosionDamage *expl, int n )
+{
+   int i, k, mode;
+   double x, y, radius;
+   double dist, rad2;
 
-         dist = pow2(curLayer[i]->solid->pos.x - x) +
-               pow2(curLayer[i]->solid->pos.y - y);
+   if (weapon_explOld == NULL)
+      weapon_explOld = array_create( char );
+   array_resize( &weapon_explOld, nLayer );
+   memset( weapon_explOld, 0, nLayer );
 
-         if (dist < rad2) {
-            weapon_destroy(curLayer[i], layer);
-            i--;
+   for (k=0; k<n; k++) {
+      if (!(expl[k].mode & (EXPL_MODE_MISSILE | EXPL_MODE_BOLT)))
+         continue;
+      x      = expl[k].x;
+      y      = expl[k].y;
+      radius = expl[k].radius;
+      mode   = expl[k].mode;
+
+      rad2 = radius*radius;
+
+      /* Now try to destroy the weapons affected. */
+      for (i=0; i<nLayer; i++) {
+         if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(curLayer[i]->outfit)) ||
+               ((mode & EXPL_MODE_BOLT) && outfit_isBolt(curLayer[i]->outfit))) {
+
+            dist = pow2(curLayer[i]->solid->pos.x - x) +
+                  pow2(curLayer[i]->solid->pos.y - y);
+
+            if (dist < rad2)
+               weapon_explOld[i] = 1;
          }
       }
    }
+
+   for (i=0; i<nLayer; i++) {
+      if (weapon_explOld[i])
+         expl_checkWeapons++;
+      if (weapon_explOld[i] != weapon_explHit[i]) {
+         WARN(_("Explosions %s weapon at (%.0f,%.0f) the old loop %s"),
+               weapon_explHit[i] ? "caught" : "missed",
+               curLayer[i]->solid->pos.x, curLayer[i]->solid->pos.y,
+               weapon_explOld[i] ? "caught" : "missed");
+         expl_checkErrors++;
+      }
+   }
 }
+#endif /* EXPL_CHECK */
 
 